@@ -0,0 +1,95 @@
+#include "bench.hpp"
+
+#include <cmath>
+#include <functional>
+#include <map>
+
+#include "../tracer/PathTracer.hpp"
+
+static const std::map<std::string, std::function<int()>> benchmarks = {
+  {"wide-bvh", bench::wideBVH},
+  {"bvh-builders", bench::bvhBuilders},
+  {"lazy-bvh", bench::lazyBVH},
+  {"triangle-layout", bench::triangleLayout},
+  {"triangle-intersection", bench::triangleIntersection},
+  {"simd-intersection", bench::simdIntersection},
+  {"ray-streams", bench::rayStreams},
+  {"nee", bench::lightSampling},
+  {"roulette", bench::russianRoulette},
+  {"samplers", bench::samplers},
+  {"denoiser", bench::denoiser},
+};
+
+namespace bench {
+
+int run(const std::string& name) {
+  auto it = benchmarks.find(name);
+
+  if (it == benchmarks.end()) {
+    std::string names;
+    for (const auto& [benchName, _] : benchmarks)
+      names += " " + benchName;
+
+    warning(std::format("[bench::run] Unknown benchmark [{}], available:{}", name, names));
+    return 1;
+  }
+
+  return it->second();
+}
+
+std::vector<Ray> generateOrbitRays(const MeshInfo& meshInfo, u32 resolution, u32 numViews) {
+  vec3 center = (meshInfo.boundsMin + meshInfo.boundsMax) * 0.5f;
+  float radius = glm::length(meshInfo.boundsMax - meshInfo.boundsMin) * 0.5f;
+  float tanHalfFov = std::tan(glm::radians(45.f) * 0.5f);
+
+  std::vector<Ray> rays;
+  rays.reserve(resolution * resolution * numViews);
+
+  for (u32 view = 0; view < numViews; view++) {
+    float angle = PI * 2.f * view / numViews;
+    vec3 origin = center + vec3(std::sin(angle), 0.3f, std::cos(angle)) * radius * 2.5f;
+    vec3 forward = glm::normalize(center - origin);
+    vec3 right = glm::normalize(glm::cross(forward, global::up));
+    vec3 up = glm::cross(right, forward);
+
+    for (u32 y = 0; y < resolution; y++)
+      for (u32 x = 0; x < resolution; x++) {
+        vec2 ndc = (vec2(x, y) + 0.5f) / static_cast<float>(resolution) * 2.f - 1.f;
+        vec3 dir = forward + (right * ndc.x + up * ndc.y) * tanHalfFov;
+        rays.push_back({origin, glm::normalize(dir)});
+      }
+  }
+
+  return rays;
+}
+
+void setupPathTracer(PathTracer& pathTracer) {
+  pathTracer.loadScene();
+  pathTracer.setCamera(TRACER_DEFAULT_CAMERA);
+}
+
+std::vector<vec3> renderReference(const RayTracingData& rtData, uvec2 resolution, u32 numFrames) {
+  PathTracer pathTracer(resolution);
+  setupPathTracer(pathTracer);
+
+  std::vector<vec3> reference(resolution.x * resolution.y, vec3(0.f));
+  for (u32 i = 0; i < numFrames; i++)
+    pathTracer.renderRegion(uvec2(0u), resolution, BENCH_REFERENCE_FIRST_FRAME + i, rtData, TRACER_DEFAULT_LIGHT_POS, reference.data());
+
+  for (vec3& pixel : reference)
+    pixel /= static_cast<float>(numFrames);
+
+  return reference;
+}
+
+double calcRMSE(const std::vector<vec3>& image, float scale, const std::vector<vec3>& reference) {
+  double sum = 0.;
+  for (size_t i = 0; i < image.size(); i++) {
+    vec3 diff = image[i] * scale - reference[i];
+    sum += glm::dot(diff, diff);
+  }
+
+  return std::sqrt(sum / (image.size() * 3));
+}
+
+} // namespace bench
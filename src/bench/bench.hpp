@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../objects/MeshInfo.hpp"
+#include "../objects/Ray.hpp"
+
+#define BENCH_REFERENCE_FIRST_FRAME (1u << 20) // First frame of the reference renders, away from the measured ones
+
+class PathTracer;
+struct RayTracingData;
+
+// Headless CPU benchmarks, launched with `--bench <name>`
+namespace bench {
+  int run(const std::string& name);
+
+  // Primary rays of a pinhole camera orbiting the mesh at `numViews` angles, looking at its center
+  std::vector<Ray> generateOrbitRays(const MeshInfo& meshInfo, u32 resolution, u32 numViews);
+
+  // Loads the scene in the tracer and puts it at TRACER_DEFAULT_CAMERA
+  void setupPathTracer(PathTracer& pathTracer);
+
+  // Mean of numFrames frames from BENCH_REFERENCE_FIRST_FRAME on, at TRACER_DEFAULT_CAMERA
+  std::vector<vec3> renderReference(const RayTracingData& rtData, uvec2 resolution, u32 numFrames);
+
+  // Between `image` times `scale` and `reference`, over every channel
+  double calcRMSE(const std::vector<vec3>& image, float scale, const std::vector<vec3>& reference);
+
+  int wideBVH();
+  int bvhBuilders();
+  int lazyBVH();
+  int triangleLayout();
+  int triangleIntersection();
+  int simdIntersection();
+  int rayStreams();
+  int lightSampling();
+  int russianRoulette();
+  int samplers();
+  int denoiser();
+}
@@ -0,0 +1,158 @@
+#include "bench.hpp"
+
+#include <random>
+
+#include "../objects/MeshRT.hpp"
+#include "../objects/Scene.hpp"
+
+#define BENCH_BVH_BUILDERS_SOUP_TRIANGLES 1000000u
+#define BENCH_BVH_BUILDERS_SOUP_TRIANGLE_SIZE 0.01f
+#define BENCH_BVH_BUILDERS_REPEATS 3u
+
+struct BuildResult {
+  u32 builder;
+  double seconds = 0.;
+  BVHStats stats;
+};
+
+// Small random triangles scattered in the unit cube
+static std::vector<Triangle> generateSoup() {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  std::vector<Triangle> triangles(BENCH_BVH_BUILDERS_SOUP_TRIANGLES);
+
+  for (Triangle& tri : triangles) {
+    vec3 p(dist(rng), dist(rng), dist(rng));
+    tri.a = p;
+    tri.b = p + vec3(dist(rng), dist(rng), dist(rng)) * BENCH_BVH_BUILDERS_SOUP_TRIANGLE_SIZE;
+    tri.c = p + vec3(dist(rng), dist(rng), dist(rng)) * BENCH_BVH_BUILDERS_SOUP_TRIANGLE_SIZE;
+  }
+
+  return triangles;
+}
+
+static void printResults(const char* name, u32 numTriangles, const std::vector<BuildResult>& results) {
+  printf("\n%s, %u triangles, best of %u\n", name, numTriangles, BENCH_BVH_BUILDERS_REPEATS);
+  printf("%-18s %12s %10s %10s %8s\n", "builder", "build ms", "SAH cost", "nodes", "depth");
+
+  for (const BuildResult& result : results)
+    printf(
+      "%-18s %12.3f %10.3f %10u %8u\n",
+      BVH::getBuilderName(result.builder), result.seconds * 1e3, result.stats.sahCost, result.stats.numNodes, result.stats.depth
+    );
+}
+
+static std::vector<BuildResult> measure(const std::vector<Triangle>& triangles, const std::vector<u32>& builders) {
+  std::vector<BuildResult> results;
+
+  for (u32 builder : builders) {
+    BuildResult result{builder};
+    BVH bvh;
+
+    for (u32 repeat = 0; repeat < BENCH_BVH_BUILDERS_REPEATS; repeat++) {
+      bvh.build(triangles.data(), static_cast<u32>(triangles.size()), builder);
+      if (repeat == 0 || bvh.stats.buildTime < result.seconds) result.seconds = bvh.stats.buildTime;
+    }
+
+    result.stats = bvh.stats;
+    results.push_back(result);
+  }
+
+  return results;
+}
+
+// Hidden window for the GPU LBVH, null without a GL 4.6 context
+static GLFWwindow* createContext() {
+  if (!glfwInit())
+    return nullptr;
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, false);
+
+  GLFWwindow* window = glfwCreateWindow(1, 1, "bvh-builders", NULL, NULL);
+  if (!window) {
+    glfwTerminate();
+    return nullptr;
+  }
+
+  glfwMakeContextCurrent(window);
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return nullptr;
+  }
+
+  Shader::setDirectoryLocation("shaders");
+  scene::defineShaderConstants();
+  return window;
+}
+
+// The GPU pass computes the same codes and radix tree as the CPU, so both must give the same tree
+static bool compareLBVH(const char* name, const std::vector<Triangle>& triangles) {
+  BVH cpu, gpu;
+  cpu.build(triangles.data(), static_cast<u32>(triangles.size()), BVH_BUILDER_LBVH);
+  gpu.build(triangles.data(), static_cast<u32>(triangles.size()), BVH_BUILDER_LBVH_GPU);
+
+  u32 numDifferentNodes = cpu.nodes.size() == gpu.nodes.size() ? 0 : static_cast<u32>(cpu.nodes.size());
+  for (size_t i = 0; i < cpu.nodes.size() && i < gpu.nodes.size(); i++) {
+    const BVHNode& a = cpu.nodes[i];
+    const BVHNode& b = gpu.nodes[i];
+    if (a.leftFirst != b.leftFirst || a.numPrimitives != b.numPrimitives || a.boundsMin != b.boundsMin || a.boundsMax != b.boundsMax)
+      numDifferentNodes++;
+  }
+
+  bool isSame = numDifferentNodes == 0 && cpu.primIndices == gpu.primIndices;
+  printf("%s: GPU LBVH %s the CPU LBVH (%u different nodes)\n", name, isSame ? "matches" : "DIFFERS FROM", numDifferentNodes);
+  return isSame;
+}
+
+namespace bench {
+
+// Also prints the BVH report of scene3 and scene4. The GPU LBVH runs and is checked against the CPU one when a GL context can be made (not on a headless machine)
+int bvhBuilders() {
+  MeshRT knight;
+  knight.loadOBJ("res/obj/Knight.obj");
+  std::vector<Triangle> knightTriangles = knight.getTriangles();
+
+  // The scenes stay on the CPU, the GPU is only needed by the LBVH below
+  scene::setHeadless(true);
+  for (u32 sceneNumber : {3u, 4u}) {
+    RayTracingData rtData;
+    scene::load(sceneNumber, rtData);
+    scene::printBVHReport(std::format("scene{}", sceneNumber).c_str());
+  }
+  scene::setHeadless(false);
+
+  GLFWwindow* window = createContext();
+  std::vector<u32> knightBuilders = {BVH_BUILDER_SWEEP_SAH, BVH_BUILDER_BINNED_SAH, BVH_BUILDER_SPATIAL_SAH, BVH_BUILDER_LBVH};
+  // The sweep and spatial split builders take too long for a million primitives
+  std::vector<u32> soupBuilders = {BVH_BUILDER_BINNED_SAH, BVH_BUILDER_LBVH};
+  if (window) {
+    knightBuilders.push_back(BVH_BUILDER_LBVH_GPU);
+    soupBuilders.push_back(BVH_BUILDER_LBVH_GPU);
+  }
+
+  std::vector<BuildResult> knightResults = measure(knightTriangles, knightBuilders);
+  std::vector<Triangle> soup = generateSoup();
+  std::vector<BuildResult> soupResults = measure(soup, soupBuilders);
+
+  printResults("Knight", knight.getNumTriangles(), knightResults);
+  printResults("Triangle soup", static_cast<u32>(soup.size()), soupResults);
+
+  if (!window) {
+    printf("\nNo GL 4.6 context, the GPU LBVH was skipped\n");
+    return 0;
+  }
+
+  printf("\n");
+  bool isSame = compareLBVH("Knight", knightTriangles);
+  isSame &= compareLBVH("Triangle soup", soup);
+
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return isSame ? 0 : 1;
+}
+
+} // namespace bench
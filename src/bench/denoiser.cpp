@@ -0,0 +1,79 @@
+#include "bench.hpp"
+
+#include <chrono>
+
+#include "../objects/Scene.hpp"
+#include "../tracer/PathTracer.hpp"
+
+#define BENCH_DENOISER_RESOLUTION uvec2(160u, 96u)
+#define BENCH_DENOISER_MAX_SPP 256u // Of the raw renders, the denoised ones stop at BENCH_DENOISER_MAX_DENOISED_SPP
+#define BENCH_DENOISER_MAX_DENOISED_SPP 32u
+#define BENCH_DENOISER_REFERENCE_FRAMES 1024u
+
+namespace bench {
+
+// The denoiser on the CPU tracer on scene3, one sample per frame: the error of the raw and of the denoised average at
+// every power of 2 spp against a long render of other frames, then the raw spp reaching the error of each denoised
+// one. The filter is biased, its error stops going down where the raw one keeps on
+int denoiser() {
+  scene::setHeadless(true);
+  RayTracingData rtData;
+  scene::load(3, rtData);
+  rtData.numRaysPerPixel = 1;
+
+  uvec2 resolution = BENCH_DENOISER_RESOLUTION;
+  std::vector<vec3> reference = renderReference(rtData, resolution, BENCH_DENOISER_REFERENCE_FRAMES);
+
+  PathTracer pathTracer(BENCH_DENOISER_RESOLUTION);
+  setupPathTracer(pathTracer);
+
+  std::vector<double> rawRMSE;
+  std::vector<u32> denoisedSpps;
+  std::vector<double> denoisedRMSE;
+  double renderSeconds = 0.;
+  double denoiseSeconds = 0.;
+  for (u32 spp = 1; spp <= BENCH_DENOISER_MAX_SPP; spp++) {
+    auto start = std::chrono::steady_clock::now();
+    pathTracer.renderFrame(rtData, TRACER_DEFAULT_LIGHT_POS);
+    renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    rawRMSE.push_back(calcRMSE(pathTracer.getAccumulated(), 1.f / spp, reference));
+
+    if ((spp & (spp - 1)) == 0 && spp <= BENCH_DENOISER_MAX_DENOISED_SPP) {
+      start = std::chrono::steady_clock::now();
+      std::vector<vec3> denoised = pathTracer.denoise(rtData, rtData.denoiseIterations);
+      denoiseSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      denoisedSpps.push_back(spp);
+      denoisedRMSE.push_back(calcRMSE(denoised, 1.f, reference));
+    }
+  }
+
+  printf(
+    "\n%ux%u, %d bounces, %d iterations, reference of %u frames\n", resolution.x, resolution.y, rtData.numRayBounces,
+    rtData.denoiseIterations, BENCH_DENOISER_REFERENCE_FRAMES
+  );
+  printf("%-8s %10s %10s %10s %14s\n", "spp", "raw", "denoised", "raw spp", "fewer samples");
+
+  for (size_t i = 0; i < denoisedSpps.size(); i++) {
+    u32 spp = denoisedSpps[i];
+    u32 rawSpp = 0;
+    for (size_t j = 0; j < rawRMSE.size() && rawSpp == 0; j++)
+      if (rawRMSE[j] <= denoisedRMSE[i])
+        rawSpp = static_cast<u32>(j + 1);
+
+    printf("%-8u %10.5f %10.5f ", spp, rawRMSE[spp - 1], denoisedRMSE[i]);
+    if (rawSpp > 0)
+      printf("%10u %13.2fx\n", rawSpp, static_cast<double>(rawSpp) / spp);
+    else
+      printf("%10s %13s\n", std::format("> {}", BENCH_DENOISER_MAX_SPP).c_str(), "-");
+  }
+
+  printf(
+    "ms: %.3f per frame, %.3f per denoise (features and filter)\n", renderSeconds / BENCH_DENOISER_MAX_SPP * 1e3,
+    denoiseSeconds / denoisedSpps.size() * 1e3
+  );
+
+  return 0;
+}
+
+} // namespace bench
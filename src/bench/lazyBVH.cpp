@@ -0,0 +1,134 @@
+#include "bench.hpp"
+
+#include <chrono>
+
+#include "../engine/ThreadPool.hpp"
+#include "../objects/bvh/LazyBVH.hpp"
+
+#define BENCH_LAZY_BVH_GRID_SIZE 1024u // Quads per side of the terrain, 2 triangles each
+#define BENCH_LAZY_BVH_RESOLUTION 256u
+
+// Wavy height field in [0, 1] x [0, 1], facing up
+static std::vector<Triangle> generateTerrain() {
+  u32 n = BENCH_LAZY_BVH_GRID_SIZE;
+  std::vector<Triangle> triangles;
+  triangles.reserve(n * n * 2);
+
+  auto vertex = [n](u32 x, u32 z) {
+    vec2 p = vec2(x, z) / static_cast<float>(n);
+    return vec3(p.x, 0.02f * std::sin(p.x * 40.f) * std::cos(p.y * 40.f), p.y);
+  };
+
+  for (u32 z = 0; z < n; z++)
+    for (u32 x = 0; x < n; x++) {
+      Triangle tri{};
+      tri.a = vertex(x, z);
+      tri.b = vertex(x, z + 1);
+      tri.c = vertex(x + 1, z);
+      triangles.push_back(tri);
+
+      tri.a = vertex(x + 1, z);
+      tri.b = vertex(x, z + 1);
+      tri.c = vertex(x + 1, z + 1);
+      triangles.push_back(tri);
+    }
+
+  return triangles;
+}
+
+// A close-up of one corner, most of the terrain is never reached
+static std::vector<Ray> generateRays() {
+  vec3 origin(0.1f, 0.15f, 0.1f);
+  vec3 forward = glm::normalize(vec3(0.2f, 0.f, 0.2f) - origin);
+  vec3 right = glm::normalize(glm::cross(forward, global::up));
+  vec3 up = glm::cross(right, forward);
+  float tanHalfFov = std::tan(glm::radians(60.f) * 0.5f);
+
+  std::vector<Ray> rays;
+  rays.reserve(BENCH_LAZY_BVH_RESOLUTION * BENCH_LAZY_BVH_RESOLUTION);
+
+  for (u32 y = 0; y < BENCH_LAZY_BVH_RESOLUTION; y++)
+    for (u32 x = 0; x < BENCH_LAZY_BVH_RESOLUTION; x++) {
+      vec2 ndc = (vec2(x, y) + 0.5f) / static_cast<float>(BENCH_LAZY_BVH_RESOLUTION) * 2.f - 1.f;
+      rays.push_back({origin, glm::normalize(forward + (right * ndc.x + up * ndc.y) * tanHalfFov)});
+    }
+
+  return rays;
+}
+
+// Traces every ray on the thread pool, returns the closest hit distances
+template<typename Traverse>
+static std::vector<float> trace(const std::vector<Ray>& rays, Traverse&& traverse) {
+  std::vector<float> dsts(rays.size());
+
+  ThreadPool::get().parallelFor(static_cast<u32>(rays.size()), [&](u32 begin, u32 end) {
+    for (u32 i = begin; i < end; i++)
+      dsts[i] = traverse(rays[i]);
+  }, BENCH_LAZY_BVH_RESOLUTION);
+
+  return dsts;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+namespace bench {
+
+int lazyBVH() {
+  std::vector<Triangle> triangles = generateTerrain();
+  std::vector<Ray> rays = generateRays();
+  u32 numTriangles = static_cast<u32>(triangles.size());
+
+  auto intersectTriangle = [&](const Ray& ray) {
+    return [&](u32 triIdx, float& closestDst) {
+      intersect::TriangleHit hit = intersect::rayTriangle(ray, triangles[triIdx]);
+      if (hit.didHit && hit.dst < closestDst) closestDst = hit.dst;
+    };
+  };
+
+  // ===== Eager ============================================ //
+
+  auto start = std::chrono::steady_clock::now();
+
+  BVH eager;
+  eager.build(triangles.data(), numTriangles);
+  std::vector<float> reference = trace(rays, [&](const Ray& ray) {
+    float dst = FLT_MAX;
+    eager.intersect(ray, dst, intersectTriangle(ray));
+    return dst;
+  });
+
+  double eagerFirstImage = secondsSince(start);
+
+  // ===== Lazy ============================================= //
+
+  start = std::chrono::steady_clock::now();
+
+  LazyBVH lazy;
+  lazy.build(triangles.data(), numTriangles);
+  std::vector<float> dsts = trace(rays, [&](const Ray& ray) {
+    float dst = FLT_MAX;
+    lazy.intersect(ray, dst, intersectTriangle(ray));
+    return dst;
+  });
+
+  double lazyFirstImage = secondsSince(start);
+  u32 numBuiltSubtrees = lazy.stats.numBuiltSubtrees;
+
+  lazy.finish();
+
+  u32 numMismatches = 0;
+  for (size_t i = 0; i < dsts.size(); i++)
+    numMismatches += dsts[i] != reference[i];
+
+  printf("\n%u triangles, %u rays, %u threads\n", numTriangles, static_cast<u32>(rays.size()), ThreadPool::get().getNumThreads());
+  printf("%-6s %18s %14s %10s %10s\n", "build", "first image ms", "build ms", "SAH cost", "nodes");
+  printf("%-6s %18.3f %14.3f %10.3f %10u\n", "eager", eagerFirstImage * 1e3, eager.stats.buildTime * 1e3, eager.stats.sahCost, eager.stats.numNodes);
+  printf("%-6s %18.3f %14.3f %10.3f %10u\n", "lazy", lazyFirstImage * 1e3, lazy.bvh.stats.buildTime * 1e3, lazy.bvh.stats.sahCost, lazy.bvh.stats.numNodes);
+  printf("Subtrees built for the first image: %u of %u, mismatches: %u\n", numBuiltSubtrees, lazy.stats.numSubtrees, numMismatches);
+
+  return numMismatches == 0 ? 0 : 1;
+}
+
+} // namespace bench
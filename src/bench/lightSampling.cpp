@@ -0,0 +1,81 @@
+#include "bench.hpp"
+
+#include <thread>
+
+#include "../engine/RenderBudget.hpp"
+#include "../objects/Scene.hpp"
+#include "../tracer/PathTracer.hpp"
+
+#define BENCH_NEE_RESOLUTION uvec2(160u, 96u)
+#define BENCH_NEE_REFERENCE_FRAMES 512u
+#define BENCH_NEE_SECONDS 2.
+
+struct LightSamplingResult {
+  u32 numFrames = 0;
+  u32 spp = 0;
+  double seconds = 0.;
+  u64 numRays = 0;
+  double rmse = 0.;
+};
+
+static LightSamplingResult renderEqualTime(RayTracingData rtData, bool useLightSampling, const std::vector<vec3>& reference) {
+  rtData.useLightSampling = useLightSampling;
+  PathTracer pathTracer(BENCH_NEE_RESOLUTION);
+  bench::setupPathTracer(pathTracer);
+  RenderBudget budget(BENCH_NEE_SECONDS);
+
+  budget.start();
+  while (budget.hasRoomForFrame()) {
+    u64 numRays = pathTracer.getNumRays();
+    pathTracer.renderFrame(rtData, TRACER_DEFAULT_LIGHT_POS);
+    budget.addFrame(rtData.numRaysPerPixel, pathTracer.getNumRays() - numRays);
+  }
+  budget.stop();
+
+  LightSamplingResult result;
+  result.numFrames = budget.getNumFrames();
+  result.spp = budget.getSpp();
+  result.seconds = budget.getElapsed();
+  result.numRays = budget.getNumRays();
+  result.rmse = bench::calcRMSE(pathTracer.getAccumulated(), 1.f / pathTracer.getNumFrames(), reference);
+
+  return result;
+}
+
+namespace bench {
+
+// Bounces only against next-event estimation with MIS in the CPU tracer on scene3 (the Knight in the room lit by
+// the lamp quad), each given the same time. The error is against a long light sampled render of other frames. The
+// frames aren't clamped, both estimators converge to the reference and the RMSE ratio is the one of their noise
+int lightSampling() {
+  scene::setHeadless(true);
+  RayTracingData rtData;
+  scene::load(3, rtData);
+
+  uvec2 resolution = BENCH_NEE_RESOLUTION;
+  std::vector<vec3> reference = renderReference(rtData, resolution, BENCH_NEE_REFERENCE_FRAMES);
+
+  LightSamplingResult bounces = renderEqualTime(rtData, false, reference);
+  LightSamplingResult lightSampling = renderEqualTime(rtData, true, reference);
+
+  printf(
+    "\n%ux%u, %.1f s each, %d bounces, %u threads, %d emitters, reference of %u frames\n", resolution.x, resolution.y,
+    BENCH_NEE_SECONDS, rtData.numRayBounces, std::max(std::thread::hardware_concurrency(), 1u), rtData.numEmitters,
+    BENCH_NEE_REFERENCE_FRAMES
+  );
+  printf("%-16s %8s %8s %10s %10s\n", "estimator", "frames", "spp", "Mrays/s", "RMSE");
+
+  auto printResult = [](const char* name, const LightSamplingResult& result) {
+    printf(
+      "%-16s %8u %8u %10.3f %10.5f\n", name, result.numFrames, result.spp, result.numRays / result.seconds * 1e-6, result.rmse
+    );
+  };
+
+  printResult("bounces", bounces);
+  printResult("NEE + MIS", lightSampling);
+  printf("RMSE ratio at equal time: %.2fx\n", bounces.rmse / lightSampling.rmse);
+
+  return 0;
+}
+
+} // namespace bench
@@ -0,0 +1,97 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include "../engine/PerfCounters.hpp"
+#include "../objects/Scene.hpp"
+#include "../tracer/PathTracer.hpp"
+
+#define BENCH_RAY_STREAMS_RESOLUTION uvec2(320u, 192u)
+#define BENCH_RAY_STREAMS_FRAMES 2u
+#define BENCH_RAY_STREAMS_BOUNCES 5 // More scattered bounces than the scene default
+
+struct StreamsResult {
+  double seconds = 0.;
+  u64 numRays = 0;
+  u64 counters[PERF_COUNTER_COUNT] = {};
+  bool hasCounters[PERF_COUNTER_COUNT] = {};
+  std::vector<vec3> accumulated;
+};
+
+static StreamsResult renderScene(const RayTracingData& rtData, bool useRayStreams) {
+  StreamsResult result;
+  PerfCounters counters;
+
+  {
+    PathTracer pathTracer(BENCH_RAY_STREAMS_RESOLUTION);
+    bench::setupPathTracer(pathTracer);
+    pathTracer.setRayStreams(useRayStreams);
+
+    counters.start();
+    auto start = std::chrono::steady_clock::now();
+
+    for (u32 i = 0; i < BENCH_RAY_STREAMS_FRAMES; i++)
+      pathTracer.renderFrame(rtData, TRACER_DEFAULT_LIGHT_POS);
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    counters.stop();
+
+    result.numRays = pathTracer.getNumRays();
+    result.accumulated = pathTracer.getAccumulated();
+  }
+
+  // Workers have exited, their counts are in
+  for (u32 i = 0; i < PERF_COUNTER_COUNT; i++) {
+    result.counters[i] = counters.get(i);
+    result.hasCounters[i] = counters.isAvailable(i);
+  }
+
+  return result;
+}
+
+namespace bench {
+
+// Depth first paths against sorted ray streams in the CPU tracer on scene3 (the Knight in the room): path segments
+// per second and, where perf_event is available, cache misses per segment. Both must render the same image
+int rayStreams() {
+  scene::setHeadless(true);
+  RayTracingData rtData;
+  scene::scene3(rtData);
+  rtData.numRayBounces = BENCH_RAY_STREAMS_BOUNCES;
+
+  StreamsResult depthFirst = renderScene(rtData, false);
+  StreamsResult streams = renderScene(rtData, true);
+
+  uvec2 resolution = BENCH_RAY_STREAMS_RESOLUTION;
+  printf(
+    "\n%ux%u, %u frames, %d bounces, %u threads\n", resolution.x, resolution.y, BENCH_RAY_STREAMS_FRAMES,
+    rtData.numRayBounces, std::max(std::thread::hardware_concurrency(), 1u)
+  );
+
+  printf("%-12s %10s %12s %10s", "mode", "seconds", "segments", "Mrays/s");
+  for (u32 i = 0; i < PERF_COUNTER_COUNT; i++)
+    printf(" %16s", (std::string(PerfCounters::getName(i)) + "/ray").c_str());
+  printf("\n");
+
+  auto printResult = [](const char* name, const StreamsResult& result) {
+    printf("%-12s %10.3f %12llu %10.3f", name, result.seconds, static_cast<unsigned long long>(result.numRays), result.numRays / result.seconds * 1e-6);
+    for (u32 i = 0; i < PERF_COUNTER_COUNT; i++) {
+      if (result.hasCounters[i])
+        printf(" %16.2f", static_cast<double>(result.counters[i]) / result.numRays);
+      else
+        printf(" %16s", "n/a");
+    }
+    printf("\n");
+  };
+
+  printResult("depth first", depthFirst);
+  printResult("streams", streams);
+
+  bool isSame = depthFirst.numRays == streams.numRays && depthFirst.accumulated == streams.accumulated;
+  if (!isSame) printf("Ray streams don't render the same image as depth first\n");
+
+  return isSame ? 0 : 1;
+}
+
+} // namespace bench
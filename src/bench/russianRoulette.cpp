@@ -0,0 +1,110 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "../objects/Scene.hpp"
+#include "../tracer/PathTracer.hpp"
+
+#define BENCH_ROULETTE_RESOLUTION uvec2(160u, 96u)
+#define BENCH_ROULETTE_FRAMES 32u
+#define BENCH_ROULETTE_BOUNCES 64 // The top of the GUI slider range, where the fixed depth pays the most
+
+struct RouletteResult {
+  double seconds = 0.;
+  u64 numRays = 0;
+  double meanPathLength = 0.;
+  double meanRadiance = 0.;
+  std::vector<double> frameRadiances; // Mean over the image of every frame alone
+  std::vector<vec3> image;
+};
+
+static double calcMeanRadiance(const std::vector<vec3>& image) {
+  double sum = 0.;
+  for (const vec3& pixel : image)
+    sum += (pixel.r + pixel.g + pixel.b) / 3.f;
+
+  return sum / image.size();
+}
+
+static RouletteResult renderScene(RayTracingData rtData, bool useRussianRoulette) {
+  rtData.useRussianRoulette = useRussianRoulette;
+
+  PathTracer pathTracer(BENCH_ROULETTE_RESOLUTION);
+  bench::setupPathTracer(pathTracer);
+
+  RouletteResult result;
+  double prevRadiance = 0.;
+  for (u32 i = 0; i < BENCH_ROULETTE_FRAMES; i++) {
+    auto start = std::chrono::steady_clock::now();
+    pathTracer.renderFrame(rtData, TRACER_DEFAULT_LIGHT_POS);
+    result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double radiance = calcMeanRadiance(pathTracer.getAccumulated());
+    result.frameRadiances.push_back(radiance - prevRadiance);
+    prevRadiance = radiance;
+  }
+
+  result.numRays = pathTracer.getNumRays();
+  result.meanPathLength = pathTracer.getMeanPathLength();
+  result.image = pathTracer.getAccumulated();
+
+  for (vec3& pixel : result.image)
+    pixel /= static_cast<float>(BENCH_ROULETTE_FRAMES);
+  result.meanRadiance = calcMeanRadiance(result.image);
+
+  return result;
+}
+
+namespace bench {
+
+// Fixed depth paths against the Russian roulette in the CPU tracer on scene3 at a high bounce cap, same frames for
+// both: time and mean path length, and how far the images are. The frames aren't clamped, so an unbiased roulette
+// keeps the mean radiance within the standard error of the per-frame differences
+int russianRoulette() {
+  scene::setHeadless(true);
+  RayTracingData rtData;
+  scene::load(3, rtData);
+  rtData.numRayBounces = BENCH_ROULETTE_BOUNCES;
+
+  RouletteResult fixedDepth = renderScene(rtData, false);
+  RouletteResult roulette = renderScene(rtData, true);
+
+  double rmse = bench::calcRMSE(roulette.image, 1.f, fixedDepth.image);
+
+  // The frames share their seeds, so their differences are paired
+  double meanDiff = 0.;
+  double sumSquaredDiff = 0.;
+  for (u32 i = 0; i < BENCH_ROULETTE_FRAMES; i++) {
+    double diff = roulette.frameRadiances[i] - fixedDepth.frameRadiances[i];
+    meanDiff += diff;
+    sumSquaredDiff += diff * diff;
+  }
+  meanDiff /= BENCH_ROULETTE_FRAMES;
+  double variance = (sumSquaredDiff - BENCH_ROULETTE_FRAMES * meanDiff * meanDiff) / (BENCH_ROULETTE_FRAMES - 1);
+  double standardError = std::sqrt(std::max(variance, 0.) / BENCH_ROULETTE_FRAMES);
+
+  uvec2 resolution = BENCH_ROULETTE_RESOLUTION;
+  printf(
+    "\n%ux%u, %u frames, at most %d bounces, roulette after %d, %u threads\n", resolution.x, resolution.y,
+    BENCH_ROULETTE_FRAMES, rtData.numRayBounces, rtData.rouletteMinBounces, std::max(std::thread::hardware_concurrency(), 1u)
+  );
+  printf("%-12s %10s %12s %10s %14s\n", "paths", "seconds", "rays", "bounces", "mean radiance");
+
+  auto printResult = [](const char* name, const RouletteResult& result) {
+    printf(
+      "%-12s %10.3f %12llu %10.2f %14.5f\n", name, result.seconds, static_cast<unsigned long long>(result.numRays),
+      result.meanPathLength, result.meanRadiance
+    );
+  };
+
+  printResult("fixed depth", fixedDepth);
+  printResult("roulette", roulette);
+  printf("Speedup: %.2fx, RMSE between the images: %.5f\n", fixedDepth.seconds / roulette.seconds, rmse);
+  printf("Mean radiance difference (roulette - fixed depth): %.5f +- %.5f standard error\n", meanDiff, standardError);
+
+  return 0;
+}
+
+} // namespace bench
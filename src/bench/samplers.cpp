@@ -0,0 +1,105 @@
+#include "bench.hpp"
+
+#include <chrono>
+
+#include "../objects/Scene.hpp"
+#include "../tracer/PathTracer.hpp"
+
+#define BENCH_SAMPLERS_RESOLUTION uvec2(160u, 96u)
+#define BENCH_SAMPLERS_MAX_SPP 64u
+#define BENCH_SAMPLERS_REFERENCE_FRAMES 1024u
+
+struct SamplerResult {
+  std::vector<double> rmse; // After every frame of one sample
+  double seconds = 0.;
+};
+
+static const char* samplerNames[RT_SAMPLER_COUNT] = {"random", "sobol", "lattice"};
+
+static SamplerResult renderSampler(RayTracingData rtData, u32 samplerType, const std::vector<vec3>& reference) {
+  rtData.samplerType = static_cast<int>(samplerType);
+  PathTracer pathTracer(BENCH_SAMPLERS_RESOLUTION);
+  bench::setupPathTracer(pathTracer);
+
+  SamplerResult result;
+  for (u32 i = 0; i < BENCH_SAMPLERS_MAX_SPP; i++) {
+    auto start = std::chrono::steady_clock::now();
+    pathTracer.renderFrame(rtData, TRACER_DEFAULT_LIGHT_POS);
+    result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.rmse.push_back(bench::calcRMSE(pathTracer.getAccumulated(), 1.f / pathTracer.getNumFrames(), reference));
+  }
+
+  return result;
+}
+
+// First spp at or under the error, 0 past the measured ones
+static u32 findSppForError(const SamplerResult& result, double rmse) {
+  for (size_t i = 0; i < result.rmse.size(); i++)
+    if (result.rmse[i] <= rmse)
+      return static_cast<u32>(i + 1);
+
+  return 0;
+}
+
+namespace bench {
+
+// Convergence of the samplers in the CPU tracer on scene3, one sample per frame: the error at every power of 2 spp
+// against a long render of other frames with the hash RNG, then how many samples each one needs to reach the error
+// of the hash RNG at the most spp. The samples are the same for rt.frag
+int samplers() {
+  scene::setHeadless(true);
+  RayTracingData rtData;
+  scene::load(3, rtData);
+  rtData.numRaysPerPixel = 1;
+
+  uvec2 resolution = BENCH_SAMPLERS_RESOLUTION;
+  RayTracingData referenceData = rtData;
+  referenceData.samplerType = RT_SAMPLER_RANDOM;
+  std::vector<vec3> reference = renderReference(referenceData, resolution, BENCH_SAMPLERS_REFERENCE_FRAMES);
+
+  std::vector<SamplerResult> results;
+  for (u32 i = 0; i < RT_SAMPLER_COUNT; i++)
+    results.push_back(renderSampler(rtData, i, reference));
+
+  printf(
+    "\n%ux%u, %d bounces, reference of %u frames with the hash RNG\n", resolution.x, resolution.y, rtData.numRayBounces,
+    BENCH_SAMPLERS_REFERENCE_FRAMES
+  );
+
+  printf("%-8s", "spp");
+  for (u32 i = 0; i < RT_SAMPLER_COUNT; i++)
+    printf(" %10s", samplerNames[i]);
+  printf("\n");
+
+  for (u32 spp = 1; spp <= BENCH_SAMPLERS_MAX_SPP; spp *= 2) {
+    printf("%-8u", spp);
+    for (const SamplerResult& result : results)
+      printf(" %10.5f", result.rmse[spp - 1]);
+    printf("\n");
+  }
+
+  printf("%-8s", "ms/frame");
+  for (const SamplerResult& result : results)
+    printf(" %10.3f", result.seconds / BENCH_SAMPLERS_MAX_SPP * 1e3);
+  printf("\n");
+
+  // The time is the mean frame time of the sampler at the spp it needs, its draws cost more than the hash RNG
+  const SamplerResult& random = results[RT_SAMPLER_RANDOM];
+  double targetRMSE = random.rmse.back();
+  printf("\nSpp to reach the error of %u random samples (%.5f):\n", BENCH_SAMPLERS_MAX_SPP, targetRMSE);
+  for (u32 i = 0; i < RT_SAMPLER_COUNT; i++) {
+    u32 spp = findSppForError(results[i], targetRMSE);
+    if (spp > 0)
+      printf(
+        "%-8s %4u (%.2fx fewer samples, %.2fx less time)\n", samplerNames[i], spp, static_cast<double>(BENCH_SAMPLERS_MAX_SPP) / spp,
+        random.seconds / (results[i].seconds / BENCH_SAMPLERS_MAX_SPP * spp)
+      );
+    else
+      printf("%-8s  > %u\n", samplerNames[i], BENCH_SAMPLERS_MAX_SPP);
+  }
+
+  return 0;
+}
+
+} // namespace bench
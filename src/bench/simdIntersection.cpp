@@ -0,0 +1,204 @@
+#include "bench.hpp"
+
+#include <chrono>
+
+#include "../objects/MeshRT.hpp"
+#include "../objects/bvh/SimdBVH.hpp"
+
+#define BENCH_SIMD_INTERSECTION_RESOLUTION 256u
+#define BENCH_SIMD_INTERSECTION_NUM_VIEWS 4u
+#define BENCH_SIMD_INTERSECTION_REPEATS 5u
+
+struct SimdHit {
+  float dst = FLT_MAX;
+  u32 triIdx = BVH_INVALID_INDEX;
+  float u = 0.f;
+  float v = 0.f;
+
+  bool operator==(const SimdHit&) const = default;
+};
+
+struct PacketPair {
+  u32 rayIdx;
+  u32 idx; // Packet or node
+};
+
+// Best of a few runs, in seconds
+template<typename Run>
+static double timeRuns(Run&& run) {
+  double best = FLT_MAX;
+
+  for (u32 r = 0; r < BENCH_SIMD_INTERSECTION_REPEATS; r++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  return best;
+}
+
+namespace bench {
+
+// One ray against 8 triangles and against 8 boxes with the scalar, SSE4 and AVX2 kernels, then whole closest hit
+// traversals of the SIMD BVH. Every level must give the same results as the scalar WideBVH walk
+int simdIntersection() {
+  MeshRT knight;
+  knight.loadOBJ("res/obj/Knight.obj");
+  knight.buildBVH();
+
+  SimdBVH simdBVH;
+  simdBVH.build(knight.wideBVH, knight.vertices, knight.indices);
+
+  std::vector<Triangle> triangles = knight.getTriangles();
+  std::vector<Ray> rays = generateOrbitRays(knight.meshInfo, BENCH_SIMD_INTERSECTION_RESOLUTION, BENCH_SIMD_INTERSECTION_NUM_VIEWS);
+  u32 numPackets = static_cast<u32>(simdBVH.packets.size());
+
+  // ===== Reference ======================================== //
+
+  std::vector<SimdHit> reference(rays.size());
+  double referenceSeconds = timeRuns([&]() {
+    for (size_t i = 0; i < rays.size(); i++) {
+      SimdHit hit;
+      knight.wideBVH.intersect(rays[i], hit.dst, [&](u32 triIdx, float& closestDst) {
+        intersect::TriangleHit triHit = intersect::rayTriangle(rays[i], triangles[triIdx]);
+        if (triHit.didHit && triHit.dst < closestDst) {
+          closestDst = triHit.dst;
+          hit = {triHit.dst, triIdx, triHit.u, triHit.v};
+        }
+      });
+      reference[i] = hit;
+    }
+  });
+
+  // Kernel inputs: the packet holding the hit and its neighbours, and the node holding that packet and the root.
+  // Mostly hits and near misses, like the leaves and nodes a traversal ends on
+  std::vector<u32> packetOfTriangle(knight.getNumTriangles());
+  std::vector<u32> nodeOfPacket(numPackets);
+
+  for (u32 p = 0; p < numPackets; p++)
+    for (u32 lane = 0; lane < simdBVH.packets[p].numTriangles; lane++)
+      packetOfTriangle[simdBVH.packets[p].primIndices[lane]] = p;
+
+  for (u32 n = 0; n < simdBVH.nodes.size(); n++)
+    for (u32 i = 0; i < simdBVH.nodes[n].numChildren; i++) {
+      u32 ref = simdBVH.nodes[n].childRefs[i];
+      if (!(ref & WIDE_BVH_LEAF_BIT)) continue;
+
+      u32 first = ref & WIDE_BVH_LEAF_MAX_FIRST;
+      for (u32 p = first; p < first + ((ref >> 24) & WIDE_BVH_LEAF_MAX_PRIMITIVES); p++)
+        nodeOfPacket[p] = n;
+    }
+
+  std::vector<PacketPair> trianglePairs, boxPairs;
+  for (u32 i = 0; i < rays.size(); i++) {
+    if (reference[i].triIdx == BVH_INVALID_INDEX) continue;
+
+    u32 p = packetOfTriangle[reference[i].triIdx];
+    for (u32 q = p > 0 ? p - 1 : p; q <= std::min(p + 1, numPackets - 1); q++)
+      trianglePairs.push_back({i, q});
+
+    boxPairs.push_back({i, nodeOfPacket[p]});
+    boxPairs.push_back({i, 0});
+  }
+
+  std::vector<vec3> invDirs(rays.size());
+  for (size_t i = 0; i < rays.size(); i++)
+    invDirs[i] = 1.f / rays[i].dir;
+
+  // ===== Levels =========================================== //
+
+  struct LevelResult {
+    u32 level;
+    double triangleSeconds;
+    double boxSeconds;
+    double traversalSeconds;
+    u32 numMismatches;
+  };
+
+  std::vector<LevelResult> results;
+  std::vector<SimdHit> scalarTriangleHits;
+  std::vector<float> scalarBoxDsts;
+  u32 initialLevel = simd::getLevel();
+
+  for (u32 level = SIMD_LEVEL_SCALAR; level <= simd::getMaxLevel(); level++) {
+    simd::setLevel(level);
+    const simd::Kernels& kernels = simd::getKernels();
+    LevelResult result{level, 0., 0., 0., 0};
+
+    std::vector<SimdHit> triangleHits(trianglePairs.size());
+    result.triangleSeconds = timeRuns([&]() {
+      for (size_t i = 0; i < trianglePairs.size(); i++) {
+        const TrianglePacket& packet = simdBVH.packets[trianglePairs[i].idx];
+        intersect::TriangleHit hit;
+        int lane = kernels.rayTriangles(rays[trianglePairs[i].rayIdx], packet, FLT_MAX, hit);
+        triangleHits[i] = lane >= 0 ? SimdHit{hit.dst, packet.primIndices[lane], hit.u, hit.v} : SimdHit{};
+      }
+    });
+
+    std::vector<float> boxDsts(boxPairs.size() * SIMD_WIDTH);
+    result.boxSeconds = timeRuns([&]() {
+      for (size_t i = 0; i < boxPairs.size(); i++) {
+        const SimdBVHNode& node = simdBVH.nodes[boxPairs[i].idx];
+        kernels.rayBoxes(rays[boxPairs[i].rayIdx], invDirs[boxPairs[i].rayIdx], node.childBounds, node.numChildren, FLT_MAX, &boxDsts[i * SIMD_WIDTH]);
+      }
+    });
+
+    std::vector<SimdHit> hits(rays.size());
+    result.traversalSeconds = timeRuns([&]() {
+      for (size_t i = 0; i < rays.size(); i++) {
+        SimdHit hit;
+        vec2 barycentric;
+        hit.triIdx = simdBVH.intersect(rays[i], hit.dst, barycentric);
+        if (hit.triIdx != BVH_INVALID_INDEX) {
+          hit.u = barycentric.x;
+          hit.v = barycentric.y;
+        }
+        hits[i] = hit;
+      }
+    });
+
+    if (level == SIMD_LEVEL_SCALAR) {
+      scalarTriangleHits = triangleHits;
+      scalarBoxDsts = boxDsts;
+    }
+
+    for (size_t i = 0; i < rays.size(); i++)
+      result.numMismatches += !(hits[i] == reference[i]);
+    for (size_t i = 0; i < triangleHits.size(); i++)
+      result.numMismatches += !(triangleHits[i] == scalarTriangleHits[i]);
+    for (size_t i = 0; i < boxDsts.size(); i++)
+      result.numMismatches += boxDsts[i] != scalarBoxDsts[i];
+
+    results.push_back(result);
+  }
+
+  simd::setLevel(initialLevel);
+
+  // ===== Report =========================================== //
+
+  double numRays = static_cast<double>(rays.size());
+  double numTrianglePairs = static_cast<double>(trianglePairs.size());
+  double numBoxPairs = static_cast<double>(boxPairs.size());
+  const LevelResult& scalar = results[0];
+
+  printf("\n%u triangles, %u packets, %zu nodes (%u bytes), %u rays (%u views of %ux%u)\n", knight.getNumTriangles(), numPackets, simdBVH.nodes.size(), simdBVH.getNumBytes(), static_cast<u32>(rays.size()), BENCH_SIMD_INTERSECTION_NUM_VIEWS, BENCH_SIMD_INTERSECTION_RESOLUTION, BENCH_SIMD_INTERSECTION_RESOLUTION);
+  printf("%-8s %16s %16s %16s %10s\n", "kernels", "Mtri packets/s", "Mbox packets/s", "Mrays/s", "mismatches");
+  printf("%-8s %16s %16s %16.2f %10s\n", "wide BVH", "-", "-", numRays / referenceSeconds * 1e-6, "-");
+
+  bool isSame = true;
+  for (const LevelResult& result : results) {
+    printf(
+      "%-8s %9.2f (%4.2fx) %9.2f (%4.2fx) %9.2f (%4.2fx) %10u\n", simd::getLevelName(result.level),
+      numTrianglePairs / result.triangleSeconds * 1e-6, scalar.triangleSeconds / result.triangleSeconds,
+      numBoxPairs / result.boxSeconds * 1e-6, scalar.boxSeconds / result.boxSeconds,
+      numRays / result.traversalSeconds * 1e-6, scalar.traversalSeconds / result.traversalSeconds, result.numMismatches
+    );
+    isSame = isSame && result.numMismatches == 0;
+  }
+
+  if (!isSame) printf("SIMD kernels don't match the scalar reference\n");
+
+  return isSame ? 0 : 1;
+}
+
+} // namespace bench
@@ -0,0 +1,202 @@
+#include "bench.hpp"
+
+#include <chrono>
+
+#include "../objects/MeshRT.hpp"
+#include "../objects/PackedMesh.hpp"
+#include "../objects/bvh/BVH.hpp"
+
+#define BENCH_TRIANGLE_INTERSECTION_RESOLUTION 256u
+#define BENCH_TRIANGLE_INTERSECTION_NUM_VIEWS 4u
+#define BENCH_TRIANGLE_INTERSECTION_REPEATS 5u
+#define BENCH_TRIANGLE_INTERSECTION_GRID_SIZE 64u // Quads per side of the leak test grid
+
+struct TestPair {
+  u32 rayIdx;
+  u32 triIdx;
+};
+
+// Sum of the hit distances, keeps the loops from being optimized out and tells if two variants agree
+struct TestResult {
+  double seconds = FLT_MAX;
+  u32 numHits = 0;
+  double sumDst = 0.;
+};
+
+template<typename Test>
+static TestResult timeTests(const std::vector<TestPair>& pairs, Test&& test) {
+  TestResult result;
+
+  for (u32 r = 0; r < BENCH_TRIANGLE_INTERSECTION_REPEATS; r++) {
+    u32 numHits = 0;
+    double sumDst = 0.;
+    auto start = std::chrono::steady_clock::now();
+
+    for (const TestPair& pair : pairs) {
+      intersect::TriangleHit hit = test(pair);
+      numHits += hit.didHit;
+      sumDst += hit.didHit ? hit.dst : 0.f;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result = {std::min(result.seconds, seconds), numHits, sumDst};
+  }
+
+  return result;
+}
+
+// Height field with jittered vertices facing up, every interior vertex is shared by 6 triangles
+static MeshRT generateGrid() {
+  u32 n = BENCH_TRIANGLE_INTERSECTION_GRID_SIZE;
+  MeshRT grid;
+
+  for (u32 z = 0; z <= n; z++)
+    for (u32 x = 0; x <= n; x++) {
+      vec2 p = vec2(x, z) + vec2(std::sin(x * 12.9898f + z * 78.233f), std::cos(x * 39.346f + z * 11.135f)) * 0.3f;
+      grid.vertices.push_back({vec3(p.x, 0.7f * std::sin(p.x * 0.37f) * std::cos(p.y * 0.23f), p.y) * 0.1f, global::up});
+    }
+
+  for (u32 z = 0; z < n; z++)
+    for (u32 x = 0; x < n; x++) {
+      u32 i = z * (n + 1) + x;
+      grid.indices.push_back(uvec3(i, i + n + 1, i + 1));
+      grid.indices.push_back(uvec3(i + 1, i + n + 1, i + n + 2));
+    }
+
+  return grid;
+}
+
+namespace bench {
+
+// Intersection tests per second of the indexed positions (edges and normal computed per test), the precomputed
+// edges and the watertight test, on the candidates of a BVH traversal. Then rays aimed at the shared vertices and
+// edges of a grid, every one of them should hit it
+int triangleIntersection() {
+  MeshRT knight;
+  knight.loadOBJ("res/obj/Knight.obj");
+  knight.buildBVH();
+
+  u32 numTriangles = knight.getNumTriangles();
+  std::vector<Ray> rays = generateOrbitRays(knight.meshInfo, BENCH_TRIANGLE_INTERSECTION_RESOLUTION, BENCH_TRIANGLE_INTERSECTION_NUM_VIEWS);
+  std::vector<intersect::RayShear> shears(rays.size());
+  for (size_t i = 0; i < rays.size(); i++)
+    shears[i] = intersect::calcRayShear(rays[i]);
+
+  std::vector<float> positions(knight.vertices.size() * PACKED_VERTEX_POSITION_WORDS);
+  std::vector<u32> normals(knight.vertices.size() * PACKED_VERTEX_NORMAL_WORDS);
+  std::vector<u32> indices(numTriangles * PACKED_TRIANGLE_INDEX_WORDS);
+  std::vector<float> edges(numTriangles * PACKED_TRIANGLE_EDGE_WORDS);
+
+  for (size_t i = 0; i < knight.vertices.size(); i++)
+    packedMesh::packVertex(knight.vertices[i], &positions[i * PACKED_VERTEX_POSITION_WORDS], &normals[i * PACKED_VERTEX_NORMAL_WORDS]);
+
+  auto getPosition = [&](u32 vertexIdx) {
+    const float* p = &positions[vertexIdx * PACKED_VERTEX_POSITION_WORDS];
+    return vec3(p[0], p[1], p[2]);
+  };
+
+  for (u32 i = 0; i < numTriangles; i++) {
+    u32* tri = &indices[i * PACKED_TRIANGLE_INDEX_WORDS];
+    packedMesh::packTriangle(knight.indices[i], 0, tri);
+    packedMesh::packTriangleEdges(getPosition(tri[0]), getPosition(tri[1]), getPosition(tri[2]), &edges[i * PACKED_TRIANGLE_EDGE_WORDS]);
+  }
+
+  // The tests a closest hit traversal does, in traversal order
+  std::vector<Triangle> triangles = knight.getTriangles();
+  std::vector<TestPair> pairs;
+
+  for (u32 i = 0; i < rays.size(); i++) {
+    float dst = FLT_MAX;
+    knight.bvh.intersect(rays[i], dst, [&](u32 triIdx, float& closestDst) {
+      pairs.push_back({i, triIdx});
+      intersect::TriangleHit hit = intersect::rayTriangle(rays[i], triangles[triIdx]);
+      if (hit.didHit && hit.dst < closestDst) closestDst = hit.dst;
+    });
+  }
+
+  TestResult indexed = timeTests(pairs, [&](const TestPair& pair) {
+    const u32* tri = &indices[pair.triIdx * PACKED_TRIANGLE_INDEX_WORDS];
+    vec3 a = getPosition(tri[0]);
+    return intersect::rayTriangle(rays[pair.rayIdx], a, getPosition(tri[1]) - a, getPosition(tri[2]) - a);
+  });
+
+  TestResult precomputed = timeTests(pairs, [&](const TestPair& pair) {
+    const float* e = &edges[pair.triIdx * PACKED_TRIANGLE_EDGE_WORDS];
+    return intersect::rayTriangle(rays[pair.rayIdx], vec3(e[0], e[1], e[2]), vec3(e[4], e[5], e[6]), vec3(e[8], e[9], e[10]), vec3(e[3], e[7], e[11]));
+  });
+
+  TestResult watertight = timeTests(pairs, [&](const TestPair& pair) {
+    const u32* tri = &indices[pair.triIdx * PACKED_TRIANGLE_INDEX_WORDS];
+    return intersect::rayTriangleWatertight(rays[pair.rayIdx], shears[pair.rayIdx], getPosition(tri[0]), getPosition(tri[1]), getPosition(tri[2]));
+  });
+
+  // ===== Leaks ============================================ //
+
+  MeshRT grid = generateGrid();
+  grid.buildBVH();
+  u32 n = BENCH_TRIANGLE_INTERSECTION_GRID_SIZE;
+  std::vector<Ray> leakRays;
+
+  // Interior vertices, and the midpoints of the edges between them, seen from a few directions. Steep enough that no
+  // target is on a silhouette, where the culled back face could legitimately take the hit
+  const vec3 origins[] = {vec3(3.2f, 4.f, 3.2f), vec3(-1.f, 2.f, 5.f), vec3(7.f, 3.f, -0.5f), vec3(3.3f, 2.f, 3.1f)};
+  for (const vec3& origin : origins)
+    for (u32 z = 1; z < n - 1; z++)
+      for (u32 x = 1; x < n - 1; x++) {
+        u32 i = z * (n + 1) + x;
+        vec3 p = grid.vertices[i].position;
+        vec3 targets[] = {p, (p + grid.vertices[i + 1].position) * 0.5f, (p + grid.vertices[i + n + 1].position) * 0.5f, (p + grid.vertices[i + n + 2].position) * 0.5f};
+
+        for (const vec3& target : targets)
+          leakRays.push_back({origin, glm::normalize(target - origin)});
+      }
+
+  u32 numLeaks = 0;
+  u32 numWatertightLeaks = 0;
+
+  for (const Ray& ray : leakRays) {
+    float dst = FLT_MAX;
+    grid.bvh.intersect(ray, dst, [&](u32 triIdx, float& closestDst) {
+      intersect::TriangleHit hit = intersect::rayTriangle(ray, grid.getTriangle(triIdx));
+      if (hit.didHit && hit.dst < closestDst) closestDst = hit.dst;
+    });
+    numLeaks += dst == FLT_MAX;
+
+    dst = FLT_MAX;
+    intersect::RayShear shear = intersect::calcRayShear(ray);
+    grid.bvh.intersect(ray, dst, [&](u32 triIdx, float& closestDst) {
+      const uvec3& tri = grid.indices[triIdx];
+      intersect::TriangleHit hit = intersect::rayTriangleWatertight(ray, shear, grid.vertices[tri.x].position, grid.vertices[tri.y].position, grid.vertices[tri.z].position);
+      if (hit.didHit && hit.dst < closestDst) closestDst = hit.dst;
+    });
+    numWatertightLeaks += dst == FLT_MAX;
+  }
+
+  // ===== Report =========================================== //
+
+  u32 indexedBytes = (PACKED_TRIANGLE_INDEX_WORDS + 3u * PACKED_VERTEX_POSITION_WORDS) * sizeof(u32);
+  u32 precomputedBytes = PACKED_TRIANGLE_EDGE_WORDS * sizeof(float);
+  double numTests = static_cast<double>(pairs.size());
+
+  auto printResult = [&](const char* name, const TestResult& result, u32 testBytes, size_t streamBytes) {
+    printf(
+      "%-11s %14.1f %14.3f %11u %14u %14zu\n", name, numTests / result.seconds * 1e-6, result.seconds / numTests * 1e9,
+      result.numHits, testBytes, streamBytes
+    );
+  };
+
+  printf("\n%u triangles, %u rays (%u views of %ux%u), %zu tests\n", numTriangles, static_cast<u32>(rays.size()), BENCH_TRIANGLE_INTERSECTION_NUM_VIEWS, BENCH_TRIANGLE_INTERSECTION_RESOLUTION, BENCH_TRIANGLE_INTERSECTION_RESOLUTION, pairs.size());
+  printf("%-11s %14s %14s %11s %14s %14s\n", "test", "Mtests/s", "ns/test", "hits", "bytes/test", "stream bytes");
+  printResult("indexed", indexed, indexedBytes, (positions.size() + indices.size()) * sizeof(u32));
+  printResult("precomputed", precomputed, precomputedBytes, edges.size() * sizeof(float));
+  printResult("watertight", watertight, indexedBytes, (positions.size() + indices.size()) * sizeof(u32));
+  printf("Rays through shared vertices and edges: %zu, leaks: %u (watertight %u)\n", leakRays.size(), numLeaks, numWatertightLeaks);
+
+  // The precomputed edges are the same values the indexed test computes, so every result must match
+  bool isSame = precomputed.numHits == indexed.numHits && precomputed.sumDst == indexed.sumDst;
+  if (!isSame) printf("Precomputed edges don't match the indexed test\n");
+
+  return isSame && numWatertightLeaks == 0 ? 0 : 1;
+}
+
+} // namespace bench
@@ -0,0 +1,124 @@
+#include "bench.hpp"
+
+#include "../objects/MeshRT.hpp"
+#include "../objects/PackedMesh.hpp"
+
+#define BENCH_TRIANGLE_LAYOUT_RESOLUTION 512u
+#define BENCH_TRIANGLE_LAYOUT_NUM_VIEWS 4u
+
+struct LayoutHit {
+  float dst = FLT_MAX;
+  u32 triIdx = 0;
+  float u = 0.f;
+  float v = 0.f;
+};
+
+namespace bench {
+
+// Closest hits through the unindexed std140 triangles and through the packed indexed streams, the packed ones must
+// land on the same triangle at the same distance. Normals only differ by the octahedral quantization
+int triangleLayout() {
+  MeshRT knight;
+  knight.loadOBJ("res/obj/Knight.obj");
+  knight.buildBVH();
+
+  std::vector<Triangle> triangles = knight.getTriangles();
+  u32 numTriangles = knight.getNumTriangles();
+  u32 numVertices = static_cast<u32>(knight.vertices.size());
+
+  std::vector<float> positions(numVertices * PACKED_VERTEX_POSITION_WORDS);
+  std::vector<u32> normals(numVertices * PACKED_VERTEX_NORMAL_WORDS);
+  std::vector<u32> indices(numTriangles * PACKED_TRIANGLE_INDEX_WORDS);
+
+  for (u32 i = 0; i < numVertices; i++)
+    packedMesh::packVertex(knight.vertices[i], &positions[i * PACKED_VERTEX_POSITION_WORDS], &normals[i * PACKED_VERTEX_NORMAL_WORDS]);
+
+  for (u32 i = 0; i < numTriangles; i++)
+    packedMesh::packTriangle(knight.indices[i], 0, &indices[i * PACKED_TRIANGLE_INDEX_WORDS]);
+
+  auto getPosition = [&](u32 vertexIdx) {
+    const float* p = &positions[vertexIdx * PACKED_VERTEX_POSITION_WORDS];
+    return vec3(p[0], p[1], p[2]);
+  };
+
+  std::vector<Ray> rays = generateOrbitRays(knight.meshInfo, BENCH_TRIANGLE_LAYOUT_RESOLUTION, BENCH_TRIANGLE_LAYOUT_NUM_VIEWS);
+  vec3 lightDir = glm::normalize(vec3(1.f, 2.f, 1.5f));
+
+  u32 numHits = 0;
+  u32 numMismatches = 0;
+  u64 numTests = 0;
+  double sumAngle = 0.;
+  float maxAngle = 0.f;
+  float maxShadingDiff = 0.f;
+
+  for (const Ray& ray : rays) {
+    LayoutHit reference, packed;
+    BVHTraversalStats stats;
+
+    knight.bvh.intersect(ray, reference.dst, [&](u32 triIdx, float& closestDst) {
+      intersect::TriangleHit hit = intersect::rayTriangle(ray, triangles[triIdx]);
+      if (hit.didHit && hit.dst < closestDst) {
+        closestDst = hit.dst;
+        reference = {hit.dst, triIdx, hit.u, hit.v};
+      }
+    }, &stats);
+
+    knight.bvh.intersect(ray, packed.dst, [&](u32 triIdx, float& closestDst) {
+      const u32* tri = &indices[triIdx * PACKED_TRIANGLE_INDEX_WORDS];
+      vec3 a = getPosition(tri[0]);
+      intersect::TriangleHit hit = intersect::rayTriangle(ray, a, getPosition(tri[1]) - a, getPosition(tri[2]) - a);
+      if (hit.didHit && hit.dst < closestDst) {
+        closestDst = hit.dst;
+        packed = {hit.dst, triIdx, hit.u, hit.v};
+      }
+    });
+
+    numTests += stats.numPrimitives;
+    if (reference.dst == FLT_MAX && packed.dst == FLT_MAX) continue;
+
+    if (reference.dst != packed.dst || reference.triIdx != packed.triIdx) {
+      numMismatches++;
+      continue;
+    }
+
+    const Triangle& tri = triangles[reference.triIdx];
+    const u32* packedTri = &indices[packed.triIdx * PACKED_TRIANGLE_INDEX_WORDS];
+    float w = 1.f - reference.u - reference.v;
+    vec3 referenceNormal = glm::normalize(tri.normalA * w + tri.normalB * reference.u + tri.normalC * reference.v);
+    vec3 packedNormal = glm::normalize(
+      packedMesh::decodeNormal(normals[packedTri[0]]) * w +
+      packedMesh::decodeNormal(normals[packedTri[1]]) * packed.u +
+      packedMesh::decodeNormal(normals[packedTri[2]]) * packed.v
+    );
+
+    float angle = glm::degrees(std::acos(std::clamp(glm::dot(referenceNormal, packedNormal), -1.f, 1.f)));
+    float shadingDiff = std::abs(std::max(glm::dot(referenceNormal, lightDir), 0.f) - std::max(glm::dot(packedNormal, lightDir), 0.f));
+
+    numHits++;
+    sumAngle += angle;
+    maxAngle = std::max(maxAngle, angle);
+    maxShadingDiff = std::max(maxShadingDiff, shadingDiff);
+  }
+
+  // The std140 triangle is fetched whole for every test. An indexed test reads the indices and the three positions,
+  // the normals are only read for the closest hit
+  u32 indexedBytes = (numVertices * (PACKED_VERTEX_POSITION_WORDS + PACKED_VERTEX_NORMAL_WORDS) + numTriangles * PACKED_TRIANGLE_INDEX_WORDS) * sizeof(u32);
+  u32 testBytes = (PACKED_TRIANGLE_INDEX_WORDS + 3u * PACKED_VERTEX_POSITION_WORDS) * sizeof(u32);
+  u32 hitBytes = (PACKED_TRIANGLE_INDEX_WORDS + 3u * PACKED_VERTEX_NORMAL_WORDS) * sizeof(u32);
+  double numRays = static_cast<double>(rays.size());
+  double testsPerRay = numTests / numRays;
+  double hitRatio = numHits / numRays;
+
+  printf("\n%u triangles, %u vertices, %u rays (%u views of %ux%u), %u hits\n", numTriangles, numVertices, static_cast<u32>(rays.size()), BENCH_TRIANGLE_LAYOUT_NUM_VIEWS, BENCH_TRIANGLE_LAYOUT_RESOLUTION, BENCH_TRIANGLE_LAYOUT_RESOLUTION, numHits);
+  printf("%-8s %14s %16s %16s\n", "layout", "bytes/tri", "mesh bytes", "tri bytes/ray");
+  printf("%-8s %14.1f %16u %16.1f\n", "std140", static_cast<double>(sizeof(Triangle)), static_cast<u32>(sizeof(Triangle) * numTriangles), testsPerRay * sizeof(Triangle));
+  printf(
+    "%-8s %14.1f %16u %16.1f\n", "indexed", static_cast<double>(indexedBytes) / numTriangles, indexedBytes,
+    testsPerRay * testBytes + hitRatio * hitBytes
+  );
+  printf("Hit mismatches: %u, normal error: mean %.5f deg, max %.5f deg, max shading difference %.6f (%.3f of 255)\n", numMismatches, numHits ? sumAngle / numHits : 0., maxAngle, maxShadingDiff, maxShadingDiff * 255.f);
+
+  return numMismatches == 0 && maxShadingDiff * 255.f < 0.5f ? 0 : 1;
+}
+
+} // namespace bench
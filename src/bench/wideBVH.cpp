@@ -0,0 +1,109 @@
+#include "bench.hpp"
+
+#include <chrono>
+
+#include "../objects/MeshRT.hpp"
+
+#define BENCH_WIDE_BVH_RESOLUTION 512u
+#define BENCH_WIDE_BVH_NUM_VIEWS 4u
+#define BENCH_WIDE_BVH_REPEATS 3u
+
+struct LayoutResult {
+  const char* name;
+  double seconds = 0.;
+  BVHTraversalStats stats;
+  u32 numBytes = 0; // Size of the nodes
+  u32 numMismatches = 0;
+};
+
+// Returns the closest hit distance of every ray
+template<typename Traverse>
+static std::vector<float> measure(LayoutResult& result, const std::vector<Ray>& rays, Traverse&& traverse) {
+  std::vector<float> dsts(rays.size());
+
+  for (u32 repeat = 0; repeat < BENCH_WIDE_BVH_REPEATS; repeat++) {
+    BVHTraversalStats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < rays.size(); i++)
+      dsts[i] = traverse(rays[i], stats);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (repeat == 0 || seconds < result.seconds) result.seconds = seconds;
+    result.stats = stats;
+  }
+
+  return dsts;
+}
+
+static void compare(LayoutResult& result, const std::vector<float>& dsts, const std::vector<float>& reference) {
+  for (size_t i = 0; i < dsts.size(); i++)
+    result.numMismatches += dsts[i] != reference[i];
+}
+
+namespace bench {
+
+int wideBVH() {
+  MeshRT knight;
+  knight.loadOBJ("res/obj/Knight.obj");
+  knight.buildBVH();
+
+  WideBVH wide4, wide8;
+  wide4.collapse(knight.bvh, 4);
+  wide8.collapse(knight.bvh, 8);
+
+  std::vector<Ray> rays = generateOrbitRays(knight.meshInfo, BENCH_WIDE_BVH_RESOLUTION, BENCH_WIDE_BVH_NUM_VIEWS);
+  std::vector<Triangle> triangles = knight.getTriangles();
+
+  auto intersectTriangle = [&](const Ray& ray) {
+    return [&](u32 triIdx, float& closestDst) {
+      intersect::TriangleHit hit = intersect::rayTriangle(ray, triangles[triIdx]);
+      if (hit.didHit && hit.dst < closestDst) closestDst = hit.dst;
+    };
+  };
+
+  LayoutResult results[3] = {{"binary"}, {"4-wide"}, {"8-wide"}};
+  results[0].numBytes = static_cast<u32>(knight.bvh.nodes.size() * sizeof(BVHNode));
+  results[1].numBytes = wide4.getNumBytes();
+  results[2].numBytes = wide8.getNumBytes();
+
+  // The binary layout is the reference for the others
+  std::vector<float> reference = measure(results[0], rays, [&](const Ray& ray, BVHTraversalStats& stats) {
+    float dst = FLT_MAX;
+    knight.bvh.intersect(ray, dst, intersectTriangle(ray), &stats);
+    return dst;
+  });
+
+  std::vector<float> dsts4 = measure(results[1], rays, [&](const Ray& ray, BVHTraversalStats& stats) {
+    float dst = FLT_MAX;
+    wide4.intersect(ray, dst, intersectTriangle(ray), &stats);
+    return dst;
+  });
+
+  std::vector<float> dsts8 = measure(results[2], rays, [&](const Ray& ray, BVHTraversalStats& stats) {
+    float dst = FLT_MAX;
+    wide8.intersect(ray, dst, intersectTriangle(ray), &stats);
+    return dst;
+  });
+
+  compare(results[1], dsts4, reference);
+  compare(results[2], dsts8, reference);
+
+  // bytes/ray counts nodes and primitive indices, the triangles themselves are left out
+  printf("\n%u rays (%u views of %ux%u), 1 thread, best of %u\n", static_cast<u32>(rays.size()), BENCH_WIDE_BVH_NUM_VIEWS, BENCH_WIDE_BVH_RESOLUTION, BENCH_WIDE_BVH_RESOLUTION, BENCH_WIDE_BVH_REPEATS);
+  printf("%-8s %12s %10s %12s %12s %12s %10s\n", "layout", "node bytes", "Mrays/s", "bytes/ray", "nodes/ray", "tris/ray", "mismatch");
+
+  for (const LayoutResult& result : results) {
+    double numRays = static_cast<double>(rays.size());
+    printf(
+      "%-8s %12u %10.2f %12.1f %12.2f %12.2f %10u\n",
+      result.name, result.numBytes, numRays / result.seconds * 1e-6,
+      result.stats.numBytes / numRays, result.stats.numNodes / numRays, result.stats.numPrimitives / numRays,
+      result.numMismatches
+    );
+  }
+
+  return results[1].numMismatches + results[2].numMismatches == 0 ? 0 : 1;
+}
+
+} // namespace bench
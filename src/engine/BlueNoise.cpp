@@ -0,0 +1,147 @@
+#include "BlueNoise.hpp"
+
+#define BLUE_NOISE_KERNEL_SIDE (2 * BLUE_NOISE_KERNEL_RADIUS + 1)
+
+// exp(-x) for x >= 0, std::exp isn't constexpr: a Taylor series of exp(-x / 64) squared 6 times
+static constexpr float expNeg(float x) {
+  float y = x / 64.f;
+  float term = 1.f;
+  float sum = 1.f;
+  for (int i = 1; i < 8; i++) {
+    term *= -y / static_cast<float>(i);
+    sum += term;
+  }
+
+  for (int i = 0; i < 6; i++)
+    sum *= sum;
+
+  return sum;
+}
+
+// Ulichney, "The void-and-cluster method for dither array generation". Every pixel has the energy of a Gaussian
+// around each set pixel. A random start is relaxed by moving its tightest cluster to the largest void until that is
+// the same pixel, then ranked: the start gets the ranks below it by removing its tightest clusters, the rest the ranks
+// above by filling the largest voids. The kernel sums to the same everywhere on the torus, so the largest void of the
+// set pixels is also the tightest cluster of the unset ones, the usual third phase is the second one
+static constexpr std::array<u32, BLUE_NOISE_NUM_PIXELS> generate() {
+  // Plain arrays, the evaluation of std::array::operator[] counts against the constexpr operation limit
+  float kernel[BLUE_NOISE_KERNEL_SIDE * BLUE_NOISE_KERNEL_SIDE] = {};
+  for (int y = -BLUE_NOISE_KERNEL_RADIUS; y <= BLUE_NOISE_KERNEL_RADIUS; y++)
+    for (int x = -BLUE_NOISE_KERNEL_RADIUS; x <= BLUE_NOISE_KERNEL_RADIUS; x++) {
+      float d2 = static_cast<float>(x * x + y * y);
+      kernel[(y + BLUE_NOISE_KERNEL_RADIUS) * BLUE_NOISE_KERNEL_SIDE + x + BLUE_NOISE_KERNEL_RADIUS] =
+        expNeg(d2 / (2.f * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+    }
+
+  float energy[BLUE_NOISE_NUM_PIXELS] = {};
+  bool isSet[BLUE_NOISE_NUM_PIXELS] = {};
+  float initialEnergy[BLUE_NOISE_NUM_PIXELS] = {};
+  bool initialIsSet[BLUE_NOISE_NUM_PIXELS] = {};
+  std::array<u32, BLUE_NOISE_NUM_PIXELS> ranks{};
+
+  // Tightest cluster and largest void of every row, a flip only changes the rows under the kernel
+  u32 rowClusters[BLUE_NOISE_SIZE] = {};
+  u32 rowVoids[BLUE_NOISE_SIZE] = {};
+
+  auto updateRow = [&](u32 y) {
+    u32 cluster = BLUE_NOISE_NUM_PIXELS;
+    u32 largestVoid = BLUE_NOISE_NUM_PIXELS;
+    for (u32 i = y * BLUE_NOISE_SIZE; i < (y + 1) * BLUE_NOISE_SIZE; i++) {
+      if (isSet[i]) {
+        if (cluster == BLUE_NOISE_NUM_PIXELS || energy[i] > energy[cluster])
+          cluster = i;
+      } else if (largestVoid == BLUE_NOISE_NUM_PIXELS || energy[i] < energy[largestVoid])
+        largestVoid = i;
+    }
+
+    rowClusters[y] = cluster;
+    rowVoids[y] = largestVoid;
+  };
+
+  auto setPixel = [&](u32 idx, bool value) {
+    isSet[idx] = value;
+    float sign = value ? 1.f : -1.f;
+    int px = static_cast<int>(idx % BLUE_NOISE_SIZE);
+    int py = static_cast<int>(idx / BLUE_NOISE_SIZE);
+
+    for (int y = -BLUE_NOISE_KERNEL_RADIUS; y <= BLUE_NOISE_KERNEL_RADIUS; y++) {
+      u32 wy = static_cast<u32>(py + y + BLUE_NOISE_SIZE) & (BLUE_NOISE_SIZE - 1);
+      for (int x = -BLUE_NOISE_KERNEL_RADIUS; x <= BLUE_NOISE_KERNEL_RADIUS; x++) {
+        u32 wx = static_cast<u32>(px + x + BLUE_NOISE_SIZE) & (BLUE_NOISE_SIZE - 1);
+        energy[wy * BLUE_NOISE_SIZE + wx] += sign * kernel[(y + BLUE_NOISE_KERNEL_RADIUS) * BLUE_NOISE_KERNEL_SIDE + x + BLUE_NOISE_KERNEL_RADIUS];
+      }
+      updateRow(wy);
+    }
+  };
+
+  auto findCluster = [&]() {
+    u32 best = BLUE_NOISE_NUM_PIXELS;
+    for (u32 cluster : rowClusters)
+      if (cluster != BLUE_NOISE_NUM_PIXELS && (best == BLUE_NOISE_NUM_PIXELS || energy[cluster] > energy[best]))
+        best = cluster;
+
+    return best;
+  };
+
+  auto findLargestVoid = [&]() {
+    u32 best = BLUE_NOISE_NUM_PIXELS;
+    for (u32 largestVoid : rowVoids)
+      if (largestVoid != BLUE_NOISE_NUM_PIXELS && (best == BLUE_NOISE_NUM_PIXELS || energy[largestVoid] < energy[best]))
+        best = largestVoid;
+
+    return best;
+  };
+
+  for (u32 y = 0; y < BLUE_NOISE_SIZE; y++)
+    updateRow(y);
+
+  u32 numInitial = BLUE_NOISE_NUM_PIXELS / 10;
+  u32 state = 1u;
+  for (u32 numSet = 0; numSet < numInitial;) {
+    state = state * 747796405u + 2891336453u;
+    u32 idx = (state >> 16) % BLUE_NOISE_NUM_PIXELS;
+    if (!isSet[idx]) {
+      setPixel(idx, true);
+      numSet++;
+    }
+  }
+
+  for (u32 i = 0; i < BLUE_NOISE_NUM_PIXELS; i++) {
+    u32 cluster = findCluster();
+    setPixel(cluster, false);
+    u32 largestVoid = findLargestVoid();
+    setPixel(largestVoid, true);
+    if (largestVoid == cluster)
+      break;
+  }
+
+  for (u32 i = 0; i < BLUE_NOISE_NUM_PIXELS; i++) {
+    initialEnergy[i] = energy[i];
+    initialIsSet[i] = isSet[i];
+  }
+
+  for (u32 rank = numInitial; rank-- > 0;) {
+    u32 cluster = findCluster();
+    setPixel(cluster, false);
+    ranks[cluster] = rank;
+  }
+
+  for (u32 i = 0; i < BLUE_NOISE_NUM_PIXELS; i++) {
+    energy[i] = initialEnergy[i];
+    isSet[i] = initialIsSet[i];
+  }
+  for (u32 y = 0; y < BLUE_NOISE_SIZE; y++)
+    updateRow(y);
+
+  for (u32 rank = numInitial; rank < BLUE_NOISE_NUM_PIXELS; rank++) {
+    u32 largestVoid = findLargestVoid();
+    setPixel(largestVoid, true);
+    ranks[largestVoid] = rank;
+  }
+
+  return ranks;
+}
+
+namespace blueNoise {
+  constinit const std::array<u32, BLUE_NOISE_NUM_PIXELS> tile = generate();
+}
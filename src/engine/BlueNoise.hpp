@@ -0,0 +1,15 @@
+#pragma once
+
+#include <array>
+
+#define BLUE_NOISE_SIZE 32u // Side of the tile, a power of 2
+#define BLUE_NOISE_BITS 10u // log2 of the pixel count, the bits of a rank
+#define BLUE_NOISE_NUM_PIXELS (BLUE_NOISE_SIZE * BLUE_NOISE_SIZE)
+#define BLUE_NOISE_SIGMA 1.5f // Of the Gaussian energy of the void-and-cluster method
+#define BLUE_NOISE_KERNEL_RADIUS 5 // The Gaussian is under 0.4% of its peak past it
+
+namespace blueNoise {
+  // Rank of every pixel of a toroidal BLUE_NOISE_SIZE tile (row-major) in [0, BLUE_NOISE_NUM_PIXELS): thresholding
+  // it at any level gives evenly spread pixels. Generated by the compiler (BlueNoise.cpp)
+  extern const std::array<u32, BLUE_NOISE_NUM_PIXELS> tile;
+}
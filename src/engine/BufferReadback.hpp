@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "SSBO.hpp"
+
+// Copies of a small GPU buffer in a ring of persistently mapped buffers, each behind a fence. The oldest copy is read
+// once the GPU is done with it, so the GPU is never waited for
+struct BufferReadback {
+  std::vector<SSBO> buffers;
+  std::vector<GLsync> fences;
+  std::vector<const void*> mapped;
+  GLsizeiptr dataSize = 0;
+  u32 current = 0; // Buffer of the next copy, the oldest one once every buffer has been used
+
+  BufferReadback() {}
+
+  BufferReadback(GLsizei size, GLsizeiptr dataSize) : buffers(size), fences(size, nullptr), mapped(size), dataSize(dataSize) {
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    for (GLsizei i = 0; i < size; i++) {
+      buffers[i] = SSBO(1);
+      buffers[i].storage(dataSize, flags);
+      mapped[i] = buffers[i].map(dataSize, flags);
+    }
+  }
+
+  // Queues the copy of the start of source, shader writes to it need a GL_BUFFER_UPDATE_BARRIER_BIT barrier first
+  void copy(const SSBO& source) {
+    glBindBuffer(GL_COPY_READ_BUFFER, source.id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[current].id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, dataSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (fences[current]) glDeleteSync(fences[current]);
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % buffers.size();
+  }
+
+  // Writes the oldest copy to data, false while the GPU hasn't made it yet
+  bool read(void* data) const {
+    GLsync fence = fences[current];
+    if (!fence) return false;
+
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+    std::memcpy(data, mapped[current], dataSize);
+    return true;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < buffers.size(); i++) {
+      if (fences[i]) glDeleteSync(fences[i]);
+      buffers[i].clear(); // Also unmaps it
+    }
+
+    buffers.clear();
+    fences.clear();
+    mapped.clear();
+  }
+};
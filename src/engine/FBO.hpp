@@ -1,5 +1,7 @@
 #pragma once
 
+#include <initializer_list>
+
 #include "mesh/texture/Texture.hpp"
 
 struct FBO {
@@ -22,5 +24,12 @@ struct FBO {
     glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, tex.id, 0);
     unbind();
   }
+
+  // The attachments written by the fragment outputs, in the order of their locations
+  void setDrawBuffers(std::initializer_list<GLenum> attachments) const {
+    bind();
+    glDrawBuffers(static_cast<GLsizei>(attachments.size()), attachments.begin());
+    unbind();
+  }
 };
 
@@ -0,0 +1,77 @@
+#include "PerfCounters.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int openCounter(u32 type, u64 config) {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+PerfCounters::PerfCounters() {
+  fds[PERF_COUNTER_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  fds[PERF_COUNTER_CACHE_REFS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+  fds[PERF_COUNTER_CACHE_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  fds[PERF_COUNTER_L1D_MISSES] = openCounter(
+    PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16
+  );
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds)
+    if (fd >= 0) close(fd);
+}
+
+void PerfCounters::start() {
+  for (int fd : fds)
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop() {
+  for (int fd : fds)
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+u64 PerfCounters::get(u32 counter) const {
+  u64 value = 0;
+  if (fds[counter] < 0 || read(fds[counter], &value, sizeof(value)) != sizeof(value))
+    return 0;
+
+  return value;
+}
+#else
+PerfCounters::PerfCounters() {
+  for (int& fd : fds)
+    fd = -1;
+}
+
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+u64 PerfCounters::get(u32) const { return 0; }
+#endif
+
+const char* PerfCounters::getName(u32 counter) {
+  switch (counter) {
+    case PERF_COUNTER_INSTRUCTIONS: return "instructions";
+    case PERF_COUNTER_CACHE_REFS:   return "LLC refs";
+    case PERF_COUNTER_CACHE_MISSES: return "LLC misses";
+    case PERF_COUNTER_L1D_MISSES:   return "L1D misses";
+    default:                        return "unknown";
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#define PERF_COUNTER_INSTRUCTIONS   0u
+#define PERF_COUNTER_CACHE_REFS     1u // Last level cache
+#define PERF_COUNTER_CACHE_MISSES   2u // Last level cache
+#define PERF_COUNTER_L1D_MISSES     3u // L1 data cache read misses
+#define PERF_COUNTER_COUNT          4u
+
+// CPU hardware counters through perf_event (Linux only, unavailable elsewhere or when the kernel forbids it).
+// Counters follow the threads created after the construction and their counts are only added when they exit: create
+// the worker threads after this, join them before reading, and use a new instance per measurement
+class PerfCounters {
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  static const char* getName(u32 counter);
+
+  bool isAvailable(u32 counter) const { return fds[counter] >= 0; }
+
+  void start(); // Resets and enables every counter
+  void stop();
+
+  // 0 if unavailable
+  u64 get(u32 counter) const;
+
+private:
+  int fds[PERF_COUNTER_COUNT];
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+
+#include "SSBO.hpp"
+
+#define PERSISTENT_SSBO_GROWTH 1.5f
+
+// Blocks until the GPU has run every command issued so far
+inline void waitForGPU() {
+  GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  if (fence) {
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+    glDeleteSync(fence);
+  }
+}
+
+// Persistently mapped array of T in a shader storage buffer, sized at runtime. The storage is immutable, so growing
+// allocates a new buffer, copies the old contents over on the GPU and waits for the copy. The binding is lost when it
+// grows, so bindBase has to be called again before drawing
+template<typename T>
+class PersistentSSBO {
+public:
+  T* data = nullptr;
+
+  // Makes room for at least count elements, keeps the ones already written
+  void reserve(u32 count) {
+    if (count <= capacity) return;
+
+    u32 newCapacity = std::max(count, static_cast<u32>(capacity * PERSISTENT_SSBO_GROWTH));
+    GLsizeiptr size = sizeof(T) * newCapacity;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    SSBO grown(1);
+    grown.storage(size, flags);
+
+    if (capacity) {
+      glBindBuffer(GL_COPY_READ_BUFFER, ssbo.id);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, grown.id);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(T) * capacity);
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+      // The copy is only queued, writes through the new map must not land before it runs
+      waitForGPU();
+
+      ssbo.clear(); // Also unmaps it
+    }
+
+    data = (T*)grown.map(size, flags);
+    ssbo = grown;
+    capacity = newCapacity;
+  }
+
+  u32 getCapacity() const { return capacity; }
+
+  void bindBase(GLuint idx) const { ssbo.bindBase(idx); }
+
+private:
+  SSBO ssbo;
+  u32 capacity = 0;
+};
@@ -0,0 +1,81 @@
+#include "RadixSort.hpp"
+
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+
+// Every pass splits the input the same way, so each chunk can scatter to its own precomputed offsets.
+// forChunks(numChunks, func) calls func(chunkBegin, chunkEnd) over ranges covering all chunks
+template <typename ForChunks>
+static void sortPasses(std::vector<u32>& keys, std::vector<u32>& values, u32 numKeyBits, u32 numChunks, const ForChunks& forChunks) {
+  u32 count = static_cast<u32>(keys.size());
+  u32 chunkSize = (count + numChunks - 1) / numChunks;
+
+  std::vector<u32> keysTemp(count);
+  std::vector<u32> valuesTemp(count);
+  std::vector<u32> offsets(numChunks * RADIX_SORT_NUM_BUCKETS);
+
+  for (u32 shift = 0; shift < numKeyBits; shift += RADIX_SORT_DIGIT_BITS) {
+    std::fill(offsets.begin(), offsets.end(), 0u);
+
+    forChunks(numChunks, [&](u32 chunkBegin, u32 chunkEnd) {
+      for (u32 chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+        u32* histogram = &offsets[chunk * RADIX_SORT_NUM_BUCKETS];
+        u32 end = std::min((chunk + 1) * chunkSize, count);
+
+        for (u32 i = chunk * chunkSize; i < end; i++)
+          histogram[(keys[i] >> shift) & (RADIX_SORT_NUM_BUCKETS - 1)]++;
+      }
+    });
+
+    // Exclusive scan, bucket major so equal digits keep the chunk order (stable)
+    u32 sum = 0;
+    for (u32 bucket = 0; bucket < RADIX_SORT_NUM_BUCKETS; bucket++)
+      for (u32 chunk = 0; chunk < numChunks; chunk++) {
+        u32& offset = offsets[chunk * RADIX_SORT_NUM_BUCKETS + bucket];
+        u32 bucketCount = offset;
+        offset = sum;
+        sum += bucketCount;
+      }
+
+    forChunks(numChunks, [&](u32 chunkBegin, u32 chunkEnd) {
+      for (u32 chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+        u32* chunkOffsets = &offsets[chunk * RADIX_SORT_NUM_BUCKETS];
+        u32 end = std::min((chunk + 1) * chunkSize, count);
+
+        for (u32 i = chunk * chunkSize; i < end; i++) {
+          u32 dst = chunkOffsets[(keys[i] >> shift) & (RADIX_SORT_NUM_BUCKETS - 1)]++;
+          keysTemp[dst] = keys[i];
+          valuesTemp[dst] = values[i];
+        }
+      }
+    });
+
+    keys.swap(keysTemp);
+    values.swap(valuesTemp);
+  }
+}
+
+static bool checkSizes(const std::vector<u32>& keys, const std::vector<u32>& values) {
+  if (keys.size() <= 1) return false;
+
+  if (values.size() != keys.size())
+    error("[radixSort] Amount of values [{}] doesn't match the keys [{}]", values.size(), keys.size());
+
+  return true;
+}
+
+void radixSort(std::vector<u32>& keys, std::vector<u32>& values, u32 numKeyBits) {
+  if (!checkSizes(keys, values)) return;
+
+  ThreadPool& pool = ThreadPool::get();
+  u32 numChunks = std::clamp(static_cast<u32>(keys.size()) / RADIX_SORT_MIN_CHUNK_SIZE, 1u, pool.getNumThreads() * 4);
+
+  sortPasses(keys, values, numKeyBits, numChunks, [&](u32 count, const auto& func) { pool.parallelFor(count, func, 1); });
+}
+
+void radixSortSerial(std::vector<u32>& keys, std::vector<u32>& values, u32 numKeyBits) {
+  if (!checkSizes(keys, values)) return;
+
+  sortPasses(keys, values, numKeyBits, 1, [](u32 count, const auto& func) { func(0, count); });
+}
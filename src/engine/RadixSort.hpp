@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+#define RADIX_SORT_DIGIT_BITS 8u
+#define RADIX_SORT_NUM_BUCKETS (1u << RADIX_SORT_DIGIT_BITS)
+#define RADIX_SORT_MIN_CHUNK_SIZE 16384u
+
+// Stable LSD radix sort of `keys` carrying `values` along, on the shared thread pool.
+// Only the lowest `numKeyBits` bits take part, fewer bits means fewer passes
+void radixSort(std::vector<u32>& keys, std::vector<u32>& values, u32 numKeyBits = 32);
+
+// Same sort on the calling thread, for callers already running on worker threads (tile schedulers)
+void radixSortSerial(std::vector<u32>& keys, std::vector<u32>& values, u32 numKeyBits = 32);
@@ -0,0 +1,47 @@
+#include "RenderBudget.hpp"
+
+#include <cstdio>
+
+RenderBudget::RenderBudget(double seconds, u32 spp) : seconds(seconds), spp(spp) {}
+
+void RenderBudget::start() {
+  numFrames = 0;
+  achievedSpp = 0;
+  numRays = 0;
+  startTime = std::chrono::steady_clock::now();
+  isStopped = false;
+}
+
+bool RenderBudget::hasRoomForFrame() const {
+  if (numFrames == 0) return true;
+  if (spp > 0 && achievedSpp >= spp) return false;
+  if (seconds <= 0.) return true;
+
+  double elapsed = getElapsed();
+  return elapsed + elapsed / numFrames <= seconds;
+}
+
+void RenderBudget::addFrame(u32 frameSpp, u64 frameRays) {
+  numFrames++;
+  achievedSpp += frameSpp;
+  numRays += frameRays;
+}
+
+void RenderBudget::stop() {
+  stopTime = std::chrono::steady_clock::now();
+  isStopped = true;
+}
+
+double RenderBudget::getElapsed() const {
+  return std::chrono::duration<double>((isStopped ? stopTime : std::chrono::steady_clock::now()) - startTime).count();
+}
+
+void RenderBudget::print(const char* renderer) const {
+  double elapsed = getElapsed();
+
+  printf("%s: %u spp in %u passes, %.3f s (budget:", renderer, achievedSpp, numFrames, elapsed);
+  if (seconds > 0.) printf(" %.3f s", seconds);
+  if (spp > 0) printf(" %u spp", spp);
+  if (!isLimited()) printf(" none");
+  printf("), %.2f Mrays/s\n", numRays / elapsed * 1e-6);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+
+// Limits of a progressive render: a wall-clock time and a number of samples per pixel, 0 is no limit. A frame is only
+// started if it fits in the time left at the mean frame time so far, the first one always is
+class RenderBudget {
+public:
+  RenderBudget(double seconds = 0., u32 spp = 0);
+
+  bool isLimited() const { return seconds > 0. || spp > 0; }
+  u32 getSppLimit() const { return spp; }
+
+  void start();
+  bool hasRoomForFrame() const;
+  void addFrame(u32 frameSpp, u64 frameRays);
+  void stop(); // Freezes the elapsed time at the end of the render loop, before any output work
+
+  double getElapsed() const;
+  u32 getNumFrames() const { return numFrames; }
+  u32 getSpp() const { return achievedSpp; }
+  u64 getNumRays() const { return numRays; }
+
+  // Achieved spp and Mrays/s against the limits, over the time up to stop
+  void print(const char* renderer) const;
+
+private:
+  double seconds;
+  u32 spp;
+
+  u32 numFrames = 0;
+  u32 achievedSpp = 0;
+  u64 numRays = 0;
+  std::chrono::steady_clock::time_point startTime;
+  std::chrono::steady_clock::time_point stopTime;
+  bool isStopped = false;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+// Shader Storage Buffer Object
+struct SSBO {
+  GLuint id = 0;
+  GLsizei size = 0;
+
+  SSBO() {}
+
+  SSBO(GLsizei size) : size(size) {
+    glGenBuffers(size, &id);
+  }
+
+  static void unbind() { glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); }
+
+  void storage(GLsizeiptr size, GLbitfield flags) {
+    bind();
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, flags);
+    unbind();
+  }
+
+  [[nodiscard]]
+  void* map(GLsizeiptr size, GLbitfield flags) {
+    bind();
+    void* ptr = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags);
+    unbind();
+    return ptr;
+  }
+
+  void data(GLsizeiptr dataSize, const void* data, GLenum usage = GL_DYNAMIC_COPY) {
+    bind();
+    glBufferData(GL_SHADER_STORAGE_BUFFER, dataSize, data, usage);
+    unbind();
+  }
+
+  void read(GLsizeiptr dataSize, void* data) const {
+    bind();
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, dataSize, data);
+    unbind();
+  }
+
+  void bind()               const { glBindBuffer(GL_SHADER_STORAGE_BUFFER, id); }
+  void bindBase(GLuint idx) const { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, idx, id); }
+  void clear()                    { glDeleteBuffers(size, &id); size = 0; }
+};
@@ -3,12 +3,14 @@
 #include <cstdio>
 #include <format>
 #include <stdexcept>
+#include <sstream>
 #include <string>
 
 #include "utils/clrp.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
 fspath Shader::directory = "";
+std::string Shader::defines = "";
 Shader Shader::defaultColor;
 Shader Shader::defaultNormals;
 Shader Shader::defaultTexture;
@@ -63,6 +65,10 @@ const Shader& Shader::getDefaultShader(u32 type) {
 
 void Shader::setDirectoryLocation(const fspath& path) { Shader::directory = path; }
 
+void Shader::define(const std::string& name, const std::string& value) {
+  Shader::defines += std::format("#define {} {}\n", name, value);
+}
+
 void Shader::setDefaultShader(u32 type, const fspath& vsPath, const fspath& fsPath, const fspath& gsPath) {
   switch (type) {
     case SHADER_DEFAULT_TYPE_COLOR_SHADER:
@@ -129,9 +135,51 @@ void Shader::setUniformBlock(const std::string& name, const GLuint& i) const {
   setUniformBlock(idx, i);
 }
 
+#define SHADER_MAX_INCLUDE_DEPTH 8
+
+// Replaces the #include "file" lines (relative to the including file) by the file contents. The included lines are
+// numbered as source string [depth], then #line goes back to the including file
+static std::string expandIncludes(const std::string& source, const fspath& path, int depth = 0) {
+  if (depth > SHADER_MAX_INCLUDE_DEPTH)
+    error(std::format("[Shader::expandIncludes] Include depth over {} in [{}]", SHADER_MAX_INCLUDE_DEPTH, path.string()));
+
+  std::istringstream lines(source);
+  std::string expanded, line;
+  int lineNumber = 0;
+
+  while (std::getline(lines, line)) {
+    lineNumber++;
+
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+      expanded += line + '\n';
+      continue;
+    }
+
+    size_t nameStart = line.find('"', start);
+    size_t nameEnd = nameStart == std::string::npos ? nameStart : line.find('"', nameStart + 1);
+    if (nameEnd == std::string::npos)
+      error(std::format("[Shader::expandIncludes] Expected #include \"file\" in [{}] line {}", path.string(), lineNumber));
+
+    fspath includePath = path.parent_path() / line.substr(nameStart + 1, nameEnd - nameStart - 1);
+    expanded += std::format("#line 1 {}\n", depth + 1);
+    expanded += expandIncludes(readFile(includePath), includePath, depth + 1);
+    expanded += std::format("#line {} {}\n", lineNumber + 1, depth);
+  }
+
+  return expanded;
+}
+
 GLuint Shader::load(fspath path, int type) {
   path = directory.empty() ? path : directory / path;
-  std::string shaderStr = readFile(path);
+  std::string shaderStr = expandIncludes(readFile(path), path);
+
+  // The defines go after the #version line, #line keeps the error messages pointing at the file lines
+  if (!defines.empty()) {
+    size_t versionEnd = shaderStr.find('\n') + 1;
+    shaderStr.insert(versionEnd, defines + "#line 2\n");
+  }
+
   const char* shaderStrPtr = shaderStr.c_str();
   GLuint shaderId = glCreateShader(type);
   glShaderSource(shaderId, 1, &shaderStrPtr, NULL);
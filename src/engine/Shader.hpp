@@ -16,6 +16,10 @@ public:
   static const Shader& getDefaultShader(u32 type);
 
   static void setDirectoryLocation(const fspath& path);
+
+  // Injected after the #version line of every shader compiled from now on, so constants shared with the C++ side
+  // have a single source
+  static void define(const std::string& name, const std::string& value);
   static void setDefaultShader(u32 type, const fspath& vsPath, const fspath& fsPath, const fspath& gsPath = "");
 
   GLint getUniformLoc(const std::string& name) const;
@@ -51,6 +55,7 @@ public:
   GLuint program = 0;
 private:
   static fspath directory;
+  static std::string defines;
   static Shader defaultColor;
   static Shader defaultNormals;
   static Shader defaultTexture;
@@ -0,0 +1,194 @@
+#include "Socket.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+
+using SocketLength = int;
+
+// Winsock must be started before the first call
+static bool startWinsock() {
+  static const bool isStarted = [] {
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+  }();
+
+  return isStarted;
+}
+
+static void closeHandle(SocketHandle handle) { closesocket(handle); }
+#define SOCKET_SEND_FLAGS 0
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using SocketLength = socklen_t;
+
+static bool startWinsock() { return true; }
+static void closeHandle(SocketHandle handle) { ::close(handle); }
+#define SOCKET_SEND_FLAGS MSG_NOSIGNAL // A closed peer is a failed send, not a SIGPIPE
+#endif
+
+// Tiles and jobs are small messages answered right away, Nagle's algorithm would hold them back
+static void setNoDelay(SocketHandle handle) {
+  int enabled = 1;
+  setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+}
+
+Socket::~Socket() { close(); }
+
+Socket::Socket(Socket&& other) : handle(other.handle) { other.handle = SOCKET_INVALID_HANDLE; }
+
+Socket& Socket::operator=(Socket&& other) {
+  if (this != &other) {
+    close();
+    handle = other.handle;
+    other.handle = SOCKET_INVALID_HANDLE;
+  }
+
+  return *this;
+}
+
+Socket Socket::listen(u16 port) {
+  if (!startWinsock()) return {};
+
+  Socket socket(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+  if (!socket.isValid()) return {};
+
+  int enabled = 1;
+  setsockopt(socket.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+
+  if (bind(socket.handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(socket.handle, SOMAXCONN) != 0) {
+    warning(std::format("[Socket::listen] Can't listen on port [{}]", port));
+    return {};
+  }
+
+  return socket;
+}
+
+Socket Socket::connect(const std::string& host, u16 port) {
+  if (!startWinsock()) return {};
+
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+    warning(std::format("[Socket::connect] Can't resolve [{}]", host));
+    return {};
+  }
+
+  Socket socket;
+  for (addrinfo* address = addresses; address && !socket.isValid(); address = address->ai_next) {
+    socket = Socket(::socket(address->ai_family, address->ai_socktype, address->ai_protocol));
+    if (socket.isValid() && ::connect(socket.handle, address->ai_addr, static_cast<SocketLength>(address->ai_addrlen)) != 0)
+      socket.close();
+  }
+  freeaddrinfo(addresses);
+
+  if (socket.isValid())
+    setNoDelay(socket.handle);
+
+  return socket;
+}
+
+u16 Socket::getPort() const {
+  sockaddr_in address{};
+  SocketLength length = sizeof(address);
+  if (getsockname(handle, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+    return 0;
+
+  return ntohs(address.sin_port);
+}
+
+Socket Socket::accept() const {
+  Socket socket(::accept(handle, nullptr, nullptr));
+  if (socket.isValid())
+    setNoDelay(socket.handle);
+
+  return socket;
+}
+
+void Socket::setTimeout(double timeout) const {
+#ifdef _WIN32
+  DWORD time = static_cast<DWORD>(timeout * 1e3);
+#else
+  timeval time;
+  time.tv_sec = static_cast<long>(timeout);
+  time.tv_usec = static_cast<long>((timeout - time.tv_sec) * 1e6);
+#endif
+
+  setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&time), sizeof(time));
+  setsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&time), sizeof(time));
+}
+
+bool Socket::send(const void* data, size_t size) const {
+  const char* bytes = static_cast<const char*>(data);
+
+  while (size > 0) {
+    int numSent = ::send(handle, bytes, static_cast<int>(std::min<size_t>(size, 1 << 20)), SOCKET_SEND_FLAGS);
+    if (numSent <= 0) return false;
+
+    bytes += numSent;
+    size -= numSent;
+  }
+
+  return true;
+}
+
+bool Socket::receive(void* data, size_t size) const {
+  char* bytes = static_cast<char*>(data);
+
+  while (size > 0) {
+    int numReceived = ::recv(handle, bytes, static_cast<int>(std::min<size_t>(size, 1 << 20)), 0);
+    if (numReceived <= 0) return false; // 0 is a closed connection
+
+    bytes += numReceived;
+    size -= numReceived;
+  }
+
+  return true;
+}
+
+bool Socket::waitReadable(const std::vector<const Socket*>& sockets, double timeout, std::vector<bool>& readable) {
+  fd_set set;
+  FD_ZERO(&set);
+
+  SocketHandle maxHandle = 0;
+  for (const Socket* socket : sockets) {
+    FD_SET(socket->handle, &set);
+    maxHandle = std::max(maxHandle, socket->handle);
+  }
+
+  timeval time;
+  time.tv_sec = static_cast<long>(timeout);
+  time.tv_usec = static_cast<long>((timeout - time.tv_sec) * 1e6);
+
+  // The first parameter is ignored by Winsock
+  int numReady = select(static_cast<int>(maxHandle) + 1, &set, nullptr, nullptr, &time);
+
+  readable.assign(sockets.size(), false);
+  for (size_t i = 0; i < sockets.size() && numReady > 0; i++)
+    readable[i] = FD_ISSET(sockets[i]->handle, &set);
+
+  return numReady > 0;
+}
+
+void Socket::close() {
+  if (isValid()) {
+    closeHandle(handle);
+    handle = SOCKET_INVALID_HANDLE;
+  }
+}
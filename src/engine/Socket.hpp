@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+using SocketHandle = SOCKET;
+#define SOCKET_INVALID_HANDLE INVALID_SOCKET
+#else
+using SocketHandle = int;
+#define SOCKET_INVALID_HANDLE -1
+#endif
+
+// Blocking TCP socket (Winsock or BSD sockets). Failures don't throw: the calls return false or an invalid socket and
+// a broken connection is for the caller to drop
+class Socket {
+public:
+  Socket() {}
+  ~Socket();
+
+  Socket(Socket&& other);
+  Socket& operator=(Socket&& other);
+
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+
+  // On every interface, port 0 picks a free one
+  static Socket listen(u16 port);
+  static Socket connect(const std::string& host, u16 port);
+
+  bool isValid() const { return handle != SOCKET_INVALID_HANDLE; }
+  u16 getPort() const;
+
+  Socket accept() const;
+
+  // Bounds every blocking send and receive, one that runs out fails as a broken connection would
+  void setTimeout(double timeout) const;
+
+  // Both return false unless the whole buffer went through
+  bool send(const void* data, size_t size) const;
+  bool receive(void* data, size_t size) const;
+
+  template<typename T>
+  bool send(const T& value) const { return send(&value, sizeof(T)); }
+  template<typename T>
+  bool receive(T& value) const { return receive(&value, sizeof(T)); }
+
+  // Flags the sockets with data (or a closed connection) to read, false on timeout
+  static bool waitReadable(const std::vector<const Socket*>& sockets, double timeout, std::vector<bool>& readable);
+
+  void close();
+
+private:
+  SocketHandle handle = SOCKET_INVALID_HANDLE;
+
+  Socket(SocketHandle handle) : handle(handle) {}
+};
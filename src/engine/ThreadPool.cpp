@@ -0,0 +1,90 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(u32 numThreads) {
+  numThreads = std::max(numThreads, 1u);
+  workers.reserve(numThreads);
+
+  for (u32 i = 0; i < numThreads; i++)
+    workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  taskAvailable.notify_all();
+
+  for (std::thread& worker : workers)
+    worker.join();
+}
+
+ThreadPool& ThreadPool::get() {
+  static ThreadPool pool;
+  return pool;
+}
+
+u32 ThreadPool::getNumThreads() const {
+  return static_cast<u32>(workers.size());
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard lock(mutex);
+    tasks.push(std::move(task));
+    numPending++;
+  }
+  taskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock lock(mutex);
+  tasksDone.wait(lock, [this] { return numPending == 0; });
+}
+
+void ThreadPool::parallelFor(u32 count, const std::function<void(u32, u32)>& func, u32 minChunkSize) {
+  if (count == 0) return;
+
+  u32 numChunks = std::min(getNumThreads() * 4, (count + minChunkSize - 1) / minChunkSize);
+  numChunks = std::max(numChunks, 1u);
+
+  if (numChunks == 1) {
+    func(0, count);
+    return;
+  }
+
+  u32 chunkSize = (count + numChunks - 1) / numChunks;
+  for (u32 begin = 0; begin < count; begin += chunkSize) {
+    u32 end = std::min(begin + chunkSize, count);
+    submit([&func, begin, end] { func(begin, end); });
+  }
+
+  wait();
+}
+
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(mutex);
+      taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+      if (stopping && tasks.empty())
+        return;
+
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+
+    task();
+
+    {
+      std::lock_guard lock(mutex);
+      numPending--;
+      if (numPending == 0)
+        tasksDone.notify_all();
+    }
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  ThreadPool(u32 numThreads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  // Shared pool with a worker per hardware thread
+  static ThreadPool& get();
+
+  u32 getNumThreads() const;
+
+  void submit(std::function<void()> task);
+
+  // Blocks until every submitted task has finished.
+  // NOTE: Must not be called from inside a task (workers would wait for themselves)
+  void wait();
+
+  // Splits [0, count) into chunks and waits for them. func(begin, end)
+  void parallelFor(u32 count, const std::function<void(u32, u32)>& func, u32 minChunkSize = 1024);
+
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable taskAvailable;
+  std::condition_variable tasksDone;
+  u32 numPending = 0;
+  bool stopping = false;
+
+  void work();
+};
@@ -0,0 +1,211 @@
+#include "TileScheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Interleaves the lowest 16 bits of x and y
+static u32 calcMortonCode(uvec2 p) {
+  auto expandBits = [](u32 v) {
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+  };
+
+  return expandBits(p.x) | expandBits(p.y) << 1;
+}
+
+// Windows splits the cores in processor groups (up to 64 each) and a thread runs in one group at a time
+static void pinToCore(u32 core) {
+#ifdef _WIN32
+  WORD numGroups = GetActiveProcessorGroupCount();
+  WORD group = 0;
+  while (group + 1 < numGroups && core >= GetActiveProcessorCount(group))
+    core -= GetActiveProcessorCount(group++);
+
+  GROUP_AFFINITY affinity{};
+  affinity.Group = group;
+  affinity.Mask = static_cast<KAFFINITY>(1) << (core % 64);
+  if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr))
+    warning(std::format("[TileScheduler::pinToCore] Failed to pin a worker to core [{}] of group [{}]", core, group));
+#else
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(core % CPU_SETSIZE, &cpus);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+    warning(std::format("[TileScheduler::pinToCore] Failed to pin a worker to core [{}]", core));
+#endif
+}
+
+TileScheduler::TileScheduler(u32 numThreads, bool pinThreads) {
+  numThreads = std::max(numThreads, 1u);
+  threadStats.resize(numThreads);
+
+  for (u32 i = 0; i < numThreads; i++)
+    queues.push_back(std::make_unique<Queue>());
+
+  workers.reserve(numThreads);
+  for (u32 i = 0; i < numThreads; i++)
+    workers.emplace_back(&TileScheduler::work, this, i, pinThreads);
+}
+
+TileScheduler::~TileScheduler() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  runStarted.notify_all();
+
+  for (std::thread& worker : workers)
+    worker.join();
+}
+
+void TileScheduler::run(uvec2 numTiles, const std::function<void(uvec2, u32)>& func) {
+  u32 count = numTiles.x * numTiles.y;
+  if (count == 0) return;
+
+  std::vector<uvec2> tiles(count);
+  for (u32 i = 0; i < count; i++)
+    tiles[i] = uvec2(i % numTiles.x, i / numTiles.x);
+
+  std::sort(tiles.begin(), tiles.end(), [](uvec2 a, uvec2 b) { return calcMortonCode(a) < calcMortonCode(b); });
+
+  u32 numThreads = getNumThreads();
+  u32 chunkSize = (count + numThreads - 1) / numThreads;
+
+  for (u32 i = 0; i < numThreads; i++) {
+    u32 begin = std::min(i * chunkSize, count);
+    u32 end = std::min(begin + chunkSize, count);
+
+    std::lock_guard lock(queues[i]->mutex);
+    queues[i]->tiles.assign(tiles.begin() + begin, tiles.begin() + end);
+  }
+
+  this->func = &func;
+  numRemaining = count;
+
+  std::unique_lock lock(mutex);
+  runStart = std::chrono::steady_clock::now();
+  runIdx++;
+  numWorking = numThreads;
+  runStarted.notify_all();
+
+  runFinished.wait(lock, [this] { return numWorking == 0; });
+  this->func = nullptr;
+}
+
+void TileScheduler::resetStats() {
+  std::fill(threadStats.begin(), threadStats.end(), TileSchedulerThreadStats{});
+}
+
+double TileScheduler::calcImbalance() const {
+  double maxBusyTime = 0.;
+  double sumBusyTime = 0.;
+
+  for (const TileSchedulerThreadStats& stats : threadStats) {
+    maxBusyTime = std::max(maxBusyTime, stats.busyTime);
+    sumBusyTime += stats.busyTime;
+  }
+
+  return sumBusyTime > 0. ? maxBusyTime * threadStats.size() / sumBusyTime : 1.;
+}
+
+void TileScheduler::work(u32 threadIdx, bool pin) {
+  if (pin)
+    pinToCore(threadIdx % std::max(std::thread::hardware_concurrency(), 1u));
+
+  u32 rngState = threadIdx * 0x9e3779b9u + 1u;
+  u64 lastRunIdx = 0;
+
+  while (true) {
+    std::chrono::steady_clock::time_point start;
+    {
+      std::unique_lock lock(mutex);
+      runStarted.wait(lock, [&] { return stopping || runIdx != lastRunIdx; });
+
+      if (stopping)
+        return;
+
+      lastRunIdx = runIdx;
+      start = runStart;
+    }
+
+    TileSchedulerThreadStats& stats = threadStats[threadIdx];
+    double busyTime = 0.;
+
+    while (true) {
+      uvec2 tile;
+      bool isStolen = false;
+
+      if (!popTile(threadIdx, tile)) {
+        if (!stealTile(threadIdx, rngState, tile))
+          break;
+        isStolen = true;
+      }
+
+      auto tileStart = std::chrono::steady_clock::now();
+      (*func)(tile, threadIdx);
+      busyTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - tileStart).count();
+
+      stats.numTiles++;
+      stats.numSteals += isStolen;
+      if (numRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        numRemaining.notify_all();
+    }
+
+    // Every queue is empty, sleep until the other workers are done with the tiles they hold
+    for (u32 remaining = numRemaining.load(std::memory_order_acquire); remaining > 0; remaining = numRemaining.load(std::memory_order_acquire))
+      numRemaining.wait(remaining, std::memory_order_acquire);
+
+    double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.busyTime += busyTime;
+    stats.idleTime += std::max(runTime - busyTime, 0.);
+
+    std::lock_guard lock(mutex);
+    if (--numWorking == 0)
+      runFinished.notify_one();
+  }
+}
+
+bool TileScheduler::popTile(u32 threadIdx, uvec2& tile) {
+  Queue& queue = *queues[threadIdx];
+  std::lock_guard lock(queue.mutex);
+  if (queue.tiles.empty()) return false;
+
+  tile = queue.tiles.front();
+  queue.tiles.pop_front();
+  return true;
+}
+
+// Takes the tile furthest along the victim's Morton run, away from where the victim is working. The victims are
+// visited from a random one on, so a miss means every queue is empty: tiles are never added during a run
+bool TileScheduler::stealTile(u32 threadIdx, u32& rngState, uvec2& tile) {
+  u32 numThreads = getNumThreads();
+  if (numThreads == 1) return false;
+
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+
+  for (u32 i = 0; i < numThreads - 1; i++) {
+    u32 victim = (threadIdx + 1 + (rngState + i) % (numThreads - 1)) % numThreads;
+
+    Queue& queue = *queues[victim];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tiles.empty()) continue;
+
+    tile = queue.tiles.back();
+    queue.tiles.pop_back();
+    return true;
+  }
+
+  return false;
+}
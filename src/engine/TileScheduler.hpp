@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Per worker, summed over the runs since the last resetStats
+struct TileSchedulerThreadStats {
+  double busyTime = 0.; // Seconds inside the tile function
+  double idleTime = 0.; // Seconds of the runs spent looking for tiles or waiting for the others to finish
+  u32 numTiles = 0;
+  u32 numSteals = 0; // Tiles taken from another worker
+};
+
+// Work-stealing scheduler for image tiles. The tiles are sorted along a Morton curve and split in contiguous runs,
+// one per worker, so every worker starts on a compact block of the image. A worker takes its own tiles from the
+// front of its deque and, once empty, steals from the back of a random victim's deque: cheap tiles (sky) finish
+// early and their workers help with the expensive ones. Workers are kept across runs, optionally pinned to a core each
+class TileScheduler {
+public:
+  TileScheduler(u32 numThreads = std::thread::hardware_concurrency(), bool pinThreads = false);
+  ~TileScheduler();
+
+  u32 getNumThreads() const { return static_cast<u32>(workers.size()); }
+
+  // Calls func(tile, threadIdx) once per tile of the grid and blocks until all of them are done.
+  // NOTE: Not reentrant, func must not call run
+  void run(uvec2 numTiles, const std::function<void(uvec2, u32)>& func);
+
+  const std::vector<TileSchedulerThreadStats>& getThreadStats() const { return threadStats; }
+  void resetStats();
+
+  // Busiest worker over the mean, 1 when perfectly balanced
+  double calcImbalance() const;
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<uvec2> tiles;
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<TileSchedulerThreadStats> threadStats;
+
+  std::mutex mutex;
+  std::condition_variable runStarted;
+  std::condition_variable runFinished;
+  std::chrono::steady_clock::time_point runStart;
+  u64 runIdx = 0;
+  u32 numWorking = 0;
+  bool stopping = false;
+
+  const std::function<void(uvec2, u32)>* func = nullptr;
+  std::atomic<u32> numRemaining = 0; // Tiles not done yet, the workers out of tiles wait on it
+
+  void work(u32 threadIdx, bool pin);
+  bool popTile(u32 threadIdx, uvec2& tile);
+  bool stealTile(u32 threadIdx, u32& rngState, uvec2& tile);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+// GPU timer (GL_TIME_ELAPSED query), a ring of queries read size frames late so the GPU is never waited for
+struct TimerQuery {
+  std::vector<GLuint> ids;
+  GLsizei size = 0;
+  u32 current = 0; // Query of the next begin, the oldest one once every query has been used
+  u64 numEnded = 0;
+  double seconds = 0.;
+
+  TimerQuery() {}
+
+  TimerQuery(GLsizei size) : ids(size), size(size) {
+    glGenQueries(size, ids.data());
+  }
+
+  void begin() const { glBeginQuery(GL_TIME_ELAPSED, ids[current]); }
+  void clear()       { glDeleteQueries(size, ids.data()); ids.clear(); size = 0; }
+
+  void end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    current = (current + 1) % size;
+    numEnded++;
+  }
+
+  // Time of the oldest query, the last known one while it is not available
+  double getSeconds() {
+    if (numEnded < static_cast<u64>(size))
+      return seconds;
+
+    GLuint isAvailable = GL_FALSE;
+    glGetQueryObjectuiv(ids[current], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+    if (isAvailable) {
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(ids[current], GL_QUERY_RESULT, &ns);
+      seconds = ns * 1e-9;
+    }
+
+    return seconds;
+  }
+};
@@ -1,5 +1,6 @@
 #include "Mesh.hpp"
 #include "vertex.hpp"
+#include "VertexWelder.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -173,7 +174,8 @@ Mesh<Vertex4> Mesh<Vertex4>::loadObj(const fspath& file, bool printInfo) {
   const std::vector<tinyobj::shape_t>& shapes = reader.GetShapes();
   // const std::vector<tinyobj::material_t>& materials = reader.GetMaterials();
 
-  std::vector<Vertex4> vertices;
+  VertexWelder<Vertex4> welder;
+  std::vector<GLuint> indices;
 
   // Loop over shapes
   for (size_t s = 0; s < shapes.size(); s++) {
@@ -187,7 +189,7 @@ Mesh<Vertex4> Mesh<Vertex4>::loadObj(const fspath& file, bool printInfo) {
         // access to vertex
         tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
         size_t idxVert = 3 * size_t(idx.vertex_index);
-        Vertex4 vertex;
+        Vertex4 vertex{};
 
         vertex.position.x = attrib.vertices[idxVert + 0];
         vertex.position.y = attrib.vertices[idxVert + 1];
@@ -211,7 +213,7 @@ Mesh<Vertex4> Mesh<Vertex4>::loadObj(const fspath& file, bool printInfo) {
         vertex.color.y = attrib.colors[3*size_t(idx.vertex_index)+1];
         vertex.color.z = attrib.colors[3*size_t(idx.vertex_index)+2];
 
-        vertices.push_back(vertex);
+        indices.push_back(welder.add(vertex));
       }
       index_offset += fv;
 
@@ -229,7 +231,7 @@ Mesh<Vertex4> Mesh<Vertex4>::loadObj(const fspath& file, bool printInfo) {
     };
     std::string cname = clrp::format(std::format("[{}]", file.string()), cfmt);
     std::string infoLoad = std::format("[load]\nvertices: {}\ncolors:   {}\ntextures: {}\nnormals:  {}", attrib.vertices.size() / 3, attrib.colors.size() / 3, attrib.texcoords.size() / 2, attrib.normals.size() / 3);
-    std::string infoFinal = std::format("[final]\nvertices: {}\n", vertices.size());
+    std::string infoFinal = std::format("[final]\nvertices: {}\nindices:  {}\n", welder.vertices.size(), indices.size());
     printf("\n==================== %s ====================\n\n%s\n\n%s\n\n", cname.c_str(), infoLoad.c_str(), infoFinal.c_str());
 
     std::string end = "============================================";
@@ -243,8 +245,9 @@ Mesh<Vertex4> Mesh<Vertex4>::loadObj(const fspath& file, bool printInfo) {
   // ==================================== //
 
   status::end(true);
+  welder.printReport(file.string().c_str());
 
-  return Mesh<Vertex4>(vertices, GL_TRIANGLES, false);
+  return Mesh<Vertex4>(welder.vertices, indices, GL_TRIANGLES, false);
 }
 
 template<>
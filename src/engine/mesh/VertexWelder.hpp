@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Corners of the faces against the distinct vertices, with the bytes of the unindexed and of the indexed layouts
+inline void printWeldReport(const char* name, u32 numCorners, size_t numVertices, u64 bytesBefore, u64 bytesAfter) {
+  printf(
+    "%s: welded %u -> %zu vertices, %llu -> %llu bytes (%.1f%%)\n",
+    name, numCorners, numVertices, static_cast<unsigned long long>(bytesBefore), static_cast<unsigned long long>(bytesAfter),
+    bytesBefore ? 100. * bytesAfter / bytesBefore : 0.
+  );
+}
+
+// Collects the corners of the faces of a mesh and keeps one copy of every distinct vertex.
+// Vertices are compared by their bytes, so they must be fully initialized (no padding)
+template<typename T>
+class VertexWelder {
+public:
+  std::vector<T> vertices;
+
+  VertexWelder() : indices(0, VertexHash{&vertices}, VertexEqual{&vertices}) {}
+
+  // The set hashes through a pointer to vertices
+  VertexWelder(const VertexWelder&) = delete;
+  VertexWelder& operator=(const VertexWelder&) = delete;
+
+  void reserve(size_t numCorners) {
+    vertices.reserve(numCorners);
+    indices.reserve(numCorners);
+  }
+
+  // Returns the index of the vertex, added if it wasn't seen yet
+  u32 add(const T& vertex) {
+    numCorners++;
+
+    // The set only holds indices, so the candidate goes to the end of vertices and is taken back if it is a duplicate
+    u32 idx = static_cast<u32>(vertices.size());
+    vertices.push_back(vertex);
+
+    auto [it, isNew] = indices.insert(idx);
+    if (!isNew)
+      vertices.pop_back();
+
+    return *it;
+  }
+
+  u32 getNumCorners() const { return numCorners; }
+
+  // Unindexed vertices vs the welded ones plus a 32-bit index per corner
+  void printReport(const char* name) const {
+    u64 bytesBefore = static_cast<u64>(numCorners) * sizeof(T);
+    u64 bytesAfter = vertices.size() * sizeof(T) + static_cast<u64>(numCorners) * sizeof(u32);
+    printWeldReport(name, numCorners, vertices.size(), bytesBefore, bytesAfter);
+  }
+
+private:
+  struct VertexHash {
+    const std::vector<T>* vertices;
+
+    size_t operator()(u32 idx) const {
+      return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(&(*vertices)[idx]), sizeof(T)));
+    }
+  };
+
+  struct VertexEqual {
+    const std::vector<T>* vertices;
+
+    bool operator()(u32 a, u32 b) const { return std::memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(T)) == 0; }
+  };
+
+  std::unordered_set<u32, VertexHash, VertexEqual> indices; // Into vertices, hashed and compared by the vertex bytes
+  u32 numCorners = 0;
+};
@@ -21,5 +21,10 @@ struct VertexPC {
   vec3 color;
 };
 
+struct VertexPN {
+  vec3 position;
+  vec3 normal;
+};
+
 typedef Vertex1 VertexP;
 typedef Vertex4 VertexPCTN;
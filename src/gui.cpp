@@ -66,11 +66,42 @@ void gui::draw() {
     ColorEdit3("Sky horizon color", glm::value_ptr(rtDataPtr->skyHorizonColor));
     ColorEdit3("Sky zenith color", glm::value_ptr(rtDataPtr->skyZenithColor));
     SliderInt("Rays per pixel", &rtDataPtr->numRaysPerPixel, 1, 100);
-    SliderInt("Ray bounces", &rtDataPtr->numRayBounces, 1, 100);
+    SliderInt("Ray bounces (max)", &rtDataPtr->numRayBounces, 1, 100);
+    Checkbox("Russian roulette", &rtDataPtr->useRussianRoulette);
+    BeginDisabled(!rtDataPtr->useRussianRoulette);
+    SliderInt("Roulette min bounces", &rtDataPtr->rouletteMinBounces, 1, 20);
+    EndDisabled();
     SliderFloat("Rays diverge strength", &rtDataPtr->divergeStrength, 0.f, 100.f);
     SliderFloat("Rays defocus strength", &rtDataPtr->defocusStrength, 0.f, 100.f);
     SliderFloat("Focus distance", &rtDataPtr->focusDistance, 1.f, 100.f);
 
+    Checkbox("Use BVH (off: brute force)", &rtDataPtr->useBVH);
+    BeginDisabled(!rtDataPtr->useBVH);
+    Checkbox("Wide BVH (compressed nodes)", &rtDataPtr->useWideBVH);
+    static const u32 blasBuilders[] = {BVH_BUILDER_SWEEP_SAH, BVH_BUILDER_BINNED_SAH, BVH_BUILDER_LBVH, BVH_BUILDER_LBVH_GPU};
+    if (BeginCombo("BLAS builder", BVH::getBuilderName(rtDataPtr->blasBuilder))) {
+      for (u32 builder : blasBuilders)
+        if (Selectable(BVH::getBuilderName(builder), rtDataPtr->blasBuilder == builder) && rtDataPtr->blasBuilder != builder) {
+          rtDataPtr->blasBuilder = builder;
+          scene::rebuildBLAS(*rtDataPtr);
+        }
+      EndCombo();
+    }
+    EndDisabled();
+    Checkbox("Watertight triangles", &rtDataPtr->useWatertight);
+    Checkbox("Light sampling (NEE + MIS)", &rtDataPtr->useLightSampling);
+    static const char* samplers[RT_SAMPLER_COUNT] = {"Random (white noise)", "Sobol (Owen scrambled)", "Lattice (blue noise)"};
+    Combo("Sampler", &rtDataPtr->samplerType, samplers, RT_SAMPLER_COUNT);
+    Checkbox("Adaptive sampling", &rtDataPtr->useAdaptiveSampling);
+    BeginDisabled(!rtDataPtr->useAdaptiveSampling);
+    SliderFloat("Adaptive threshold", &rtDataPtr->adaptiveThreshold, 0.001f, 0.5f, "%.3f", ImGuiSliderFlags_Logarithmic);
+    SliderInt("Adaptive min spp", &rtDataPtr->adaptiveMinSpp, 1, 256);
+    EndDisabled();
+    Checkbox("Spp heatmap", &rtDataPtr->showSppHeatmap);
+    Checkbox("Denoiser (a-trous)", &rtDataPtr->useDenoiser);
+    BeginDisabled(!rtDataPtr->useDenoiser);
+    SliderInt("Denoise iterations", &rtDataPtr->denoiseIterations, 1, RT_DENOISE_MAX_ITERATIONS);
+    EndDisabled();
     Checkbox("Enable environmental light", &rtDataPtr->enableEnvLight);
     BeginDisabled(!rtDataPtr->enableEnvLight);
     SliderFloat("Sun focus", &rtDataPtr->sunFocus, -1.f, 1000.f);
@@ -79,6 +110,8 @@ void gui::draw() {
 
     SeparatorText("Spheres");
     if (rtDataPtr->numSpheres != 0) {
+      Checkbox("Animate", &rtDataPtr->animateSpheres);
+
       static int currentIdx = 0;
       if (BeginCombo("Spheres", std::to_string(currentIdx).c_str())) {
         for (int i = 0; i < rtDataPtr->numSpheres; i++) {
@@ -93,30 +126,34 @@ void gui::draw() {
       }
 
       Sphere sphere = scene::getSphere(currentIdx);
-      RayTracingMaterial& material = sphere.material;
+      RayTracingMaterial material = scene::getMaterial(sphere.materialIdx);
       bool didChange = false;
       didChange += DragFloat3("Position", glm::value_ptr(sphere.pos));
       didChange += SliderFloat("Radius", &sphere.radius, 0.f, 50.f);
 
-      didChange += ColorEdit4("Color", glm::value_ptr(material.color));
-      didChange += ColorEdit3("Emission color", glm::value_ptr(material.emissionColor));
-      didChange += SliderFloat("Emission strength", &material.emissionStrength, 0.f, 100.f);
-      didChange += SliderFloat("Smoothness", &material.smoothness, 0.f, 1.f);
-      didChange += SliderFloat("Specular probability", &material.specularProbability, 0.f, 1.f);
-      didChange += ColorEdit3("Specular color", glm::value_ptr(material.specularColor));
-
       if (didChange)
         scene::updateSpheresBuffer(sphere, currentIdx);
+
+      bool didChangeMaterial = false;
+      didChangeMaterial += ColorEdit4("Color", glm::value_ptr(material.color));
+      didChangeMaterial += ColorEdit3("Emission color", glm::value_ptr(material.emissionColor));
+      didChangeMaterial += SliderFloat("Emission strength", &material.emissionStrength, 0.f, 100.f);
+      didChangeMaterial += SliderFloat("Smoothness", &material.smoothness, 0.f, 1.f);
+      didChangeMaterial += SliderFloat("Specular probability", &material.specularProbability, 0.f, 1.f);
+      didChangeMaterial += ColorEdit3("Specular color", glm::value_ptr(material.specularColor));
+
+      if (didChangeMaterial)
+        scene::updateMaterial(sphere.materialIdx, material);
     }
 
     SeparatorText("Room");
-    if (!rtDataPtr->room.meshesRT[0].triangles.empty()) {
+    if (!rtDataPtr->room.isEmpty()) {
       static const char* walls[ROOM_TOTAL_MESHES] = {"Left", "Right", "Back", "Front", "Ceiling", "Floor", "Lamp"};
       static int wallIdx = 0;
       Combo("Walls", &wallIdx, walls, ROOM_TOTAL_MESHES);
 
       MeshRT& wall = rtDataPtr->room.meshesRT[wallIdx];
-      RayTracingMaterial& material = wall.meshInfo.material;
+      RayTracingMaterial& material = wall.material;
       bool didChange = false;
 
       didChange += ColorEdit4("Color##2", glm::value_ptr(material.color));
@@ -126,11 +163,8 @@ void gui::draw() {
       didChange += SliderFloat("Specular probability##2", &material.specularProbability, 0.f, 1.f);
       didChange += ColorEdit3("Specular color##2", glm::value_ptr(material.specularColor));
 
-      if (didChange) {
-        // NOTE: Don't pass directly beacuse the function will increase the value;
-        u32 firstTriIdx = wall.meshInfo.firstTriangleIndex;
-        scene::updateMeshBuffer(firstTriIdx, &wall, 1, wallIdx);
-      }
+      if (didChange)
+        scene::updateMaterial(wall.meshInfo.materialIdx, material);
     }
 
     TreePop();
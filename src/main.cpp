@@ -1,7 +1,11 @@
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <format>
+#include <string>
+#include <vector>
 #include <direct.h>
 
 #include "imgui.h"
@@ -17,11 +21,21 @@
 #include "engine/Light.hpp"
 #include "engine/FBO.hpp"
 #include "engine/RBO.hpp"
+#include "engine/TimerQuery.hpp"
+#include "engine/BufferReadback.hpp"
+#include "engine/SSBO.hpp"
+#include "engine/RenderBudget.hpp"
+#include "engine/BlueNoise.hpp"
+#include "engine/mesh/texture/image2D.hpp"
 #include "global.hpp"
 #include "gui.hpp"
 #include "objects/RayTracingData.hpp"
 #include "objects/scene.hpp"
 #include "utils/clrp.hpp"
+#include "bench/bench.hpp"
+#include "tracer/tracer.hpp"
+
+#define BATCH_DEFAULT_SPP 16u
 
 using global::window;
 
@@ -49,10 +63,65 @@ void GLAPIENTRY MessageCallback(
   exit(1);
 }
 
-int main() {
+// `--render-gl <scene> [output] [--time seconds] [--spp n] [--adaptive] [--denoise]`: accumulates the scene in a hidden
+// window until the budget runs out, then writes the result, denoised or not. The spp budget counts uniform passes,
+// adaptive ones trace fewer rays
+static bool parseBatchArgs(
+  int argc, char* argv[], u32& sceneNumber, std::string& output, RenderBudget& budget, bool& useAdaptiveSampling,
+  bool& useDenoiser
+) {
+  std::vector<std::string> args;
+  double seconds = 0.;
+  u32 spp = 0;
+
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--time" && i + 1 < argc)
+      seconds = std::atof(argv[++i]);
+    else if (arg == "--spp" && i + 1 < argc)
+      spp = static_cast<u32>(std::atoi(argv[++i]));
+    else if (arg == "--adaptive")
+      useAdaptiveSampling = true;
+    else if (arg == "--denoise")
+      useDenoiser = true;
+    else
+      args.push_back(arg);
+  }
+
+  sceneNumber = static_cast<u32>(std::atoi(args.empty() ? "" : args[0].c_str()));
+  if (sceneNumber < 1 || sceneNumber > NUM_SCENES) {
+    warning(std::format("[main] Unknown scene [{}], available: 1 to {}", args.empty() ? "" : args[0], NUM_SCENES));
+    return false;
+  }
+
+  output = args.size() > 1 ? args[1] : std::format("render_gl_scene{}.png", sceneNumber);
+  budget = seconds > 0. || spp > 0 ? RenderBudget(seconds, spp) : RenderBudget(0., BATCH_DEFAULT_SPP);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
   // Assuming the executable is launching from its own directory
   _chdir("../../../src");
-  srand(static_cast<unsigned int>(time(nullptr)));
+  srand(0); // Fixed so runs are reproducible, the path tracers seed their own streams (shaders/rng.glsl)
+
+  if (argc >= 3 && std::string(argv[1]) == "--bench")
+    return bench::run(argv[2]);
+
+  if (argc >= 3 && std::string(argv[1]) == "--render")
+    return tracer::run(argc, argv);
+
+  if (argc >= 3 && std::string(argv[1]) == "--worker")
+    return tracer::runWorker(argc, argv);
+
+  bool isBatch = argc >= 3 && std::string(argv[1]) == "--render-gl";
+  u32 sceneNumber = 3;
+  std::string batchOutput;
+  RenderBudget budget;
+  bool batchAdaptive = false;
+  bool batchDenoise = false;
+  if (isBatch && !parseBatchArgs(argc, argv, sceneNumber, batchOutput, budget, batchAdaptive, batchDenoise))
+    return EXIT_FAILURE;
 
   // GLFW init
   glfwInit();
@@ -60,6 +129,7 @@ int main() {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+  glfwWindowHint(GLFW_VISIBLE, !isBatch);
 
   // Window init
   window = glfwCreateWindow(1200, 720, "Sphere", NULL, NULL);
@@ -97,6 +167,7 @@ int main() {
   // ===== Shaders ============================================== //
 
   Shader::setDirectoryLocation("shaders");
+  scene::defineShaderConstants();
   Shader::setDefaultShader(SHADER_DEFAULT_TYPE_COLOR_SHADER, "default/color.vert", "default/color.frag");
   Shader::setDefaultShader(SHADER_DEFAULT_TYPE_NORMALS_SHADER, "default/normal.vert", "default/normal.frag", "default/normal.geom");
   Shader::setDefaultShader(SHADER_DEFAULT_TYPE_TEXTURE_SHADER, "default/texture.vert", "default/texture.frag");
@@ -105,12 +176,20 @@ int main() {
   Shader rtShader("rt.vert", "rt.frag");
   Shader averageShader("average.vert", "average.frag");
   Shader swapShader("swap.vert", "swap.frag");
+  Shader denoiseShader("denoise.vert", "denoise.frag");
   Shader colorShader = Shader::getDefaultShader(SHADER_DEFAULT_TYPE_COLOR_SHADER);
 
   const GLint averageNumRenderedFramesLoc = averageShader.getUniformLoc("u_numRenderedFrames");
   const GLint averageNewRenderLoc = averageShader.getUniformLoc("u_newRender");
 
   const GLint rtLightPosLoc = rtShader.getUniformLoc("u_lightPos");
+  const GLint rtUpdateDenoiseFeaturesLoc = rtShader.getUniformLoc("u_updateDenoiseFeatures");
+
+  const GLint mainShowSppHeatmapLoc = mainShader.getUniformLoc("u_showSppHeatmap");
+  const GLint mainUniformSppLoc = mainShader.getUniformLoc("u_uniformSpp");
+  const GLint mainUseDenoiserLoc = mainShader.getUniformLoc("u_useDenoiser");
+
+  const GLint denoiseIterationLoc = denoiseShader.getUniformLoc("u_denoiseIteration");
 
   rtShader.setUniform2f("u_resolution", vec2(winSize));
 
@@ -151,11 +230,27 @@ int main() {
   FBO fboRT(1);
   FBO fboAverage(1);
   FBO fboSwap(1);
+  FBO fboDenoiseA(1);
+  FBO fboDenoiseB(1);
+  FBO fboDenoised(1);
   RBO rboScreen(1);
 
+  // Error of the pixels and, a few mip levels up, of their tiles (adaptive sampling in rt.frag)
+  TexParams errorTexParams{
+    GL_NEAREST_MIPMAP_NEAREST,
+    GL_NEAREST,
+    GL_CLAMP_TO_EDGE,
+    GL_CLAMP_TO_EDGE,
+  };
+
+  // The accumulation is in floats, an RGB8 average stops moving once a frame weighs less than 1 / 255. The alpha of
+  // the color is the mean squared luminance, the stats are the samples of every pixel and the passes that added some
   // fboSwap write
-  Texture screenColorTextureOld(winSize, GL_RGB, GL_RGB, "u_screenColorTexOld", 0);
+  Texture screenColorTextureOld(winSize, GL_RGBA32F, GL_RGBA, "u_screenColorTexOld", 0);
+  Texture screenStatsTextureOld(winSize, GL_RG32F, GL_RG, "u_screenStatsTexOld", 2);
   fboSwap.attach2D(GL_COLOR_ATTACHMENT0, screenColorTextureOld);
+  fboSwap.attach2D(GL_COLOR_ATTACHMENT1, screenStatsTextureOld);
+  fboSwap.setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
 
   // fboScreen write
   Texture screenColorTextureDefault(winSize, GL_RGB, GL_RGB, "u_screenColorTexDefault", 0);
@@ -163,13 +258,39 @@ int main() {
   fboScreen.attach2D(GL_COLOR_ATTACHMENT0, screenColorTextureDefault);
   fboScreen.attach2D(GL_DEPTH_ATTACHMENT, screenDepthTexture);
 
-  // fboRT write
-  Texture screenColorTextureNew(winSize, GL_RGB, GL_RGB, "u_screenColorTexNew", 1); // Binding along with scscreenColorTextureOld
+  // fboRT write. The new frame is in floats too, the samples over 1 and the dark ones count fully in the error map
+  Texture screenColorTextureNew(winSize, GL_RGB32F, GL_RGB, "u_screenColorTexNew", 1); // Binding along with scscreenColorTextureOld
+  Texture screenRaysTexture(winSize, GL_R32F, GL_RED, "u_screenRaysTex", 3);
+  Texture screenAlbedoTexture(winSize, GL_RGBA16F, GL_RGBA, "u_screenAlbedoTex", 2);
+  Texture screenNormalDepthTexture(winSize, GL_RGBA32F, GL_RGBA, "u_screenNormalDepthTex", 3);
   fboRT.attach2D(GL_COLOR_ATTACHMENT0, screenColorTextureNew);
+  fboRT.attach2D(GL_COLOR_ATTACHMENT1, screenRaysTexture);
+  fboRT.attach2D(GL_COLOR_ATTACHMENT2, screenAlbedoTexture);
+  fboRT.attach2D(GL_COLOR_ATTACHMENT3, screenNormalDepthTexture);
+  fboRT.setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3});
 
   // fboAverage write (swapping with old render)
-  Texture screenColorTextureFinal(winSize, GL_RGB, GL_RGB, "u_screenColorTexFinal", 0);
+  Texture screenColorTextureFinal(winSize, GL_RGBA32F, GL_RGBA, "u_screenColorTexFinal", 0);
+  Texture screenStatsTextureFinal(winSize, GL_RG32F, GL_RG, "u_screenStatsTexFinal", 1);
+  Texture screenErrorTexture(winSize, GL_R32F, GL_RED, "u_screenErrorTex", 3, GL_TEXTURE_2D, errorTexParams);
   fboAverage.attach2D(GL_COLOR_ATTACHMENT0, screenColorTextureFinal);
+  fboAverage.attach2D(GL_COLOR_ATTACHMENT1, screenStatsTextureFinal);
+  fboAverage.attach2D(GL_COLOR_ATTACHMENT2, screenErrorTexture);
+  fboAverage.setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2});
+
+  // fboDenoiseA / fboDenoiseB / fboDenoised write, the iterations of denoise.frag go back and forth between the first
+  // two and the last one writes the image shown
+  Texture screenDenoiseTextureA(winSize, GL_RGBA32F, GL_RGBA, "u_denoiseInputTex", 0);
+  Texture screenDenoiseTextureB(winSize, GL_RGBA32F, GL_RGBA, "u_denoiseInputTex", 0);
+  Texture screenDenoisedTexture(winSize, GL_RGBA32F, GL_RGBA, "u_screenDenoisedTex", 2);
+  fboDenoiseA.attach2D(GL_COLOR_ATTACHMENT0, screenDenoiseTextureA);
+  fboDenoiseB.attach2D(GL_COLOR_ATTACHMENT0, screenDenoiseTextureB);
+  fboDenoised.attach2D(GL_COLOR_ATTACHMENT0, screenDenoisedTexture);
+
+  // Allocates the mip levels, rt.frag reads the tiles before the first average pass fills them
+  screenErrorTexture.bind();
+  glGenerateMipmap(GL_TEXTURE_2D);
+  screenErrorTexture.unbind();
 
   fboScreen.bind();
   rboScreen.storage(GL_DEPTH24_STENCIL8, winSize);
@@ -177,19 +298,56 @@ int main() {
   FBO::unbind();
 
   mainShader.setUniformTexture(screenColorTextureFinal);
+  mainShader.setUniformTexture(screenStatsTextureFinal);
   rtShader.setUniformTexture(screenColorTextureNew);
   rtShader.setUniformTexture(screenDepthTexture);
+  rtShader.setUniformTexture(screenStatsTextureOld);
+  rtShader.setUniformTexture(screenErrorTexture);
   averageShader.setUniformTexture(screenColorTextureOld);
   averageShader.setUniformTexture(screenColorTextureNew);
+  averageShader.setUniformTexture(screenStatsTextureOld);
+  averageShader.setUniformTexture(screenRaysTexture);
   swapShader.setUniformTexture(screenColorTextureFinal);
+  swapShader.setUniformTexture(screenStatsTextureFinal);
+  mainShader.setUniformTexture(screenDenoisedTexture);
+  denoiseShader.setUniformTexture(screenDenoiseTextureA);
+  denoiseShader.setUniformTexture(screenStatsTextureFinal);
+  denoiseShader.setUniformTexture(screenAlbedoTexture);
+  denoiseShader.setUniformTexture(screenNormalDepthTexture);
 
   Mesh<VertexPT> screenMesh = meshes::screen();
 
+  TimerQuery rtTimer(2);
+
+  // Paths and segments counted by rt.frag, the 32 bit counters wrap so they are summed by differences
+  SSBO pathStatsBuf(1);
+  uvec2 pathStats(0u);
+  pathStatsBuf.data(sizeof(pathStats), &pathStats);
+
+  // The window title reads a copy two frames old, the batch mode reads the buffer itself after waiting for the frame
+  BufferReadback pathStatsReadback(2, sizeof(pathStats));
+
+  u64 numStatsPaths = 0;
+  u64 numStatsPathSegments = 0;
+  u32 numStatsFrames = 0; // Copied since the last read of the window title
+  u64 numAdaptiveCameraRays = 0; // Estimated from the paths of the stats grid, for the spp of the batch mode
+  auto addPathStats = [&](const uvec2& newPathStats) {
+    numStatsPaths += newPathStats.x - pathStats.x;
+    numStatsPathSegments += newPathStats.y - pathStats.y;
+    pathStats = newPathStats;
+  };
+
+  // Read by the lattice sampler of rt.frag, the table is made by the compiler
+  SSBO blueNoiseBuf(1);
+  blueNoiseBuf.data(sizeof(blueNoise::tile), blueNoise::tile.data(), GL_STATIC_DRAW);
+
   // ===== Scenes =============================================== //
 
   RayTracingData rtData;
-  scene::scene3(rtData);
+  scene::load(sceneNumber, rtData);
   scene::setUnifrom(rtShader);
+  rtData.useAdaptiveSampling |= batchAdaptive;
+  rtData.useDenoiser |= batchDenoise;
 
   // ============================================================ //
 
@@ -197,8 +355,14 @@ int main() {
   gui::link(&light);
   gui::link(&rtData);
 
-  // Render loop
-  while (!glfwWindowShouldClose(window)) {
+  // The first hits only move with the camera and the scene, the other frames leave the feature textures as they are
+  bool hasDenoiseFeatures = false;
+  mat4 denoiseFeaturesCamera(0.f);
+  u32 denoiseFeaturesEdits = 0;
+
+  // Render loop, in batch mode uncapped and without inputs, GUI nor presentation
+  budget.start();
+  while (!glfwWindowShouldClose(window) && (!isBatch || budget.hasRoomForFrame())) {
     static Camera* camera = &cameraScene;
     static double titleTimer = glfwGetTime();
     static double prevTime = titleTimer;
@@ -209,24 +373,51 @@ int main() {
     global::dt = currTime - prevTime;
 
     // FPS cap
-    if (global::dt < fpsLimit) continue;
+    if (!isBatch && global::dt < fpsLimit) continue;
     else prevTime = currTime;
 
     camera = global::sceneCamera ? &cameraScene : &cameraHelper1;
 
-    if (glfwGetWindowAttrib(window, GLFW_FOCUSED))
-      InputsHandler::process(camera);
-    else
-      glfwSetCursorPos(window, winCenter.x, winCenter.y);
+    if (!isBatch) {
+      if (glfwGetWindowAttrib(window, GLFW_FOCUSED))
+        InputsHandler::process(camera);
+      else
+        glfwSetCursorPos(window, winCenter.x, winCenter.y);
 
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
+      ImGui_ImplOpenGL3_NewFrame();
+      ImGui_ImplGlfw_NewFrame();
+      ImGui::NewFrame();
+    }
 
     // Update window title every 0.3 seconds
-    if (currTime - titleTimer >= 0.3) {
+    if (!isBatch && currTime - titleTimer >= 0.3) {
       u16 fps = static_cast<u16>(1.f / global::dt);
-      glfwSetWindowTitle(window, std::format("FPS: {} / {:.5f} ms", fps, global::dt).c_str());
+      double rtTime = rtTimer.getSeconds();
+      const char* traversal = !rtData.useBVH ? "brute force" : rtData.useWideBVH ? "wide BVH" : "BVH";
+
+      // Means over the frames since the last update, the last known ones while the copy isn't ready. The adaptive
+      // passes trace from none to RT_ADAPTIVE_MAX_RAYS_SCALE times the rays per pixel, their camera rays are
+      // estimated from the paths of the stats grid
+      static double meanPathLength = 0.;
+      static double adaptiveCameraRays = 0.;
+      uvec2 newPathStats;
+      if (pathStatsReadback.read(&newPathStats)) {
+        numStatsPaths = numStatsPathSegments = 0;
+        addPathStats(newPathStats);
+        if (numStatsPaths) meanPathLength = static_cast<double>(numStatsPathSegments) / numStatsPaths;
+        if (numStatsFrames)
+          adaptiveCameraRays = static_cast<double>(numStatsPaths) * RT_PATH_STATS_STRIDE * RT_PATH_STATS_STRIDE / numStatsFrames;
+        numStatsFrames = 0;
+      }
+
+      double cameraRays = rtData.useAdaptiveSampling
+        ? adaptiveCameraRays
+        : static_cast<double>(winSize.x) * winSize.y * rtData.numRaysPerPixel;
+      double mraysPerSec = cameraRays / rtTime * 1e-6;
+
+      glfwSetWindowTitle(window, std::format(
+        "FPS: {} / {:.5f} ms / {:.2f} Mrays/s ({}) / {:.2f} bounces per path", fps, global::dt, mraysPerSec, traversal, meanPathLength
+      ).c_str());
       titleTimer = currTime;
     }
 
@@ -237,8 +428,10 @@ int main() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     screenColorTextureFinal.bind();
+    screenStatsTextureFinal.bind();
     screenMesh.draw(camera, swapShader);
     screenColorTextureFinal.unbind();
+    screenStatsTextureFinal.unbind();
 
     // ===== Default world draw =================================== //
 
@@ -253,19 +446,52 @@ int main() {
 
     // ===== Ray tracing (Post-process) =========================== //
 
+    bool updateDenoiseFeatures = rtData.useDenoiser && (
+      !hasDenoiseFeatures || global::frameId == 1 || rtData.animateSpheres || camera->getMatrix() != denoiseFeaturesCamera ||
+      scene::getNumEdits() != denoiseFeaturesEdits
+    );
+    if (updateDenoiseFeatures)
+      fboRT.setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3});
+    else
+      fboRT.setDrawBuffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_NONE, GL_NONE});
+    hasDenoiseFeatures = rtData.useDenoiser;
+    denoiseFeaturesCamera = camera->getMatrix();
+    denoiseFeaturesEdits = scene::getNumEdits();
+
     fboRT.bind();
     glClearColor(0.f, 0.f, 0.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT);
     glDisable(GL_DEPTH_TEST);
 
+    if (rtData.animateSpheres)
+      scene::animateSpheres();
+    scene::refit();
+    scene::updateEmitters(rtData);
+
     screenColorTextureDefault.bind();
+    screenStatsTextureOld.bind();
+    screenErrorTexture.bind();
     scene::bind();
+    pathStatsBuf.bindBase(RT_SSBO_PATH_STATS);
+    blueNoiseBuf.bindBase(RT_SSBO_BLUE_NOISE);
 
     rtData.update(rtShader);
     rtShader.setUniform3f(rtLightPosLoc, light.getPosition());
+    rtShader.setUniform1i(rtUpdateDenoiseFeaturesLoc, updateDenoiseFeatures);
+    rtTimer.begin();
     screenMesh.draw(camera, rtShader);
+    rtTimer.end();
+
+    // The path stats are written with atomics, both the copy and the read of the batch mode come after the barrier
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    if (!isBatch) {
+      pathStatsReadback.copy(pathStatsBuf);
+      numStatsFrames++;
+    }
 
     screenColorTextureDefault.unbind();
+    screenStatsTextureOld.unbind();
+    screenErrorTexture.unbind();
     scene::unbind();
 
     // ===== Average between old and new render (Post-process) ==== //
@@ -276,6 +502,8 @@ int main() {
 
     screenColorTextureOld.bind();
     screenColorTextureNew.bind();
+    screenStatsTextureOld.bind();
+    screenRaysTexture.bind();
 
     averageShader.setUniform1i(averageNumRenderedFramesLoc, global::frameId);
     averageShader.setUniform1i(averageNewRenderLoc, global::newRender);
@@ -284,6 +512,67 @@ int main() {
 
     screenColorTextureOld.unbind();
     screenColorTextureNew.unbind();
+    screenStatsTextureOld.unbind();
+    screenRaysTexture.unbind();
+
+    // The tile errors are the mean of their pixels
+    screenErrorTexture.bind();
+    glGenerateMipmap(GL_TEXTURE_2D);
+    screenErrorTexture.unbind();
+
+    // ===== Denoise (Post-process) =============================== //
+
+    // Iteration 0 reads the accumulation, the next ones the output of the last
+    if (rtData.useDenoiser) {
+      const Texture* denoiseInput = &screenColorTextureFinal;
+      screenStatsTextureFinal.bind();
+      screenAlbedoTexture.bind();
+      screenNormalDepthTexture.bind();
+
+      for (int i = 0; i <= rtData.denoiseIterations; i++) {
+        bool isEven = i % 2 == 0;
+        if (i == rtData.denoiseIterations)
+          fboDenoised.bind();
+        else
+          (isEven ? fboDenoiseA : fboDenoiseB).bind();
+
+        denoiseInput->bind();
+        denoiseShader.setUniform1i(denoiseIterationLoc, i);
+        screenMesh.draw(camera, denoiseShader);
+        denoiseInput->unbind();
+
+        denoiseInput = isEven ? &screenDenoiseTextureA : &screenDenoiseTextureB;
+      }
+
+      screenStatsTextureFinal.unbind();
+      screenAlbedoTexture.unbind();
+      screenNormalDepthTexture.unbind();
+    }
+
+    // Waiting for the frame keeps the budget on GPU time, the driver would queue frames past the deadline otherwise
+    if (isBatch) {
+      glFinish();
+      // The adaptive camera rays are estimated from the paths of the stats grid
+      u64 prevNumStatsPaths = numStatsPaths;
+      uvec2 newPathStats;
+      pathStatsBuf.read(sizeof(newPathStats), &newPathStats);
+      addPathStats(newPathStats);
+      u64 numFrameRays = static_cast<u64>(winSize.x) * winSize.y * rtData.numRaysPerPixel;
+      u32 frameSpp = rtData.numRaysPerPixel;
+
+      // The adaptive passes give the pixels from none to RT_ADAPTIVE_MAX_RAYS_SCALE times the rays per pixel, the spp
+      // is the mean over the image so far, rounded once so it doesn't drift
+      if (rtData.useAdaptiveSampling) {
+        numFrameRays = (numStatsPaths - prevNumStatsPaths) * RT_PATH_STATS_STRIDE * RT_PATH_STATS_STRIDE;
+        numAdaptiveCameraRays += numFrameRays;
+        double numPixels = static_cast<double>(winSize.x) * winSize.y;
+        u32 meanSpp = static_cast<u32>(std::round(numAdaptiveCameraRays / numPixels));
+        frameSpp = meanSpp > budget.getSpp() ? meanSpp - budget.getSpp() : 0u;
+      }
+      budget.addFrame(frameSpp, numFrameRays);
+      global::frameId++;
+      continue;
+    }
 
     // ===== Final draw =========================================== //
 
@@ -292,10 +581,17 @@ int main() {
     glClear(GL_COLOR_BUFFER_BIT);
 
     mainShader.setUniformTexture(screenColorTextureFinal);
+    mainShader.setUniform1i(mainShowSppHeatmapLoc, rtData.showSppHeatmap);
+    mainShader.setUniform1f(mainUniformSppLoc, static_cast<float>(global::frameId * rtData.numRaysPerPixel));
+    mainShader.setUniform1i(mainUseDenoiserLoc, rtData.useDenoiser);
 
     screenColorTextureFinal.bind();
+    screenStatsTextureFinal.bind();
+    screenDenoisedTexture.bind();
     screenMesh.draw(camera, mainShader);
     screenColorTextureFinal.unbind();
+    screenStatsTextureFinal.unbind();
+    screenDenoisedTexture.unbind();
 
     if (global::drawGlobalAxis)
       meshes::axis(50.f).draw(camera, colorShader);
@@ -316,6 +612,40 @@ int main() {
       global::frameId = 1;
   }
 
+  if (isBatch) {
+    budget.stop();
+    std::vector<byte> pixels(static_cast<size_t>(winSize.x) * winSize.y * 3);
+    (rtData.useDenoiser ? fboDenoised : fboAverage).bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, winSize.x, winSize.y, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    std::vector<vec2> stats(static_cast<size_t>(winSize.x) * winSize.y);
+    fboAverage.bind();
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glReadPixels(0, 0, winSize.x, winSize.y, GL_RG, GL_FLOAT, stats.data());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    FBO::unbind();
+
+    image2D::write(batchOutput, uvec2(winSize), 3, pixels.data());
+    budget.print("GL renderer");
+    printf("Mean path length: %.2f bounces\n", numStatsPaths ? static_cast<double>(numStatsPathSegments) / numStatsPaths : 0.);
+    if (rtData.useAdaptiveSampling) {
+      double sumSpp = 0.;
+      float minSpp = stats[0].x;
+      float maxSpp = stats[0].x;
+      for (const vec2& pixelStats : stats) {
+        sumSpp += pixelStats.x;
+        minSpp = std::min(minSpp, pixelStats.x);
+        maxSpp = std::max(maxSpp, pixelStats.x);
+      }
+      printf("Adaptive sampling: %.1f spp per pixel on average, %.0f to %.0f\n", sumSpp / stats.size(), minSpp, maxSpp);
+    }
+    printf(
+      "Rendered scene%u, %ux%u%s -> %s\n", sceneNumber, winSize.x, winSize.y, rtData.useDenoiser ? ", denoised" : "",
+      batchOutput.c_str()
+    );
+  }
+
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
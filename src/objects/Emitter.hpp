@@ -0,0 +1,24 @@
+#pragma once
+
+#define EMITTER_TYPE_TRIANGLE 0u
+#define EMITTER_TYPE_SPHERE   1u
+
+// Emissive primitive for the light sampling of the path tracers: triangles in world space, spheres by index as they
+// move. The alias table (Vose) is packed in the entries: a slot drawn uniformly keeps its own emitter with
+// probability, its alias otherwise, so emitters come out weighted by luminance x area
+struct Emitter {
+  alignas(16) vec3 a; // Triangle vertices as a and the edges to b and c
+  u32 type = EMITTER_TYPE_TRIANGLE;
+  alignas(16) vec3 ab;
+  u32 sphereIdx = 0;
+  alignas(16) vec3 ac;
+  u32 materialIdx = 0;
+  float probability = 1.f;
+  u32 alias = 0;
+};
+
+// Weight of an emitter per unit of area. The selection pdf over the area is then the same for every point of every
+// emitter, luminance / total power, so a surface hit by chance doesn't need to know its emitter for MIS
+inline float calcEmitterLuminance(vec3 emission) {
+  return glm::dot(emission, vec3(0.2126f, 0.7152f, 0.0722f));
+}
@@ -1,12 +1,13 @@
 #pragma once
 
-#include "RayTracingMaterial.hpp"
-
 struct MeshInfo {
   u32 firstTriangleIndex;
   u32 numTriangles = 0;
+  u32 rootNodeIndex = 0; // BLAS root in the nodes buffer
+  u32 rootWideNodeIndex = 0; // BLAS root in the wide nodes buffer
   alignas(16) vec3 boundsMin = vec3(FLT_MAX);
+  u32 firstVertexIndex = 0; // Packed in the padding of boundsMin
   alignas(16) vec3 boundsMax = vec3(-FLT_MAX);
-  RayTracingMaterial material;
+  u32 materialIdx = 0; // In the scene material table, packed in the padding of boundsMax
 };
 
@@ -0,0 +1,12 @@
+#pragma once
+
+#define RT_INSTANCE_FLAG_MATERIAL_OVERRIDE 1u
+
+// Placement of a MeshRT in the scene, the triangles stay in the object space
+struct MeshInstance {
+  alignas(16) mat4 transform = mat4(1.f); // Object -> world
+  mat4 invTransform = mat4(1.f);          // World -> object
+  u32 meshIndex = 0;
+  u32 flags = 0;
+  u32 materialIdx = 0; // Used instead of the mesh one with RT_INSTANCE_FLAG_MATERIAL_OVERRIDE
+};
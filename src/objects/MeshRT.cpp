@@ -1,8 +1,8 @@
 #include "MeshRT.hpp"
 
-#include <cassert>
 #include <tiny_obj_loader.h>
 
+#include "../engine/mesh/VertexWelder.hpp"
 #include "utils/utils.hpp"
 #include "utils/status.hpp"
 #include "utils/clrp.hpp"
@@ -29,40 +29,26 @@ void MeshRT::loadOBJ(const fspath& file, float scale, const vec3& offset, bool p
   const std::vector<tinyobj::shape_t>& shapes = reader.GetShapes();
   // const std::vector<tinyobj::material_t>& materials = reader.GetMaterials();
 
+  VertexWelder<VertexPN> welder;
+
   // Loop over shapes
-  u32 numVertices = 0;
   for (size_t s = 0; s < shapes.size(); s++) {
     // Loop over faces(polygon)
     size_t index_offset = 0;
     for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
       size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
+      if (fv != 3)
+        error("[MeshRT::loadOBJ] Unexpected face with [{}] vertices", fv);
 
       // Loop over vertices
-      Triangle tri;
+      uvec3 tri;
       for (size_t v = 0; v < fv; v++) {
         // access to vertex
         tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
         size_t idxVert = 3 * size_t(idx.vertex_index);
-        vec3* pos = nullptr;
-        vec3* normal = nullptr;
-        switch (v) {
-          case 0:
-            pos = &tri.a;
-            normal = &tri.normalA;
-            break;
-          case 1:
-            pos = &tri.b;
-            normal = &tri.normalB;
-            break;
-          case 2:
-            pos = &tri.c;
-            normal = &tri.normalC;
-            break;
-          default:
-            error("[MeshRT::loadOBJ] Unexpected vertex index [{}]", v);
-        }
+        VertexPN vertex{};
 
-        vec3& p = *pos;
+        vec3& p = vertex.position;
         p.x = attrib.vertices[idxVert + 0];
         p.y = attrib.vertices[idxVert + 1];
         p.z = attrib.vertices[idxVert + 2];
@@ -74,13 +60,14 @@ void MeshRT::loadOBJ(const fspath& file, float scale, const vec3& offset, bool p
 
         // Check if `normal_index` is zero or positive. negative = no normal data
         if (idx.normal_index >= 0) {
-          normal->x = attrib.normals[3*size_t(idx.normal_index)+0];
-          normal->y = attrib.normals[3*size_t(idx.normal_index)+1];
-          normal->z = attrib.normals[3*size_t(idx.normal_index)+2];
+          vertex.normal.x = attrib.normals[3*size_t(idx.normal_index)+0];
+          vertex.normal.y = attrib.normals[3*size_t(idx.normal_index)+1];
+          vertex.normal.z = attrib.normals[3*size_t(idx.normal_index)+2];
         }
-        numVertices++;
+
+        tri[v] = welder.add(vertex);
       }
-      triangles.push_back(tri);
+      indices.push_back(tri);
       index_offset += fv;
 
       // per-face material
@@ -88,15 +75,13 @@ void MeshRT::loadOBJ(const fspath& file, float scale, const vec3& offset, bool p
     }
   }
 
-  assert(numVertices % 3 == 0);
+  vertices = std::move(welder.vertices);
 
-  RayTracingMaterial material;
   material.color = vec4(1.f);
   material.emissionColor = vec4(0.f);
   material.emissionStrength = 0.f;
 
-  meshInfo.numTriangles = numVertices / 3;
-  meshInfo.material = material;
+  meshInfo.numTriangles = getNumTriangles();
 
   // ============ Print info ============ //
 
@@ -107,7 +92,7 @@ void MeshRT::loadOBJ(const fspath& file, float scale, const vec3& offset, bool p
     };
     std::string cname = clrp::format(std::format("[{}]", file.string()), cfmt);
     std::string infoLoad = std::format("[load]\nvertices: {}\ncolors:   {}\ntextures: {}\nnormals:  {}", attrib.vertices.size() / 3, attrib.colors.size() / 3, attrib.texcoords.size() / 2, attrib.normals.size() / 3);
-    std::string infoFinal = std::format("[final]\nvertices: {}\n", numVertices);
+    std::string infoFinal = std::format("[final]\nvertices:  {}\ntriangles: {}\n", vertices.size(), indices.size());
     printf("\n==================== %s ====================\n\n%s\n\n%s\n\n", cname.c_str(), infoLoad.c_str(), infoFinal.c_str());
 
     std::string end = "============================================";
@@ -121,44 +106,70 @@ void MeshRT::loadOBJ(const fspath& file, float scale, const vec3& offset, bool p
   // ==================================== //
 
   status::end(true);
+
+  // Unindexed std140 triangles vs the welded vertices and their index triples
+  u64 bytesBefore = indices.size() * sizeof(Triangle);
+  u64 bytesAfter = vertices.size() * sizeof(VertexPN) + indices.size() * sizeof(uvec3);
+  printWeldReport(file.string().c_str(), welder.getNumCorners(), vertices.size(), bytesBefore, bytesAfter);
 }
 
 void MeshRT::createQuad(const vec3& bottomLeft, const vec3& axisY, const vec3& axisX, const vec3& normal, const vec2& size, const RayTracingMaterial& material) {
-  Triangle tri1;
-  tri1.a = bottomLeft + axisY * size.y;
-  tri1.b = bottomLeft;
-  tri1.c = bottomLeft + axisY * size.y + axisX * size.x;
-  tri1.normalA = normal;
-  tri1.normalB = normal;
-  tri1.normalC = normal;
-  triangles.push_back(tri1);
-
-  Triangle tri2;
-  tri2.a = bottomLeft + axisX * size.x;
-  tri2.b = bottomLeft + axisY * size.y + axisX * size.x;
-  tri2.c = bottomLeft;
-  tri2.normalA = normal;
-  tri2.normalB = normal;
-  tri2.normalC = normal;
-  triangles.push_back(tri2);
-
-  meshInfo.numTriangles = 2;
-  meshInfo.boundsMin = min(min(min(meshInfo.boundsMin, tri1.a), tri1.b), tri1.c);
-  meshInfo.boundsMin = min(min(min(meshInfo.boundsMin, tri2.a), tri2.b), tri2.c);
-  meshInfo.boundsMax = max(max(max(meshInfo.boundsMax, tri1.a), tri1.b), tri1.c);
-  meshInfo.boundsMax = max(max(max(meshInfo.boundsMax, tri2.a), tri2.b), tri2.c);
-  meshInfo.material = material;
+  u32 first = static_cast<u32>(vertices.size());
+  vec3 corners[4] = {
+    bottomLeft,
+    bottomLeft + axisY * size.y,
+    bottomLeft + axisX * size.x,
+    bottomLeft + axisY * size.y + axisX * size.x
+  };
+
+  for (const vec3& corner : corners) {
+    vertices.push_back({corner, normal});
+    meshInfo.boundsMin = min(meshInfo.boundsMin, corner);
+    meshInfo.boundsMax = max(meshInfo.boundsMax, corner);
+  }
+
+  indices.push_back(uvec3(first + 1, first + 0, first + 3));
+  indices.push_back(uvec3(first + 2, first + 3, first + 0));
+
+  meshInfo.numTriangles = getNumTriangles();
+  this->material = material;
+}
+
+Triangle MeshRT::getTriangle(u32 idx) const {
+  const uvec3& tri = indices[idx];
+  const VertexPN& a = vertices[tri.x];
+  const VertexPN& b = vertices[tri.y];
+  const VertexPN& c = vertices[tri.z];
+
+  Triangle triangle;
+  triangle.a = a.position;
+  triangle.b = b.position;
+  triangle.c = c.position;
+  triangle.normalA = a.normal;
+  triangle.normalB = b.normal;
+  triangle.normalC = c.normal;
+  return triangle;
+}
+
+std::vector<Triangle> MeshRT::getTriangles() const {
+  std::vector<Triangle> triangles(indices.size());
+  for (u32 i = 0; i < indices.size(); i++)
+    triangles[i] = getTriangle(i);
+
+  return triangles;
 }
 
 void MeshRT::rotate(float rad, const vec3& axis) {
   glm::quat q = glm::angleAxis(rad, axis);
 
-  for (Triangle& tri : triangles) {
-    tri.a = q * tri.a;
-    tri.b = q * tri.b;
-    tri.c = q * tri.c;
-    tri.normalA = q * tri.normalA;
-    tri.normalB = q * tri.normalB;
-    tri.normalC = q * tri.normalC;
+  for (VertexPN& vertex : vertices) {
+    vertex.position = q * vertex.position;
+    vertex.normal = q * vertex.normal;
   }
 }
+
+void MeshRT::buildBVH(u32 builder) {
+  std::vector<Triangle> triangles = getTriangles();
+  bvh.build(triangles.data(), getNumTriangles(), builder);
+  wideBVH.collapse(bvh);
+}
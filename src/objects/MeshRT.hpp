@@ -3,15 +3,28 @@
 #include <vector>
 
 #include "MeshInfo.hpp"
+#include "RayTracingMaterial.hpp"
 #include "Triangle.hpp"
+#include "../engine/mesh/vertex.hpp"
+#include "bvh/BVH.hpp"
+#include "bvh/WideBVH.hpp"
 
 struct MeshRT {
-  std::vector<Triangle> triangles;
+  std::vector<VertexPN> vertices; // Welded, shared by the triangles
+  std::vector<uvec3> indices; // One per triangle
   MeshInfo meshInfo;
+  RayTracingMaterial material; // Goes to the scene material table with the mesh
+  BVH bvh; // Bottom level, shared by every instance of the mesh
+  WideBVH wideBVH; // Collapsed copy of bvh
 
   void loadOBJ(const fspath& file, float scale = 1.f, const vec3& offset = vec3(0.f), bool printInfo = false);
   void createQuad(const vec3& bottomLeft, const vec3& axisY, const vec3& axisX, const vec3& normal, const vec2& size, const RayTracingMaterial& material);
 
+  u32 getNumTriangles() const { return static_cast<u32>(indices.size()); }
+  Triangle getTriangle(u32 idx) const;
+  std::vector<Triangle> getTriangles() const; // Unindexed copy, for the builders and the CPU traversals
+
   void rotate(float rad, const vec3& axis);
+  void buildBVH(u32 builder = BVH_BUILDER_BINNED_SAH);
 };
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "../engine/mesh/vertex.hpp"
+
+// NOTE: Must match in rt.frag
+#define PACKED_VERTEX_POSITION_WORDS 3u
+#define PACKED_VERTEX_NORMAL_WORDS 1u  // Octahedral
+#define PACKED_TRIANGLE_INDEX_WORDS 3u // Vertices of a, b and c
+#define PACKED_TRIANGLE_EDGE_WORDS 12u // a, ab, ac and the geometric normal, interleaved as 3 vec4
+
+// GPU copy of an indexed MeshRT as tightly packed streams: the positions are read for every intersection test, the
+// normals only once for the closest hit. Triangles reference their vertices, so shared vertices are stored once
+namespace packedMesh {
+
+// Unit vector folded onto the octahedron and stored as two snorm16 (same as packSnorm2x16 in GLSL)
+inline u32 encodeNormal(const vec3& n) {
+  float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  vec2 p = sum > 0.f ? vec2(n.x, n.y) / sum : vec2(0.f); // A missing normal decodes to +z
+
+  if (n.z < 0.f) {
+    vec2 s(p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f);
+    p = (1.f - vec2(std::abs(p.y), std::abs(p.x))) * s;
+  }
+
+  auto snorm = [](float v) {
+    return static_cast<u32>(static_cast<u16>(static_cast<s16>(std::round(std::clamp(v, -1.f, 1.f) * 32767.f))));
+  };
+
+  return snorm(p.x) | snorm(p.y) << 16;
+}
+
+// Same as decodeNormal in rt.frag
+inline vec3 decodeNormal(u32 encoded) {
+  auto snorm = [](u32 bits) {
+    return std::clamp(static_cast<s16>(static_cast<u16>(bits)) / 32767.f, -1.f, 1.f);
+  };
+
+  vec3 n(snorm(encoded), snorm(encoded >> 16), 0.f);
+  n.z = 1.f - std::abs(n.x) - std::abs(n.y);
+
+  float t = std::max(-n.z, 0.f);
+  n.x += n.x >= 0.f ? -t : t;
+  n.y += n.y >= 0.f ? -t : t;
+
+  return glm::normalize(n);
+}
+
+// Writes PACKED_VERTEX_POSITION_WORDS floats and PACKED_VERTEX_NORMAL_WORDS words
+inline void packVertex(const VertexPN& vertex, float* position, u32* normal) {
+  for (int axis = 0; axis < 3; axis++)
+    position[axis] = vertex.position[axis];
+
+  normal[0] = encodeNormal(vertex.normal);
+}
+
+// Writes PACKED_TRIANGLE_INDEX_WORDS words, firstVertexIdx places the mesh in the scene wide vertex streams
+inline void packTriangle(const uvec3& tri, u32 firstVertexIdx, u32* indices) {
+  for (int i = 0; i < 3; i++)
+    indices[i] = tri[i] + firstVertexIdx;
+}
+
+// Writes PACKED_TRIANGLE_EDGE_WORDS floats as (a, n.x), (ab, n.y), (ac, n.z), n being the unnormalized geometric
+// normal. The intersection test reads them instead of the indices and positions and skips the subtractions and cross
+inline void packTriangleEdges(const vec3& a, const vec3& b, const vec3& c, float* edges) {
+  vec3 ab = b - a;
+  vec3 ac = c - a;
+  vec3 n = glm::cross(ab, ac);
+
+  for (int axis = 0; axis < 3; axis++) {
+    edges[axis] = a[axis];
+    edges[4 + axis] = ab[axis];
+    edges[8 + axis] = ac[axis];
+  }
+
+  edges[3] = n.x;
+  edges[7] = n.y;
+  edges[11] = n.z;
+}
+
+} // namespace packedMesh
@@ -0,0 +1,6 @@
+#pragma once
+
+struct Ray {
+  vec3 origin;
+  vec3 dir;
+};
@@ -3,20 +3,59 @@
 #include "../engine/Shader.hpp"
 #include "Room.hpp"
 
+// Sample sequences of the path tracers (shaders/sampler.glsl)
+#define RT_SAMPLER_RANDOM  0u // Hash RNG, white noise
+#define RT_SAMPLER_SOBOL   1u // Owen scrambled Sobol
+#define RT_SAMPLER_LATTICE 2u // Rank-1 lattice rotated by blue noise
+#define RT_SAMPLER_COUNT   3u
+#define RT_SAMPLER_BOUNCE_DIMENSIONS 8u // Dimensions of every bounce, more than its draws
+
+// Adaptive sampling (average.frag estimates the error of every pixel, rt.frag spends the rays by it)
+#define RT_ADAPTIVE_TILE_LOD 3 // Mip level of the error map read as the error of the 8x8 tile of a pixel
+#define RT_ADAPTIVE_MAX_RAYS_SCALE 4u // The noisiest pixels get up to 4 times numRaysPerPixel
+#define RT_ADAPTIVE_MIN_LUMINANCE 0.05f // The error is relative to the mean luminance, but not below it
+
+// Denoiser (shaders/denoise.glsl), edge-stopping weights of the a-trous iterations
+#define RT_DENOISE_MAX_ITERATIONS 5 // Taps 1 to 16 pixels apart
+#define RT_DENOISE_FEATURE_RAYS 4u // Camera rays averaged into the features of a pixel
+#define RT_DENOISE_SIGMA_LUMINANCE 3.f // In standard deviations of the pixel luminance
+#define RT_DENOISE_SIGMA_NORMAL 128.f // Exponent of the cosine between the normals
+#define RT_DENOISE_SIGMA_DEPTH 0.02f // Relative depth change per pixel of distance
+#define RT_DENOISE_SIGMA_ALBEDO 0.1f
+#define RT_DENOISE_MISS_DEPTH 10000.f // Depth of the pixels that see the environment
+
 struct RayTracingData {
   vec3 groundColor = vec3(0.637f);
   vec3 skyHorizonColor = {1.000f, 1.000f, 1.000f};
   vec3 skyZenithColor  = {0.289f, 0.565f, 1.000f};
   int  numRaysPerPixel = 1;
-  int  numRayBounces = 2;
+  int  numRayBounces = 2; // Hard cap of the path length
+  int  rouletteMinBounces = 3; // Bounces before the Russian roulette starts
   int  numSpheres = 0;
   int  numMeshes = 0;
+  int  numInstances = 0;
+  int  numEmitters = 0; // Set by scene::updateEmitters
+  int  samplerType = RT_SAMPLER_SOBOL;
+  int  adaptiveMinSpp = 16; // Samples of a pixel before its error is trusted
+  int  denoiseIterations = RT_DENOISE_MAX_ITERATIONS; // Not a uniform, filter passes of denoise.frag
+  u32  blasBuilder = BVH_BUILDER_BINNED_SAH; // Not a uniform, builder of the mesh BVHs (scene::load, scene::rebuildBLAS)
   bool enableEnvLight = true;
+  bool useBVH = true; // false = brute force over every triangle (validation)
+  bool useWideBVH = false; // Compressed wide layout of the bottom levels
+  bool useWatertight = false; // Watertight triangle test instead of the precomputed edges
+  bool useLightSampling = true; // Next-event estimation on the emitters, combined with the bounces by MIS
+  bool useRussianRoulette = true; // Paths go on with a chance of their throughput, reweighted by it
+  bool useAdaptiveSampling = false; // Pixels get rays by the error of their mean, converged ones none
+  bool showSppHeatmap = false; // Not a uniform, main.frag shows the samples of every pixel instead of the image
+  bool useDenoiser = false; // Not a uniform, denoise.frag filters the image shown with the first hit features of rt.frag
+  bool animateSpheres = false; // Not a uniform, moves the spheres with Sphere::update every frame
   float sunFocus = 500.f;
   float sunIntensity = 10.f;
   float divergeStrength = 0.15f;
   float defocusStrength = 0.15f;
   float focusDistance = 1.f;
+  float emittersPower = 0.f; // Sum of luminance x area, set by scene::updateEmitters
+  float adaptiveThreshold = 0.02f; // Relative standard error of a pixel mean under which it is converged
 
   Room room;
 
@@ -27,14 +66,27 @@ struct RayTracingData {
     static const GLint skyColorZenithLoc    = shader.getUniformLoc("u_skyZenithColor");
     static const GLint numRaysPerPixelLoc   = shader.getUniformLoc("u_numRaysPerPixel");
     static const GLint numRayBouncesLoc     = shader.getUniformLoc("u_numRayBounces");
+    static const GLint rouletteMinBouncesLoc = shader.getUniformLoc("u_rouletteMinBounces");
     static const GLint numSpheresLoc        = shader.getUniformLoc("u_numSpheres");
     static const GLint numMeshesLoc         = shader.getUniformLoc("u_numMeshes");
+    static const GLint numInstancesLoc      = shader.getUniformLoc("u_numInstances");
+    static const GLint numEmittersLoc       = shader.getUniformLoc("u_numEmitters");
+    static const GLint samplerTypeLoc       = shader.getUniformLoc("u_samplerType");
+    static const GLint adaptiveMinSppLoc    = shader.getUniformLoc("u_adaptiveMinSpp");
     static const GLint enableEnvLightLoc    = shader.getUniformLoc("u_enableEnvironmentalLight");
+    static const GLint useBVHLoc            = shader.getUniformLoc("u_useBVH");
+    static const GLint useWideBVHLoc        = shader.getUniformLoc("u_useWideBVH");
+    static const GLint useWatertightLoc     = shader.getUniformLoc("u_useWatertight");
+    static const GLint useLightSamplingLoc  = shader.getUniformLoc("u_useLightSampling");
+    static const GLint useRussianRouletteLoc = shader.getUniformLoc("u_useRussianRoulette");
+    static const GLint useAdaptiveSamplingLoc = shader.getUniformLoc("u_useAdaptiveSampling");
     static const GLint sunFocusLoc          = shader.getUniformLoc("u_sunFocus");
     static const GLint sunIntensityLoc      = shader.getUniformLoc("u_sunIntensity");
     static const GLint divergeStrengthLoc   = shader.getUniformLoc("u_divergeStrength");
     static const GLint defocusStrengthLoc   = shader.getUniformLoc("u_defocusStrength");
     static const GLint focusDistanceLoc   = shader.getUniformLoc("u_focusDistance");
+    static const GLint emittersPowerLoc     = shader.getUniformLoc("u_emittersPower");
+    static const GLint adaptiveThresholdLoc = shader.getUniformLoc("u_adaptiveThreshold");
 
     shader.setUniform1i(numRenderedFramesLoc, global::frameId);
     shader.setUniform3f(groundColorLoc, groundColor);
@@ -42,14 +94,27 @@ struct RayTracingData {
     shader.setUniform3f(skyColorZenithLoc, skyZenithColor);
     shader.setUniform1i(numRaysPerPixelLoc, numRaysPerPixel);
     shader.setUniform1i(numRayBouncesLoc, numRayBounces);
+    shader.setUniform1i(rouletteMinBouncesLoc, rouletteMinBounces);
     shader.setUniform1i(numSpheresLoc, numSpheres);
     shader.setUniform1i(numMeshesLoc, numMeshes);
+    shader.setUniform1i(numInstancesLoc, numInstances);
+    shader.setUniform1i(numEmittersLoc, numEmitters);
+    shader.setUniform1i(samplerTypeLoc, samplerType);
+    shader.setUniform1i(adaptiveMinSppLoc, adaptiveMinSpp);
     shader.setUniform1i(enableEnvLightLoc, enableEnvLight);
+    shader.setUniform1i(useBVHLoc, useBVH);
+    shader.setUniform1i(useWideBVHLoc, useWideBVH);
+    shader.setUniform1i(useWatertightLoc, useWatertight);
+    shader.setUniform1i(useLightSamplingLoc, useLightSampling);
+    shader.setUniform1i(useRussianRouletteLoc, useRussianRoulette);
+    shader.setUniform1i(useAdaptiveSamplingLoc, useAdaptiveSampling);
     shader.setUniform1f(sunFocusLoc, sunFocus);
     shader.setUniform1f(sunIntensityLoc, sunIntensity);
     shader.setUniform1f(divergeStrengthLoc, divergeStrength);
     shader.setUniform1f(defocusStrengthLoc, defocusStrength);
     shader.setUniform1f(focusDistanceLoc, focusDistance);
+    shader.setUniform1f(emittersPowerLoc, emittersPower);
+    shader.setUniform1f(adaptiveThresholdLoc, adaptiveThreshold);
   }
 };
 
@@ -38,6 +38,8 @@ Room::Room(vec3 center, float width, float height, float depth, const vec3& lamp
 
   vec3 lampOffset = sizeHalf * lampPosScale;
   meshesRT[ROOM_IDX_LAMP].createQuad(center + lampOffset, -global::forward, -global::right, -global::up, vec2{width, depth} * lampScale, wallLamp);
+
+  empty = false;
 }
 
 MeshRT* Room::getMeshes() {
@@ -45,10 +47,10 @@ MeshRT* Room::getMeshes() {
 }
 
 const RayTracingMaterial& Room::getWallMaterial(size_t idx) const {
-  return meshesRT[idx].meshInfo.material;
+  return meshesRT[idx].material;
 }
 
 void Room::updateMaterial(size_t idx, const RayTracingMaterial& material) {
-  meshesRT[idx].meshInfo.material = material;
+  meshesRT[idx].material = material;
 }
 
@@ -24,9 +24,12 @@ public:
 
   void updateMaterial(size_t idx, const RayTracingMaterial& material);
 
+  bool isEmpty() const { return empty; }
+
 private:
   friend struct gui;
 
-  MeshRT meshesRT[7];
+  MeshRT meshesRT[7]; // The geometry moves to the scene once uploaded, the materials stay for the GUI
+  bool empty = true;
 };
 
@@ -1,53 +1,301 @@
 #include "scene.hpp"
 
+#include <algorithm>
+#include <random>
+
 #include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/matrix_transform.hpp"
 #include "../engine/UBO.hpp"
+#include "../engine/PersistentSSBO.hpp"
+#include "../engine/BlueNoise.hpp"
 #include "Room.hpp"
 #include "MeshRT.hpp"
 #include "utils/utils.hpp"
 #include "Sphere.hpp"
 #include "Triangle.hpp"
+#include "PackedMesh.hpp"
+#include "intersect.hpp"
 #include "MeshInfo.hpp"
+#include "MeshInstance.hpp"
+#include "bvh/BVH.hpp"
+#include "bvh/LinearBuilder.hpp"
+#include "bvh/WideBVH.hpp"
+
+static UBO uboInstances;
+static UBO uboTLASNodes;
+static UBO uboTLASInstIndices;
+
+// Sized from the scene, grown when geometry is added
+static PersistentSSBO<Sphere> spheresBuf;
+static PersistentSSBO<BVHNode> sphereNodesBuf;
+static PersistentSSBO<u32> sphereIndicesBuf;
+static PersistentSSBO<MeshInfo> meshesInfosBuf;
+static PersistentSSBO<float> vertexPositionsBuf;
+static PersistentSSBO<u32> vertexNormalsBuf;
+static PersistentSSBO<u32> triIndicesBuf;
+static PersistentSSBO<float> triEdgesBuf;
+static PersistentSSBO<BVHNode> bvhNodesBuf;
+static PersistentSSBO<u32> bvhTriIndicesBuf;
+static PersistentSSBO<u32> wideBVHNodesBuf;
+static PersistentSSBO<RayTracingMaterial> materialsBuf;
+static PersistentSSBO<Emitter> emittersBuf;
+
+static MeshInstance* instancesBuf = nullptr;
+static BVHNode* tlasNodesBuf = nullptr;
+static u32* tlasInstIndicesBuf = nullptr; // uvec4[] in the shader
+
+static std::vector<Sphere> sceneSpheres; // CPU copy of spheresBuf
+static std::vector<MeshInfo> sceneMeshesInfos; // CPU copy of meshesInfosBuf (the mapping is write only)
+static std::vector<MeshRT> sceneMeshes; // CPU copy of the uploaded meshes, for the reference tracer
+static std::vector<MeshInstance> sceneInstances;
+static std::vector<RayTracingMaterial> sceneMaterials; // CPU copy of materialsBuf
+static std::vector<Emitter> sceneEmitters; // CPU copy of emittersBuf
+static BVH tlas;
+static BVH sphereBVH;
+
+static bool isHeadless = false; // Nothing goes to the GPU
+static u32 blasBuilder = BVH_BUILDER_BINNED_SAH; // Of the mesh BVHs, RayTracingData::blasBuilder of the last load
+static bool hasLazyBLAS = false; // The mesh BVHs are left to the CPU tracer
+
+// Primitives moved since the last refit
+static std::vector<u32> dirtySpheres;
+static std::vector<u32> dirtyInstances;
+static bool areEmittersDirty = true; // An emission, a radius or the instances changed since updateEmitters
+static u32 numEdits = 0; // Bumped by every change of what the first hits see
+
+static void allocateInstances() {
+  GLsizeiptr size = sizeof(MeshInstance) * MAX_INSTANCES;
+  GLsizeiptr nodesSize = sizeof(BVHNode) * MAX_TLAS_NODES;
+  GLsizeiptr indicesSize = sizeof(u32) * ((MAX_TLAS_REFERENCES + 3u) / 4u) * 4u;
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 
-static UBO uboSpheres;
-static UBO uboTriangles;
-static UBO uboMeshesInfos;
+  uboInstances = UBO(1);
+  uboInstances.storage(size, flags);
+  instancesBuf = (MeshInstance*)uboInstances.map(size, flags);
 
-static Sphere* spheresBuf = nullptr;
-static Triangle* trianglesBuf = nullptr;
-static MeshInfo* meshesInfosBuf = nullptr;
+  uboTLASNodes = UBO(1);
+  uboTLASNodes.storage(nodesSize, flags);
+  tlasNodesBuf = (BVHNode*)uboTLASNodes.map(nodesSize, flags);
 
-static void allocateSpheres() {
-  GLsizeiptr size = sizeof(Sphere) * MAX_SPHERES;
-  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  uboTLASInstIndices = UBO(1);
+  uboTLASInstIndices.storage(indicesSize, flags);
+  tlasInstIndicesBuf = (u32*)uboTLASInstIndices.map(indicesSize, flags);
+}
+
+static void addInstance(u32 meshIndex, const mat4& transform = mat4(1.f)) {
+  if (sceneInstances.size() >= MAX_INSTANCES)
+    error("[scene::addInstance] Amount of instances exceeds the limit [{}]", MAX_INSTANCES);
 
-  uboSpheres = UBO(1);
-  uboSpheres.storage(size, flags);
-  spheresBuf = (Sphere*)uboSpheres.map(size, flags);
+  MeshInstance instance;
+  instance.transform = transform;
+  instance.invTransform = glm::inverse(transform);
+  instance.meshIndex = meshIndex;
+
+  sceneInstances.push_back(instance);
 }
 
-static void allocateTriangles() {
-  GLsizeiptr size = sizeof(Triangle) * MAX_TRIANGLES;
-  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+static AABB calcInstanceBounds(const MeshInstance& instance) {
+  const MeshInfo& meshInfo = sceneMeshesInfos[instance.meshIndex];
+  AABB bounds;
+
+  for (int i = 0; i < 8; i++) {
+    vec3 corner{
+      i & 1 ? meshInfo.boundsMax.x : meshInfo.boundsMin.x,
+      i & 2 ? meshInfo.boundsMax.y : meshInfo.boundsMin.y,
+      i & 4 ? meshInfo.boundsMax.z : meshInfo.boundsMin.z,
+    };
+    bounds.grow(vec3(instance.transform * vec4(corner, 1.f)));
+  }
 
-  uboTriangles = UBO(1);
-  uboTriangles.storage(size, flags);
-  trianglesBuf = (Triangle*)uboTriangles.map(size, flags);
+  return bounds;
 }
 
-static void allocateMeshes() {
-  GLsizeiptr size = sizeof(MeshInfo) * MAX_MESHES;
-  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+static std::vector<AABB> calcInstancesBounds() {
+  std::vector<AABB> bounds(sceneInstances.size());
+  for (size_t i = 0; i < sceneInstances.size(); i++)
+    bounds[i] = calcInstanceBounds(sceneInstances[i]);
+
+  return bounds;
+}
+
+static std::vector<AABB> calcSpheresBounds() {
+  std::vector<AABB> bounds(sceneSpheres.size());
+  for (size_t i = 0; i < sceneSpheres.size(); i++) {
+    const Sphere& sphere = sceneSpheres[i];
+    bounds[i] = AABB{sphere.pos - sphere.radius, sphere.pos + sphere.radius};
+  }
+
+  return bounds;
+}
+
+// Uploads only the nodes touched by a refit (all of them and the indices after a rebuild)
+static void uploadRefit(const BVH& bvh, const BVHRefitResult& result, BVHNode* nodesBuf, u32* indicesBuf) {
+  if (!result.hasChanges() || isHeadless) return;
+
+  std::copy(bvh.nodes.begin() + result.firstNode, bvh.nodes.begin() + result.lastNode + 1, nodesBuf + result.firstNode);
+
+  if (result.rebuilt)
+    std::copy(bvh.primIndices.begin(), bvh.primIndices.end(), indicesBuf);
+}
+
+// Builds the top level over the added instances and uploads both. Spatial splits gain nothing on a few instances and
+// their duplicated references would make every refit a full one
+static void updateInstancesBuffer(RayTracingData& rtData) {
+  tlas.build(calcInstancesBounds(), BVH_BUILDER_BINNED_SAH);
+  dirtyInstances.clear();
+  numEdits++;
 
-  uboMeshesInfos = UBO(1);
-  uboMeshesInfos.storage(size, flags);
-  meshesInfosBuf = (MeshInfo*)uboMeshesInfos.map(size, flags);
+  if (tlas.primIndices.size() > MAX_TLAS_REFERENCES)
+    error("[scene::updateInstancesBuffer] Amount of instance references [{}] exceeds the limit [{}]", tlas.primIndices.size(), MAX_TLAS_REFERENCES);
+
+  rtData.numInstances = static_cast<int>(sceneInstances.size());
+  areEmittersDirty = true;
+  if (isHeadless) return;
+
+  if (!instancesBuf) allocateInstances();
+
+  std::copy(sceneInstances.begin(), sceneInstances.end(), instancesBuf);
+  std::copy(tlas.nodes.begin(), tlas.nodes.end(), tlasNodesBuf);
+  std::copy(tlas.primIndices.begin(), tlas.primIndices.end(), tlasInstIndicesBuf);
+}
+
+static void updateSpheresBVH() {
+  sphereBVH.build(calcSpheresBounds());
+  dirtySpheres.clear();
+
+  if (isHeadless) return;
+
+  // A rebuild after a refit has the same amount of spheres, so it never needs more than 2N - 1 nodes
+  sphereNodesBuf.reserve(static_cast<u32>(sceneSpheres.size()) * 2u);
+  sphereIndicesBuf.reserve(static_cast<u32>(sphereBVH.primIndices.size()));
+
+  std::copy(sphereBVH.nodes.begin(), sphereBVH.nodes.end(), sphereNodesBuf.data);
+  std::copy(sphereBVH.primIndices.begin(), sphereBVH.primIndices.end(), sphereIndicesBuf.data);
+}
+
+// Sizes the mesh buffers for the whole scene up front, updateMeshBuffer still grows them if more is added later
+static void reserveMeshes(const std::vector<const MeshRT*>& meshes) {
+  u32 numVertices = 0;
+  u32 numTriangles = 0;
+  for (const MeshRT* mesh : meshes) {
+    numVertices += static_cast<u32>(mesh->vertices.size());
+    numTriangles += mesh->getNumTriangles();
+  }
+
+  sceneMeshes.clear();
+  sceneMeshes.reserve(meshes.size());
+
+  // A BLAS over N triangles has at most 2N - 1 nodes and fewer wide nodes than triangles
+  if (!isHeadless) {
+    meshesInfosBuf.reserve(static_cast<u32>(meshes.size()));
+    vertexPositionsBuf.reserve(numVertices * PACKED_VERTEX_POSITION_WORDS);
+    vertexNormalsBuf.reserve(numVertices * PACKED_VERTEX_NORMAL_WORDS);
+    triIndicesBuf.reserve(numTriangles * PACKED_TRIANGLE_INDEX_WORDS);
+    triEdgesBuf.reserve(numTriangles * PACKED_TRIANGLE_EDGE_WORDS);
+    bvhNodesBuf.reserve(numTriangles * 2u);
+    bvhTriIndicesBuf.reserve(numTriangles);
+    wideBVHNodesBuf.reserve(numTriangles * WIDE_BVH_NODE_WORDS(WIDE_BVH_WIDTH));
+  }
+
+  printf(
+    "Scene buffers: %zu meshes, %u vertices, %u triangles, %u materials\n",
+    meshes.size(), numVertices, numTriangles, static_cast<u32>(sceneMaterials.size())
+  );
+}
+
+// Vose's method: slots under the mean weight are topped up by one alias over it, so every slot holds 1 / N of the
+// total in at most two emitters
+static void buildAliasTable(std::vector<Emitter>& emitters, const std::vector<float>& weights, float totalWeight) {
+  u32 numEmitters = static_cast<u32>(emitters.size());
+  std::vector<float> scaledWeights(numEmitters);
+  std::vector<u32> small, large;
+
+  for (u32 i = 0; i < numEmitters; i++) {
+    scaledWeights[i] = weights[i] * numEmitters / totalWeight;
+    (scaledWeights[i] < 1.f ? small : large).push_back(i);
+  }
+
+  while (!small.empty() && !large.empty()) {
+    u32 smallIdx = small.back();
+    u32 largeIdx = large.back();
+    small.pop_back();
+
+    emitters[smallIdx].probability = scaledWeights[smallIdx];
+    emitters[smallIdx].alias = largeIdx;
+
+    scaledWeights[largeIdx] -= 1.f - scaledWeights[smallIdx];
+    if (scaledWeights[largeIdx] < 1.f) {
+      large.pop_back();
+      small.push_back(largeIdx);
+    }
+  }
+
+  // What is left is 1 up to the rounding
+  for (const std::vector<u32>* rest : {&small, &large})
+    for (u32 idx : *rest) {
+      emitters[idx].probability = 1.f;
+      emitters[idx].alias = idx;
+    }
+}
+
+// Writes the mesh at the ranges of its meshInfo
+static void uploadMesh(const MeshRT& mesh, u32 meshIdx) {
+  const MeshInfo& meshInfo = mesh.meshInfo;
+  u32 firstTriIdx = meshInfo.firstTriangleIndex;
+  u32 firstVertexIdx = meshInfo.firstVertexIndex;
+
+  // Only grows when the mesh wasn't part of the scene reserveMeshes sized the buffers for
+  u32 numVertices = firstVertexIdx + static_cast<u32>(mesh.vertices.size());
+  u32 numTriangles = firstTriIdx + mesh.getNumTriangles();
+  meshesInfosBuf.reserve(meshIdx + 1);
+  vertexPositionsBuf.reserve(numVertices * PACKED_VERTEX_POSITION_WORDS);
+  vertexNormalsBuf.reserve(numVertices * PACKED_VERTEX_NORMAL_WORDS);
+  triIndicesBuf.reserve(numTriangles * PACKED_TRIANGLE_INDEX_WORDS);
+  triEdgesBuf.reserve(numTriangles * PACKED_TRIANGLE_EDGE_WORDS);
+  bvhNodesBuf.reserve(numTriangles * 2u);
+  bvhTriIndicesBuf.reserve(numTriangles);
+  wideBVHNodesBuf.reserve(numTriangles * WIDE_BVH_NODE_WORDS(WIDE_BVH_WIDTH));
+
+  for (size_t j = 0; j < mesh.vertices.size(); j++) {
+    u32 vertexIdx = static_cast<u32>(j) + firstVertexIdx;
+    packedMesh::packVertex(mesh.vertices[j], vertexPositionsBuf.data + vertexIdx * PACKED_VERTEX_POSITION_WORDS, vertexNormalsBuf.data + vertexIdx * PACKED_VERTEX_NORMAL_WORDS);
+  }
+
+  for (u32 j = 0; j < mesh.getNumTriangles(); j++) {
+    u32 triIdx = j + firstTriIdx;
+    const uvec3& tri = mesh.indices[j];
+    packedMesh::packTriangle(tri, firstVertexIdx, triIndicesBuf.data + triIdx * PACKED_TRIANGLE_INDEX_WORDS);
+    packedMesh::packTriangleEdges(mesh.vertices[tri.x].position, mesh.vertices[tri.y].position, mesh.vertices[tri.z].position, triEdgesBuf.data + triIdx * PACKED_TRIANGLE_EDGE_WORDS);
+    bvhTriIndicesBuf.data[triIdx] = mesh.bvh.primIndices[j] + firstTriIdx;
+  }
+
+  for (size_t j = 0; j < mesh.bvh.nodes.size(); j++) {
+    BVHNode node = mesh.bvh.nodes[j];
+    node.leftFirst += node.isLeaf() ? firstTriIdx : meshInfo.rootNodeIndex;
+    bvhNodesBuf.data[j + meshInfo.rootNodeIndex] = node;
+  }
+
+  mesh.wideBVH.copyTo(wideBVHNodesBuf.data, meshInfo.rootWideNodeIndex, firstTriIdx);
+
+  meshesInfosBuf.data[meshIdx] = meshInfo;
+}
+
+// The bottom levels are uploaded with one reference per triangle, the GPU LBVH needs the GL context
+static void setBLASBuilder(u32 builder) {
+  if (builder == BVH_BUILDER_SPATIAL_SAH)
+    error("[scene::setBLASBuilder] The spatial split builder duplicates references, it's only in the BVH report");
+  if (builder == BVH_BUILDER_LBVH_GPU && isHeadless)
+    error("[scene::setBLASBuilder] The GPU LBVH needs a GL context");
+
+  blasBuilder = builder;
 }
 
 namespace scene {
 
 void scene1(RayTracingData& rtData) {
-  constexpr vec4 palette[MAX_SPHERES] = {
+  sceneMaterials.clear();
+
+  constexpr vec4 palette[] = {
     {1.00f, 0.00f, 1.00f, 1.f}, // Purple
     {0.11f, 0.11f, 0.11f, 1.f}, // Black
     {0.00f, 1.00f, 0.00f, 1.f}, // Green
@@ -57,10 +305,11 @@ void scene1(RayTracingData& rtData) {
   };
 
   rtData.numSpheres = 6;
+  rtData.numInstances = 0;
   rtData.enableEnvLight = true;
 
-  if (!spheresBuf)
-    allocateSpheres();
+  sceneSpheres.resize(rtData.numSpheres);
+  if (!isHeadless) spheresBuf.reserve(rtData.numSpheres);
 
   RayTracingMaterial bigSphereMaterial;
   bigSphereMaterial.color = palette[0];
@@ -70,9 +319,9 @@ void scene1(RayTracingData& rtData) {
   Sphere bigSphere;
   bigSphere.pos = vec3(0.f);
   bigSphere.radius = 10.f;
-  bigSphere.material = bigSphereMaterial;
+  bigSphere.materialIdx = addMaterial(bigSphereMaterial);
 
-  spheresBuf[0] = bigSphere;
+  updateSpheresBuffer(bigSphere, 0);
 
   vec3 spawnFromBigSphereCenterDir = global::up;
   glm::quat q = glm::angleAxis(-PI * 0.1f, global::right);
@@ -89,49 +338,51 @@ void scene1(RayTracingData& rtData) {
     Sphere sphere;
     sphere.pos = spawnFromBigSphereCenterDir * (bigSphere.radius + r);
     sphere.radius = r;
-    sphere.material = material;
+    sphere.materialIdx = addMaterial(material);
 
     updateSpheresBuffer(sphere, i);
     q = glm::angleAxis(PI * 0.03f, global::right);
     spawnFromBigSphereCenterDir = q * spawnFromBigSphereCenterDir;
   }
+
+  updateSpheresBVH();
 }
 
 void scene2(RayTracingData& rtData) {
+  sceneMaterials.clear();
+
   rtData.numMeshes = 1;
   rtData.enableEnvLight = true;
 
   MeshRT rtMeshKnight;
-  rtMeshKnight.loadOBJ("res/obj/Knight.obj", 0.05f);
+  rtMeshKnight.loadOBJ("res/obj/Knight.obj");
 
-  u32 totalNumTriangles = 0;
-  for (int i = 0; i < 1; i++) {
-    totalNumTriangles += rtMeshKnight.triangles.size();
-
-    if (totalNumTriangles > MAX_TRIANGLES)
-      error("[Scene::scene2] Mesh amount of triangles [{}] exceeds the limit [{}]", totalNumTriangles, MAX_TRIANGLES);
-  }
-
-  if (!trianglesBuf)   allocateTriangles();
-  if (!meshesInfosBuf) allocateMeshes();
+  reserveMeshes({&rtMeshKnight});
 
   // Add meshes to buffers
   u32 firstTriangleIndex = 0;
-  updateMeshBuffer(firstTriangleIndex, &rtMeshKnight, 1);
+  u32 firstVertexIndex = 0;
+  updateMeshBuffer(firstTriangleIndex, firstVertexIndex, &rtMeshKnight, 1);
+
+  sceneInstances.clear();
+  addInstance(0, glm::scale(mat4(1.f), vec3(0.05f)));
+  updateInstancesBuffer(rtData);
 }
 
 void scene3(RayTracingData& rtData) {
+  sceneMaterials.clear();
+
   rtData.numMeshes = 1 + ROOM_TOTAL_MESHES; // Knight + room
   rtData.enableEnvLight = false;
-  u32 totalNumTriangles = 0;
 
   // ===== Knight meshes ==================================== //
 
   MeshRT rtMeshKnight;
-  rtMeshKnight.loadOBJ("res/obj/Knight.obj", 0.05f, {0.f, -15.f, 0.f});
-  rtMeshKnight.rotate(PI_3, -global::up);
+  rtMeshKnight.loadOBJ("res/obj/Knight.obj");
 
-  totalNumTriangles += rtMeshKnight.triangles.size();
+  mat4 knightTransform = glm::rotate(mat4(1.f), PI_3, -global::up);
+  knightTransform = glm::translate(knightTransform, {0.f, -15.f, 0.f});
+  knightTransform = glm::scale(knightTransform, vec3(0.05f));
 
   // ===== Room meshes ====================================== //
 
@@ -140,22 +391,33 @@ void scene3(RayTracingData& rtData) {
 
   // ===== Preparing scene ================================== //
 
-  totalNumTriangles += ROOM_TOTAL_TRIANGLES;
+  std::vector<const MeshRT*> meshes;
+  for (u32 i = 0; i < ROOM_TOTAL_MESHES; i++)
+    meshes.push_back(&rtRoomMeshes[i]);
 
-  if (totalNumTriangles > MAX_TRIANGLES)
-    error("[Scene::scene3] Mesh amount of triangles [{}] exceeds the limit [{}]", totalNumTriangles, MAX_TRIANGLES);
-
-  if (!trianglesBuf)   allocateTriangles();
-  if (!meshesInfosBuf) allocateMeshes();
+  meshes.push_back(&rtMeshKnight);
+  reserveMeshes(meshes);
 
   // ===== Add meshes to buffers ============================ //
 
   u32 firstTriangleIndex = 0;
-  updateMeshBuffer(firstTriangleIndex, rtRoomMeshes, ROOM_TOTAL_MESHES); // Room
-  updateMeshBuffer(firstTriangleIndex, &rtMeshKnight, 1, ROOM_TOTAL_MESHES); // Knight
+  u32 firstVertexIndex = 0;
+  updateMeshBuffer(firstTriangleIndex, firstVertexIndex, rtRoomMeshes, ROOM_TOTAL_MESHES); // Room
+  updateMeshBuffer(firstTriangleIndex, firstVertexIndex, &rtMeshKnight, 1, ROOM_TOTAL_MESHES); // Knight
+
+  // ===== Instances ======================================== //
+
+  sceneInstances.clear();
+  for (u32 i = 0; i < ROOM_TOTAL_MESHES; i++)
+    addInstance(i);
+
+  addInstance(ROOM_TOTAL_MESHES, knightTransform);
+  updateInstancesBuffer(rtData);
 }
 
 void scene4(RayTracingData& rtData) {
+  sceneMaterials.clear();
+
   rtData.numMeshes = ROOM_TOTAL_MESHES;
   rtData.numSpheres = 4;
   rtData.enableEnvLight = false;
@@ -176,15 +438,14 @@ void scene4(RayTracingData& rtData) {
 
   // ===== Preparing scene ================================== //
 
-  u32 totalNumTriangles = 0;
-  totalNumTriangles += ROOM_TOTAL_TRIANGLES;
+  std::vector<const MeshRT*> meshes;
+  for (u32 i = 0; i < ROOM_TOTAL_MESHES; i++)
+    meshes.push_back(&rtRoomMeshes[i]);
 
-  if (totalNumTriangles > MAX_TRIANGLES)
-    error("[Scene::scene4] Mesh amount of triangles [{}] exceeds the limit [{}]", totalNumTriangles, MAX_TRIANGLES);
+  reserveMeshes(meshes);
 
-  if (!spheresBuf)     allocateSpheres();
-  if (!trianglesBuf)   allocateTriangles();
-  if (!meshesInfosBuf) allocateMeshes();
+  sceneSpheres.resize(rtData.numSpheres);
+  if (!isHeadless) spheresBuf.reserve(rtData.numSpheres);
 
   // ===== Spheres ========================================== //
 
@@ -204,81 +465,456 @@ void scene4(RayTracingData& rtData) {
     Sphere sphere;
     sphere.pos = initPos + offset;
     sphere.radius = r;
-    sphere.material = material;
+    sphere.materialIdx = addMaterial(material);
 
     updateSpheresBuffer(sphere, i);
     offset.x += r * 2.f + 2.f;
   }
 
+  updateSpheresBVH();
+
   // ===== Add room to buffers ============================== //
 
   u32 firstTriangleIndex = 0;
-  updateMeshBuffer(firstTriangleIndex, rtRoomMeshes, ROOM_TOTAL_MESHES);
+  u32 firstVertexIndex = 0;
+  updateMeshBuffer(firstTriangleIndex, firstVertexIndex, rtRoomMeshes, ROOM_TOTAL_MESHES);
+
+  sceneInstances.clear();
+  for (u32 i = 0; i < ROOM_TOTAL_MESHES; i++)
+    addInstance(i);
+
+  updateInstancesBuffer(rtData);
+}
+
+void load(u32 sceneNumber, RayTracingData& rtData) {
+  static void (*const scenes[NUM_SCENES])(RayTracingData&) = { scene1, scene2, scene3, scene4 };
+
+  if (sceneNumber < 1 || sceneNumber > NUM_SCENES)
+    error(std::format("[scene::load] Unknown scene [{}], available: 1 to {}", sceneNumber, NUM_SCENES));
+
+  setBLASBuilder(rtData.blasBuilder);
+  scenes[sceneNumber - 1](rtData);
+  updateEmitters(rtData);
+}
+
+void rebuildBLAS(const RayTracingData& rtData) {
+  setBLASBuilder(rtData.blasBuilder);
+
+  // The persistent buffers are written in place, frames in flight must not read them meanwhile
+  if (!isHeadless) waitForGPU();
+
+  double buildTime = 0.;
+  for (u32 i = 0; i < sceneMeshes.size(); i++) {
+    MeshRT& mesh = sceneMeshes[i];
+    mesh.buildBVH(blasBuilder);
+    buildTime += mesh.bvh.stats.buildTime;
+
+    // Only the nodes and their primitive order change, the bounds of the instances stay
+    if (!isHeadless)
+      uploadMesh(mesh, i);
+  }
+
+  printf("BLAS rebuilt: %zu meshes with %s in %.3f ms\n", sceneMeshes.size(), BVH::getBuilderName(blasBuilder), buildTime * 1e3);
+}
+
+// Compares the plain SAH build with the SBVH on the current instances, both as a single level over every
+// triangle in world space and as the TLAS over the mesh BLASes. Steps are counted on the CPU with random
+// rays starting inside the scene
+void printBVHReport(const char* sceneName) {
+  constexpr u32 numRays = 1u << 14;
+  if (hasLazyBLAS) return;
+
+  std::vector<std::vector<Triangle>> meshesTriangles;
+  for (const MeshRT& mesh : sceneMeshes)
+    meshesTriangles.push_back(mesh.getTriangles());
+
+  std::vector<Triangle> worldTriangles;
+  for (const MeshInstance& instance : sceneInstances) {
+    for (Triangle tri : meshesTriangles[instance.meshIndex]) {
+      tri.a = vec3(instance.transform * vec4(tri.a, 1.f));
+      tri.b = vec3(instance.transform * vec4(tri.b, 1.f));
+      tri.c = vec3(instance.transform * vec4(tri.c, 1.f));
+      worldTriangles.push_back(tri);
+    }
+  }
+
+  std::vector<Ray> rays(numRays);
+  {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+    const BVHNode& root = tlas.nodes[0];
+
+    for (Ray& ray : rays) {
+      ray.origin = glm::mix(root.boundsMin, root.boundsMax, vec3(dist(rng), dist(rng), dist(rng)));
+      ray.dir = glm::normalize(vec3(dist(rng), dist(rng), dist(rng)) * 2.f - 1.f);
+    }
+  }
+
+  auto intersectTriangles = [](const Ray& ray, const std::vector<Triangle>& triangles) {
+    return [&ray, &triangles](u32 triIdx, float& closestDst) {
+      intersect::TriangleHit hit = intersect::rayTriangle(ray, triangles[triIdx]);
+      if (hit.didHit && hit.dst < closestDst) closestDst = hit.dst;
+    };
+  };
+
+  auto printRow = [](const char* structure, const BVH& bvh, const BVHTraversalStats& stats) {
+    printf(
+      "%-12s %-18s %6u %6u %8.3f %8.3f %10.2f %10.2f\n",
+      structure, BVH::getBuilderName(bvh.builder), bvh.stats.numReferences, bvh.stats.numNodes,
+      bvh.calcOverlap(), bvh.stats.sahCost, stats.numNodes / double(numRays), stats.numPrimitives / double(numRays)
+    );
+  };
+
+  BVH flat[2];
+  BVH topLevel[2];
+  BVHTraversalStats flatStats[2];
+  BVHTraversalStats topLevelStats[2];
+  u32 builders[2] = {BVH_BUILDER_BINNED_SAH, BVH_BUILDER_SPATIAL_SAH};
+  std::vector<AABB> instancesBounds = calcInstancesBounds();
+
+  for (int i = 0; i < 2; i++) {
+    flat[i].build(worldTriangles.data(), static_cast<u32>(worldTriangles.size()), builders[i]);
+    topLevel[i].build(instancesBounds, builders[i]);
+
+    for (const Ray& ray : rays) {
+      float closestDst = FLT_MAX;
+      flat[i].intersect(ray, closestDst, intersectTriangles(ray, worldTriangles), &flatStats[i]);
+
+      closestDst = FLT_MAX;
+      topLevel[i].intersect(ray, closestDst, [&](u32 instanceIdx, float& closestDst) {
+        const MeshInstance& instance = sceneInstances[instanceIdx];
+        const MeshRT& mesh = sceneMeshes[instance.meshIndex];
+
+        // Direction isn't normalized, so distances stay the same in both spaces
+        Ray objectRay{vec3(instance.invTransform * vec4(ray.origin, 1.f)), vec3(instance.invTransform * vec4(ray.dir, 0.f))};
+        mesh.bvh.intersect(objectRay, closestDst, intersectTriangles(objectRay, meshesTriangles[instance.meshIndex]), &topLevelStats[i]);
+      }, &topLevelStats[i]);
+    }
+  }
+
+  printf("\nBVH report [%s]: %u triangles, %zu instances, %u rays from inside the scene\n", sceneName, static_cast<u32>(worldTriangles.size()), sceneInstances.size(), numRays);
+  printf("%-12s %-18s %6s %6s %8s %8s %10s %10s\n", "structure", "builder", "refs", "nodes", "overlap", "SAH", "steps/ray", "tris/ray");
+
+  for (int i = 0; i < 2; i++)
+    printRow("flat", flat[i], flatStats[i]);
+
+  for (int i = 0; i < 2; i++)
+    printRow("TLAS + BLAS", topLevel[i], topLevelStats[i]);
+
+  printf("\n");
+}
+
+void updateEmitters(RayTracingData& rtData) {
+  if (!areEmittersDirty) return;
+  areEmittersDirty = false;
+
+  std::vector<float> weights;
+  float totalWeight = 0.f;
+  sceneEmitters.clear();
+
+  auto addEmitter = [&](const Emitter& emitter, float luminance, float area) {
+    if (area <= 0.f) return;
+
+    sceneEmitters.push_back(emitter);
+    weights.push_back(luminance * area);
+    totalWeight += luminance * area;
+  };
+
+  for (int i = 0; i < rtData.numSpheres; i++) {
+    const Sphere& sphere = sceneSpheres[i];
+    const RayTracingMaterial& material = sceneMaterials[sphere.materialIdx];
+    float luminance = calcEmitterLuminance(material.emissionColor * material.emissionStrength);
+    if (luminance <= 0.f) continue;
+
+    Emitter emitter;
+    emitter.type = EMITTER_TYPE_SPHERE;
+    emitter.sphereIdx = static_cast<u32>(i);
+    emitter.materialIdx = sphere.materialIdx;
+    addEmitter(emitter, luminance, 4.f * PI * sphere.radius * sphere.radius);
+  }
+
+  for (const MeshInstance& instance : sceneInstances) {
+    const MeshRT& mesh = sceneMeshes[instance.meshIndex];
+    u32 materialIdx = instance.flags & RT_INSTANCE_FLAG_MATERIAL_OVERRIDE ? instance.materialIdx : mesh.meshInfo.materialIdx;
+    const RayTracingMaterial& material = sceneMaterials[materialIdx];
+    float luminance = calcEmitterLuminance(material.emissionColor * material.emissionStrength);
+    if (luminance <= 0.f) continue;
+
+    for (const uvec3& tri : mesh.indices) {
+      Emitter emitter;
+      emitter.a = vec3(instance.transform * vec4(mesh.vertices[tri.x].position, 1.f));
+      emitter.ab = vec3(instance.transform * vec4(mesh.vertices[tri.y].position, 1.f)) - emitter.a;
+      emitter.ac = vec3(instance.transform * vec4(mesh.vertices[tri.z].position, 1.f)) - emitter.a;
+      emitter.materialIdx = materialIdx;
+      addEmitter(emitter, luminance, 0.5f * glm::length(glm::cross(emitter.ab, emitter.ac)));
+    }
+  }
+
+  if (!sceneEmitters.empty())
+    buildAliasTable(sceneEmitters, weights, totalWeight);
+
+  rtData.numEmitters = static_cast<int>(sceneEmitters.size());
+  rtData.emittersPower = totalWeight;
+  printf("Emitters: %zu, power (luminance x area) %.3f\n", sceneEmitters.size(), totalWeight);
+
+  if (isHeadless || sceneEmitters.empty()) return;
+
+  emittersBuf.reserve(static_cast<u32>(sceneEmitters.size()));
+  std::copy(sceneEmitters.begin(), sceneEmitters.end(), emittersBuf.data);
 }
 
+void setHeadless(bool headless) {
+  isHeadless = headless;
+}
+
+void setLazyBLAS(bool lazy) {
+  if (lazy && !isHeadless)
+    error("[scene::setLazyBLAS] The GPU needs the mesh BVHs, only a headless scene can leave them unbuilt");
+
+  hasLazyBLAS = lazy;
+}
+
+bool isLazyBLAS() { return hasLazyBLAS; }
+
 const Sphere& getSphere(size_t idx) {
-  return spheresBuf[idx];
+  return sceneSpheres[idx];
+}
+
+const std::vector<Sphere>& getSpheres() { return sceneSpheres; }
+const BVH& getSpheresBVH() { return sphereBVH; }
+const std::vector<MeshRT>& getMeshes() { return sceneMeshes; }
+const std::vector<MeshInstance>& getInstances() { return sceneInstances; }
+const BVH& getTLAS() { return tlas; }
+const std::vector<RayTracingMaterial>& getMaterials() { return sceneMaterials; }
+const std::vector<Emitter>& getEmitters() { return sceneEmitters; }
+
+u32 getNumEdits() { return numEdits; }
+
+const RayTracingMaterial& getMaterial(u32 idx) {
+  return sceneMaterials[idx];
+}
+
+u32 addMaterial(const RayTracingMaterial& material) {
+  u32 idx = static_cast<u32>(sceneMaterials.size());
+  sceneMaterials.push_back(material);
+  areEmittersDirty = true;
+  if (isHeadless) return idx;
+
+  materialsBuf.reserve(idx + 1);
+  materialsBuf.data[idx] = material;
+
+  return idx;
+}
+
+void updateMaterial(u32 idx, const RayTracingMaterial& material) {
+  if (idx >= sceneMaterials.size())
+    error("[scene::updateMaterial] Material index [{}] is out of range [{}]", idx, sceneMaterials.size());
+
+  const RayTracingMaterial& oldMaterial = sceneMaterials[idx];
+  if (oldMaterial.emissionColor != material.emissionColor || oldMaterial.emissionStrength != material.emissionStrength)
+    areEmittersDirty = true;
+
+  sceneMaterials[idx] = material;
+  numEdits++;
+  if (!isHeadless) materialsBuf.data[idx] = material;
 }
 
 void updateSpheresBuffer(const Sphere& sphere, size_t idx) {
-  if (!spheresBuf)
-    error("[scene::updateSpheresBuffer] spheresBuf is not allocated");
+  if (idx >= sceneSpheres.size()) {
+    sceneSpheres.resize(idx + 1);
+    areEmittersDirty = true;
+  }
+
+  numEdits++;
 
-  spheresBuf[idx] = sphere;
+  // The animation only moves them, the emitters follow the sphere buffer
+  if (sceneSpheres[idx].radius != sphere.radius || sceneSpheres[idx].materialIdx != sphere.materialIdx)
+    areEmittersDirty = true;
+
+  sceneSpheres[idx] = sphere;
+  dirtySpheres.push_back(static_cast<u32>(idx));
+  if (isHeadless) return;
+
+  spheresBuf.reserve(static_cast<u32>(idx) + 1);
+  spheresBuf.data[idx] = sphere;
 }
 
-void updateMeshBuffer(u32& firstTriIdx, MeshRT* meshes, int numMeshes, int meshIdxOffset) {
-  if (!meshesInfosBuf)
-    error("[scene::updateMeshBuffer] meshesInfosBuf is not allocated");
+void animateSpheres() {
+  for (size_t i = 0; i < sceneSpheres.size(); i++) {
+    Sphere sphere = sceneSpheres[i];
+    sphere.update();
+    updateSpheresBuffer(sphere, i);
+  }
+}
 
-  if (!trianglesBuf)
-    error("[scene::updateMeshBuffer] trianglesBuf is not allocated");
+void refit() {
+  if (!dirtySpheres.empty() && !sphereBVH.nodes.empty()) {
+    BVHRefitResult result = sphereBVH.refit(calcSpheresBounds(), dirtySpheres);
+    uploadRefit(sphereBVH, result, sphereNodesBuf.data, sphereIndicesBuf.data);
+  }
 
-  GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-  if (fence) {
-    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
-    glDeleteSync(fence);
+  if (!dirtyInstances.empty() && !tlas.nodes.empty()) {
+    BVHRefitResult result = tlas.refit(calcInstancesBounds(), dirtyInstances);
+    uploadRefit(tlas, result, tlasNodesBuf, tlasInstIndicesBuf);
   }
 
+  dirtySpheres.clear();
+  dirtyInstances.clear();
+}
+
+void updateMeshBuffer(u32& firstTriIdx, u32& firstVertexIdx, MeshRT* meshes, int numMeshes, int meshIdxOffset) {
+  if (!isHeadless) waitForGPU(); // Frames in flight must not read the buffers while they are rewritten
+
   for (int i = 0; i < numMeshes; i++) {
     MeshRT& mesh = meshes[i];
+    u32 meshIdx = i + meshIdxOffset;
+
+    if (mesh.bvh.nodes.empty() && !hasLazyBLAS)
+      mesh.buildBVH(blasBuilder);
+
+    // The node and index ranges of a mesh are sized by its triangles
+    if (mesh.bvh.primIndices.size() > mesh.getNumTriangles())
+      error("[scene::updateMeshBuffer] BLAS with duplicated references [{} > {}] doesn't fit the buffers", mesh.bvh.primIndices.size(), mesh.getNumTriangles());
+
+    // A BLAS over N triangles has at most 2N - 1 nodes, so the ranges of different meshes never overlap
     mesh.meshInfo.firstTriangleIndex = firstTriIdx;
+    mesh.meshInfo.rootNodeIndex = firstTriIdx * 2;
+    mesh.meshInfo.rootWideNodeIndex = firstTriIdx;
+    mesh.meshInfo.firstVertexIndex = firstVertexIdx;
+    mesh.meshInfo.materialIdx = addMaterial(mesh.material);
 
-    for (size_t j = 0; j < mesh.triangles.size(); j++) {
-      trianglesBuf[j + firstTriIdx] = mesh.triangles[j];
-    }
+    if (!isHeadless)
+      uploadMesh(mesh, meshIdx);
+
+    if (sceneMeshesInfos.size() <= meshIdx)
+      sceneMeshesInfos.resize(meshIdx + 1);
+    sceneMeshesInfos[meshIdx] = mesh.meshInfo;
+
+    if (sceneMeshes.size() <= meshIdx)
+      sceneMeshes.resize(meshIdx + 1);
+    // Only the geometry and the BVHs move, the caller keeps its meshInfo and material for the GUI edits
+    sceneMeshes[meshIdx] = std::move(mesh);
 
-    meshesInfosBuf[i + meshIdxOffset] = mesh.meshInfo;
+    numEdits++;
 
-    firstTriIdx += mesh.triangles.size();
+    // The bounds of every placement of the mesh may have changed
+    for (u32 j = 0; j < sceneInstances.size(); j++)
+      if (sceneInstances[j].meshIndex == meshIdx)
+        dirtyInstances.push_back(j);
+
+    firstTriIdx += sceneMeshes[meshIdx].getNumTriangles();
+    firstVertexIdx += sceneMeshes[meshIdx].vertices.size();
   }
 }
 
+void defineShaderConstants() {
+  auto defineUint = [](const char* name, u32 value) { Shader::define(name, std::format("{}u", value)); };
+  auto defineInt = [](const char* name, int value) { Shader::define(name, std::to_string(value)); };
+  // The alternate form keeps the decimal point of whole values, GLSL has no 4f
+  auto defineFloat = [](const char* name, float value) { Shader::define(name, std::format("{:#}f", value)); };
+
+  defineUint("MAX_INSTANCES", MAX_INSTANCES);
+  defineUint("MAX_TLAS_REFERENCES", MAX_TLAS_REFERENCES);
+  defineUint("MAX_TLAS_NODES", MAX_TLAS_NODES);
+
+  defineUint("WIDE_BVH_WIDTH", WIDE_BVH_WIDTH);
+  defineInt("WIDE_BVH_STACK_SIZE", WIDE_BVH_STACK_SIZE);
+  defineUint("WIDE_BVH_NODE_WORDS", WIDE_BVH_NODE_WORDS(WIDE_BVH_WIDTH));
+  defineUint("WIDE_BVH_LEAF_BIT", WIDE_BVH_LEAF_BIT);
+
+  defineInt("LBVH_COMP_WORK_GROUP_SIZE", LBVH_COMP_WORK_GROUP_SIZE);
+  defineUint("BVH_LBVH_LEAF_BIT", BVH_LBVH_LEAF_BIT);
+
+  defineUint("PACKED_VERTEX_POSITION_WORDS", PACKED_VERTEX_POSITION_WORDS);
+  defineUint("PACKED_VERTEX_NORMAL_WORDS", PACKED_VERTEX_NORMAL_WORDS);
+  defineUint("PACKED_TRIANGLE_INDEX_WORDS", PACKED_TRIANGLE_INDEX_WORDS);
+  defineUint("PACKED_TRIANGLE_EDGE_WORDS", PACKED_TRIANGLE_EDGE_WORDS);
+
+  defineFloat("RAY_BOX_FAR_SCALE", RAY_BOX_FAR_SCALE);
+
+  defineUint("RT_MATERIAL_FLAG_CHECKERED_PATTERN", RT_MATERIAL_FLAG_CHECKERED_PATTERN);
+  defineUint("RT_INSTANCE_FLAG_MATERIAL_OVERRIDE", RT_INSTANCE_FLAG_MATERIAL_OVERRIDE);
+
+  defineInt("RT_SSBO_SPHERES", RT_SSBO_SPHERES);
+  defineInt("RT_SSBO_SPHERE_NODES", RT_SSBO_SPHERE_NODES);
+  defineInt("RT_SSBO_SPHERE_INDICES", RT_SSBO_SPHERE_INDICES);
+  defineInt("RT_SSBO_MESHES_INFOS", RT_SSBO_MESHES_INFOS);
+  defineInt("RT_SSBO_VERTEX_POSITIONS", RT_SSBO_VERTEX_POSITIONS);
+  defineInt("RT_SSBO_VERTEX_NORMALS", RT_SSBO_VERTEX_NORMALS);
+  defineInt("RT_SSBO_TRI_INDICES", RT_SSBO_TRI_INDICES);
+  defineInt("RT_SSBO_BVH_NODES", RT_SSBO_BVH_NODES);
+  defineInt("RT_SSBO_BVH_TRI_INDICES", RT_SSBO_BVH_TRI_INDICES);
+  defineInt("RT_SSBO_WIDE_BVH_NODES", RT_SSBO_WIDE_BVH_NODES);
+  defineInt("RT_SSBO_MATERIALS", RT_SSBO_MATERIALS);
+  defineInt("RT_SSBO_TRI_EDGES", RT_SSBO_TRI_EDGES);
+  defineInt("RT_SSBO_EMITTERS", RT_SSBO_EMITTERS);
+  defineInt("RT_SSBO_PATH_STATS", RT_SSBO_PATH_STATS);
+  defineInt("RT_SSBO_BLUE_NOISE", RT_SSBO_BLUE_NOISE);
+
+  defineUint("RT_PATH_STATS_STRIDE", RT_PATH_STATS_STRIDE);
+
+  defineUint("RT_SAMPLER_RANDOM", RT_SAMPLER_RANDOM);
+  defineUint("RT_SAMPLER_SOBOL", RT_SAMPLER_SOBOL);
+  defineUint("RT_SAMPLER_LATTICE", RT_SAMPLER_LATTICE);
+  defineUint("RT_SAMPLER_BOUNCE_DIMENSIONS", RT_SAMPLER_BOUNCE_DIMENSIONS);
+  defineUint("BLUE_NOISE_SIZE", BLUE_NOISE_SIZE);
+  defineUint("BLUE_NOISE_BITS", BLUE_NOISE_BITS);
+
+  defineInt("RT_ADAPTIVE_TILE_LOD", RT_ADAPTIVE_TILE_LOD);
+  defineUint("RT_ADAPTIVE_MAX_RAYS_SCALE", RT_ADAPTIVE_MAX_RAYS_SCALE);
+  defineFloat("RT_ADAPTIVE_MIN_LUMINANCE", RT_ADAPTIVE_MIN_LUMINANCE);
+
+  defineUint("RT_DENOISE_FEATURE_RAYS", RT_DENOISE_FEATURE_RAYS);
+  defineFloat("RT_DENOISE_SIGMA_LUMINANCE", RT_DENOISE_SIGMA_LUMINANCE);
+  defineFloat("RT_DENOISE_SIGMA_NORMAL", RT_DENOISE_SIGMA_NORMAL);
+  defineFloat("RT_DENOISE_SIGMA_DEPTH", RT_DENOISE_SIGMA_DEPTH);
+  defineFloat("RT_DENOISE_SIGMA_ALBEDO", RT_DENOISE_SIGMA_ALBEDO);
+  defineFloat("RT_DENOISE_MISS_DEPTH", RT_DENOISE_MISS_DEPTH);
+
+  defineUint("EMITTER_TYPE_TRIANGLE", EMITTER_TYPE_TRIANGLE);
+  defineUint("EMITTER_TYPE_SPHERE", EMITTER_TYPE_SPHERE);
+}
+
 void setUnifrom(const Shader& shader) {
-  static const GLint spheresBlockLoc     = shader.getUniformBlockIndex("u_spheresBlock");
-  static const GLint trianglesBlockLoc   = shader.getUniformBlockIndex("u_trianglesBlock");
-  static const GLint meshesInfosBlockLoc = shader.getUniformBlockIndex("u_meshesInfosBlock");
+  static const GLint instancesBlockLoc   = shader.getUniformBlockIndex("u_instancesBlock");
+  static const GLint tlasNodesBlockLoc   = shader.getUniformBlockIndex("u_tlasNodesBlock");
+  static const GLint tlasInstIndicesLoc  = shader.getUniformBlockIndex("u_tlasInstIndicesBlock");
 
-  shader.setUniformBlock(spheresBlockLoc, 0);
-  shader.setUniformBlock(trianglesBlockLoc, 1);
-  shader.setUniformBlock(meshesInfosBlockLoc, 2);
+  shader.setUniformBlock(instancesBlockLoc, 5);
+  shader.setUniformBlock(tlasNodesBlockLoc, 6);
+  shader.setUniformBlock(tlasInstIndicesLoc, 7);
 
-  uboSpheres.bindBase(0);
-  uboTriangles.bindBase(1);
-  uboMeshesInfos.bindBase(2);
+  uboInstances.bindBase(5);
+  uboTLASNodes.bindBase(6);
+  uboTLASInstIndices.bindBase(7);
 }
 
+// The storage buffers are bound every frame, they change when they grow and other passes (the LBVH build) use the
+// same binding points
 void bind() {
-  uboSpheres.bind();
-  uboTriangles.bind();
-  uboMeshesInfos.bind();
+  uboInstances.bind();
+  uboTLASNodes.bind();
+  uboTLASInstIndices.bind();
+
+  spheresBuf.bindBase(RT_SSBO_SPHERES);
+  sphereNodesBuf.bindBase(RT_SSBO_SPHERE_NODES);
+  sphereIndicesBuf.bindBase(RT_SSBO_SPHERE_INDICES);
+  meshesInfosBuf.bindBase(RT_SSBO_MESHES_INFOS);
+  vertexPositionsBuf.bindBase(RT_SSBO_VERTEX_POSITIONS);
+  vertexNormalsBuf.bindBase(RT_SSBO_VERTEX_NORMALS);
+  triIndicesBuf.bindBase(RT_SSBO_TRI_INDICES);
+  triEdgesBuf.bindBase(RT_SSBO_TRI_EDGES);
+  bvhNodesBuf.bindBase(RT_SSBO_BVH_NODES);
+  bvhTriIndicesBuf.bindBase(RT_SSBO_BVH_TRI_INDICES);
+  wideBVHNodesBuf.bindBase(RT_SSBO_WIDE_BVH_NODES);
+  materialsBuf.bindBase(RT_SSBO_MATERIALS);
+  emittersBuf.bindBase(RT_SSBO_EMITTERS);
 }
 
 void unbind() {
-  uboSpheres.unbind();
-  uboTriangles.unbind();
-  uboMeshesInfos.unbind();
+  uboInstances.unbind();
+  uboTLASNodes.unbind();
+  uboTLASInstIndices.unbind();
 }
 
 } // namespace scenes
-
@@ -3,22 +3,95 @@
 #include "../engine/Shader.hpp"
 #include "RayTracingData.hpp"
 #include "Sphere.hpp"
+#include "RayTracingMaterial.hpp"
+#include "MeshRT.hpp"
+#include "MeshInstance.hpp"
+#include "Emitter.hpp"
+#include "bvh/BVH.hpp"
 
-// NOTE: Must match in rt.frag
-#define MAX_SPHERES 6u
-#define MAX_TRIANGLES 500u
-#define MAX_MESHES 10u
+// Injected into the shaders by scene::defineShaderConstants
+#define MAX_INSTANCES 16u
+#define MAX_TLAS_REFERENCES MAX_INSTANCES // One per instance, the top level is a binned SAH BVH
+#define MAX_TLAS_NODES (MAX_TLAS_REFERENCES * 2u)
+
+#define NUM_SCENES 4u
+
+// Storage buffer bindings, the buffers are sized from the scene
+#define RT_SSBO_SPHERES          0
+#define RT_SSBO_SPHERE_NODES     1
+#define RT_SSBO_SPHERE_INDICES   2
+#define RT_SSBO_MESHES_INFOS     3
+#define RT_SSBO_VERTEX_POSITIONS 4
+#define RT_SSBO_VERTEX_NORMALS   5
+#define RT_SSBO_TRI_INDICES      6
+#define RT_SSBO_BVH_NODES        7
+#define RT_SSBO_BVH_TRI_INDICES  8
+#define RT_SSBO_WIDE_BVH_NODES   9
+#define RT_SSBO_MATERIALS        10
+#define RT_SSBO_TRI_EDGES        11
+#define RT_SSBO_EMITTERS         12
+#define RT_SSBO_PATH_STATS       13 // Counts of the paths and their segments, written by rt.frag
+#define RT_SSBO_BLUE_NOISE       14 // Ranks of blueNoise::tile, uploaded by main
+
+#define RT_PATH_STATS_STRIDE 8u // Only every 8th pixel of every 8th row counts its paths, the mean needs no more
 
 namespace scene {
+  // Must be called before the ray tracing shader is compiled
+  void defineShaderConstants();
+
+  // Keeps the scenes on the CPU, without a GL context. Must be set before a scene is loaded
+  void setHeadless(bool headless);
+
+  // Loads the meshes without their BVHs, the CPU tracer builds them as rays reach them (LazyBVH). Headless only, must
+  // be set before a scene is loaded
+  void setLazyBLAS(bool lazy);
+  bool isLazyBLAS();
+
   void scene1(RayTracingData& rtData);
   void scene2(RayTracingData& rtData);
   void scene3(RayTracingData& rtData);
   void scene4(RayTracingData& rtData);
 
+  // sceneN by its number, from 1 to NUM_SCENES
+  void load(u32 sceneNumber, RayTracingData& rtData);
+
+  // Rebuilds the mesh BVHs of the loaded scene with rtData.blasBuilder
+  void rebuildBLAS(const RayTracingData& rtData);
+
+  // Compares the binned SAH and the SBVH on the loaded scene, flat and as TLAS + BLAS (`--bench bvh-builders`).
+  // Nothing with lazy BLASes
+  void printBVHReport(const char* sceneName);
+
+  // Rebuilds the emitter table of the light sampling when an emission, a radius or the instances changed since the
+  // last call. Sets numEmitters and emittersPower
+  void updateEmitters(RayTracingData& rtData);
+
   const Sphere& getSphere(size_t idx);
+  const RayTracingMaterial& getMaterial(u32 idx);
+
+  // CPU copies of what the shader reads, for the reference tracer
+  const std::vector<Sphere>& getSpheres();
+  const BVH& getSpheresBVH();
+  const std::vector<MeshRT>& getMeshes();
+  const std::vector<MeshInstance>& getInstances();
+  const BVH& getTLAS();
+  const std::vector<RayTracingMaterial>& getMaterials();
+  const std::vector<Emitter>& getEmitters();
+
+  // Counts the changes to the spheres, the materials, the meshes and the instances, the first hits stay the same
+  // while it does
+  u32 getNumEdits();
+
+  // Returns the index of the new slot in the material table, the table is cleared when a scene is loaded
+  u32 addMaterial(const RayTracingMaterial& material);
+  void updateMaterial(u32 idx, const RayTracingMaterial& material);
 
   void updateSpheresBuffer(const Sphere& sphere, size_t idx);
-  void updateMeshBuffer(u32& firstTriIdx, MeshRT* meshes, int numMeshes, int meshIdxOffset = 0);
+  void animateSpheres();
+  void updateMeshBuffer(u32& firstTriIdx, u32& firstVertexIdx, MeshRT* meshes, int numMeshes, int meshIdxOffset = 0);
+
+  // Refits the sphere BVH and the top level over whatever moved since the last call
+  void refit();
 
   void setUnifrom(const Shader& shader);
   void bind();
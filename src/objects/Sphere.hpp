@@ -2,12 +2,10 @@
 
 #include <cmath>
 
-#include "RayTracingMaterial.hpp"
-
 struct Sphere {
   alignas(16) vec3 pos;
   float radius;
-  RayTracingMaterial material;
+  u32 materialIdx = 0; // In the scene material table
 
   void update() {
     pos.y += sin(global::time) * global::dt * (radius + radius);
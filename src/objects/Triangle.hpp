@@ -10,4 +10,3 @@ struct Triangle {
   alignas(16) vec3 normalB;
   alignas(16) vec3 normalC;
 };
-
@@ -0,0 +1,32 @@
+#pragma once
+
+struct AABB {
+  vec3 min = vec3(FLT_MAX);
+  vec3 max = vec3(-FLT_MAX);
+
+  void grow(const vec3& p) {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+
+  void grow(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  AABB intersection(const AABB& other) const {
+    return AABB{glm::max(min, other.min), glm::min(max, other.max)};
+  }
+
+  vec3 center() const { return (min + max) * 0.5f; }
+  vec3 extent() const { return max - min; }
+
+  bool isValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+  // Half of the surface area (the constant factor cancels out in SAH)
+  float area() const {
+    if (!isValid()) return 0.f;
+    vec3 e = extent();
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+  }
+};
@@ -0,0 +1,271 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <numeric>
+
+#include "utils/status.hpp"
+#include "SweepBuilder.hpp"
+#include "BinnedBuilder.hpp"
+#include "SpatialSplitBuilder.hpp"
+#include "LinearBuilder.hpp"
+#include "../../engine/ThreadPool.hpp"
+
+const char* BVH::getBuilderName(u32 builder) {
+  switch (builder) {
+    case BVH_BUILDER_SWEEP_SAH:  return "sweep SAH";
+    case BVH_BUILDER_BINNED_SAH: return "binned SAH";
+    case BVH_BUILDER_SPATIAL_SAH: return "spatial split SAH";
+    case BVH_BUILDER_LBVH:       return "LBVH";
+    case BVH_BUILDER_LBVH_GPU:   return "LBVH (GPU)";
+    default:
+      error("[BVH::getBuilderName] Unhandled builder type [{}]", builder);
+  }
+
+  return "";
+}
+
+void BVH::build(const std::vector<AABB>& primBounds, u32 builder, const BVHSplitPrimitive& splitPrimitive) {
+  nodes.clear();
+  primIndices.clear();
+  parentIndices.clear();
+  primLeafIndices.clear();
+  stats = BVHStats{};
+  numPrimitives = static_cast<u32>(primBounds.size());
+  this->builder = builder;
+  this->splitPrimitive = splitPrimitive;
+
+  if (primBounds.empty()) return;
+
+  status::start("Building", std::format("BVH [{}, {} primitives]", getBuilderName(builder), primBounds.size()));
+  auto start = std::chrono::steady_clock::now();
+
+  switch (builder) {
+    case BVH_BUILDER_SWEEP_SAH:
+      SweepBuilder(*this, primBounds).build();
+      break;
+    case BVH_BUILDER_BINNED_SAH:
+      BinnedBuilder(*this, primBounds).build();
+      break;
+    case BVH_BUILDER_SPATIAL_SAH:
+      SpatialSplitBuilder(*this, primBounds, splitPrimitive).build();
+      break;
+    case BVH_BUILDER_LBVH:
+    case BVH_BUILDER_LBVH_GPU:
+      LinearBuilder(*this, primBounds, builder == BVH_BUILDER_LBVH_GPU).build();
+      break;
+    default:
+      status::end(false);
+      error("[BVH::build] Unhandled builder type [{}]", builder);
+  }
+
+  linkNodes();
+
+  stats.buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats.numNodes = static_cast<u32>(nodes.size());
+  stats.numReferences = static_cast<u32>(primIndices.size());
+  stats.sahCost = calcSAHCost();
+  stats.depth = calcDepth();
+
+  for (const BVHNode& node : nodes)
+    stats.numLeaves += node.isLeaf();
+
+  status::end(true);
+
+  bool isParallel = builder == BVH_BUILDER_BINNED_SAH || builder == BVH_BUILDER_LBVH || builder == BVH_BUILDER_LBVH_GPU;
+  u32 numThreads = isParallel ? ThreadPool::get().getNumThreads() : 1;
+  printf(
+    "BVH: %.3f ms (%u threads), %u nodes, %u leaves, %u references, depth %u, SAH cost %.3f\n",
+    stats.buildTime * 1e3, numThreads, stats.numNodes, stats.numLeaves, stats.numReferences, stats.depth, stats.sahCost
+  );
+}
+
+void BVH::build(const Triangle* triangles, u32 numTriangles, u32 builder) {
+  std::vector<AABB> bounds(numTriangles);
+
+  for (u32 i = 0; i < numTriangles; i++) {
+    const Triangle& tri = triangles[i];
+    bounds[i].grow(tri.a);
+    bounds[i].grow(tri.b);
+    bounds[i].grow(tri.c);
+  }
+
+  // Clips the edges of the triangle against the plane, so the parts are tighter than the cut bounds
+  auto splitTriangle = [triangles](u32 primIdx, const AABB& bounds, int axis, float pos, AABB& left, AABB& right) {
+    const Triangle& tri = triangles[primIdx];
+    const vec3* vertices[3] = {&tri.a, &tri.b, &tri.c};
+    left = right = AABB{};
+
+    for (int i = 0; i < 3; i++) {
+      const vec3& v0 = *vertices[i];
+      const vec3& v1 = *vertices[(i + 1) % 3];
+      float p0 = v0[axis];
+      float p1 = v1[axis];
+
+      if (p0 <= pos) left.grow(v0);
+      if (p0 >= pos) right.grow(v0);
+
+      if ((p0 < pos && pos < p1) || (p1 < pos && pos < p0)) {
+        vec3 p = glm::mix(v0, v1, (pos - p0) / (p1 - p0));
+        p[axis] = pos;
+        left.grow(p);
+        right.grow(p);
+      }
+    }
+
+    left = left.intersection(bounds);
+    right = right.intersection(bounds);
+  };
+
+  build(bounds, builder, splitTriangle);
+  splitPrimitive = nullptr; // The triangles may not outlive the build, rebuilds after a refit don't clip
+}
+
+BVHRefitResult BVH::refit(const std::vector<AABB>& primBounds, const std::vector<u32>& dirtyPrims) {
+  BVHRefitResult result;
+  if (nodes.empty() || dirtyPrims.empty()) return result;
+
+  if (primBounds.size() != numPrimitives)
+    error("[BVH::refit] Amount of primitives changed since the build [{} -> {}]", numPrimitives, primBounds.size());
+
+  // Collect the dirty leaves and every ancestor of them, each node once
+  std::vector<u32> dirtyNodes;
+  std::vector<bool> isDirty(nodes.size(), false);
+
+  // A duplicated primitive sits in several leaves, so everything is refit.
+  // Leaves then get the whole primitive instead of the clipped part, which is looser but still correct
+  if (primIndices.size() != numPrimitives) {
+    dirtyNodes.resize(nodes.size());
+    std::iota(dirtyNodes.begin(), dirtyNodes.end(), 0u);
+  } else {
+    for (u32 primIdx : dirtyPrims) {
+      u32 nodeIdx = primLeafIndices[primIdx];
+
+      while (nodeIdx != BVH_INVALID_INDEX && !isDirty[nodeIdx]) {
+        isDirty[nodeIdx] = true;
+        dirtyNodes.push_back(nodeIdx);
+        nodeIdx = parentIndices[nodeIdx];
+      }
+    }
+  }
+
+  // Children are always stored after their parent, so going from the highest index down is bottom-up
+  std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<u32>());
+
+  for (u32 nodeIdx : dirtyNodes) {
+    BVHNode& node = nodes[nodeIdx];
+
+    if (node.isLeaf()) {
+      updateNodeBounds(nodeIdx, primBounds.data());
+    } else {
+      const BVHNode& left = nodes[node.leftFirst];
+      const BVHNode& right = nodes[node.leftFirst + 1];
+      node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+      node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+    }
+  }
+
+  result.firstNode = dirtyNodes.back();
+  result.lastNode = dirtyNodes.front();
+
+  float sahCost = calcSAHCost();
+  if (sahCost > stats.sahCost * BVH_REFIT_MAX_SAH_RATIO) {
+    printf("BVH: refit SAH cost %.3f exceeds %.3f, rebuilding\n", sahCost, stats.sahCost * BVH_REFIT_MAX_SAH_RATIO);
+    build(primBounds, builder, splitPrimitive);
+
+    result.firstNode = 0;
+    result.lastNode = static_cast<u32>(nodes.size()) - 1;
+    result.rebuilt = true;
+  }
+
+  return result;
+}
+
+float BVH::calcSAHCost() const {
+  if (nodes.empty()) return 0.f;
+
+  AABB rootBounds{nodes[0].boundsMin, nodes[0].boundsMax};
+  float rootArea = rootBounds.area();
+  if (rootArea <= 0.f) return 0.f;
+
+  float cost = 0.f;
+  for (const BVHNode& node : nodes) {
+    float area = AABB{node.boundsMin, node.boundsMax}.area() / rootArea;
+
+    if (node.isLeaf())
+      cost += BVH_SAH_INTERSECTION_COST * node.numPrimitives * area;
+    else
+      cost += BVH_SAH_TRAVERSAL_COST * area;
+  }
+
+  return cost;
+}
+
+u32 BVH::calcDepth() const {
+  if (nodes.empty()) return 0;
+
+  u32 maxDepth = 0;
+  std::vector<std::pair<u32, u32>> stack{{0, 0}};
+
+  while (!stack.empty()) {
+    auto [nodeIdx, depth] = stack.back();
+    stack.pop_back();
+    maxDepth = std::max(maxDepth, depth);
+
+    const BVHNode& node = nodes[nodeIdx];
+    if (!node.isLeaf()) {
+      stack.push_back({node.leftFirst, depth + 1});
+      stack.push_back({node.leftFirst + 1, depth + 1});
+    }
+  }
+
+  return maxDepth;
+}
+
+float BVH::calcOverlap() const {
+  if (nodes.empty()) return 0.f;
+
+  float rootArea = AABB{nodes[0].boundsMin, nodes[0].boundsMax}.area();
+  if (rootArea <= 0.f) return 0.f;
+
+  float overlap = 0.f;
+  for (const BVHNode& node : nodes) {
+    if (node.isLeaf()) continue;
+
+    const BVHNode& left = nodes[node.leftFirst];
+    const BVHNode& right = nodes[node.leftFirst + 1];
+    AABB shared = AABB{left.boundsMin, left.boundsMax}.intersection(AABB{right.boundsMin, right.boundsMax});
+    overlap += shared.area();
+  }
+
+  return overlap / rootArea;
+}
+
+void BVH::updateNodeBounds(u32 nodeIdx, const AABB* primBounds) {
+  BVHNode& node = nodes[nodeIdx];
+  AABB bounds;
+
+  for (u32 i = 0; i < node.numPrimitives; i++)
+    bounds.grow(primBounds[primIndices[node.leftFirst + i]]);
+
+  node.boundsMin = bounds.min;
+  node.boundsMax = bounds.max;
+}
+
+void BVH::linkNodes() {
+  parentIndices.assign(nodes.size(), BVH_INVALID_INDEX);
+  primLeafIndices.assign(numPrimitives, BVH_INVALID_INDEX);
+
+  for (u32 i = 0; i < nodes.size(); i++) {
+    const BVHNode& node = nodes[i];
+
+    if (node.isLeaf()) {
+      for (u32 j = 0; j < node.numPrimitives; j++)
+        primLeafIndices[primIndices[node.leftFirst + j]] = i;
+    } else {
+      parentIndices[node.leftFirst] = i;
+      parentIndices[node.leftFirst + 1] = i;
+    }
+  }
+}
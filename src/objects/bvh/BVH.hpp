@@ -0,0 +1,142 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "AABB.hpp"
+#include "BVHNode.hpp"
+#include "../Triangle.hpp"
+#include "../intersect.hpp"
+
+#define BVH_SAH_TRAVERSAL_COST 1.f
+#define BVH_SAH_INTERSECTION_COST 1.f
+#define BVH_MAX_LEAF_PRIMITIVES 8u
+
+// NOTE: Must not exceed BVH_STACK_SIZE in rt.frag
+#define BVH_MAX_DEPTH 31u
+
+// A refit keeps the topology, so the tree gets worse the further primitives move from where they were built.
+// Rebuild once the SAH cost grows by this factor over the cost right after the last build
+#define BVH_REFIT_MAX_SAH_RATIO 1.5f
+
+#define BVH_INVALID_INDEX UINT32_MAX
+
+#define BVH_BUILDER_SWEEP_SAH  0u // Exact SAH over sorted centroids, single thread
+#define BVH_BUILDER_BINNED_SAH 1u // Binned SAH on the thread pool
+#define BVH_BUILDER_SPATIAL_SAH 2u // SBVH, references may be duplicated (primIndices can outgrow the primitives)
+#define BVH_BUILDER_LBVH       3u // Morton codes and a radix tree on the thread pool
+#define BVH_BUILDER_LBVH_GPU   4u // Same, codes and radix tree in a compute shader (needs a GL context)
+
+// Cap on the extra references of the SBVH builder, as a fraction of the primitives
+#define BVH_SBVH_MAX_DUPLICATION 0.5f
+
+struct BVHStats {
+  u32 numNodes = 0;
+  u32 numLeaves = 0;
+  u32 numReferences = 0; // Size of primIndices
+  u32 depth = 0;
+  float sahCost = 0.f;
+  double buildTime = 0.; // Seconds
+};
+
+// Counted by the CPU traversals, bytes are what a GPU would fetch for the same walk
+struct BVHTraversalStats {
+  u64 numNodes = 0;
+  u64 numPrimitives = 0;
+  u64 numBytes = 0;
+};
+
+// Bounds of the parts of primitive `primIdx` (limited to `bounds`) on each side of the plane `axis = pos`.
+// Without one, spatial splits cut the bounds themselves
+using BVHSplitPrimitive = std::function<void(u32 primIdx, const AABB& bounds, int axis, float pos, AABB& left, AABB& right)>;
+
+struct BVHRefitResult {
+  u32 firstNode = BVH_INVALID_INDEX; // Range of nodes that changed (inclusive), invalid if none
+  u32 lastNode = 0;
+  bool rebuilt = false;
+
+  bool hasChanges() const { return firstNode != BVH_INVALID_INDEX; }
+};
+
+struct BVH {
+  std::vector<BVHNode> nodes;
+  std::vector<u32> primIndices; // Leaves reference primitives through this array
+  std::vector<u32> parentIndices; // Per node, BVH_INVALID_INDEX for the root
+  std::vector<u32> primLeafIndices; // Per primitive, the leaf that references it (any of them if duplicated)
+  BVHStats stats;
+  u32 builder = BVH_BUILDER_BINNED_SAH;
+
+  static const char* getBuilderName(u32 builder);
+
+  void build(const std::vector<AABB>& primBounds, u32 builder = BVH_BUILDER_BINNED_SAH, const BVHSplitPrimitive& splitPrimitive = nullptr);
+  void build(const Triangle* triangles, u32 numTriangles, u32 builder = BVH_BUILDER_BINNED_SAH);
+
+  // Recomputes the bounds of the leaves holding `dirtyPrims` and of their ancestors only.
+  // Falls back to a full rebuild with the last used builder if the tree has degraded too much
+  BVHRefitResult refit(const std::vector<AABB>& primBounds, const std::vector<u32>& dirtyPrims);
+
+  // Closest hit walk, same order as traverseBLAS in rt.frag.
+  // intersectPrim(primIdx, closestDst) tests a primitive and shrinks closestDst on a closer hit
+  template<typename IntersectPrim>
+  void intersect(const Ray& ray, float& closestDst, IntersectPrim&& intersectPrim, BVHTraversalStats* stats = nullptr) const;
+
+  float calcSAHCost() const;
+  u32 calcDepth() const;
+
+  // Sum of the areas shared by sibling boxes, relative to the root area
+  float calcOverlap() const;
+
+  void updateNodeBounds(u32 nodeIdx, const AABB* primBounds);
+
+private:
+  friend class LazyBVH;
+
+  BVHSplitPrimitive splitPrimitive; // Kept for rebuilds after a refit
+  u32 numPrimitives = 0;
+
+  void linkNodes();
+};
+
+template<typename IntersectPrim>
+void BVH::intersect(const Ray& ray, float& closestDst, IntersectPrim&& intersectPrim, BVHTraversalStats* stats) const {
+  if (nodes.empty()) return;
+
+  vec3 invDir = 1.f / ray.dir;
+  u32 stack[BVH_MAX_DEPTH + 1];
+  int stackSize = 0;
+
+  if (intersect::rayBoundingBoxDst(ray, invDir, nodes[0].boundsMin, nodes[0].boundsMax) < closestDst)
+    stack[stackSize++] = 0;
+
+  while (stackSize > 0) {
+    const BVHNode& node = nodes[stack[--stackSize]];
+    if (stats) {
+      stats->numNodes++;
+      stats->numBytes += sizeof(BVHNode);
+    }
+
+    if (node.isLeaf()) {
+      for (u32 i = 0; i < node.numPrimitives; i++)
+        intersectPrim(primIndices[node.leftFirst + i], closestDst);
+
+      if (stats) {
+        stats->numPrimitives += node.numPrimitives;
+        stats->numBytes += node.numPrimitives * sizeof(u32);
+      }
+    } else {
+      u32 childIdxA = node.leftFirst;
+      u32 childIdxB = node.leftFirst + 1;
+      float dstA = intersect::rayBoundingBoxDst(ray, invDir, nodes[childIdxA].boundsMin, nodes[childIdxA].boundsMax);
+      float dstB = intersect::rayBoundingBoxDst(ray, invDir, nodes[childIdxB].boundsMin, nodes[childIdxB].boundsMax);
+
+      if (stats) stats->numBytes += 2 * sizeof(BVHNode); // Child boxes
+
+      bool isNearestA = dstA <= dstB;
+      float dstNear = isNearestA ? dstA : dstB;
+      float dstFar  = isNearestA ? dstB : dstA;
+
+      if (dstFar  < closestDst) stack[stackSize++] = isNearestA ? childIdxB : childIdxA;
+      if (dstNear < closestDst) stack[stackSize++] = isNearestA ? childIdxA : childIdxB;
+    }
+  }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// NOTE: Must match in rt.frag
+// Leaf:     leftFirst = first index in the primitive indices array, numPrimitives > 0
+// Interior: leftFirst = index of the left child (the right one is next to it), numPrimitives = 0
+struct BVHNode {
+  alignas(16) vec3 boundsMin = vec3(FLT_MAX);
+  u32 leftFirst = 0;
+  alignas(16) vec3 boundsMax = vec3(-FLT_MAX);
+  u32 numPrimitives = 0;
+
+  bool isLeaf() const { return numPrimitives > 0; }
+};
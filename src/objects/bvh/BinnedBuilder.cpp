@@ -0,0 +1,274 @@
+#include "BinnedBuilder.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+
+#include "../../engine/ThreadPool.hpp"
+
+BinnedBuilder::BinnedBuilder(BVH& bvh, const std::vector<AABB>& primBounds)
+  : bvh(bvh),
+    primBounds(primBounds.data()),
+    centroids(primBounds.size())
+{
+  ThreadPool::get().parallelFor(static_cast<u32>(primBounds.size()), [&](u32 begin, u32 end) {
+    for (u32 i = begin; i < end; i++)
+      this->centroids[i] = primBounds[i].center();
+  });
+}
+
+void BinnedBuilder::build() {
+  ThreadPool& pool = ThreadPool::get();
+  std::vector<Subtree> subtrees = buildTopLevels();
+
+  if (subtrees.size() == 1) {
+    buildSubtree(subtrees[0].nodeIdx, subtrees[0].depth);
+  } else {
+    for (auto [nodeIdx, depth] : subtrees)
+      pool.submit([this, nodeIdx, depth] { buildSubtree(nodeIdx, depth); });
+
+    pool.wait();
+  }
+
+  finish();
+}
+
+std::vector<BinnedBuilder::Subtree> BinnedBuilder::buildTopLevels(u32 minSubtreePrimitives) {
+  ThreadPool& pool = ThreadPool::get();
+  u32 numPrims = static_cast<u32>(centroids.size());
+
+  bvh.primIndices.resize(numPrims);
+  std::iota(bvh.primIndices.begin(), bvh.primIndices.end(), 0u);
+
+  // Nodes are allocated by several tasks at once, so the storage can't grow
+  bvh.nodes.resize(numPrims * 2 - 1);
+  numNodes = 1;
+
+  BVHNode& root = bvh.nodes[0];
+  root.leftFirst = 0;
+  root.numPrimitives = numPrims;
+
+  std::mutex boundsMutex;
+  AABB rootBounds;
+  pool.parallelFor(numPrims, [&](u32 begin, u32 end) {
+    AABB bounds;
+    for (u32 i = begin; i < end; i++)
+      bounds.grow(primBounds[i]);
+
+    std::lock_guard lock(boundsMutex);
+    rootBounds.grow(bounds);
+  });
+  root.boundsMin = rootBounds.min;
+  root.boundsMax = rootBounds.max;
+
+  // ===== Top levels (on this thread) ====================== //
+
+  std::vector<Subtree> stack{{0, 0}};
+  std::vector<Subtree> subtrees;
+
+  while (!stack.empty()) {
+    auto [nodeIdx, depth] = stack.back();
+    stack.pop_back();
+
+    u32 count = bvh.nodes[nodeIdx].numPrimitives;
+    if (count < minSubtreePrimitives) {
+      subtrees.push_back({nodeIdx, depth});
+      continue;
+    }
+
+    if (split(nodeIdx, depth, count >= BVH_PARALLEL_BINNING_MIN_PRIMITIVES)) {
+      u32 leftIdx = bvh.nodes[nodeIdx].leftFirst;
+      stack.push_back({leftIdx, depth + 1});
+      stack.push_back({leftIdx + 1, depth + 1});
+    }
+  }
+
+  return subtrees;
+}
+
+void BinnedBuilder::finish() {
+  bvh.nodes.resize(numNodes);
+}
+
+void BinnedBuilder::buildSubtree(u32 nodeIdx, u32 depth) {
+  if (!split(nodeIdx, depth, false))
+    return;
+
+  u32 leftIdx = bvh.nodes[nodeIdx].leftFirst;
+  buildSubtree(leftIdx, depth + 1);
+  buildSubtree(leftIdx + 1, depth + 1);
+}
+
+// Turns the leaf into an interior node. Returns false if it should stay a leaf
+bool BinnedBuilder::split(u32 nodeIdx, u32 depth, bool parallel) {
+  BVHNode& node = bvh.nodes[nodeIdx];
+  u32 count = node.numPrimitives;
+
+  if (count <= 1 || depth >= BVH_MAX_DEPTH)
+    return false;
+
+  Bins bins;
+  bins.centroidBounds = calcCentroidBounds(node, parallel);
+  bins.numBins = std::clamp(count, 4u, BVH_NUM_BINS);
+
+  if (parallel) {
+    std::mutex binsMutex;
+    ThreadPool::get().parallelFor(count, [&](u32 begin, u32 end) {
+      Bins localBins;
+      localBins.centroidBounds = bins.centroidBounds;
+      localBins.numBins = bins.numBins;
+      fillBins(node, localBins, begin, end);
+
+      std::lock_guard lock(binsMutex);
+      for (int a = 0; a < 3; a++)
+        for (u32 b = 0; b < bins.numBins; b++) {
+          bins.bins[a][b].bounds.grow(localBins.bins[a][b].bounds);
+          bins.bins[a][b].count += localBins.bins[a][b].count;
+        }
+    });
+  } else {
+    fillBins(node, bins, 0, count);
+  }
+
+  Split best = findBestSplit(node, bins);
+  float leafCost = BVH_SAH_INTERSECTION_COST * count;
+
+  if (best.cost >= leafCost && count <= BVH_MAX_LEAF_PRIMITIVES)
+    return false;
+
+  u32* begin = bvh.primIndices.data() + node.leftFirst;
+  u32* end = begin + count;
+  u32 leftCount = 0;
+  AABB leftBounds, rightBounds;
+
+  if (best.axis >= 0) {
+    u32* mid = std::partition(begin, end, [&](u32 primIdx) {
+      return getBinIdx(centroids[primIdx], bins, best.axis) < best.bin;
+    });
+    leftCount = static_cast<u32>(mid - begin);
+    leftBounds = best.leftBounds;
+    rightBounds = best.rightBounds;
+  }
+
+  // All centroids are in one spot, but there are too many primitives for a leaf
+  if (leftCount == 0 || leftCount == count) {
+    leftCount = count / 2;
+
+    for (u32* p = begin; p < begin + leftCount; p++) leftBounds.grow(primBounds[*p]);
+    for (u32* p = begin + leftCount; p < end; p++)   rightBounds.grow(primBounds[*p]);
+  }
+
+  u32 leftIdx = numNodes.fetch_add(2);
+  BVHNode& left = bvh.nodes[leftIdx];
+  BVHNode& right = bvh.nodes[leftIdx + 1];
+
+  left.leftFirst = node.leftFirst;
+  left.numPrimitives = leftCount;
+  left.boundsMin = leftBounds.min;
+  left.boundsMax = leftBounds.max;
+
+  right.leftFirst = node.leftFirst + leftCount;
+  right.numPrimitives = count - leftCount;
+  right.boundsMin = rightBounds.min;
+  right.boundsMax = rightBounds.max;
+
+  node.leftFirst = leftIdx;
+  node.numPrimitives = 0;
+
+  return true;
+}
+
+AABB BinnedBuilder::calcCentroidBounds(const BVHNode& node, bool parallel) const {
+  const u32* indices = bvh.primIndices.data() + node.leftFirst;
+  AABB centroidBounds;
+
+  if (!parallel) {
+    for (u32 i = 0; i < node.numPrimitives; i++)
+      centroidBounds.grow(centroids[indices[i]]);
+
+    return centroidBounds;
+  }
+
+  std::mutex boundsMutex;
+  ThreadPool::get().parallelFor(node.numPrimitives, [&](u32 begin, u32 end) {
+    AABB bounds;
+    for (u32 i = begin; i < end; i++)
+      bounds.grow(centroids[indices[i]]);
+
+    std::lock_guard lock(boundsMutex);
+    centroidBounds.grow(bounds);
+  });
+
+  return centroidBounds;
+}
+
+void BinnedBuilder::fillBins(const BVHNode& node, Bins& bins, u32 begin, u32 end) const {
+  const u32* indices = bvh.primIndices.data() + node.leftFirst;
+
+  for (u32 i = begin; i < end; i++) {
+    u32 primIdx = indices[i];
+
+    for (int a = 0; a < 3; a++) {
+      Bin& bin = bins.bins[a][getBinIdx(centroids[primIdx], bins, a)];
+      bin.bounds.grow(primBounds[primIdx]);
+      bin.count++;
+    }
+  }
+}
+
+// Cost is relative to the parent's surface area: C_trav + C_isect * (A_l * N_l + A_r * N_r) / A_p
+BinnedBuilder::Split BinnedBuilder::findBestSplit(const BVHNode& node, const Bins& bins) const {
+  Split best;
+  float parentArea = AABB{node.boundsMin, node.boundsMax}.area();
+
+  if (parentArea <= 0.f) return best;
+
+  for (int a = 0; a < 3; a++) {
+    if (bins.centroidBounds.extent()[a] <= 0.f) continue;
+
+    const Bin* axisBins = bins.bins[a];
+    AABB rightBounds[BVH_NUM_BINS];
+    u32 rightCounts[BVH_NUM_BINS];
+
+    AABB bounds;
+    u32 count = 0;
+    for (u32 b = bins.numBins - 1; b > 0; b--) {
+      bounds.grow(axisBins[b].bounds);
+      count += axisBins[b].count;
+      rightBounds[b] = bounds;
+      rightCounts[b] = count;
+    }
+
+    bounds = AABB{};
+    count = 0;
+    for (u32 b = 1; b < bins.numBins; b++) {
+      bounds.grow(axisBins[b - 1].bounds);
+      count += axisBins[b - 1].count;
+
+      if (count == 0 || rightCounts[b] == 0) continue;
+
+      float cost = bounds.area() * count + rightBounds[b].area() * rightCounts[b];
+      if (cost < best.cost) {
+        best.axis = a;
+        best.bin = b;
+        best.cost = cost;
+        best.leftBounds = bounds;
+        best.rightBounds = rightBounds[b];
+      }
+    }
+  }
+
+  if (best.axis >= 0)
+    best.cost = BVH_SAH_TRAVERSAL_COST + BVH_SAH_INTERSECTION_COST * best.cost / parentArea;
+
+  return best;
+}
+
+u32 BinnedBuilder::getBinIdx(const vec3& centroid, const Bins& bins, int axis) const {
+  const AABB& centroidBounds = bins.centroidBounds;
+  float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+  if (extent <= 0.f) return 0;
+
+  float t = (centroid[axis] - centroidBounds.min[axis]) / extent;
+  return std::min(static_cast<u32>(t * bins.numBins), bins.numBins - 1);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+
+#include "BVH.hpp"
+
+#define BVH_NUM_BINS 32u // Maximum, small nodes use one bin per primitive
+#define BVH_TASK_MIN_PRIMITIVES 4096u               // Smaller subtrees are finished by a single task
+#define BVH_PARALLEL_BINNING_MIN_PRIMITIVES 65536u // Bigger nodes are binned by the whole pool
+
+// Binned SAH builder.
+// Large nodes near the root are split on the calling thread with binning spread over the thread pool,
+// the remaining subtrees are then built as independent tasks.
+class BinnedBuilder {
+public:
+  struct Subtree {
+    u32 nodeIdx;
+    u32 depth;
+  };
+
+  BinnedBuilder(BVH& bvh, const std::vector<AABB>& primBounds);
+
+  void build();
+
+  // The two halves of build(), for callers that schedule the subtrees themselves (see LazyBVH).
+  // Subtrees may be built concurrently and in any order, each exactly once. `primBounds` must outlive them
+  std::vector<Subtree> buildTopLevels(u32 minSubtreePrimitives = BVH_TASK_MIN_PRIMITIVES);
+  void buildSubtree(u32 nodeIdx, u32 depth);
+  void finish();
+
+private:
+  struct Bin {
+    AABB bounds;
+    u32 count = 0;
+  };
+
+  struct Bins {
+    Bin bins[3][BVH_NUM_BINS];
+    AABB centroidBounds;
+    u32 numBins = BVH_NUM_BINS;
+  };
+
+  struct Split {
+    int axis = -1;
+    u32 bin = 0;
+    float cost = FLT_MAX;
+    AABB leftBounds;
+    AABB rightBounds;
+  };
+
+  BVH& bvh;
+  const AABB* primBounds;
+  std::vector<vec3> centroids;
+  std::atomic<u32> numNodes = 0;
+
+  bool split(u32 nodeIdx, u32 depth, bool parallel);
+
+  AABB calcCentroidBounds(const BVHNode& node, bool parallel) const;
+  void fillBins(const BVHNode& node, Bins& bins, u32 begin, u32 end) const;
+  Split findBestSplit(const BVHNode& node, const Bins& bins) const;
+  u32 getBinIdx(const vec3& centroid, const Bins& bins, int axis) const;
+};
@@ -0,0 +1,114 @@
+#include "LazyBVH.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "../../engine/ThreadPool.hpp"
+
+void LazyBVH::build(std::vector<AABB>&& primBounds) {
+  bvh = BVH{};
+  bvh.builder = BVH_BUILDER_BINNED_SAH;
+  bvh.numPrimitives = static_cast<u32>(primBounds.size());
+  this->primBounds = std::move(primBounds);
+  stats.numSubtrees = 0;
+  stats.numBuiltSubtrees = 0;
+  stats.subtreeBuildTime = 0;
+  subtreeIndices.clear();
+  subtrees.reset();
+  builder.reset();
+
+  if (this->primBounds.empty()) return;
+
+  auto start = std::chrono::steady_clock::now();
+
+  builder = std::make_unique<BinnedBuilder>(bvh, this->primBounds);
+  std::vector<BinnedBuilder::Subtree> roots = builder->buildTopLevels(BVH_LAZY_SUBTREE_PRIMITIVES);
+
+  u32 numTopNodes = 0;
+  for (const BinnedBuilder::Subtree& root : roots)
+    numTopNodes = std::max(numTopNodes, root.nodeIdx + 1);
+
+  stats.numSubtrees = static_cast<u32>(roots.size());
+  subtrees = std::make_unique<Subtree[]>(roots.size());
+  subtreeIndices.assign(numTopNodes, BVH_INVALID_INDEX);
+
+  for (u32 i = 0; i < roots.size(); i++) {
+    subtrees[i].depth = roots[i].depth;
+    subtreeIndices[roots[i].nodeIdx] = i;
+  }
+
+  stats.topBuildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf(
+    "Lazy BVH: %.3f ms for the top levels, %u subtrees of less than %u primitives left\n",
+    stats.topBuildTime * 1e3, stats.numSubtrees, BVH_LAZY_SUBTREE_PRIMITIVES
+  );
+}
+
+void LazyBVH::build(const Triangle* triangles, u32 numTriangles) {
+  std::vector<AABB> bounds(numTriangles);
+
+  for (u32 i = 0; i < numTriangles; i++) {
+    bounds[i].grow(triangles[i].a);
+    bounds[i].grow(triangles[i].b);
+    bounds[i].grow(triangles[i].c);
+  }
+
+  build(std::move(bounds));
+}
+
+void LazyBVH::build(const std::vector<VertexPN>& vertices, const std::vector<uvec3>& indices) {
+  std::vector<AABB> bounds(indices.size());
+
+  for (size_t i = 0; i < indices.size(); i++) {
+    bounds[i].grow(vertices[indices[i].x].position);
+    bounds[i].grow(vertices[indices[i].y].position);
+    bounds[i].grow(vertices[indices[i].z].position);
+  }
+
+  build(std::move(bounds));
+}
+
+// NOTE: Must not run alongside intersect, the node storage is shrunk at the end
+void LazyBVH::finish() {
+  if (!builder) return;
+
+  ThreadPool& pool = ThreadPool::get();
+
+  for (u32 nodeIdx = 0; nodeIdx < subtreeIndices.size(); nodeIdx++)
+    if (subtreeIndices[nodeIdx] != BVH_INVALID_INDEX)
+      pool.submit([this, nodeIdx] { ensureBuilt(nodeIdx); });
+
+  pool.wait();
+
+  builder->finish();
+  builder.reset();
+  subtreeIndices.clear();
+  bvh.linkNodes();
+
+  bvh.stats.buildTime = stats.topBuildTime + stats.subtreeBuildTime * 1e-9;
+  bvh.stats.numNodes = static_cast<u32>(bvh.nodes.size());
+  bvh.stats.numReferences = static_cast<u32>(bvh.primIndices.size());
+  bvh.stats.sahCost = bvh.calcSAHCost();
+  bvh.stats.depth = bvh.calcDepth();
+
+  for (const BVHNode& node : bvh.nodes)
+    bvh.stats.numLeaves += node.isLeaf();
+
+  printf(
+    "Lazy BVH: finished, %.3f ms of subtree builds over all threads, %u nodes, depth %u, SAH cost %.3f\n",
+    stats.subtreeBuildTime * 1e-6, bvh.stats.numNodes, bvh.stats.depth, bvh.stats.sahCost
+  );
+}
+
+void LazyBVH::buildSubtree(u32 nodeIdx, Subtree& subtree) {
+  auto start = std::chrono::steady_clock::now();
+
+  builder->buildSubtree(nodeIdx, subtree.depth);
+
+  u64 nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  stats.subtreeBuildTime += nanoseconds;
+  stats.numBuiltSubtrees++;
+
+  subtree.state.store(BVH_LAZY_SUBTREE_BUILT, std::memory_order_release);
+}
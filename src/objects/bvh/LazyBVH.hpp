@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "BinnedBuilder.hpp"
+#include "../../engine/mesh/vertex.hpp"
+
+// Subtrees smaller than this are left for the first ray that reaches them
+#define BVH_LAZY_SUBTREE_PRIMITIVES BVH_PARALLEL_BINNING_MIN_PRIMITIVES
+
+#define BVH_LAZY_SUBTREE_UNBUILT  0u
+#define BVH_LAZY_SUBTREE_BUILDING 1u
+#define BVH_LAZY_SUBTREE_BUILT    2u
+
+struct LazyBVHStats {
+  u32 numSubtrees = 0;
+  std::atomic<u32> numBuiltSubtrees = 0;
+  double topBuildTime = 0.; // Seconds
+  std::atomic<u64> subtreeBuildTime = 0; // Nanoseconds, summed over every thread
+};
+
+// Binned SAH BVH for the CPU tracer where only the top levels are built up front. A subtree is built the first
+// time a traversal enters it: the first thread to flip its flag from unbuilt to building does the work, any other
+// thread reaching it meanwhile waits for the flag instead of building it twice.
+// Once every subtree is built (or after finish()) the tree is the same as an eager binned SAH build
+class LazyBVH {
+public:
+  BVH bvh;
+  LazyBVHStats stats;
+
+  void build(std::vector<AABB>&& primBounds);
+  void build(const Triangle* triangles, u32 numTriangles);
+  void build(const std::vector<VertexPN>& vertices, const std::vector<uvec3>& indices); // Straight from a welded mesh
+
+  // Builds the subtrees no ray has reached yet, on the thread pool
+  void finish();
+
+  bool isFinished() const { return stats.numBuiltSubtrees == stats.numSubtrees; }
+
+  // Same as BVH::intersect, safe to call from several threads at once
+  template<typename IntersectPrim>
+  void intersect(const Ray& ray, float& closestDst, IntersectPrim&& intersectPrim, BVHTraversalStats* stats = nullptr);
+
+private:
+  struct Subtree {
+    u32 depth;
+    std::atomic<u32> state = BVH_LAZY_SUBTREE_UNBUILT;
+  };
+
+  std::vector<AABB> primBounds; // Kept for the deferred subtrees
+  std::unique_ptr<BinnedBuilder> builder;
+  std::unique_ptr<Subtree[]> subtrees;
+  std::vector<u32> subtreeIndices; // Per node created by the top levels, BVH_INVALID_INDEX if not a subtree root
+
+  void ensureBuilt(u32 nodeIdx);
+  void buildSubtree(u32 nodeIdx, Subtree& subtree);
+};
+
+template<typename IntersectPrim>
+void LazyBVH::intersect(const Ray& ray, float& closestDst, IntersectPrim&& intersectPrim, BVHTraversalStats* stats) {
+  const std::vector<BVHNode>& nodes = bvh.nodes;
+  if (nodes.empty()) return;
+
+  vec3 invDir = 1.f / ray.dir;
+  u32 stack[BVH_MAX_DEPTH + 1];
+  int stackSize = 0;
+
+  if (intersect::rayBoundingBoxDst(ray, invDir, nodes[0].boundsMin, nodes[0].boundsMax) < closestDst)
+    stack[stackSize++] = 0;
+
+  while (stackSize > 0) {
+    u32 nodeIdx = stack[--stackSize];
+    ensureBuilt(nodeIdx);
+
+    const BVHNode& node = nodes[nodeIdx];
+    if (stats) {
+      stats->numNodes++;
+      stats->numBytes += sizeof(BVHNode);
+    }
+
+    if (node.isLeaf()) {
+      for (u32 i = 0; i < node.numPrimitives; i++)
+        intersectPrim(bvh.primIndices[node.leftFirst + i], closestDst);
+
+      if (stats) {
+        stats->numPrimitives += node.numPrimitives;
+        stats->numBytes += node.numPrimitives * sizeof(u32);
+      }
+    } else {
+      u32 childIdxA = node.leftFirst;
+      u32 childIdxB = node.leftFirst + 1;
+      float dstA = intersect::rayBoundingBoxDst(ray, invDir, nodes[childIdxA].boundsMin, nodes[childIdxA].boundsMax);
+      float dstB = intersect::rayBoundingBoxDst(ray, invDir, nodes[childIdxB].boundsMin, nodes[childIdxB].boundsMax);
+
+      if (stats) stats->numBytes += 2 * sizeof(BVHNode); // Child boxes
+
+      bool isNearestA = dstA <= dstB;
+      float dstNear = isNearestA ? dstA : dstB;
+      float dstFar  = isNearestA ? dstB : dstA;
+
+      if (dstFar  < closestDst) stack[stackSize++] = isNearestA ? childIdxB : childIdxA;
+      if (dstNear < closestDst) stack[stackSize++] = isNearestA ? childIdxA : childIdxB;
+    }
+  }
+}
+
+inline void LazyBVH::ensureBuilt(u32 nodeIdx) {
+  if (nodeIdx >= subtreeIndices.size() || subtreeIndices[nodeIdx] == BVH_INVALID_INDEX) return;
+
+  Subtree& subtree = subtrees[subtreeIndices[nodeIdx]];
+  u32 state = subtree.state.load(std::memory_order_acquire);
+  if (state == BVH_LAZY_SUBTREE_BUILT) return;
+
+  if (state == BVH_LAZY_SUBTREE_UNBUILT &&
+      subtree.state.compare_exchange_strong(state, BVH_LAZY_SUBTREE_BUILDING, std::memory_order_acquire)) {
+    buildSubtree(nodeIdx, subtree);
+    return;
+  }
+
+  // Another thread claimed it, its nodes are readable once the flag says so
+  while (subtree.state.load(std::memory_order_acquire) != BVH_LAZY_SUBTREE_BUILT)
+    std::this_thread::yield();
+}
@@ -0,0 +1,241 @@
+#include "LinearBuilder.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+#include "../../engine/RadixSort.hpp"
+#include "../../engine/Shader.hpp"
+#include "../../engine/SSBO.hpp"
+#include "../../engine/ThreadPool.hpp"
+
+// Spreads the lowest 10 bits so that there are two zero bits between each of them
+static u32 expandBits(u32 v) {
+  v = (v * 0x00010001u) & 0xff0000ffu;
+  v = (v * 0x00000101u) & 0x0f00f00fu;
+  v = (v * 0x00000011u) & 0xc30c30c3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+static u32 calcMortonCode(const vec3& p) {
+  uvec3 q = uvec3(glm::clamp(p * 1024.f, vec3(0.f), vec3(1023.f)));
+  return expandBits(q.x) << 2 | expandBits(q.y) << 1 | expandBits(q.z);
+}
+
+LinearBuilder::LinearBuilder(BVH& bvh, const std::vector<AABB>& primBounds, bool useGPU)
+  : bvh(bvh),
+    primBounds(primBounds),
+    useGPU(useGPU) {}
+
+void LinearBuilder::build() {
+  // Codes are relative to the bounds of the whole primitive set (MeshInfo bounds for a mesh)
+  for (const AABB& primBound : primBounds)
+    bounds.grow(primBound);
+
+  u32 numPrims = static_cast<u32>(primBounds.size());
+  bvh.primIndices.resize(numPrims);
+  std::iota(bvh.primIndices.begin(), bvh.primIndices.end(), 0u);
+
+  if (useGPU) {
+    calcOnGPU();
+  } else {
+    calcCodes();
+    radixSort(codes, bvh.primIndices, BVH_LBVH_MORTON_BITS);
+    calcRadixTree();
+  }
+
+  emitNodes();
+}
+
+// Computed here for both paths, a GPU division isn't correctly rounded and the codes would differ
+vec3 LinearBuilder::calcInvExtent() const {
+  return 1.f / glm::max(bounds.extent(), vec3(FLT_MIN));
+}
+
+void LinearBuilder::calcCodes() {
+  u32 numPrims = static_cast<u32>(primBounds.size());
+  vec3 invExtent = calcInvExtent();
+  codes.resize(numPrims);
+
+  ThreadPool::get().parallelFor(numPrims, [&](u32 begin, u32 end) {
+    for (u32 i = begin; i < end; i++)
+      codes[i] = calcMortonCode((primBounds[i].center() - bounds.min) * invExtent);
+  });
+}
+
+void LinearBuilder::calcRadixTree() {
+  int numPrims = static_cast<int>(codes.size());
+  radixNodes.resize(numPrims - 1);
+
+  // Length of the common prefix of the codes at i and j, equal codes are told apart by their index
+  auto delta = [&](int i, int j) {
+    if (j < 0 || j >= numPrims) return -1;
+    if (codes[i] == codes[j]) return 32 + std::countl_zero(static_cast<u32>(i ^ j));
+    return std::countl_zero(codes[i] ^ codes[j]);
+  };
+
+  ThreadPool::get().parallelFor(numPrims - 1, [&](u32 begin, u32 end) {
+    for (int i = begin; i < static_cast<int>(end); i++) {
+      // Direction of the range and its other end
+      int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+      int deltaMin = delta(i, i - d);
+
+      int lengthMax = 2;
+      while (delta(i, i + lengthMax * d) > deltaMin)
+        lengthMax *= 2;
+
+      int length = 0;
+      for (int t = lengthMax / 2; t >= 1; t /= 2)
+        if (delta(i, i + (length + t) * d) > deltaMin)
+          length += t;
+
+      int j = i + length * d;
+      int deltaNode = delta(i, j);
+
+      // Split position, the last index sharing more than deltaNode bits with i
+      int split = 0;
+      int divisor = 1;
+      int t;
+      do {
+        divisor *= 2;
+        t = (length + divisor - 1) / divisor;
+        if (delta(i, i + (split + t) * d) > deltaNode)
+          split += t;
+      } while (t > 1);
+
+      int gamma = i + split * d + std::min(d, 0);
+      u32 first = std::min(i, j);
+      u32 last = std::max(i, j);
+
+      RadixNode& node = radixNodes[i];
+      node.x = first == static_cast<u32>(gamma) ? BVH_LBVH_LEAF_BIT | gamma : gamma;
+      node.y = last == static_cast<u32>(gamma + 1) ? BVH_LBVH_LEAF_BIT | (gamma + 1) : gamma + 1;
+      node.z = first;
+      node.w = last;
+    }
+  });
+}
+
+void LinearBuilder::calcOnGPU() {
+  static Shader shader("lbvh.comp");
+  static const GLint passLoc = shader.getUniformLoc("u_pass");
+  static const GLint numPrimitivesLoc = shader.getUniformLoc("u_numPrimitives");
+  static const GLint boundsMinLoc = shader.getUniformLoc("u_boundsMin");
+  static const GLint invExtentLoc = shader.getUniformLoc("u_invExtent");
+
+  u32 numPrims = static_cast<u32>(primBounds.size());
+  std::vector<vec4> centers(numPrims);
+  for (u32 i = 0; i < numPrims; i++)
+    centers[i] = vec4(primBounds[i].center(), 0.f);
+
+  SSBO centersBuf(1);
+  SSBO codesBuf(1);
+  SSBO radixNodesBuf(1);
+  centersBuf.data(sizeof(vec4) * numPrims, centers.data(), GL_STREAM_DRAW);
+  codesBuf.data(sizeof(u32) * numPrims, nullptr);
+  radixNodesBuf.data(sizeof(RadixNode) * std::max(numPrims - 1, 1u), nullptr, GL_STREAM_READ);
+
+  centersBuf.bindBase(0);
+  codesBuf.bindBase(1);
+  radixNodesBuf.bindBase(2);
+
+  shader.use();
+  shader.setUniform1ui(numPrimitivesLoc, numPrims);
+  shader.setUniform3f(boundsMinLoc, bounds.min);
+  shader.setUniform3f(invExtentLoc, calcInvExtent());
+
+  // Pass 0: Morton codes
+  shader.setUniform1ui(passLoc, 0);
+  glDispatchCompute((numPrims + LBVH_COMP_WORK_GROUP_SIZE - 1) / LBVH_COMP_WORK_GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  codes.resize(numPrims);
+  codesBuf.read(sizeof(u32) * numPrims, codes.data());
+  radixSort(codes, bvh.primIndices, BVH_LBVH_MORTON_BITS);
+
+  // Pass 1: radix tree over the sorted codes
+  codesBuf.data(sizeof(u32) * numPrims, codes.data(), GL_STREAM_DRAW);
+  codesBuf.bindBase(1);
+
+  shader.setUniform1ui(passLoc, 1);
+  glDispatchCompute((numPrims + LBVH_COMP_WORK_GROUP_SIZE - 2) / LBVH_COMP_WORK_GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  radixNodes.resize(numPrims - 1);
+  radixNodesBuf.read(sizeof(RadixNode) * radixNodes.size(), radixNodes.data());
+
+  centersBuf.clear();
+  codesBuf.clear();
+  radixNodesBuf.clear();
+}
+
+// Walks the radix tree top-down and writes it in the BVH layout (siblings next to each other, children after
+// their parent). Small subtrees become leaves, their primitives are already contiguous in the sorted order.
+// Runs of equal codes make the radix tree as deep as they are long, so a range that could no longer end in small
+// leaves within BVH_MAX_DEPTH is halved by index instead, down to the leaves
+void LinearBuilder::emitNodes() {
+  u32 numPrims = static_cast<u32>(primBounds.size());
+  bvh.nodes.reserve(numPrims * 2 - 1);
+  bvh.nodes.emplace_back();
+
+  struct Task {
+    u32 ref; // Radix tree node, BVH_INVALID_INDEX once the range is split by index
+    u32 first;
+    u32 last;
+    u32 nodeIdx;
+    u32 depth;
+  };
+
+  auto makeTask = [&](u32 ref, u32 nodeIdx, u32 depth) {
+    if (ref & BVH_LBVH_LEAF_BIT)
+      return Task{ref, ref & ~BVH_LBVH_LEAF_BIT, ref & ~BVH_LBVH_LEAF_BIT, nodeIdx, depth};
+
+    return Task{ref, radixNodes[ref].z, radixNodes[ref].w, nodeIdx, depth};
+  };
+
+  std::vector<Task> tasks{numPrims == 1 ? makeTask(BVH_LBVH_LEAF_BIT, 0, 0) : makeTask(0, 0, 0)};
+
+  while (!tasks.empty()) {
+    Task task = tasks.back();
+    tasks.pop_back();
+
+    u32 count = task.last - task.first + 1;
+    if (count <= BVH_LBVH_MAX_LEAF_PRIMITIVES) {
+      bvh.nodes[task.nodeIdx].leftFirst = task.first;
+      bvh.nodes[task.nodeIdx].numPrimitives = count;
+      continue;
+    }
+
+    u32 leftIdx = static_cast<u32>(bvh.nodes.size());
+    bvh.nodes.emplace_back();
+    bvh.nodes.emplace_back();
+    bvh.nodes[task.nodeIdx].leftFirst = leftIdx;
+    bvh.nodes[task.nodeIdx].numPrimitives = 0;
+
+    u64 maxBalancedCount = static_cast<u64>(BVH_LBVH_MAX_LEAF_PRIMITIVES) << (BVH_MAX_DEPTH - task.depth - 1);
+    if (task.ref == BVH_INVALID_INDEX || count > maxBalancedCount) {
+      u32 middle = task.first + count / 2;
+      tasks.push_back({BVH_INVALID_INDEX, middle, task.last, leftIdx + 1, task.depth + 1});
+      tasks.push_back({BVH_INVALID_INDEX, task.first, middle - 1, leftIdx, task.depth + 1});
+      continue;
+    }
+
+    tasks.push_back(makeTask(radixNodes[task.ref].y, leftIdx + 1, task.depth + 1));
+    tasks.push_back(makeTask(radixNodes[task.ref].x, leftIdx, task.depth + 1));
+  }
+
+  // Bottom-up, children are stored after their parent
+  for (u32 i = static_cast<u32>(bvh.nodes.size()); i-- > 0;) {
+    BVHNode& node = bvh.nodes[i];
+
+    if (node.isLeaf()) {
+      bvh.updateNodeBounds(i, primBounds.data());
+    } else {
+      const BVHNode& left = bvh.nodes[node.leftFirst];
+      const BVHNode& right = bvh.nodes[node.leftFirst + 1];
+      node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+      node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+    }
+  }
+}
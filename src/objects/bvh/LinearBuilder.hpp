@@ -0,0 +1,35 @@
+#pragma once
+
+#include "BVH.hpp"
+
+#define BVH_LBVH_MORTON_BITS 30u // 10 per axis
+#define BVH_LBVH_MAX_LEAF_PRIMITIVES 4u
+#define BVH_LBVH_LEAF_BIT 0x80000000u // Child reference of the radix tree pointing at a primitive
+#define LBVH_COMP_WORK_GROUP_SIZE 64u // local_size_x of lbvh.comp
+
+// Linear BVH (Karras 2012): primitives are sorted along a Morton curve and every internal node of the
+// radix tree over the sorted codes is found independently. Fast to build, but the SAH cost is worse.
+// With `useGPU` the codes and the radix tree come from lbvh.comp, the sort stays on the CPU
+class LinearBuilder {
+public:
+  LinearBuilder(BVH& bvh, const std::vector<AABB>& primBounds, bool useGPU = false);
+
+  void build();
+
+private:
+  // Per internal node of the radix tree: left child, right child, first and last sorted primitive
+  using RadixNode = uvec4;
+
+  BVH& bvh;
+  const std::vector<AABB>& primBounds;
+  bool useGPU;
+  AABB bounds;
+  std::vector<u32> codes;
+  std::vector<RadixNode> radixNodes;
+
+  vec3 calcInvExtent() const;
+  void calcCodes();
+  void calcRadixTree();
+  void calcOnGPU();
+  void emitNodes();
+};
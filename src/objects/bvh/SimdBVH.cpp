@@ -0,0 +1,114 @@
+#include "SimdBVH.hpp"
+
+#include <bit>
+
+void SimdBVH::build(const WideBVH& wideBVH, const std::vector<VertexPN>& vertices, const std::vector<uvec3>& indices) {
+  if (!wideBVH.words.empty() && wideBVH.width != SIMD_WIDTH)
+    error("[SimdBVH::build] Expected an {}-wide BVH, got [{}]", SIMD_WIDTH, wideBVH.width);
+
+  nodes.assign(wideBVH.stats.numNodes, SimdBVHNode{});
+  packets.clear();
+
+  u32 nodeWords = wideBVH.getNodeWords();
+  u32 refsOffset = 4 + SIMD_WIDTH * 3 / 2;
+
+  for (u32 nodeIdx = 0; nodeIdx < nodes.size(); nodeIdx++) {
+    const u32* wideNode = &wideBVH.words[nodeIdx * nodeWords];
+    SimdBVHNode& node = nodes[nodeIdx];
+    node.numChildren = wideNode[3] >> 24;
+
+    for (u32 i = 0; i < node.numChildren; i++) {
+      node.childBounds.set(i, wideBVH.decodeChildBounds(nodeIdx, i));
+      u32 ref = wideNode[refsOffset + i];
+
+      if (!(ref & WIDE_BVH_LEAF_BIT)) {
+        node.childRefs[i] = ref;
+        continue;
+      }
+
+      u32 first = ref & WIDE_BVH_LEAF_MAX_FIRST;
+      u32 count = (ref >> 24) & WIDE_BVH_LEAF_MAX_PRIMITIVES;
+      u32 firstPacket = static_cast<u32>(packets.size());
+      u32 numPackets = (count + SIMD_WIDTH - 1) / SIMD_WIDTH;
+
+      if (firstPacket > WIDE_BVH_LEAF_MAX_FIRST)
+        error("[SimdBVH::build] Packet [{}] doesn't fit in a child reference", firstPacket);
+
+      packets.resize(firstPacket + numPackets);
+      for (u32 j = 0; j < count; j++) {
+        u32 triIdx = wideBVH.primIndices[first + j];
+        const uvec3& tri = indices[triIdx];
+        packets[firstPacket + j / SIMD_WIDTH].set(j % SIMD_WIDTH, triIdx, vertices[tri.x].position, vertices[tri.y].position, vertices[tri.z].position);
+      }
+
+      node.childRefs[i] = WIDE_BVH_LEAF_BIT | numPackets << 24 | firstPacket;
+    }
+  }
+}
+
+u32 SimdBVH::intersect(const Ray& ray, float& closestDst, vec2& barycentric, BVHTraversalStats* stats) const {
+  if (nodes.empty()) return BVH_INVALID_INDEX;
+
+  const simd::Kernels& kernels = simd::getKernels();
+  vec3 invDir = 1.f / ray.dir;
+  u32 hitTriIdx = BVH_INVALID_INDEX;
+  u32 stack[WIDE_BVH_STACK_SIZE];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0) {
+    u32 ref = stack[--stackSize];
+
+    if (ref & WIDE_BVH_LEAF_BIT) {
+      u32 first = ref & WIDE_BVH_LEAF_MAX_FIRST;
+      u32 count = (ref >> 24) & WIDE_BVH_LEAF_MAX_PRIMITIVES;
+
+      for (u32 i = first; i < first + count; i++) {
+        intersect::TriangleHit hit;
+        int lane = kernels.rayTriangles(ray, packets[i], closestDst, hit);
+
+        if (lane >= 0) {
+          closestDst = hit.dst;
+          hitTriIdx = packets[i].primIndices[lane];
+          barycentric = vec2(hit.u, hit.v);
+        }
+
+        if (stats) {
+          stats->numPrimitives += packets[i].numTriangles;
+          stats->numBytes += sizeof(TrianglePacket);
+        }
+      }
+      continue;
+    }
+
+    const SimdBVHNode& node = nodes[ref];
+    float dsts[SIMD_WIDTH];
+    u32 mask = kernels.rayBoxes(ray, invDir, node.childBounds, node.numChildren, closestDst, dsts);
+
+    if (stats) {
+      stats->numNodes++;
+      stats->numBytes += sizeof(SimdBVHNode);
+    }
+
+    // Sorted far to near, so the nearest child ends up on top of the stack
+    float hitDsts[SIMD_WIDTH];
+    u32 refs[SIMD_WIDTH];
+    u32 numHits = 0;
+
+    for (; mask; mask &= mask - 1) {
+      u32 i = std::countr_zero(mask);
+      u32 j = numHits++;
+      for (; j > 0 && hitDsts[j - 1] < dsts[i]; j--) {
+        hitDsts[j] = hitDsts[j - 1];
+        refs[j] = refs[j - 1];
+      }
+      hitDsts[j] = dsts[i];
+      refs[j] = node.childRefs[i];
+    }
+
+    for (u32 i = 0; i < numHits; i++)
+      stack[stackSize++] = refs[i];
+  }
+
+  return hitTriIdx;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "WideBVH.hpp"
+#include "../simd/simd.hpp"
+#include "../../engine/mesh/vertex.hpp"
+
+struct SimdBVHNode {
+  BoxPacket childBounds; // Decoded from the quantized boxes, so they still enclose the children
+  u32 childRefs[SIMD_WIDTH]; // Wide node index or a leaf (WIDE_BVH_LEAF_BIT) of triangle packets
+  u32 numChildren = 0;
+};
+
+// 8-wide BVH of a mesh for the CPU tracer, with the child boxes and the leaf triangles in SoA form so a node or a
+// leaf is one call of the simd kernels. Nodes are the ones of the mesh's WideBVH, a leaf of up to 8 triangles is one
+// packet. Leaf references use the WideBVH encoding but count and index packets
+struct SimdBVH {
+  std::vector<SimdBVHNode> nodes;
+  std::vector<TrianglePacket> packets;
+
+  void build(const WideBVH& wideBVH, const std::vector<VertexPN>& vertices, const std::vector<uvec3>& indices);
+
+  u32 getNumBytes() const { return static_cast<u32>(nodes.size() * sizeof(SimdBVHNode) + packets.size() * sizeof(TrianglePacket)); }
+
+  // Closest hit walk with the active simd kernels, same order as WideBVH::intersect.
+  // Returns the triangle hit closer than closestDst, or BVH_INVALID_INDEX
+  u32 intersect(const Ray& ray, float& closestDst, vec2& barycentric, BVHTraversalStats* stats = nullptr) const;
+};
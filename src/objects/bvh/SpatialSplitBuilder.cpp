@@ -0,0 +1,252 @@
+#include "SpatialSplitBuilder.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialSplitBuilder::SpatialSplitBuilder(BVH& bvh, const std::vector<AABB>& primBounds, const BVHSplitPrimitive& splitPrimitive)
+  : bvh(bvh),
+    primBounds(primBounds),
+    splitPrimitive(splitPrimitive) {}
+
+void SpatialSplitBuilder::build() {
+  u32 numPrims = static_cast<u32>(primBounds.size());
+  std::vector<Reference> refs(numPrims);
+  AABB rootBounds;
+
+  for (u32 i = 0; i < numPrims; i++) {
+    refs[i] = {primBounds[i], i};
+    rootBounds.grow(primBounds[i]);
+  }
+
+  rootArea = rootBounds.area();
+  numReferences = numPrims;
+  maxReferences = numPrims + static_cast<u32>(numPrims * BVH_SBVH_MAX_DUPLICATION);
+
+  bvh.primIndices.reserve(maxReferences);
+  bvh.nodes.reserve(maxReferences * 2 - 1);
+  bvh.nodes.emplace_back();
+
+  subdivide(0, refs, 0);
+}
+
+void SpatialSplitBuilder::subdivide(u32 nodeIdx, std::vector<Reference>& refs, u32 depth) {
+  AABB bounds;
+  for (const Reference& ref : refs)
+    bounds.grow(ref.bounds);
+
+  bvh.nodes[nodeIdx].boundsMin = bounds.min;
+  bvh.nodes[nodeIdx].boundsMax = bounds.max;
+
+  u32 count = static_cast<u32>(refs.size());
+  if (count <= 1 || depth >= BVH_MAX_DEPTH || bounds.area() <= 0.f) {
+    makeLeaf(nodeIdx, refs);
+    return;
+  }
+
+  float overlapArea;
+  Split split = findObjectSplit(refs, bounds, overlapArea);
+
+  if (overlapArea / rootArea > BVH_SBVH_MIN_OVERLAP && numReferences < maxReferences) {
+    Split spatialSplit = findSpatialSplit(refs, bounds);
+    if (spatialSplit.cost < split.cost)
+      split = spatialSplit;
+  }
+
+  float leafCost = BVH_SAH_INTERSECTION_COST * count;
+  if (split.cost >= leafCost && count <= BVH_MAX_LEAF_PRIMITIVES) {
+    makeLeaf(nodeIdx, refs);
+    return;
+  }
+
+  std::vector<Reference> left, right;
+  if (split.isSpatial)
+    performSpatialSplit(refs, split, left, right);
+  else
+    performObjectSplit(refs, split, left, right);
+
+  // Every reference straddled the plane and the budget ran out, so halve them instead
+  if (left.empty() || right.empty()) {
+    refs = left.empty() ? std::move(right) : std::move(left);
+    sortByAxis(refs, split.axis);
+    right.assign(refs.begin() + count / 2, refs.end());
+    left.assign(refs.begin(), refs.begin() + count / 2);
+  }
+
+  std::vector<Reference>().swap(refs);
+
+  u32 leftIdx = static_cast<u32>(bvh.nodes.size());
+  bvh.nodes.emplace_back();
+  bvh.nodes.emplace_back();
+  bvh.nodes[nodeIdx].leftFirst = leftIdx;
+  bvh.nodes[nodeIdx].numPrimitives = 0;
+
+  subdivide(leftIdx, left, depth + 1);
+  subdivide(leftIdx + 1, right, depth + 1);
+}
+
+void SpatialSplitBuilder::makeLeaf(u32 nodeIdx, const std::vector<Reference>& refs) {
+  BVHNode& node = bvh.nodes[nodeIdx];
+  node.leftFirst = static_cast<u32>(bvh.primIndices.size());
+  node.numPrimitives = static_cast<u32>(refs.size());
+
+  for (const Reference& ref : refs)
+    bvh.primIndices.push_back(ref.primIdx);
+}
+
+// Same as SweepBuilder::findBestSplit, over the references
+SpatialSplitBuilder::Split SpatialSplitBuilder::findObjectSplit(std::vector<Reference>& refs, const AABB& bounds, float& overlapArea) {
+  u32 count = static_cast<u32>(refs.size());
+  float parentArea = bounds.area();
+  std::vector<AABB> rightBounds(count);
+  Split best;
+
+  overlapArea = 0.f;
+
+  for (int axis = 0; axis < 3; axis++) {
+    sortByAxis(refs, axis);
+
+    AABB right;
+    for (u32 i = count - 1; i > 0; i--) {
+      right.grow(refs[i].bounds);
+      rightBounds[i] = right;
+    }
+
+    AABB left;
+    for (u32 i = 1; i < count; i++) {
+      left.grow(refs[i - 1].bounds);
+      float cost = left.area() * i + rightBounds[i].area() * (count - i);
+
+      if (cost < best.cost) {
+        best.cost = cost;
+        best.axis = axis;
+        best.leftCount = i;
+        overlapArea = left.intersection(rightBounds[i]).area();
+      }
+    }
+  }
+
+  best.cost = BVH_SAH_TRAVERSAL_COST + BVH_SAH_INTERSECTION_COST * best.cost / parentArea;
+  return best;
+}
+
+SpatialSplitBuilder::Split SpatialSplitBuilder::findSpatialSplit(const std::vector<Reference>& refs, const AABB& bounds) {
+  struct Bin {
+    AABB bounds;
+    u32 numEntries = 0; // References starting in the bin
+    u32 numExits = 0;   // References ending in the bin
+  };
+
+  float parentArea = bounds.area();
+  Split best;
+  best.isSpatial = true;
+
+  for (int axis = 0; axis < 3; axis++) {
+    float boundsMin = bounds.min[axis];
+    float binSize = (bounds.max[axis] - boundsMin) / BVH_SBVH_NUM_BINS;
+    if (binSize <= 0.f) continue;
+
+    Bin bins[BVH_SBVH_NUM_BINS];
+    auto binIndex = [&](float p) {
+      return std::clamp(static_cast<int>((p - boundsMin) / binSize), 0, static_cast<int>(BVH_SBVH_NUM_BINS) - 1);
+    };
+
+    // Chop every reference into the bins it spans
+    for (const Reference& ref : refs) {
+      int firstBin = binIndex(ref.bounds.min[axis]);
+      int lastBin = binIndex(ref.bounds.max[axis]);
+      Reference rest = ref;
+
+      for (int b = firstBin; b < lastBin; b++) {
+        Reference leftPart, rightPart;
+        splitReference(rest, axis, boundsMin + binSize * (b + 1), leftPart, rightPart);
+        bins[b].bounds.grow(leftPart.bounds);
+        rest = rightPart;
+      }
+
+      bins[lastBin].bounds.grow(rest.bounds);
+      bins[firstBin].numEntries++;
+      bins[lastBin].numExits++;
+    }
+
+    AABB rightBounds[BVH_SBVH_NUM_BINS];
+    u32 rightCounts[BVH_SBVH_NUM_BINS];
+    AABB right;
+    u32 rightCount = 0;
+
+    for (u32 i = BVH_SBVH_NUM_BINS - 1; i > 0; i--) {
+      right.grow(bins[i].bounds);
+      rightCount += bins[i].numExits;
+      rightBounds[i] = right;
+      rightCounts[i] = rightCount;
+    }
+
+    AABB left;
+    u32 leftCount = 0;
+
+    for (u32 i = 1; i < BVH_SBVH_NUM_BINS; i++) {
+      left.grow(bins[i - 1].bounds);
+      leftCount += bins[i - 1].numEntries;
+      if (leftCount == 0 || rightCounts[i] == 0) continue;
+
+      float cost = left.area() * leftCount + rightBounds[i].area() * rightCounts[i];
+
+      if (cost < best.cost) {
+        best.cost = cost;
+        best.axis = axis;
+        best.pos = boundsMin + binSize * i;
+      }
+    }
+  }
+
+  if (best.cost < FLT_MAX)
+    best.cost = BVH_SAH_TRAVERSAL_COST + BVH_SAH_INTERSECTION_COST * best.cost / parentArea;
+
+  return best;
+}
+
+void SpatialSplitBuilder::performObjectSplit(std::vector<Reference>& refs, const Split& split, std::vector<Reference>& left, std::vector<Reference>& right) {
+  sortByAxis(refs, split.axis);
+  left.assign(refs.begin(), refs.begin() + split.leftCount);
+  right.assign(refs.begin() + split.leftCount, refs.end());
+}
+
+void SpatialSplitBuilder::performSpatialSplit(std::vector<Reference>& refs, const Split& split, std::vector<Reference>& left, std::vector<Reference>& right) {
+  for (const Reference& ref : refs) {
+    if (ref.bounds.max[split.axis] <= split.pos) {
+      left.push_back(ref);
+    } else if (ref.bounds.min[split.axis] >= split.pos) {
+      right.push_back(ref);
+    } else if (numReferences < maxReferences) {
+      Reference leftPart, rightPart;
+      splitReference(ref, split.axis, split.pos, leftPart, rightPart);
+
+      if (leftPart.bounds.isValid()) left.push_back(leftPart);
+      if (rightPart.bounds.isValid()) right.push_back(rightPart);
+      numReferences += leftPart.bounds.isValid() && rightPart.bounds.isValid();
+    } else {
+      // Out of budget, the whole reference goes to the side holding its center
+      (ref.bounds.center()[split.axis] < split.pos ? left : right).push_back(ref);
+    }
+  }
+}
+
+void SpatialSplitBuilder::splitReference(const Reference& ref, int axis, float pos, Reference& left, Reference& right) const {
+  left.primIdx = right.primIdx = ref.primIdx;
+
+  if (splitPrimitive) {
+    splitPrimitive(ref.primIdx, ref.bounds, axis, pos, left.bounds, right.bounds);
+  } else {
+    left.bounds = right.bounds = ref.bounds;
+    left.bounds.max[axis] = pos;
+    right.bounds.min[axis] = pos;
+  }
+}
+
+void SpatialSplitBuilder::sortByAxis(std::vector<Reference>& refs, int axis) const {
+  // Ties are broken by index so that the same axis always gives the same order
+  std::sort(refs.begin(), refs.end(), [axis](const Reference& a, const Reference& b) {
+    float ca = a.bounds.min[axis] + a.bounds.max[axis];
+    float cb = b.bounds.min[axis] + b.bounds.max[axis];
+    return ca < cb || (ca == cb && a.primIdx < b.primIdx);
+  });
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "BVH.hpp"
+
+#define BVH_SBVH_NUM_BINS 32u
+
+// Spatial splits are only tried where the children of the best object split overlap by more than
+// this fraction of the root area (alpha in Stich et al. 2009)
+#define BVH_SBVH_MIN_OVERLAP 1e-5f
+
+// Spatial split BVH (SBVH): besides object splits, a primitive reference may be cut by a plane and go to both children.
+// Once the number of references grows by BVH_SBVH_MAX_DUPLICATION, straddling references stop being split
+class SpatialSplitBuilder {
+public:
+  SpatialSplitBuilder(BVH& bvh, const std::vector<AABB>& primBounds, const BVHSplitPrimitive& splitPrimitive);
+
+  void build();
+
+private:
+  struct Reference {
+    AABB bounds;
+    u32 primIdx;
+  };
+
+  struct Split {
+    float cost = FLT_MAX;
+    int axis = 0;
+    u32 leftCount = 0; // Object split: references sorted along the axis before it go to the left
+    float pos = 0.f;   // Spatial split: plane position
+    bool isSpatial = false;
+  };
+
+  BVH& bvh;
+  const std::vector<AABB>& primBounds;
+  const BVHSplitPrimitive& splitPrimitive;
+  float rootArea = 0.f;
+  u32 maxReferences = 0;
+  u32 numReferences = 0;
+
+  void subdivide(u32 nodeIdx, std::vector<Reference>& refs, u32 depth);
+  void makeLeaf(u32 nodeIdx, const std::vector<Reference>& refs);
+
+  Split findObjectSplit(std::vector<Reference>& refs, const AABB& bounds, float& overlapArea);
+  Split findSpatialSplit(const std::vector<Reference>& refs, const AABB& bounds);
+  void performObjectSplit(std::vector<Reference>& refs, const Split& split, std::vector<Reference>& left, std::vector<Reference>& right);
+  void performSpatialSplit(std::vector<Reference>& refs, const Split& split, std::vector<Reference>& left, std::vector<Reference>& right);
+
+  void splitReference(const Reference& ref, int axis, float pos, Reference& left, Reference& right) const;
+  void sortByAxis(std::vector<Reference>& refs, int axis) const;
+};
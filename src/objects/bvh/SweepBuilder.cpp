@@ -0,0 +1,121 @@
+#include "SweepBuilder.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+SweepBuilder::SweepBuilder(BVH& bvh, const std::vector<AABB>& primBounds)
+  : bvh(bvh),
+    primBounds(primBounds.data()),
+    centroids(primBounds.size())
+{
+  for (size_t i = 0; i < primBounds.size(); i++)
+    centroids[i] = primBounds[i].center();
+}
+
+void SweepBuilder::build() {
+  u32 numPrims = static_cast<u32>(centroids.size());
+
+  bvh.primIndices.resize(numPrims);
+  std::iota(bvh.primIndices.begin(), bvh.primIndices.end(), 0u);
+
+  // Binary tree with N leaves at most has 2N - 1 nodes, so references to nodes stay valid
+  bvh.nodes.reserve(numPrims * 2 - 1);
+
+  BVHNode root;
+  root.leftFirst = 0;
+  root.numPrimitives = numPrims;
+  bvh.nodes.push_back(root);
+
+  bvh.updateNodeBounds(0, primBounds);
+  subdivide(0, 0);
+}
+
+void SweepBuilder::subdivide(u32 nodeIdx, u32 depth) {
+  BVHNode& node = bvh.nodes[nodeIdx];
+
+  if (node.numPrimitives <= 1 || depth >= BVH_MAX_DEPTH)
+    return;
+
+  int axis;
+  u32 leftCount;
+  float splitCost = findBestSplit(node, axis, leftCount);
+  float leafCost = BVH_SAH_INTERSECTION_COST * node.numPrimitives;
+
+  if (splitCost >= leafCost && node.numPrimitives <= BVH_MAX_LEAF_PRIMITIVES)
+    return;
+
+  sortByAxis(node, axis);
+
+  u32 leftIdx = static_cast<u32>(bvh.nodes.size());
+
+  BVHNode left;
+  left.leftFirst = node.leftFirst;
+  left.numPrimitives = leftCount;
+
+  BVHNode right;
+  right.leftFirst = node.leftFirst + leftCount;
+  right.numPrimitives = node.numPrimitives - leftCount;
+
+  bvh.nodes.push_back(left);
+  bvh.nodes.push_back(right);
+
+  node.leftFirst = leftIdx;
+  node.numPrimitives = 0;
+
+  bvh.updateNodeBounds(leftIdx, primBounds);
+  bvh.updateNodeBounds(leftIdx + 1, primBounds);
+
+  subdivide(leftIdx, depth + 1);
+  subdivide(leftIdx + 1, depth + 1);
+}
+
+// Returns the cost relative to the parent's surface area: C_trav + C_isect * (A_l * N_l + A_r * N_r) / A_p
+float SweepBuilder::findBestSplit(const BVHNode& node, int& axis, u32& leftCount) {
+  u32 count = node.numPrimitives;
+  float parentArea = AABB{node.boundsMin, node.boundsMax}.area();
+  float bestCost = FLT_MAX;
+
+  axis = 0;
+  leftCount = count / 2;
+
+  if (parentArea <= 0.f) return bestCost;
+
+  rightAreas.resize(count);
+
+  for (int a = 0; a < 3; a++) {
+    sortByAxis(node, a);
+    const u32* indices = bvh.primIndices.data() + node.leftFirst;
+
+    AABB rightBounds;
+    for (u32 i = count - 1; i > 0; i--) {
+      rightBounds.grow(primBounds[indices[i]]);
+      rightAreas[i] = rightBounds.area();
+    }
+
+    AABB leftBounds;
+    for (u32 i = 1; i < count; i++) {
+      leftBounds.grow(primBounds[indices[i - 1]]);
+      float cost = leftBounds.area() * i + rightAreas[i] * (count - i);
+
+      if (cost < bestCost) {
+        bestCost = cost;
+        axis = a;
+        leftCount = i;
+      }
+    }
+  }
+
+  return BVH_SAH_TRAVERSAL_COST + BVH_SAH_INTERSECTION_COST * bestCost / parentArea;
+}
+
+void SweepBuilder::sortByAxis(const BVHNode& node, int axis) {
+  u32* begin = bvh.primIndices.data() + node.leftFirst;
+  u32* end = begin + node.numPrimitives;
+
+  // Ties are broken by index so that the same axis always gives the same order
+  std::sort(begin, end, [&](u32 i, u32 j) {
+    float ci = centroids[i][axis];
+    float cj = centroids[j][axis];
+    return ci < cj || (ci == cj && i < j);
+  });
+}
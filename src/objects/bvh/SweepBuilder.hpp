@@ -0,0 +1,21 @@
+#pragma once
+
+#include "BVH.hpp"
+
+// Exact SAH: every axis is sorted by centroids and all N - 1 split positions are evaluated
+class SweepBuilder {
+public:
+  SweepBuilder(BVH& bvh, const std::vector<AABB>& primBounds);
+
+  void build();
+
+private:
+  BVH& bvh;
+  const AABB* primBounds;
+  std::vector<vec3> centroids;
+  std::vector<float> rightAreas;
+
+  void subdivide(u32 nodeIdx, u32 depth);
+  float findBestSplit(const BVHNode& node, int& axis, u32& leftCount);
+  void sortByAxis(const BVHNode& node, int axis);
+};
@@ -0,0 +1,185 @@
+#include "WideBVH.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+static float exponentToScale(u32 biasedExponent) {
+  return std::bit_cast<float>(biasedExponent << 23);
+}
+
+// Smallest power of two (as a biased float exponent) such that 255 steps cover the extent
+static u32 calcExponent(float extent) {
+  int e = static_cast<int>(std::ceil(std::log2(std::max(extent / 255.f, FLT_MIN))));
+  return static_cast<u32>(std::clamp(e + 127, 1, 254));
+}
+
+void WideBVH::collapse(const BVH& bvh, u32 width) {
+  if (width != 4 && width != 8)
+    error("[WideBVH::collapse] Unsupported width [{}]", width);
+
+  words.clear();
+  primIndices = bvh.primIndices;
+  stats = WideBVHStats{};
+  this->width = width;
+
+  if (bvh.nodes.empty()) return;
+
+  auto start = std::chrono::steady_clock::now();
+
+  struct Task {
+    u32 wideIdx;
+    u32 binaryIdx;
+    u32 depth;
+    u32 stackSize;
+  };
+
+  std::vector<Task> tasks{{0, 0, 0, 1}};
+  stats.numNodes = 1;
+  words.resize(getNodeWords());
+
+  while (!tasks.empty()) {
+    Task task = tasks.back();
+    tasks.pop_back();
+
+    stats.depth = std::max(stats.depth, task.depth);
+    stats.maxStackSize = std::max(stats.maxStackSize, task.stackSize);
+
+    // Open the largest interior child until the node is full
+    std::vector<u32> children;
+    if (bvh.nodes[task.binaryIdx].isLeaf())
+      children.push_back(task.binaryIdx); // Only the root can be a leaf
+    else
+      children = {bvh.nodes[task.binaryIdx].leftFirst, bvh.nodes[task.binaryIdx].leftFirst + 1};
+
+    while (children.size() < width) {
+      int bestIdx = -1;
+      float bestArea = -1.f;
+
+      for (size_t i = 0; i < children.size(); i++) {
+        const BVHNode& child = bvh.nodes[children[i]];
+        float area = AABB{child.boundsMin, child.boundsMax}.area();
+
+        if (!child.isLeaf() && area > bestArea) {
+          bestIdx = static_cast<int>(i);
+          bestArea = area;
+        }
+      }
+
+      if (bestIdx < 0) break;
+
+      u32 leftIdx = bvh.nodes[children[bestIdx]].leftFirst;
+      children[bestIdx] = leftIdx;
+      children.push_back(leftIdx + 1);
+    }
+
+    std::vector<u32> childRefs(children.size());
+    for (size_t i = 0; i < children.size(); i++) {
+      const BVHNode& child = bvh.nodes[children[i]];
+
+      if (child.isLeaf()) {
+        if (child.leftFirst > WIDE_BVH_LEAF_MAX_FIRST || child.numPrimitives > WIDE_BVH_LEAF_MAX_PRIMITIVES)
+          error("[WideBVH::collapse] Leaf [{}, {}] doesn't fit in a child reference", child.leftFirst, child.numPrimitives);
+
+        childRefs[i] = WIDE_BVH_LEAF_BIT | child.numPrimitives << 24 | child.leftFirst;
+      } else {
+        childRefs[i] = stats.numNodes++;
+        words.resize(stats.numNodes * getNodeWords());
+
+        // Siblings pushed before the child stay on the traversal stack while it's walked
+        u32 stackSize = task.stackSize - 1 + static_cast<u32>(children.size());
+        tasks.push_back({childRefs[i], children[i], task.depth + 1, stackSize});
+      }
+    }
+
+    writeNode(task.wideIdx, bvh, children, childRefs);
+  }
+
+  if (stats.maxStackSize > WIDE_BVH_STACK_SIZE)
+    error("[WideBVH::collapse] Traversal stack [{}] exceeds the limit [{}]", stats.maxStackSize, WIDE_BVH_STACK_SIZE);
+
+  stats.collapseTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf(
+    "Wide BVH: %.3f ms, %u-wide, %u nodes (%u bytes), depth %u, max stack %u\n",
+    stats.collapseTime * 1e3, width, stats.numNodes, getNumBytes(), stats.depth, stats.maxStackSize
+  );
+}
+
+void WideBVH::writeNode(u32 nodeIdx, const BVH& bvh, const std::vector<u32>& children, const std::vector<u32>& childRefs) {
+  u32* node = &words[nodeIdx * getNodeWords()];
+  u8* childBytes = reinterpret_cast<u8*>(node + 4);
+  u32 numChildren = static_cast<u32>(children.size());
+
+  AABB bounds;
+  for (u32 childIdx : children)
+    bounds.grow(AABB{bvh.nodes[childIdx].boundsMin, bvh.nodes[childIdx].boundsMax});
+
+  vec3 extent = bounds.extent();
+  u32 exponents[3] = {calcExponent(extent.x), calcExponent(extent.y), calcExponent(extent.z)};
+
+  node[0] = std::bit_cast<u32>(bounds.min.x);
+  node[1] = std::bit_cast<u32>(bounds.min.y);
+  node[2] = std::bit_cast<u32>(bounds.min.z);
+  node[3] = exponents[0] | exponents[1] << 8 | exponents[2] << 16 | numChildren << 24;
+
+  for (u32 i = 0; i < numChildren; i++) {
+    const BVHNode& child = bvh.nodes[children[i]];
+
+    for (int axis = 0; axis < 3; axis++) {
+      float origin = bounds.min[axis];
+      float scale = exponentToScale(exponents[axis]);
+      int qMin = static_cast<int>(std::floor((child.boundsMin[axis] - origin) / scale));
+      int qMax = static_cast<int>(std::ceil((child.boundsMax[axis] - origin) / scale));
+      qMin = std::clamp(qMin, 0, 255);
+      qMax = std::clamp(qMax, 0, 255);
+
+      // The division rounds, make sure the decoded box still encloses the child
+      while (qMin > 0 && origin + qMin * scale > child.boundsMin[axis]) qMin--;
+      while (qMax < 255 && origin + qMax * scale < child.boundsMax[axis]) qMax++;
+
+      childBytes[axis * width + i] = static_cast<u8>(qMin);
+      childBytes[(axis + 3) * width + i] = static_cast<u8>(qMax);
+    }
+  }
+
+  std::copy(childRefs.begin(), childRefs.end(), node + 4 + width * 3 / 2);
+}
+
+AABB WideBVH::decodeChildBounds(u32 nodeIdx, u32 childIdx) const {
+  const u32* node = &words[nodeIdx * getNodeWords()];
+  const u8* childBytes = reinterpret_cast<const u8*>(node + 4);
+  AABB bounds;
+
+  for (int axis = 0; axis < 3; axis++) {
+    float origin = std::bit_cast<float>(node[axis]);
+    float scale = exponentToScale((node[3] >> (axis * 8)) & 0xff);
+    bounds.min[axis] = origin + childBytes[axis * width + childIdx] * scale;
+    bounds.max[axis] = origin + childBytes[(axis + 3) * width + childIdx] * scale;
+  }
+
+  return bounds;
+}
+
+void WideBVH::copyTo(u32* dst, u32 nodeOffset, u32 primOffset) const {
+  u32 nodeWords = getNodeWords();
+  u32 refsOffset = 4 + width * 3 / 2;
+
+  for (u32 i = 0; i < stats.numNodes; i++) {
+    const u32* node = &words[i * nodeWords];
+    u32* dstNode = dst + (i + nodeOffset) * nodeWords;
+    u32 numChildren = node[3] >> 24;
+
+    std::copy(node, node + nodeWords, dstNode);
+
+    for (u32 j = 0; j < numChildren; j++) {
+      u32& ref = dstNode[refsOffset + j];
+
+      if ((ref & WIDE_BVH_LEAF_BIT) && (ref & WIDE_BVH_LEAF_MAX_FIRST) + primOffset > WIDE_BVH_LEAF_MAX_FIRST)
+        error("[WideBVH::copyTo] Primitive offset [{}] doesn't fit in a child reference", primOffset);
+
+      ref += ref & WIDE_BVH_LEAF_BIT ? primOffset : nodeOffset;
+    }
+  }
+}
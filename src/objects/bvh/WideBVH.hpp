@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+
+#include "BVH.hpp"
+
+#define WIDE_BVH_MAX_WIDTH 8u
+
+// NOTE: Must match in rt.frag
+#define WIDE_BVH_WIDTH 8u // Layout of the GPU copy, 4 or 8
+#define WIDE_BVH_STACK_SIZE 64u
+#define WIDE_BVH_NODE_WORDS(width) ((4u + (width) * 5u / 2u + 3u) & ~3u) // Padded to uvec4
+#define WIDE_BVH_LEAF_BIT 0x80000000u
+
+// Child reference of a leaf: first primitive index (24 bits) | number of primitives (7 bits) << 24 | leaf bit
+#define WIDE_BVH_LEAF_MAX_FIRST 0x00ffffffu
+#define WIDE_BVH_LEAF_MAX_PRIMITIVES 0x7fu
+
+struct WideBVHStats {
+  u32 numNodes = 0;
+  u32 depth = 0;
+  u32 maxStackSize = 0; // Worst case stack use of a closest hit traversal
+  double collapseTime = 0.; // Seconds
+};
+
+// Collapsed binary BVH with up to 4 or 8 children per node and child boxes quantized to 8 bits.
+// A node is packed into 32-bit words:
+//   [0, 3)                        origin (the node bounds min)
+//   [3]                           exponents of the child grid per axis (biased as in floats, 8 bits each) | numChildren << 24
+//   [4, 4 + width * 3 / 2)        child bytes: min x, min y, min z, max x, max y, max z (width bytes each)
+//   [4 + width * 3 / 2, ... + w)  child references: wide node index or a packed leaf (WIDE_BVH_LEAF_BIT)
+// Leaves keep pointing into the primitive indices of the source BVH
+struct WideBVH {
+  std::vector<u32> words;
+  std::vector<u32> primIndices;
+  WideBVHStats stats;
+  u32 width = WIDE_BVH_WIDTH;
+
+  void collapse(const BVH& bvh, u32 width = WIDE_BVH_WIDTH);
+
+  u32 getNodeWords() const { return WIDE_BVH_NODE_WORDS(width); }
+  u32 getNumBytes() const { return static_cast<u32>(words.size() * sizeof(u32)); }
+
+  // Copies the nodes to a GPU buffer with child nodes moved by `nodeOffset` and leaves by `primOffset`
+  void copyTo(u32* dst, u32 nodeOffset, u32 primOffset) const;
+
+  // Closest hit walk, same order as traverseWideBLAS in rt.frag. See BVH::intersect
+  template<typename IntersectPrim>
+  void intersect(const Ray& ray, float& closestDst, IntersectPrim&& intersectPrim, BVHTraversalStats* stats = nullptr) const;
+
+private:
+  friend struct SimdBVH;
+
+  void writeNode(u32 nodeIdx, const BVH& bvh, const std::vector<u32>& children, const std::vector<u32>& childRefs);
+  AABB decodeChildBounds(u32 nodeIdx, u32 childIdx) const;
+};
+
+template<typename IntersectPrim>
+void WideBVH::intersect(const Ray& ray, float& closestDst, IntersectPrim&& intersectPrim, BVHTraversalStats* stats) const {
+  if (words.empty()) return;
+
+  vec3 invDir = 1.f / ray.dir;
+  u32 nodeWords = getNodeWords();
+  u32 stack[WIDE_BVH_STACK_SIZE];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0) {
+    u32 ref = stack[--stackSize];
+
+    if (ref & WIDE_BVH_LEAF_BIT) {
+      u32 first = ref & WIDE_BVH_LEAF_MAX_FIRST;
+      u32 count = (ref >> 24) & WIDE_BVH_LEAF_MAX_PRIMITIVES;
+
+      for (u32 i = 0; i < count; i++)
+        intersectPrim(primIndices[first + i], closestDst);
+
+      if (stats) {
+        stats->numPrimitives += count;
+        stats->numBytes += count * sizeof(u32);
+      }
+      continue;
+    }
+
+    const u32* node = &words[ref * nodeWords];
+    u32 numChildren = node[3] >> 24;
+    const u32* childRefs = node + 4 + width * 3 / 2;
+
+    if (stats) {
+      stats->numNodes++;
+      stats->numBytes += nodeWords * sizeof(u32);
+    }
+
+    // Sorted far to near, so the nearest child ends up on top of the stack
+    float dsts[WIDE_BVH_MAX_WIDTH];
+    u32 refs[WIDE_BVH_MAX_WIDTH];
+    u32 numHits = 0;
+
+    for (u32 i = 0; i < numChildren; i++) {
+      AABB bounds = decodeChildBounds(ref, i);
+      float dst = intersect::rayBoundingBoxDst(ray, invDir, bounds.min, bounds.max);
+      if (dst >= closestDst) continue;
+
+      u32 j = numHits++;
+      for (; j > 0 && dsts[j - 1] < dst; j--) {
+        dsts[j] = dsts[j - 1];
+        refs[j] = refs[j - 1];
+      }
+      dsts[j] = dst;
+      refs[j] = childRefs[i];
+    }
+
+    for (u32 i = 0; i < numHits; i++)
+      stack[stackSize++] = refs[i];
+  }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <bit>
+
+#include "Ray.hpp"
+#include "Triangle.hpp"
+
+// Injected in rt.frag by scene::defineShaderConstants
+#define RAY_BOX_FAR_SCALE 1.0000004f // 1 + 2 * gamma(3)
+
+// CPU versions of the intersection routines in rt.frag
+namespace intersect {
+
+struct TriangleHit {
+  bool didHit = false;
+  float dst = FLT_MAX;
+  float u = 0.f; // Barycentric weights of b and c
+  float v = 0.f;
+};
+
+// Triangle given by a vertex, the two edges from it and cross(ab, ac), as stored in the packed edges
+inline TriangleHit rayTriangle(const Ray& ray, const vec3& a, const vec3& ab, const vec3& ac, const vec3& triNormal) {
+  vec3 ao = ray.origin - a;
+  vec3 dao = cross(ao, ray.dir);
+
+  float determinant = -dot(ray.dir, triNormal);
+  float invDet = 1.f / determinant;
+
+  TriangleHit hit;
+  hit.dst = dot(ao, triNormal) * invDet;
+  hit.u =  dot(ac, dao) * invDet;
+  hit.v = -dot(ab, dao) * invDet;
+  hit.didHit = determinant >= 1e-6f && hit.dst >= 0.f && hit.u >= 0.f && hit.v >= 0.f && hit.u + hit.v <= 1.f;
+
+  return hit;
+}
+
+inline TriangleHit rayTriangle(const Ray& ray, const vec3& a, const vec3& ab, const vec3& ac) {
+  return rayTriangle(ray, a, ab, ac, cross(ab, ac));
+}
+
+inline TriangleHit rayTriangle(const Ray& ray, const Triangle& tri) {
+  return rayTriangle(ray, tri.a, tri.b - tri.a, tri.c - tri.a);
+}
+
+// Distance to the near side of the sphere, FLT_MAX on miss. A ray starting inside misses, as in rt.frag
+inline float raySphere(const Ray& ray, const vec3& center, float radius) {
+  vec3 offsetRayOrigin = ray.origin - center;
+
+  float a = dot(ray.dir, ray.dir);
+  float b = 2.f * dot(offsetRayOrigin, ray.dir);
+  float c = dot(offsetRayOrigin, offsetRayOrigin) - radius * radius;
+  float discriminant = b * b - 4.f * a * c;
+  if (discriminant < 0.f) return FLT_MAX;
+
+  float dst = (-b - std::sqrt(discriminant)) / (2.f * a);
+  return dst >= 0.f ? dst : FLT_MAX;
+}
+
+// Per ray part of the watertight test: the axis where the direction is largest becomes z and the ray is sheared
+// onto it, so the edge functions are evaluated in 2D on the same values for both triangles sharing an edge
+struct RayShear {
+  int kx, ky, kz;
+  vec3 s;
+};
+
+inline RayShear calcRayShear(const Ray& ray) {
+  vec3 absDir = glm::abs(ray.dir);
+  RayShear shear;
+  shear.kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+  shear.kx = (shear.kz + 1) % 3;
+  shear.ky = (shear.kx + 1) % 3;
+  if (ray.dir[shear.kz] < 0.f) std::swap(shear.kx, shear.ky); // Keeps the winding
+
+  shear.s = vec3(ray.dir[shear.kx], ray.dir[shear.ky], 1.f) / ray.dir[shear.kz];
+  return shear;
+}
+
+// Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection". A ray through a shared edge or vertex hits at least
+// one of the triangles, the edge functions of an edge only depend on its two vertices. Same culling as rayTriangle
+inline TriangleHit rayTriangleWatertight(const Ray& ray, const RayShear& shear, const vec3& a, const vec3& b, const vec3& c) {
+  vec3 pa = a - ray.origin;
+  vec3 pb = b - ray.origin;
+  vec3 pc = c - ray.origin;
+
+  float ax = pa[shear.kx] - shear.s.x * pa[shear.kz];
+  float ay = pa[shear.ky] - shear.s.y * pa[shear.kz];
+  float bx = pb[shear.kx] - shear.s.x * pb[shear.kz];
+  float by = pb[shear.ky] - shear.s.y * pb[shear.kz];
+  float cx = pc[shear.kx] - shear.s.x * pc[shear.kz];
+  float cy = pc[shear.ky] - shear.s.y * pc[shear.kz];
+
+  float u = cx * by - cy * bx;
+  float v = ax * cy - ay * cx;
+  float w = bx * ay - by * ax;
+
+  // Exactly on an edge, redo it in double so the sign is the same from both sides
+  if (u == 0.f || v == 0.f || w == 0.f) {
+    u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+    v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+    w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+  }
+
+  TriangleHit hit;
+  float determinant = u + v + w;
+  if (u < 0.f || v < 0.f || w < 0.f || determinant <= 0.f) return hit;
+
+  float invDet = 1.f / determinant;
+  float t = (u * pa[shear.kz] + v * pb[shear.kz] + w * pc[shear.kz]) * shear.s.z;
+
+  hit.dst = t * invDet;
+  hit.u = v * invDet;
+  hit.v = w * invDet;
+  hit.didHit = hit.dst >= 0.f;
+
+  return hit;
+}
+
+// Wächter and Binder, "A Fast and Robust Method for Avoiding Self-Intersection". Moves a hit point off the surface
+// along the geometric normal by a few ulps (a fixed epsilon near the origin), so the next ray can't hit it again
+inline vec3 offsetRayOrigin(const vec3& p, const vec3& n) {
+  vec3 offset;
+  for (int axis = 0; axis < 3; axis++) {
+    int ulps = static_cast<int>(256.f * n[axis]);
+    int bits = std::bit_cast<int>(p[axis]) + (p[axis] < 0.f ? -ulps : ulps);
+    offset[axis] = std::abs(p[axis]) < 1.f / 32.f ? p[axis] + n[axis] / 65536.f : std::bit_cast<float>(bits);
+  }
+
+  return offset;
+}
+
+// Distance to the box along the ray (0 if the origin is inside), FLT_MAX on miss. The far distance is pushed out by
+// the rounding error of the slabs (Ize, "Robust BVH Ray Traversal"), otherwise a ray through a vertex lying on the
+// box can miss it and leak through the mesh even with a watertight triangle test
+inline float rayBoundingBoxDst(const Ray& ray, const vec3& invDir, const vec3& boundsMin, const vec3& boundsMax) {
+  vec3 tMin = (boundsMin - ray.origin) * invDir;
+  vec3 tMax = (boundsMax - ray.origin) * invDir;
+  vec3 t1 = glm::min(tMin, tMax);
+  vec3 t2 = glm::max(tMin, tMax);
+  float tNear = std::max(std::max(t1.x, t1.y), t1.z);
+  float tFar  = std::min(std::min(t2.x, t2.y), t2.z) * RAY_BOX_FAR_SCALE;
+
+  bool didHit = tFar >= tNear && tFar > 0.f;
+  return didHit ? std::max(tNear, 0.f) : FLT_MAX;
+}
+
+} // namespace intersect
@@ -0,0 +1,100 @@
+#include "simd.hpp"
+
+static const simd::Kernels kernels[] = {
+  {simd::scalar::rayBoxes, simd::scalar::rayTriangles},
+  {simd::sse4::rayBoxes, simd::sse4::rayTriangles},
+  {simd::avx2::rayBoxes, simd::avx2::rayTriangles},
+};
+
+static u32 detectLevel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return SIMD_LEVEL_AVX2;
+  if (__builtin_cpu_supports("sse4.1")) return SIMD_LEVEL_SSE4;
+  return SIMD_LEVEL_SCALAR;
+}
+
+static u32 maxLevel = detectLevel();
+static u32 activeLevel = maxLevel;
+
+void TrianglePacket::set(u32 lane, u32 primIdx, const vec3& a, const vec3& b, const vec3& c) {
+  vec3 ab = b - a;
+  vec3 ac = c - a;
+  vec3 n = glm::cross(ab, ac);
+
+  for (int axis = 0; axis < 3; axis++) {
+    this->a[axis][lane] = a[axis];
+    this->ab[axis][lane] = ab[axis];
+    this->ac[axis][lane] = ac[axis];
+    normal[axis][lane] = n[axis];
+  }
+
+  primIndices[lane] = primIdx;
+  numTriangles = std::max(numTriangles, lane + 1);
+}
+
+void BoxPacket::set(u32 lane, const AABB& bounds) {
+  for (int axis = 0; axis < 3; axis++) {
+    min[axis][lane] = bounds.min[axis];
+    max[axis][lane] = bounds.max[axis];
+  }
+}
+
+namespace simd {
+
+u32 getLevel() { return activeLevel; }
+u32 getMaxLevel() { return maxLevel; }
+
+void setLevel(u32 level) {
+  activeLevel = std::min(level, maxLevel);
+}
+
+const char* getLevelName(u32 level) {
+  switch (level) {
+    case SIMD_LEVEL_SCALAR: return "scalar";
+    case SIMD_LEVEL_SSE4:   return "SSE4";
+    case SIMD_LEVEL_AVX2:   return "AVX2";
+    default:                return "unknown";
+  }
+}
+
+const Kernels& getKernels() {
+  return kernels[activeLevel];
+}
+
+// ===== Scalar =========================================== //
+
+namespace scalar {
+
+u32 rayBoxes(const Ray& ray, const vec3& invDir, const BoxPacket& boxes, u32 numBoxes, float maxDst, float* dsts) {
+  u32 mask = 0;
+
+  for (u32 i = 0; i < SIMD_WIDTH; i++) {
+    vec3 boundsMin(boxes.min[0][i], boxes.min[1][i], boxes.min[2][i]);
+    vec3 boundsMax(boxes.max[0][i], boxes.max[1][i], boxes.max[2][i]);
+    dsts[i] = i < numBoxes ? intersect::rayBoundingBoxDst(ray, invDir, boundsMin, boundsMax) : FLT_MAX;
+    if (dsts[i] < maxDst) mask |= 1u << i;
+  }
+
+  return mask;
+}
+
+int rayTriangles(const Ray& ray, const TrianglePacket& triangles, float closestDst, intersect::TriangleHit& hit) {
+  int hitLane = -1;
+
+  for (u32 i = 0; i < triangles.numTriangles; i++) {
+    auto get = [&](const float (&v)[3][SIMD_WIDTH]) { return vec3(v[0][i], v[1][i], v[2][i]); };
+    intersect::TriangleHit laneHit = intersect::rayTriangle(ray, get(triangles.a), get(triangles.ab), get(triangles.ac), get(triangles.normal));
+
+    if (laneHit.didHit && laneHit.dst < closestDst) {
+      closestDst = laneHit.dst;
+      hit = laneHit;
+      hitLane = static_cast<int>(i);
+    }
+  }
+
+  return hitLane;
+}
+
+} // namespace scalar
+
+} // namespace simd
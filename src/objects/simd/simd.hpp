@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../Ray.hpp"
+#include "../intersect.hpp"
+#include "../bvh/AABB.hpp"
+
+#define SIMD_WIDTH 8u
+
+#define SIMD_LEVEL_SCALAR 0u // Loops over the intersect:: routines, the reference
+#define SIMD_LEVEL_SSE4   1u // Two halves of 4 lanes
+#define SIMD_LEVEL_AVX2   2u
+
+// Up to 8 triangles in SoA form, each as in the packed edges: a vertex, the two edges from it and cross(ab, ac).
+// Unused lanes are zero, their determinant is 0 so they never hit
+struct alignas(32) TrianglePacket {
+  float a[3][SIMD_WIDTH] = {};
+  float ab[3][SIMD_WIDTH] = {};
+  float ac[3][SIMD_WIDTH] = {};
+  float normal[3][SIMD_WIDTH] = {};
+  u32 primIndices[SIMD_WIDTH] = {};
+  u32 numTriangles = 0;
+
+  void set(u32 lane, u32 primIdx, const vec3& a, const vec3& b, const vec3& c);
+};
+
+// Up to 8 boxes in SoA form, the lanes past the count are ignored
+struct alignas(32) BoxPacket {
+  float min[3][SIMD_WIDTH] = {};
+  float max[3][SIMD_WIDTH] = {};
+
+  void set(u32 lane, const AABB& bounds);
+};
+
+// One ray against a packet. The results are the same as the scalar routines: same operations in the same order,
+// no FMA and min/max operands ordered so NaNs resolve like std::min and glm::min
+namespace simd {
+  // Writes the distance to each box (FLT_MAX on miss) and returns the mask of the boxes closer than maxDst
+  using RayBoxesFn = u32 (*)(const Ray& ray, const vec3& invDir, const BoxPacket& boxes, u32 numBoxes, float maxDst, float* dsts);
+
+  // Closest triangle of the packet hit closer than closestDst (the first one on ties, like a loop would), -1 if none
+  using RayTrianglesFn = int (*)(const Ray& ray, const TrianglePacket& triangles, float closestDst, intersect::TriangleHit& hit);
+
+  struct Kernels {
+    RayBoxesFn rayBoxes;
+    RayTrianglesFn rayTriangles;
+  };
+
+  // The best level the CPU supports is picked on first use
+  u32 getLevel();
+  u32 getMaxLevel();
+  void setLevel(u32 level); // Clamped to the supported levels
+  const char* getLevelName(u32 level);
+
+  const Kernels& getKernels();
+
+  namespace scalar {
+    u32 rayBoxes(const Ray& ray, const vec3& invDir, const BoxPacket& boxes, u32 numBoxes, float maxDst, float* dsts);
+    int rayTriangles(const Ray& ray, const TrianglePacket& triangles, float closestDst, intersect::TriangleHit& hit);
+  }
+
+  namespace sse4 {
+    u32 rayBoxes(const Ray& ray, const vec3& invDir, const BoxPacket& boxes, u32 numBoxes, float maxDst, float* dsts);
+    int rayTriangles(const Ray& ray, const TrianglePacket& triangles, float closestDst, intersect::TriangleHit& hit);
+  }
+
+  namespace avx2 {
+    u32 rayBoxes(const Ray& ray, const vec3& invDir, const BoxPacket& boxes, u32 numBoxes, float maxDst, float* dsts);
+    int rayTriangles(const Ray& ray, const TrianglePacket& triangles, float closestDst, intersect::TriangleHit& hit);
+  }
+}
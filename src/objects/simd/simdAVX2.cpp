@@ -0,0 +1,111 @@
+#include "simd.hpp"
+
+#include <bit>
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+// Same association as glm::dot, (x + y) + z
+AVX2 static inline __m256 dot8(const __m256* a, const __m256* b) {
+  return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1])), _mm256_mul_ps(a[2], b[2]));
+}
+
+namespace simd::avx2 {
+
+AVX2 u32 rayBoxes(const Ray& ray, const vec3& invDir, const BoxPacket& boxes, u32 numBoxes, float maxDst, float* dsts) {
+  __m256 origin[3], inv[3];
+  for (int axis = 0; axis < 3; axis++) {
+    origin[axis] = _mm256_set1_ps(ray.origin[axis]);
+    inv[axis] = _mm256_set1_ps(invDir[axis]);
+  }
+
+  __m256 zero = _mm256_setzero_ps();
+  __m256 farScale = _mm256_set1_ps(RAY_BOX_FAR_SCALE);
+  __m256 maxDstV = _mm256_set1_ps(maxDst);
+  __m256 noHit = _mm256_set1_ps(FLT_MAX);
+
+  __m256 t1[3], t2[3];
+  for (int axis = 0; axis < 3; axis++) {
+    __m256 tMin = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.min[axis]), origin[axis]), inv[axis]);
+    __m256 tMax = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(boxes.max[axis]), origin[axis]), inv[axis]);
+    t1[axis] = _mm256_min_ps(tMax, tMin);
+    t2[axis] = _mm256_max_ps(tMax, tMin);
+  }
+
+  __m256 tNear = _mm256_max_ps(t1[2], _mm256_max_ps(t1[1], t1[0]));
+  __m256 tFar = _mm256_mul_ps(_mm256_min_ps(t2[2], _mm256_min_ps(t2[1], t2[0])), farScale);
+  __m256 dst = _mm256_max_ps(zero, tNear);
+
+  __m256 didHit = _mm256_and_ps(_mm256_cmp_ps(tFar, tNear, _CMP_GE_OQ), _mm256_cmp_ps(tFar, zero, _CMP_GT_OQ));
+  dst = _mm256_blendv_ps(noHit, dst, didHit);
+  _mm256_storeu_ps(dsts, dst);
+
+  u32 mask = static_cast<u32>(_mm256_movemask_ps(_mm256_cmp_ps(dst, maxDstV, _CMP_LT_OQ)));
+  u32 validMask = (1u << numBoxes) - 1u;
+  for (u32 i = numBoxes; i < SIMD_WIDTH; i++)
+    dsts[i] = FLT_MAX;
+
+  return mask & validMask;
+}
+
+AVX2 int rayTriangles(const Ray& ray, const TrianglePacket& triangles, float closestDst, intersect::TriangleHit& hit) {
+  __m256 o[3], d[3];
+  for (int axis = 0; axis < 3; axis++) {
+    o[axis] = _mm256_set1_ps(ray.origin[axis]);
+    d[axis] = _mm256_set1_ps(ray.dir[axis]);
+  }
+
+  __m256 zero = _mm256_setzero_ps();
+  __m256 one = _mm256_set1_ps(1.f);
+  __m256 signBit = _mm256_set1_ps(-0.f);
+  __m256 minDeterminant = _mm256_set1_ps(1e-6f);
+  __m256 closestDstV = _mm256_set1_ps(closestDst);
+
+  __m256 ab[3], ac[3], n[3], ao[3];
+  for (int axis = 0; axis < 3; axis++) {
+    ab[axis] = _mm256_load_ps(triangles.ab[axis]);
+    ac[axis] = _mm256_load_ps(triangles.ac[axis]);
+    n[axis] = _mm256_load_ps(triangles.normal[axis]);
+    ao[axis] = _mm256_sub_ps(o[axis], _mm256_load_ps(triangles.a[axis]));
+  }
+
+  __m256 dao[3] = {
+    _mm256_sub_ps(_mm256_mul_ps(ao[1], d[2]), _mm256_mul_ps(d[1], ao[2])),
+    _mm256_sub_ps(_mm256_mul_ps(ao[2], d[0]), _mm256_mul_ps(d[2], ao[0])),
+    _mm256_sub_ps(_mm256_mul_ps(ao[0], d[1]), _mm256_mul_ps(d[0], ao[1])),
+  };
+
+  __m256 determinant = _mm256_xor_ps(dot8(d, n), signBit);
+  __m256 invDet = _mm256_div_ps(one, determinant);
+
+  __m256 dst = _mm256_mul_ps(dot8(ao, n), invDet);
+  __m256 u = _mm256_mul_ps(dot8(ac, dao), invDet);
+  __m256 v = _mm256_mul_ps(_mm256_xor_ps(dot8(ab, dao), signBit), invDet);
+
+  __m256 didHit = _mm256_cmp_ps(determinant, minDeterminant, _CMP_GE_OQ);
+  didHit = _mm256_and_ps(didHit, _mm256_cmp_ps(dst, zero, _CMP_GE_OQ));
+  didHit = _mm256_and_ps(didHit, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+  didHit = _mm256_and_ps(didHit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+  didHit = _mm256_and_ps(didHit, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+  didHit = _mm256_and_ps(didHit, _mm256_cmp_ps(dst, closestDstV, _CMP_LT_OQ));
+
+  alignas(32) float dsts[SIMD_WIDTH], us[SIMD_WIDTH], vs[SIMD_WIDTH];
+  _mm256_store_ps(dsts, dst);
+  _mm256_store_ps(us, u);
+  _mm256_store_ps(vs, v);
+  u32 mask = static_cast<u32>(_mm256_movemask_ps(didHit));
+
+  // Usually one lane at most, the lowest wins ties as in a loop
+  int hitLane = -1;
+  for (; mask; mask &= mask - 1) {
+    int lane = std::countr_zero(mask);
+    if (hitLane < 0 || dsts[lane] < dsts[hitLane]) hitLane = lane;
+  }
+
+  if (hitLane >= 0)
+    hit = {true, dsts[hitLane], us[hitLane], vs[hitLane]};
+
+  return hitLane;
+}
+
+} // namespace simd::avx2
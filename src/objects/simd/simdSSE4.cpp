@@ -0,0 +1,120 @@
+#include "simd.hpp"
+
+#include <bit>
+#include <immintrin.h>
+
+#define SSE4 __attribute__((target("sse4.1")))
+
+// Same association as glm::dot, (x + y) + z
+SSE4 static inline __m128 dot4(const __m128* a, const __m128* b) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+}
+
+namespace simd::sse4 {
+
+SSE4 u32 rayBoxes(const Ray& ray, const vec3& invDir, const BoxPacket& boxes, u32 numBoxes, float maxDst, float* dsts) {
+  __m128 origin[3], inv[3];
+  for (int axis = 0; axis < 3; axis++) {
+    origin[axis] = _mm_set1_ps(ray.origin[axis]);
+    inv[axis] = _mm_set1_ps(invDir[axis]);
+  }
+
+  __m128 zero = _mm_setzero_ps();
+  __m128 farScale = _mm_set1_ps(RAY_BOX_FAR_SCALE);
+  __m128 maxDstV = _mm_set1_ps(maxDst);
+  __m128 noHit = _mm_set1_ps(FLT_MAX);
+  u32 mask = 0;
+
+  for (u32 half = 0; half < SIMD_WIDTH; half += 4) {
+    __m128 t1[3], t2[3];
+    for (int axis = 0; axis < 3; axis++) {
+      __m128 tMin = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&boxes.min[axis][half]), origin[axis]), inv[axis]);
+      __m128 tMax = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&boxes.max[axis][half]), origin[axis]), inv[axis]);
+      t1[axis] = _mm_min_ps(tMax, tMin);
+      t2[axis] = _mm_max_ps(tMax, tMin);
+    }
+
+    __m128 tNear = _mm_max_ps(t1[2], _mm_max_ps(t1[1], t1[0]));
+    __m128 tFar = _mm_mul_ps(_mm_min_ps(t2[2], _mm_min_ps(t2[1], t2[0])), farScale);
+    __m128 dst = _mm_max_ps(zero, tNear);
+
+    __m128 didHit = _mm_and_ps(_mm_cmpge_ps(tFar, tNear), _mm_cmpgt_ps(tFar, zero));
+    dst = _mm_blendv_ps(noHit, dst, didHit);
+    _mm_storeu_ps(dsts + half, dst);
+
+    mask |= static_cast<u32>(_mm_movemask_ps(_mm_cmplt_ps(dst, maxDstV))) << half;
+  }
+
+  u32 validMask = (1u << numBoxes) - 1u;
+  for (u32 i = numBoxes; i < SIMD_WIDTH; i++)
+    dsts[i] = FLT_MAX;
+
+  return mask & validMask;
+}
+
+SSE4 int rayTriangles(const Ray& ray, const TrianglePacket& triangles, float closestDst, intersect::TriangleHit& hit) {
+  __m128 o[3], d[3];
+  for (int axis = 0; axis < 3; axis++) {
+    o[axis] = _mm_set1_ps(ray.origin[axis]);
+    d[axis] = _mm_set1_ps(ray.dir[axis]);
+  }
+
+  __m128 zero = _mm_setzero_ps();
+  __m128 one = _mm_set1_ps(1.f);
+  __m128 signBit = _mm_set1_ps(-0.f);
+  __m128 minDeterminant = _mm_set1_ps(1e-6f);
+  __m128 closestDstV = _mm_set1_ps(closestDst);
+
+  alignas(16) float dsts[SIMD_WIDTH], us[SIMD_WIDTH], vs[SIMD_WIDTH];
+  u32 mask = 0;
+
+  for (u32 half = 0; half < SIMD_WIDTH; half += 4) {
+    __m128 a[3], ab[3], ac[3], n[3], ao[3];
+    for (int axis = 0; axis < 3; axis++) {
+      a[axis] = _mm_load_ps(&triangles.a[axis][half]);
+      ab[axis] = _mm_load_ps(&triangles.ab[axis][half]);
+      ac[axis] = _mm_load_ps(&triangles.ac[axis][half]);
+      n[axis] = _mm_load_ps(&triangles.normal[axis][half]);
+      ao[axis] = _mm_sub_ps(o[axis], a[axis]);
+    }
+
+    __m128 dao[3] = {
+      _mm_sub_ps(_mm_mul_ps(ao[1], d[2]), _mm_mul_ps(d[1], ao[2])),
+      _mm_sub_ps(_mm_mul_ps(ao[2], d[0]), _mm_mul_ps(d[2], ao[0])),
+      _mm_sub_ps(_mm_mul_ps(ao[0], d[1]), _mm_mul_ps(d[0], ao[1])),
+    };
+
+    __m128 determinant = _mm_xor_ps(dot4(d, n), signBit);
+    __m128 invDet = _mm_div_ps(one, determinant);
+
+    __m128 dst = _mm_mul_ps(dot4(ao, n), invDet);
+    __m128 u = _mm_mul_ps(dot4(ac, dao), invDet);
+    __m128 v = _mm_mul_ps(_mm_xor_ps(dot4(ab, dao), signBit), invDet);
+
+    __m128 didHit = _mm_cmpge_ps(determinant, minDeterminant);
+    didHit = _mm_and_ps(didHit, _mm_cmpge_ps(dst, zero));
+    didHit = _mm_and_ps(didHit, _mm_cmpge_ps(u, zero));
+    didHit = _mm_and_ps(didHit, _mm_cmpge_ps(v, zero));
+    didHit = _mm_and_ps(didHit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+    didHit = _mm_and_ps(didHit, _mm_cmplt_ps(dst, closestDstV));
+
+    _mm_store_ps(dsts + half, dst);
+    _mm_store_ps(us + half, u);
+    _mm_store_ps(vs + half, v);
+    mask |= static_cast<u32>(_mm_movemask_ps(didHit)) << half;
+  }
+
+  // Usually one lane at most, the lowest wins ties as in a loop
+  int hitLane = -1;
+  for (; mask; mask &= mask - 1) {
+    int lane = std::countr_zero(mask);
+    if (hitLane < 0 || dsts[lane] < dsts[hitLane]) hitLane = lane;
+  }
+
+  if (hitLane >= 0)
+    hit = {true, dsts[hitLane], us[hitLane], vs[hitLane]};
+
+  return hitLane;
+}
+
+} // namespace simd::sse4
@@ -1,21 +1,51 @@
 #version 460 core
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor; // Mean color, mean squared luminance in alpha
+layout(location = 1) out vec2 FragStats; // Samples, passes that added some
+layout(location = 2) out float FragError; // Relative standard error of the mean luminance, read by rt.frag
 
 in vec2 texCoord;
 
 uniform sampler2D u_screenColorTexOld;
 uniform sampler2D u_screenColorTexNew;
+uniform sampler2D u_screenStatsTexOld;
+uniform sampler2D u_screenRaysTex;
 uniform int u_numRenderedFrames;
 uniform int u_newRender;
 
+float calcLuminance(vec3 color) {
+  return dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Every pass weighs as its rays, so the mean is the one of the samples however the passes spread them. Its variance
+// comes from the pass means around it: the rays of a pass times its squared distance sum to n * (E[L^2] - E[L]^2),
+// about the variance of a sample times passes - 1
 void main() {
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
   vec4 colorOld = texture(u_screenColorTexOld, texCoord);
-  vec4 colorNew = texture(u_screenColorTexNew, texCoord);
+  vec3 colorNew = texture(u_screenColorTexNew, texCoord).rgb;
+  vec2 statsOld = texelFetch(u_screenStatsTexOld, pixel, 0).xy;
+  float numRays = texelFetch(u_screenRaysTex, pixel, 0).r;
+
+  if (u_numRenderedFrames <= 1) {
+    colorOld = vec4(0.f);
+    statsOld = vec2(0.f);
+  }
 
-  float weight = 1.f / u_numRenderedFrames;
-  vec4 accumulatedAverage = colorOld * (1.f - weight) + colorNew * weight;
+  float numSamples = statsOld.x + numRays;
+  float weight = numSamples > 0.f ? numRays / numSamples : 0.f;
+  float luminanceNew = calcLuminance(colorNew);
+  vec4 accumulatedAverage = mix(colorOld, vec4(colorNew, luminanceNew * luminanceNew), weight);
+  float numPasses = statsOld.y + (numRays > 0.f ? 1.f : 0.f);
+
+  float error = 1.f; // Unknown, above any threshold
+  if (numPasses >= 2.f) {
+    float mean = calcLuminance(accumulatedAverage.rgb);
+    float variance = max(accumulatedAverage.a - mean * mean, 0.f) / (numPasses - 1.f);
+    error = sqrt(variance) / max(mean, RT_ADAPTIVE_MIN_LUMINANCE);
+  }
 
   FragColor = accumulatedAverage;
+  FragStats = vec2(numSamples, numPasses);
+  FragError = error;
 }
-
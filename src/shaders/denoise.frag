@@ -0,0 +1,90 @@
+#version 460 core
+
+layout(location = 0) out vec4 FragColor; // Color, variance of its luminance in alpha
+
+in vec2 texCoord;
+
+uniform sampler2D u_denoiseInputTex; // The accumulation at iteration 0, then the output of the last iteration
+uniform sampler2D u_screenStatsTexFinal;
+uniform sampler2D u_screenAlbedoTex;
+uniform sampler2D u_screenNormalDepthTex;
+uniform int u_denoiseIteration; // 0 estimates the variance, i filters with taps 2^(i - 1) pixels apart
+
+#include "denoise.glsl"
+
+DenoiseFeature getFeature(ivec2 pixel) {
+  vec4 normalDepth = texelFetch(u_screenNormalDepthTex, pixel, 0);
+  return DenoiseFeature(texelFetch(u_screenAlbedoTex, pixel, 0).rgb, normalDepth.xyz, normalDepth.w);
+}
+
+vec4 estimateVariance(ivec2 pixel, ivec2 size) {
+  vec4 accumulated = texelFetch(u_denoiseInputTex, pixel, 0);
+  float numPasses = texelFetch(u_screenStatsTexFinal, pixel, 0).y;
+  float variance = calcPassesVariance(accumulated.a, denoiseLuminance(accumulated.rgb), numPasses);
+
+  if (variance < 0.f) {
+    float sum = 0.f;
+    float sumSquares = 0.f;
+    for (int y = -1; y <= 1; y++)
+      for (int x = -1; x <= 1; x++) {
+        float luminance = denoiseLuminance(texelFetch(u_denoiseInputTex, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0).rgb);
+        sum += luminance;
+        sumSquares += luminance * luminance;
+      }
+
+    variance = max(sumSquares / 9.f - sum * sum / 81.f, 0.f);
+  }
+
+  return vec4(accumulated.rgb, variance);
+}
+
+// 3x3 Gaussian of the variance, a single pixel is too noisy to stop the edges
+float calcPrefilteredVariance(ivec2 pixel, ivec2 size) {
+  float variance = 0.f;
+  for (int y = -1; y <= 1; y++)
+    for (int x = -1; x <= 1; x++) {
+      float weight = (x == 0 ? 0.5f : 0.25f) * (y == 0 ? 0.5f : 0.25f);
+      variance += texelFetch(u_denoiseInputTex, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0).a * weight;
+    }
+
+  return variance;
+}
+
+vec4 filterIteration(ivec2 pixel, ivec2 size, int step) {
+  DenoiseFeature feature = getFeature(pixel);
+  float luminance = denoiseLuminance(texelFetch(u_denoiseInputTex, pixel, 0).rgb);
+  float luminanceDeviation = sqrt(calcPrefilteredVariance(pixel, size));
+
+  vec3 colorSum = vec3(0.f);
+  float varianceSum = 0.f;
+  float weightSum = 0.f;
+  for (int y = -2; y <= 2; y++)
+    for (int x = -2; x <= 2; x++) {
+      ivec2 q = pixel + ivec2(x, y) * step;
+      if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size)))
+        continue;
+
+      vec4 tap = texelFetch(u_denoiseInputTex, q, 0);
+      float edgeWeight = calcEdgeWeight(
+        feature, getFeature(q), luminance, denoiseLuminance(tap.rgb), luminanceDeviation, length(vec2(x, y)) * float(step)
+      );
+      float weight = getAtrousTap(x) * getAtrousTap(y) * edgeWeight;
+
+      colorSum += tap.rgb * weight;
+      varianceSum += tap.a * weight * weight;
+      weightSum += weight;
+    }
+
+  weightSum = max(weightSum, 1e-6f);
+  return vec4(colorSum / weightSum, varianceSum / (weightSum * weightSum));
+}
+
+void main() {
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  ivec2 size = textureSize(u_denoiseInputTex, 0);
+
+  if (u_denoiseIteration == 0)
+    FragColor = estimateVariance(pixel, size);
+  else
+    FragColor = filterIteration(pixel, size, 1 << (u_denoiseIteration - 1));
+}
@@ -0,0 +1,49 @@
+// Edge-avoiding a-trous wavelet filter (Dammertz et al.) guided by the variance of the pixels as in SVGF (Schied et
+// al., without its temporal reprojection, the accumulation is the history). Shared by denoise.frag and the CPU tracer
+// (tracer/Denoiser.hpp) like sampler.glsl, the includer defines DENOISE_FN and runs the passes:
+// - one turns the accumulation into colors and luminance variances: the variance of a mean over the passes
+//   (average.frag), or under 2 passes the one of the 3x3 neighbourhood
+// - each iteration i, from 1, is a 5x5 B3 spline kernel with taps 2^(i-1) pixels apart, weighted by how alike the
+//   first hits are and by the luminance difference against the standard deviation of the pixel, so noisy pixels get
+//   blurred and converged ones kept. The variance is filtered with the squared weights
+
+#ifndef DENOISE_FN
+#define DENOISE_FN
+#endif
+
+struct DenoiseFeature {
+  vec3 albedo;
+  vec3 normal; // Towards the camera for the environment
+  float depth; // Distance to the first hit, RT_DENOISE_MISS_DEPTH for the environment
+};
+
+DENOISE_FN float denoiseLuminance(vec3 color) {
+  return dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// B3 spline tap at offset -2 to 2
+DENOISE_FN float getAtrousTap(int offset) {
+  return offset == 0 ? 3.f / 8.f : abs(offset) == 1 ? 1.f / 4.f : 1.f / 16.f;
+}
+
+// Negative under 2 passes, where it is estimated from the neighbours
+DENOISE_FN float calcPassesVariance(float meanSquaredLuminance, float meanLuminance, float numPasses) {
+  if (numPasses < 2.f)
+    return -1.f;
+
+  return max(meanSquaredLuminance - meanLuminance * meanLuminance, 0.f) / (numPasses - 1.f);
+}
+
+// Of pixel q in the filter of pixel p, pixelDistance apart. luminanceDeviation is the prefiltered standard deviation
+// of the luminance of p
+DENOISE_FN float calcEdgeWeight(
+  DenoiseFeature p, DenoiseFeature q, float luminanceP, float luminanceQ, float luminanceDeviation, float pixelDistance
+) {
+  float normalWeight = pow(max(dot(p.normal, q.normal), 0.f), RT_DENOISE_SIGMA_NORMAL);
+  float depthTerm = abs(p.depth - q.depth) / (RT_DENOISE_SIGMA_DEPTH * p.depth * pixelDistance + 1e-4f);
+  vec3 albedoDiff = p.albedo - q.albedo;
+  float albedoTerm = dot(albedoDiff, albedoDiff) / (RT_DENOISE_SIGMA_ALBEDO * RT_DENOISE_SIGMA_ALBEDO);
+  float luminanceTerm = abs(luminanceP - luminanceQ) / (RT_DENOISE_SIGMA_LUMINANCE * luminanceDeviation + 1e-4f);
+
+  return normalWeight * exp(-(depthTerm + albedoTerm + luminanceTerm));
+}
@@ -5,8 +5,27 @@ out vec4 FragColor;
 in vec2 texCoord;
 
 uniform sampler2D u_screenColorTexFinal;
+uniform sampler2D u_screenStatsTexFinal;
+uniform sampler2D u_screenDenoisedTex;
+uniform bool u_showSppHeatmap;
+uniform bool u_useDenoiser;
+uniform float u_uniformSpp; // Of every pixel without adaptive sampling
 
-void main() {
-  FragColor = texture(u_screenColorTexFinal, texCoord);
+// Samples of the pixel against the uniform ones: blue skipped, green as many, red RT_ADAPTIVE_MAX_RAYS_SCALE times more
+vec3 calcSppHeat(float spp) {
+  float t = spp / u_uniformSpp;
+  if (t <= 1.f)
+    return mix(vec3(0.f, 0.f, 1.f), vec3(0.f, 1.f, 0.f), t);
+
+  return mix(vec3(0.f, 1.f, 0.f), vec3(1.f, 0.f, 0.f), clamp((t - 1.f) / (float(RT_ADAPTIVE_MAX_RAYS_SCALE) - 1.f), 0.f, 1.f));
 }
 
+void main() {
+  if (u_showSppHeatmap) {
+    FragColor = vec4(calcSppHeat(texture(u_screenStatsTexFinal, texCoord).x), 1.f);
+    return;
+  }
+
+  vec3 color = u_useDenoiser ? texture(u_screenDenoisedTex, texCoord).rgb : texture(u_screenColorTexFinal, texCoord).rgb;
+  FragColor = vec4(color, 1.f);
+}
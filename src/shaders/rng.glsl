@@ -0,0 +1,39 @@
+// Random numbers of the path tracers, shared by rt.frag (through #include) and the CPU tracer (tracer/PathSampler.hpp).
+// Written in the subset of GLSL that is also C++, so both sides compute the same bits.
+//
+// Counter based: a stream is seeded from (pixel, sample, bounce), so a path segment draws the same numbers whatever
+// ran before it, on any thread or GPU invocation. Inside a stream the state steps like a PCG generator
+
+#ifndef RNG_FN
+#define RNG_FN
+#endif
+
+// Jarzynski and Olano, "Hash Functions for GPU Rendering"
+RNG_FN uvec3 pcg3d(uvec3 v) {
+  v = v * 1664525u + 1013904223u;
+  v.x += v.y * v.z;
+  v.y += v.z * v.x;
+  v.z += v.x * v.y;
+  v ^= v >> 16u;
+  v.x += v.y * v.z;
+  v.y += v.z * v.x;
+  v.z += v.x * v.y;
+  return v;
+}
+
+// Bounce 0 is the camera ray, bounce i + 1 scatters the i-th hit
+RNG_FN uint rngSeed(uint pixelIdx, uint sampleIdx, uint bounce) {
+  return pcg3d(uvec3(pixelIdx, sampleIdx, bounce)).x;
+}
+
+RNG_FN uint rngStep(uint state) {
+  return state * 747796405u + 2891336453u;
+}
+
+// In (0, 1) with 23 bits. Only exact float operations (no division), so the GPU gets the same value
+RNG_FN float rngToFloat(uint state) {
+  uint result = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  result = (result >> 22u) ^ result;
+
+  return float(result >> 9u) * (1.f / 8388608.f) + (0.5f / 8388608.f);
+}
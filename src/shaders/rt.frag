@@ -3,13 +3,14 @@
 #define FLT_MAX 3.4028235e38f
 #define PI 3.141592265359f
 
-#define MAX_SPHERES 6u
-#define MAX_TRIANGLES 500u
-#define MAX_MESHES 10u
+// MAX_*, WIDE_BVH_*, PACKED_*, RT_*_FLAG_* and the RT_SSBO_* bindings are injected by scene::defineShaderConstants
 
-#define RT_MATERIAL_FLAG_CHECKERED_PATTERN 1u
+#define BVH_STACK_SIZE 32
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out float FragNumRays; // Weight of the pass in average.frag
+layout(location = 2) out vec4 FragAlbedo; // First hit features of the denoiser (denoise.glsl)
+layout(location = 3) out vec4 FragNormalDepth;
 
 in vec2 texCoord;
 
@@ -27,29 +28,49 @@ struct RayTracingMaterial {
   float specularProbability;
   uint flags;
 };
-const RayTracingMaterial rtMaterialInit = RayTracingMaterial(vec4(0.f), vec3(0.f), vec3(0.f), 0.f, 0.f, 0.f, 0);
 
 struct Sphere {
   vec3 pos;
   float r;
-  RayTracingMaterial material;
-};
-
-struct Triangle {
-  vec3 a;
-  vec3 b;
-  vec3 c;
-  vec3 normalA;
-  vec3 normalB;
-  vec3 normalC;
+  uint materialIdx;
 };
 
 struct MeshInfo {
   uint firstTriangleIndex;
   uint numTriangles;
+  uint rootNodeIndex;
+  uint rootWideNodeIndex;
+  vec3 boundsMin;
+  uint firstVertexIndex;
+  vec3 boundsMax;
+  uint materialIdx;
+};
+
+struct MeshInstance {
+  mat4 transform;
+  mat4 invTransform;
+  uint meshIndex;
+  uint flags;
+  uint materialIdx;
+};
+
+// See Emitter.hpp
+struct Emitter {
+  vec3 a;
+  uint type;
+  vec3 ab;
+  uint sphereIdx;
+  vec3 ac;
+  uint materialIdx;
+  float probability;
+  uint alias;
+};
+
+struct BVHNode {
   vec3 boundsMin;
+  uint leftFirst;
   vec3 boundsMax;
-  RayTracingMaterial material;
+  uint numPrimitives;
 };
 
 struct HitInfo {
@@ -57,9 +78,12 @@ struct HitInfo {
   float dst;
   vec3 hitPoint;
   vec3 normal;
-  RayTracingMaterial material;
+  vec3 geometricNormal; // The next ray starts off the surface along it
+  uint materialIdx; // The material itself is only fetched for the closest hit
+  uint triIdx; // Triangle hits only get the normal once the closest one is known
+  vec2 barycentric; // Weights of b and c
 };
-const HitInfo hitInfoInit = HitInfo(false, 0.f, vec3(0.f), vec3(0.f), rtMaterialInit);
+const HitInfo hitInfoInit = HitInfo(false, 0.f, vec3(0.f), vec3(0.f), vec3(0.f), 0u, 0u, vec2(0.f));
 
 uniform vec2 u_resolution;
 uniform vec3 u_lightPos;
@@ -72,28 +96,112 @@ uniform vec3 u_camUp;
 uniform mat4 u_camInv;
 uniform sampler2D u_screenColorTexDefault;
 uniform sampler2D u_screenDepthTex;
+uniform sampler2D u_screenStatsTexOld; // Samples of every pixel so far
+uniform sampler2D u_screenErrorTex; // Relative standard error of every pixel mean, mipmapped
 uniform int u_numRaysPerPixel;
 uniform int u_numRenderedFrames;
 uniform int u_numRayBounces;
+uniform int u_rouletteMinBounces;
 uniform int u_numSpheres;
 uniform int u_numMeshes;
+uniform int u_numInstances;
+uniform int u_numEmitters;
+uniform int u_samplerType;
+uniform int u_adaptiveMinSpp;
 uniform bool u_enableEnvironmentalLight;
+uniform bool u_useBVH;
+uniform bool u_useWideBVH;
+uniform bool u_useWatertight;
+uniform bool u_useLightSampling;
+uniform bool u_useRussianRoulette;
+uniform bool u_useAdaptiveSampling;
+uniform bool u_updateDenoiseFeatures; // Else FragAlbedo and FragNormalDepth are masked off and keep the last ones
 uniform float u_sunFocus;
 uniform float u_sunIntensity;
 uniform float u_divergeStrength;
 uniform float u_defocusStrength;
 uniform float u_focusDistance;
+uniform float u_emittersPower;
+uniform float u_adaptiveThreshold;
+
+layout(std430, binding = RT_SSBO_SPHERES) readonly buffer SpheresBuffer {
+  Sphere spheres[];
+};
+
+layout(std430, binding = RT_SSBO_SPHERE_NODES) readonly buffer SphereNodesBuffer {
+  BVHNode sphereNodes[];
+};
+
+layout(std430, binding = RT_SSBO_SPHERE_INDICES) readonly buffer SphereIndicesBuffer {
+  uint sphereIndices[];
+};
+
+layout(std430, binding = RT_SSBO_MESHES_INFOS) readonly buffer MeshesInfosBuffer {
+  MeshInfo meshesInfos[];
+};
 
-layout(std140) uniform u_spheresBlock {
-  Sphere spheres[MAX_SPHERES];
+// Packed mesh streams (see PackedMesh.hpp): 3 floats per vertex
+layout(std430, binding = RT_SSBO_VERTEX_POSITIONS) readonly buffer VertexPositionsBuffer {
+  float vertexPositions[];
 };
 
-layout(std140) uniform u_trianglesBlock {
-  Triangle triangles[MAX_TRIANGLES];
+// Octahedral normal of every vertex as 1 word
+layout(std430, binding = RT_SSBO_VERTEX_NORMALS) readonly buffer VertexNormalsBuffer {
+  uint vertexNormals[];
 };
 
-layout(std140) uniform u_meshesInfosBlock {
-  MeshInfo meshesInfos[MAX_MESHES];
+// Vertices of a, b and c as 3 words
+layout(std430, binding = RT_SSBO_TRI_INDICES) readonly buffer TriIndicesBuffer {
+  uint triIndices[];
+};
+
+// Precomputed at upload as (a, n.x), (ab, n.y), (ac, n.z), n = cross(ab, ac)
+layout(std430, binding = RT_SSBO_TRI_EDGES) readonly buffer TriEdgesBuffer {
+  vec4 triEdges[];
+};
+
+layout(std430, binding = RT_SSBO_BVH_NODES) readonly buffer BVHNodesBuffer {
+  BVHNode bvhNodes[];
+};
+
+layout(std430, binding = RT_SSBO_BVH_TRI_INDICES) readonly buffer BVHTriIndicesBuffer {
+  uint bvhTriIndices[];
+};
+
+layout(std430, binding = RT_SSBO_WIDE_BVH_NODES) readonly buffer WideBVHNodesBuffer {
+  uint wideBVHNodes[];
+};
+
+layout(std430, binding = RT_SSBO_MATERIALS) readonly buffer MaterialsBuffer {
+  RayTracingMaterial materials[];
+};
+
+// Alias table over the emissive triangles and spheres (see scene::updateEmitters)
+layout(std430, binding = RT_SSBO_EMITTERS) readonly buffer EmittersBuffer {
+  Emitter emitters[];
+};
+
+// Atomics of the pixels on the RT_PATH_STATS_STRIDE grid, read back by main for the mean path length
+layout(std430, binding = RT_SSBO_PATH_STATS) buffer PathStatsBuffer {
+  uint numStatsPaths;
+  uint numStatsPathSegments;
+};
+
+// Ranks of the blue noise tile (engine/BlueNoise.hpp)
+layout(std430, binding = RT_SSBO_BLUE_NOISE) readonly buffer BlueNoiseBuffer {
+  uint blueNoise[];
+};
+
+layout(std140) uniform u_instancesBlock {
+  MeshInstance instances[MAX_INSTANCES];
+};
+
+layout(std140) uniform u_tlasNodesBlock {
+  BVHNode tlasNodes[MAX_TLAS_NODES];
+};
+
+layout(std140) uniform u_tlasInstIndicesBlock {
+  uvec4 tlasInstIndices[(MAX_TLAS_REFERENCES + 3u) / 4u];
 };
 
 vec3 calcViewPoint() {
@@ -131,36 +239,126 @@ HitInfo raySphere(Ray ray, vec3 sphereCenter, float sphereRadius) {
       hitInfo.dst = dst;
       hitInfo.hitPoint = ray.origin + ray.dir * dst;
       hitInfo.normal = normalize(hitInfo.hitPoint - sphereCenter);
+      hitInfo.geometricNormal = hitInfo.normal;
     }
   }
 
   return hitInfo;
 }
 
-HitInfo rayTriangle(Ray ray, Triangle tri) {
-  vec3 ab = tri.b - tri.a;
-  vec3 ac = tri.c - tri.a;
-  vec3 triNormal = cross(ab, ac);
-  vec3 ao = ray.origin - tri.a;
+uvec3 getTriIndices(uint triIdx) {
+  uint i = triIdx * PACKED_TRIANGLE_INDEX_WORDS;
+  return uvec3(triIndices[i], triIndices[i + 1u], triIndices[i + 2u]);
+}
+
+vec3 getVertexPosition(uint vertexIdx) {
+  uint i = vertexIdx * PACKED_VERTEX_POSITION_WORDS;
+  return vec3(vertexPositions[i], vertexPositions[i + 1u], vertexPositions[i + 2u]);
+}
+
+vec3 decodeNormal(uint encoded) {
+  vec2 p = unpackSnorm2x16(encoded);
+  vec3 n = vec3(p, 1.f - abs(p.x) - abs(p.y));
+  float t = max(-n.z, 0.f);
+  n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.f)));
+
+  return normalize(n);
+}
+
+vec3 getVertexNormal(uint vertexIdx) {
+  return decodeNormal(vertexNormals[vertexIdx]);
+}
+
+vec3 getTriGeometricNormal(uint triIdx) {
+  uint i = triIdx * (PACKED_TRIANGLE_EDGE_WORDS / 4u);
+  return vec3(triEdges[i].w, triEdges[i + 1u].w, triEdges[i + 2u].w);
+}
+
+// Reads the precomputed edges only, the normal is left for calcTriangleNormal
+HitInfo rayTriangle(Ray ray, uint triIdx) {
+  uint i = triIdx * (PACKED_TRIANGLE_EDGE_WORDS / 4u);
+  vec4 a = triEdges[i];
+  vec4 ab = triEdges[i + 1u];
+  vec4 ac = triEdges[i + 2u];
+  vec3 triNormal = vec3(a.w, ab.w, ac.w);
+  vec3 ao = ray.origin - a.xyz;
   vec3 dao = cross(ao, ray.dir);
 
   float determinant = -dot(ray.dir, triNormal);
   float invDet = 1.f / determinant;
 
   float dst = dot(ao, triNormal) * invDet;
-  float u =  dot(ac, dao) * invDet;
-  float v = -dot(ab, dao) * invDet;
+  float u =  dot(ac.xyz, dao) * invDet;
+  float v = -dot(ab.xyz, dao) * invDet;
   float w = 1.f - u - v;
 
-  HitInfo hitInfo;
+  HitInfo hitInfo = hitInfoInit;
   hitInfo.didHit = determinant >= 1e-6f && dst >= 0.f && u >= 0.f && v >= 0.f && w >= 0.f;
-  hitInfo.hitPoint = ray.origin + ray.dir * dst;
-  hitInfo.normal = normalize(tri.normalA * w + tri.normalB * u + tri.normalC * v);
   hitInfo.dst = dst;
+  hitInfo.triIdx = triIdx;
+  hitInfo.barycentric = vec2(u, v);
 
   return hitInfo;
 }
 
+// Per ray part of rayTriangleWatertight, see intersect::calcRayShear
+struct RayShear {
+  ivec3 k;
+  vec3 s;
+};
+
+RayShear calcRayShear(Ray ray) {
+  vec3 absDir = abs(ray.dir);
+  int kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+  int kx = (kz + 1) % 3;
+  int ky = (kx + 1) % 3;
+  if (ray.dir[kz] < 0.f) {
+    int k = kx;
+    kx = ky;
+    ky = k;
+  }
+
+  return RayShear(ivec3(kx, ky, kz), vec3(ray.dir[kx], ray.dir[ky], 1.f) / ray.dir[kz]);
+}
+
+// Same as intersect::rayTriangleWatertight without the double precision fallback: an edge function of exactly 0 is
+// accepted by both triangles of the edge, so the ray can't leak through
+HitInfo rayTriangleWatertight(Ray ray, RayShear shear, uint triIdx) {
+  uvec3 tri = getTriIndices(triIdx);
+  vec3 pa = getVertexPosition(tri.x) - ray.origin;
+  vec3 pb = getVertexPosition(tri.y) - ray.origin;
+  vec3 pc = getVertexPosition(tri.z) - ray.origin;
+
+  vec2 a = vec2(pa[shear.k.x], pa[shear.k.y]) - shear.s.xy * pa[shear.k.z];
+  vec2 b = vec2(pb[shear.k.x], pb[shear.k.y]) - shear.s.xy * pb[shear.k.z];
+  vec2 c = vec2(pc[shear.k.x], pc[shear.k.y]) - shear.s.xy * pc[shear.k.z];
+
+  float u = c.x * b.y - c.y * b.x;
+  float v = a.x * c.y - a.y * c.x;
+  float w = b.x * a.y - b.y * a.x;
+  float determinant = u + v + w;
+  float dst = (u * pa[shear.k.z] + v * pb[shear.k.z] + w * pc[shear.k.z]) * shear.s.z / determinant;
+
+  HitInfo hitInfo = hitInfoInit;
+  hitInfo.didHit = u >= 0.f && v >= 0.f && w >= 0.f && determinant > 0.f && dst >= 0.f;
+  hitInfo.dst = dst;
+  hitInfo.triIdx = triIdx;
+  hitInfo.barycentric = vec2(v, w) / determinant;
+
+  return hitInfo;
+}
+
+HitInfo intersectTriangle(Ray ray, RayShear shear, uint triIdx) {
+  return u_useWatertight ? rayTriangleWatertight(ray, shear, triIdx) : rayTriangle(ray, triIdx);
+}
+
+vec3 calcTriangleNormal(uint triIdx, vec2 barycentric) {
+  uvec3 tri = getTriIndices(triIdx);
+  float w = 1.f - barycentric.x - barycentric.y;
+
+  return normalize(getVertexNormal(tri.x) * w + getVertexNormal(tri.y) * barycentric.x + getVertexNormal(tri.z) * barycentric.y);
+}
+
 bool rayInBoundingBox(Ray ray, vec3 boundsMin, vec3 boundsMax) {
   vec3 invDir = 1.f / ray.dir;
   vec3 tMin = (boundsMin - ray.origin) * invDir;
@@ -173,73 +371,380 @@ bool rayInBoundingBox(Ray ray, vec3 boundsMin, vec3 boundsMax) {
   return tNear <= tFar;
 }
 
-HitInfo calcRayCollision(Ray ray) {
-  HitInfo closestHit = hitInfoInit;
-  closestHit.dst = FLT_MAX;
+// Distance to the box along the ray (0 if the origin is inside), FLT_MAX on miss
+float rayBoundingBoxDst(Ray ray, vec3 invDir, vec3 boundsMin, vec3 boundsMax) {
+  vec3 tMin = (boundsMin - ray.origin) * invDir;
+  vec3 tMax = (boundsMax - ray.origin) * invDir;
+  vec3 t1 = min(tMin, tMax);
+  vec3 t2 = max(tMin, tMax);
+  float tNear = max(max(t1.x, t1.y), t1.z);
+  float tFar  = min(min(t2.x, t2.y), t2.z) * RAY_BOX_FAR_SCALE; // See intersect::rayBoundingBoxDst
 
-  for (int i = 0; i < u_numSpheres; i++) {
-    Sphere sphere = spheres[i];
-    HitInfo hitInfo = raySphere(ray, sphere.pos, sphere.r);
+  bool didHit = tFar >= tNear && tFar > 0.f;
+  return didHit ? max(tNear, 0.f) : FLT_MAX;
+}
+
+uint getBVHTriIndex(uint i) {
+  return bvhTriIndices[i];
+}
+
+uint getTLASInstIndex(uint i) {
+  return tlasInstIndices[i >> 2u][i & 3u];
+}
+
+uint getWideBVHWord(uint i) {
+  return wideBVHNodes[i];
+}
 
-    if (hitInfo.didHit && hitInfo.dst < closestHit.dst) {
-      closestHit = hitInfo;
-      closestHit.material = sphere.material;
+uint getWideBVHByte(uint nodeBase, uint i) {
+  return (getWideBVHWord(nodeBase + 4u + (i >> 2u)) >> ((i & 3u) * 8u)) & 0xffu;
+}
+
+uint getSphereIndex(uint i) {
+  return sphereIndices[i];
+}
+
+Ray transformRay(Ray ray, mat4 m) {
+  Ray r;
+  r.origin = (m * vec4(ray.origin, 1.f)).xyz;
+  r.dir = (m * vec4(ray.dir, 0.f)).xyz; // Not normalized, so distances stay the same in both spaces
+
+  return r;
+}
+
+// The ray is in the object space of the mesh. Returns true if the closest hit got updated
+bool traverseBLAS(Ray ray, uint rootNodeIdx, inout HitInfo closestHit) {
+  vec3 invDir = 1.f / ray.dir;
+  RayShear shear = calcRayShear(ray);
+  bool didHit = false;
+
+  if (rayBoundingBoxDst(ray, invDir, bvhNodes[rootNodeIdx].boundsMin, bvhNodes[rootNodeIdx].boundsMax) >= closestHit.dst)
+    return false;
+
+  uint stack[BVH_STACK_SIZE];
+  int stackSize = 0;
+  stack[stackSize++] = rootNodeIdx;
+
+  while (stackSize > 0) {
+    BVHNode node = bvhNodes[stack[--stackSize]];
+
+    if (node.numPrimitives > 0u) {
+      for (uint i = 0u; i < node.numPrimitives; i++) {
+        HitInfo hitInfo = intersectTriangle(ray, shear, getBVHTriIndex(node.leftFirst + i));
+
+        if (hitInfo.didHit && hitInfo.dst < closestHit.dst) {
+          closestHit = hitInfo;
+          didHit = true;
+        }
+      }
+    } else {
+      uint childIdxA = node.leftFirst;
+      uint childIdxB = node.leftFirst + 1u;
+      float dstA = rayBoundingBoxDst(ray, invDir, bvhNodes[childIdxA].boundsMin, bvhNodes[childIdxA].boundsMax);
+      float dstB = rayBoundingBoxDst(ray, invDir, bvhNodes[childIdxB].boundsMin, bvhNodes[childIdxB].boundsMax);
+
+      // Push the farther child first so the nearer one is visited first
+      bool isNearestA = dstA <= dstB;
+      float dstNear = isNearestA ? dstA : dstB;
+      float dstFar  = isNearestA ? dstB : dstA;
+      uint childIdxNear = isNearestA ? childIdxA : childIdxB;
+      uint childIdxFar  = isNearestA ? childIdxB : childIdxA;
+
+      if (dstFar  < closestHit.dst) stack[stackSize++] = childIdxFar;
+      if (dstNear < closestHit.dst) stack[stackSize++] = childIdxNear;
     }
   }
 
-  for (int i = 0; i < u_numMeshes; i++) {
-    MeshInfo meshInfo = meshesInfos[i];
+  return didHit;
+}
+
+// Same as traverseBLAS over the compressed wide layout (see WideBVH.hpp)
+bool traverseWideBLAS(Ray ray, uint rootNodeIdx, inout HitInfo closestHit) {
+  vec3 invDir = 1.f / ray.dir;
+  RayShear shear = calcRayShear(ray);
+  bool didHit = false;
+
+  uint stack[WIDE_BVH_STACK_SIZE];
+  int stackSize = 0;
+  stack[stackSize++] = rootNodeIdx;
 
-    if (rayInBoundingBox(ray, meshInfo.boundsMin, meshInfo.boundsMax))
-      for (int j = 0; j < meshInfo.numTriangles; j++) {
-        Triangle tri = triangles[meshInfo.firstTriangleIndex + j];
-        HitInfo hitInfo = rayTriangle(ray, tri);
+  while (stackSize > 0) {
+    uint ref = stack[--stackSize];
+
+    if ((ref & WIDE_BVH_LEAF_BIT) != 0u) {
+      uint first = ref & 0x00ffffffu;
+      uint count = (ref >> 24u) & 0x7fu;
+
+      for (uint i = 0u; i < count; i++) {
+        HitInfo hitInfo = intersectTriangle(ray, shear, getBVHTriIndex(first + i));
 
         if (hitInfo.didHit && hitInfo.dst < closestHit.dst) {
           closestHit = hitInfo;
-          closestHit.material = meshInfo.material;
+          didHit = true;
         }
       }
+      continue;
+    }
+
+    uint nodeBase = ref * WIDE_BVH_NODE_WORDS;
+    uint meta = getWideBVHWord(nodeBase + 3u);
+    uint numChildren = meta >> 24u;
+    vec3 origin = uintBitsToFloat(uvec3(getWideBVHWord(nodeBase), getWideBVHWord(nodeBase + 1u), getWideBVHWord(nodeBase + 2u)));
+    vec3 scale = uintBitsToFloat(uvec3(meta & 0xffu, (meta >> 8u) & 0xffu, (meta >> 16u) & 0xffu) << 23u);
+    uint refsBase = nodeBase + 4u + WIDE_BVH_WIDTH * 3u / 2u;
+
+    // Sorted far to near, so the nearest child ends up on top of the stack
+    float dsts[WIDE_BVH_WIDTH];
+    uint refs[WIDE_BVH_WIDTH];
+    uint numHits = 0u;
+
+    for (uint i = 0u; i < numChildren; i++) {
+      vec3 qMin = vec3(getWideBVHByte(nodeBase, i), getWideBVHByte(nodeBase, WIDE_BVH_WIDTH + i), getWideBVHByte(nodeBase, WIDE_BVH_WIDTH * 2u + i));
+      vec3 qMax = vec3(getWideBVHByte(nodeBase, WIDE_BVH_WIDTH * 3u + i), getWideBVHByte(nodeBase, WIDE_BVH_WIDTH * 4u + i), getWideBVHByte(nodeBase, WIDE_BVH_WIDTH * 5u + i));
+      float dst = rayBoundingBoxDst(ray, invDir, origin + qMin * scale, origin + qMax * scale);
+      if (dst >= closestHit.dst) continue;
+
+      uint j = numHits++;
+      for (; j > 0u && dsts[j - 1u] < dst; j--) {
+        dsts[j] = dsts[j - 1u];
+        refs[j] = refs[j - 1u];
+      }
+      dsts[j] = dst;
+      refs[j] = getWideBVHWord(refsBase + i);
+    }
+
+    for (uint i = 0u; i < numHits; i++)
+      stack[stackSize++] = refs[i];
+  }
+
+  return didHit;
+}
+
+// Returns the index of the hit instance or -1
+int traverseTLAS(Ray ray, inout HitInfo closestHit) {
+  vec3 invDir = 1.f / ray.dir;
+  int hitInstanceIdx = -1;
+
+  if (rayBoundingBoxDst(ray, invDir, tlasNodes[0].boundsMin, tlasNodes[0].boundsMax) >= closestHit.dst)
+    return hitInstanceIdx;
+
+  uint stack[BVH_STACK_SIZE];
+  int stackSize = 0;
+  stack[stackSize++] = 0u;
+
+  while (stackSize > 0) {
+    BVHNode node = tlasNodes[stack[--stackSize]];
+
+    if (node.numPrimitives > 0u) {
+      for (uint i = 0u; i < node.numPrimitives; i++) {
+        uint instanceIdx = getTLASInstIndex(node.leftFirst + i);
+        Ray objectRay = transformRay(ray, instances[instanceIdx].invTransform);
+        MeshInfo meshInfo = meshesInfos[instances[instanceIdx].meshIndex];
+        bool didHit = u_useWideBVH
+          ? traverseWideBLAS(objectRay, meshInfo.rootWideNodeIndex, closestHit)
+          : traverseBLAS(objectRay, meshInfo.rootNodeIndex, closestHit);
+
+        if (didHit)
+          hitInstanceIdx = int(instanceIdx);
+      }
+    } else {
+      uint childIdxA = node.leftFirst;
+      uint childIdxB = node.leftFirst + 1u;
+      float dstA = rayBoundingBoxDst(ray, invDir, tlasNodes[childIdxA].boundsMin, tlasNodes[childIdxA].boundsMax);
+      float dstB = rayBoundingBoxDst(ray, invDir, tlasNodes[childIdxB].boundsMin, tlasNodes[childIdxB].boundsMax);
+
+      bool isNearestA = dstA <= dstB;
+      float dstNear = isNearestA ? dstA : dstB;
+      float dstFar  = isNearestA ? dstB : dstA;
+      uint childIdxNear = isNearestA ? childIdxA : childIdxB;
+      uint childIdxFar  = isNearestA ? childIdxB : childIdxA;
+
+      if (dstFar  < closestHit.dst) stack[stackSize++] = childIdxFar;
+      if (dstNear < closestHit.dst) stack[stackSize++] = childIdxNear;
+    }
   }
 
+  return hitInstanceIdx;
+}
+
+void traverseSpheres(Ray ray, inout HitInfo closestHit) {
+  vec3 invDir = 1.f / ray.dir;
+
+  if (rayBoundingBoxDst(ray, invDir, sphereNodes[0].boundsMin, sphereNodes[0].boundsMax) >= closestHit.dst)
+    return;
+
+  uint stack[BVH_STACK_SIZE];
+  int stackSize = 0;
+  stack[stackSize++] = 0u;
+
+  while (stackSize > 0) {
+    BVHNode node = sphereNodes[stack[--stackSize]];
+
+    if (node.numPrimitives > 0u) {
+      for (uint i = 0u; i < node.numPrimitives; i++) {
+        Sphere sphere = spheres[getSphereIndex(node.leftFirst + i)];
+        HitInfo hitInfo = raySphere(ray, sphere.pos, sphere.r);
+
+        if (hitInfo.didHit && hitInfo.dst < closestHit.dst) {
+          closestHit = hitInfo;
+          closestHit.materialIdx = sphere.materialIdx;
+        }
+      }
+    } else {
+      uint childIdxA = node.leftFirst;
+      uint childIdxB = node.leftFirst + 1u;
+      float dstA = rayBoundingBoxDst(ray, invDir, sphereNodes[childIdxA].boundsMin, sphereNodes[childIdxA].boundsMax);
+      float dstB = rayBoundingBoxDst(ray, invDir, sphereNodes[childIdxB].boundsMin, sphereNodes[childIdxB].boundsMax);
+
+      bool isNearestA = dstA <= dstB;
+      float dstNear = isNearestA ? dstA : dstB;
+      float dstFar  = isNearestA ? dstB : dstA;
+      uint childIdxNear = isNearestA ? childIdxA : childIdxB;
+      uint childIdxFar  = isNearestA ? childIdxB : childIdxA;
+
+      if (dstFar  < closestHit.dst) stack[stackSize++] = childIdxFar;
+      if (dstNear < closestHit.dst) stack[stackSize++] = childIdxNear;
+    }
+  }
+}
+
+// Brings the object space hit of the instance to the world space and picks its material index
+void resolveInstanceHit(Ray ray, uint instanceIdx, inout HitInfo hitInfo) {
+  MeshInstance instance = instances[instanceIdx];
+  mat3 normalMatrix = transpose(mat3(instance.invTransform));
+
+  hitInfo.hitPoint = ray.origin + ray.dir * hitInfo.dst;
+  hitInfo.normal = normalize(normalMatrix * calcTriangleNormal(hitInfo.triIdx, hitInfo.barycentric));
+  hitInfo.geometricNormal = normalize(normalMatrix * getTriGeometricNormal(hitInfo.triIdx));
+
+  if ((instance.flags & RT_INSTANCE_FLAG_MATERIAL_OVERRIDE) != 0u)
+    hitInfo.materialIdx = instance.materialIdx;
+  else
+    hitInfo.materialIdx = meshesInfos[instance.meshIndex].materialIdx;
+}
+
+HitInfo calcRayCollision(Ray ray) {
+  HitInfo closestHit = hitInfoInit;
+  closestHit.dst = FLT_MAX;
+
+  if (u_useBVH && u_numSpheres > 0) {
+    traverseSpheres(ray, closestHit);
+  } else {
+    for (int i = 0; i < u_numSpheres; i++) {
+      Sphere sphere = spheres[i];
+      HitInfo hitInfo = raySphere(ray, sphere.pos, sphere.r);
+
+      if (hitInfo.didHit && hitInfo.dst < closestHit.dst) {
+        closestHit = hitInfo;
+        closestHit.materialIdx = sphere.materialIdx;
+      }
+    }
+  }
+
+  if (u_numInstances == 0)
+    return closestHit;
+
+  int hitInstanceIdx = -1;
+
+  if (u_useBVH) {
+    hitInstanceIdx = traverseTLAS(ray, closestHit);
+  } else {
+    // Brute force (validation mode)
+    for (int i = 0; i < u_numInstances; i++) {
+      Ray objectRay = transformRay(ray, instances[i].invTransform);
+      MeshInfo meshInfo = meshesInfos[instances[i].meshIndex];
+      RayShear shear = calcRayShear(objectRay);
+
+      if (rayInBoundingBox(objectRay, meshInfo.boundsMin, meshInfo.boundsMax))
+        for (int j = 0; j < meshInfo.numTriangles; j++) {
+          HitInfo hitInfo = intersectTriangle(objectRay, shear, meshInfo.firstTriangleIndex + uint(j));
+
+          if (hitInfo.didHit && hitInfo.dst < closestHit.dst) {
+            closestHit = hitInfo;
+            hitInstanceIdx = i;
+          }
+        }
+    }
+  }
+
+  if (hitInstanceIdx >= 0)
+    resolveInstanceHit(ray, uint(hitInstanceIdx), closestHit);
+
   return closestHit;
 }
 
-uint rngState = uint(gl_FragCoord.x + gl_FragCoord.y * u_resolution.x) + u_numRenderedFrames * 719393;
+uint getBlueNoise(uint i) {
+  return blueNoise[i];
+}
+
+#define SAMPLER_INOUT(T) inout T
+#include "rng.glsl"
+#include "sampler.glsl"
 
-float randomValue() {
-  rngState = rngState * 747796405 + 2891336453;
-  uint result = ((rngState >> ((rngState >> 28) + 4)) ^ rngState) * 277803737;
-  result = (result >> 22) ^ result;
+// Restarted before each path segment, so the CPU tracer draws the same samples
+SamplerState pathSampler;
 
-  return result / 4294967295.f;
+float sample1D() {
+  return samplerNext1D(pathSampler);
 }
 
-float randomValueNormalDistribution() {
-  float theta = 2.f * PI * randomValue();
-  float rho = sqrt(-2.f * log(randomValue()));
+vec2 sample2D() {
+  return samplerNext2D(pathSampler);
+}
 
-  return rho * cos(theta);
+// See intersect::offsetRayOrigin
+vec3 offsetRayOrigin(vec3 p, vec3 n) {
+  ivec3 ulps = ivec3(256.f * n);
+  vec3 offset = intBitsToFloat(floatBitsToInt(p) + mix(ulps, -ulps, lessThan(p, vec3(0.f))));
+
+  return mix(offset, p + n / 65536.f, lessThan(abs(p), vec3(1.f / 32.f)));
 }
 
-vec3 randomDirection() {
-  return normalize(vec3(
-    randomValueNormalDistribution(),
-    randomValueNormalDistribution(),
-    randomValueNormalDistribution()
-  ));
+struct LightSample {
+  vec3 pos;
+  vec3 normal;
+  vec3 emittedLight;
+};
+
+float calcLuminance(vec3 color) {
+  return dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
 }
 
-vec2 randomPointInCircle() {
-  float angle = randomValue() * 2.f * PI;
-  vec2 pointOnCircle = vec2(cos(angle), sin(angle));
+// Picks an emitter in proportion to luminance x area, then a uniform point on it. One sample picks the slot of the
+// alias table and, by its remainder, the alias
+LightSample sampleEmitter() {
+  float slot = sample1D() * float(u_numEmitters);
+  uint emitterIdx = min(uint(slot), uint(u_numEmitters - 1));
+  if (slot - float(emitterIdx) >= emitters[emitterIdx].probability)
+    emitterIdx = emitters[emitterIdx].alias;
+
+  Emitter emitter = emitters[emitterIdx];
+  LightSample lightSample;
+
+  if (emitter.type == EMITTER_TYPE_SPHERE) {
+    Sphere sphere = spheres[emitter.sphereIdx];
+    lightSample.normal = mapUniformSphere(sample2D());
+    lightSample.pos = sphere.pos + lightSample.normal * sphere.r;
+  } else {
+    vec2 barycentric = mapUniformTriangle(sample2D());
+    lightSample.pos = emitter.a + emitter.ab * barycentric.x + emitter.ac * barycentric.y;
+    lightSample.normal = normalize(cross(emitter.ab, emitter.ac));
+  }
+
+  RayTracingMaterial material = materials[emitter.materialIdx];
+  lightSample.emittedLight = material.emissionColor * material.emissionStrength;
 
-  return pointOnCircle * sqrt(randomValue());
+  return lightSample;
 }
 
-vec3 randomHemisphereDirection(vec3 normal) {
-  vec3 dir = randomDirection();
-  return dir * sign(dot(normal, dir));
+// Solid angle density of sampleEmitter towards a point at dst, seen under cosLight. The area density is the same
+// over every emitter (see calcEmitterLuminance)
+float calcLightPdf(vec3 emittedLight, float dst, float cosLight) {
+  return calcLuminance(emittedLight) / u_emittersPower * dst * dst / cosLight;
+}
+
+float powerHeuristic(float pdf, float otherPdf) {
+  return pdf * pdf / (pdf * pdf + otherPdf * otherPdf);
 }
 
 vec3 getEnvironmentLight(Ray ray) {
@@ -257,29 +762,82 @@ vec3 getEnvironmentLight(Ray ray) {
   return mix(u_groundColor, skyGradient, groundToSkyT) + sun * sunMask;
 }
 
-vec3 trace(Ray ray) {
+RayTracingMaterial getHitMaterial(HitInfo hitInfo) {
+  RayTracingMaterial material = materials[hitInfo.materialIdx];
+  if (material.flags & RT_MATERIAL_FLAG_CHECKERED_PATTERN) {
+    vec2 c = mod(floor(hitInfo.hitPoint.xz * 0.35f), 2.f);
+    material.color = c.x == c.y ? material.color : vec4(material.emissionColor, 1.f);
+  }
+
+  return material;
+}
+
+// Light sampling covers the diffuse lobe only: its directions are weighted against the diffuse bounces by the power
+// heuristic, the specular bounces keep all of the emission they hit. Not at the last bounce, whose emission the
+// bounces would never reach. Past u_rouletteMinBounces a path goes on with a chance of its throughput and is divided
+// by it, u_numRayBounces stays the cap
+vec3 trace(Ray ray, inout uint numSegments) {
   vec3 incomingLight = vec3(0.f);
   vec3 rayColor = vec3(1.f);
+  float bsdfPdf = 0.f; // Of the last diffuse bounce, 0 after the camera and the specular ones
+  bool useLightSampling = u_useLightSampling && u_numEmitters > 0;
 
   for (int i = 0; i < u_numRayBounces; i++) {
+    numSegments++;
     HitInfo hitInfo = calcRayCollision(ray);
     if (hitInfo.didHit) {
-      RayTracingMaterial material = hitInfo.material;
-      if (material.flags & RT_MATERIAL_FLAG_CHECKERED_PATTERN) {
-        vec2 c = mod(floor(hitInfo.hitPoint.xz * 0.35f), 2.f);
-        material.color = c.x == c.y ? material.color : vec4(material.emissionColor, 1.f);
+      samplerStartBounce(pathSampler, uint(i + 1));
+
+      RayTracingMaterial material = getHitMaterial(hitInfo);
+
+      vec3 emittedLight = material.emissionColor * material.emissionStrength;
+      float emissionWeight = 1.f;
+      if (useLightSampling && bsdfPdf > 0.f && calcLuminance(emittedLight) > 0.f) {
+        float lightPdf = calcLightPdf(emittedLight, hitInfo.dst, abs(dot(hitInfo.geometricNormal, ray.dir)));
+        emissionWeight = powerHeuristic(bsdfPdf, lightPdf);
+      }
+      incomingLight += emittedLight * rayColor * emissionWeight;
+
+      float diffuseProbability = clamp(1.f - material.specularProbability, 0.f, 1.f);
+      if (useLightSampling && diffuseProbability > 0.f && i + 1 < u_numRayBounces) {
+        LightSample lightSample = sampleEmitter();
+        vec3 toLight = lightSample.pos - hitInfo.hitPoint;
+        float lightDst = length(toLight);
+        vec3 lightDir = toLight / lightDst;
+        float cosSurface = dot(hitInfo.normal, lightDir);
+        float cosLight = -dot(lightSample.normal, lightDir); // Triangles are hit from the front only
+
+        if (cosSurface > 0.f && cosLight > 0.f) {
+          Ray shadowRay;
+          shadowRay.dir = lightDir;
+          shadowRay.origin = offsetRayOrigin(hitInfo.hitPoint, hitInfo.geometricNormal * sign(dot(lightDir, hitInfo.geometricNormal)));
+          HitInfo shadowHit = calcRayCollision(shadowRay);
+
+          if (!shadowHit.didHit || shadowHit.dst >= lightDst * 0.999f) {
+            float lightPdf = calcLightPdf(lightSample.emittedLight, lightDst, cosLight);
+            float lightBsdfPdf = diffuseProbability * cosSurface / PI;
+            incomingLight += lightSample.emittedLight * material.color.rgb * rayColor * (lightBsdfPdf / lightPdf * powerHeuristic(lightPdf, lightBsdfPdf));
+          }
+        }
       }
 
-      ray.origin = hitInfo.hitPoint;
-      vec3 diffuseDir = normalize(hitInfo.normal + randomDirection());
+      vec3 diffuseDir = mapCosineHemisphere(sample2D(), hitInfo.normal);
       vec3 specularDir = reflect(ray.dir, hitInfo.normal);
-      float isSpecularBounce = float(material.specularProbability >= randomValue());
-      ray.dir = mix(diffuseDir, specularDir, hitInfo.material.smoothness * isSpecularBounce);
+      float isSpecularBounce = float(material.specularProbability >= sample1D());
+      ray.dir = mix(diffuseDir, specularDir, material.smoothness * isSpecularBounce);
+      ray.origin = offsetRayOrigin(hitInfo.hitPoint, hitInfo.geometricNormal * sign(dot(ray.dir, hitInfo.geometricNormal)));
 
-      vec3 emittedLight = material.emissionColor * material.emissionStrength;
-      incomingLight += emittedLight * rayColor;
+      bsdfPdf = (1.f - isSpecularBounce) * diffuseProbability * max(dot(hitInfo.normal, ray.dir), 0.f) / PI;
       rayColor *= mix(material.color.rgb, material.specularColor, isSpecularBounce);
 
+      if (u_useRussianRoulette && i + 1 >= u_rouletteMinBounces) {
+        float survivalProbability = min(max(rayColor.r, max(rayColor.g, rayColor.b)), 1.f);
+        if (sample1D() >= survivalProbability)
+          break;
+
+        rayColor /= survivalProbability;
+      }
+
     } else {
       incomingLight += getEnvironmentLight(ray) * rayColor;
       break;
@@ -289,24 +847,93 @@ vec3 trace(Ray ray) {
   return incomingLight;
 }
 
+Ray generateCameraRay() {
+  Ray ray;
+  vec2 defocusJitter = mapConcentricDisk(sample2D()) * u_defocusStrength / u_resolution.x;
+  ray.origin = u_camPos + u_camRight * defocusJitter.x + u_camUp * defocusJitter.y;
+
+  vec2 jitter = mapConcentricDisk(sample2D()) * u_divergeStrength / u_resolution.x;
+  vec3 jitteredViewPoint = calcViewPoint() + u_camRight * jitter.x + u_camUp * jitter.y;
+  ray.dir = normalize(jitteredViewPoint - u_camPos);
+
+  return ray;
+}
+
+// First hits of the camera rays of the first RT_DENOISE_FEATURE_RAYS samples of the pixel, averaged: the same every
+// frame until the camera or the scene moves, and a pixel over an edge gets features between the ones of both sides, so
+// it is blended into neither
+void writeDenoiseFeatures(uvec2 pixel, uint pixelIdx) {
+  vec3 albedo = vec3(0.f);
+  vec4 normalDepth = vec4(0.f);
+
+  for (uint i = 0u; i < RT_DENOISE_FEATURE_RAYS; i++) {
+    pathSampler = samplerStart(uint(u_samplerType), pixel, pixelIdx, i);
+    Ray ray = generateCameraRay();
+    HitInfo hitInfo = calcRayCollision(ray);
+
+    if (hitInfo.didHit) {
+      albedo += getHitMaterial(hitInfo).color.rgb;
+      normalDepth += vec4(hitInfo.normal, hitInfo.dst);
+    } else {
+      albedo += vec3(1.f);
+      normalDepth += vec4(-ray.dir, RT_DENOISE_MISS_DEPTH);
+    }
+  }
+
+  FragAlbedo = vec4(albedo / float(RT_DENOISE_FEATURE_RAYS), 1.f);
+  FragNormalDepth = vec4(normalize(normalDepth.xyz), normalDepth.w / float(RT_DENOISE_FEATURE_RAYS));
+}
+
+// Rays of the pixel in this pass: u_numRaysPerPixel until it has u_adaptiveMinSpp samples, then none once its error
+// and the one of its tile are under the threshold, more the further the larger one is above it. The tile keeps a
+// pixel whose few samples look converged going with its noisy neighbours
+int calcNumRays(ivec2 pixel, float numSamples) {
+  if (!u_useAdaptiveSampling || numSamples < float(u_adaptiveMinSpp))
+    return u_numRaysPerPixel;
+
+  ivec2 tile = min(pixel >> RT_ADAPTIVE_TILE_LOD, textureSize(u_screenErrorTex, RT_ADAPTIVE_TILE_LOD) - 1);
+  float pixelError = texelFetch(u_screenErrorTex, pixel, 0).r;
+  float tileError = texelFetch(u_screenErrorTex, tile, RT_ADAPTIVE_TILE_LOD).r;
+  float error = max(pixelError, tileError);
+  if (error < u_adaptiveThreshold)
+    return 0;
+
+  return u_numRaysPerPixel * int(min(uint(error / u_adaptiveThreshold), RT_ADAPTIVE_MAX_RAYS_SCALE));
+}
+
 void main() {
   vec3 color = texture(u_screenColorTexDefault, texCoord).rgb; // the pixel from default drawing
   vec3 totalIncomingLight = vec3(0.f);
+  uvec2 pixel = uvec2(gl_FragCoord.xy);
+  uint pixelIdx = pixel.x + pixel.y * uint(u_resolution.x);
+  uint numPathSegments = 0u;
+
+  // The samples of a pixel go on from the ones it has, the first frame starts over
+  float numSamples = u_numRenderedFrames > 1 ? texelFetch(u_screenStatsTexOld, ivec2(pixel), 0).x : 0.f;
+  int numRays = calcNumRays(ivec2(pixel), numSamples);
+
+  for (int i = 0; i < numRays; i++) {
+    uint sampleIdx = uint(numSamples) + uint(i);
+    pathSampler = samplerStart(uint(u_samplerType), pixel, pixelIdx, sampleIdx);
+    totalIncomingLight += trace(generateCameraRay(), numPathSegments);
+  }
 
-  for (int i = 0; i < u_numRaysPerPixel; i++) {
-    Ray ray;
-    vec2 defocusJitter = randomPointInCircle() * u_defocusStrength / u_resolution.x;
-    ray.origin = u_camPos + u_camRight * defocusJitter.x + u_camUp * defocusJitter.y;
-
-    vec2 jitter = randomPointInCircle() * u_divergeStrength / u_resolution.x;
-    vec3 jitteredViewPoint = calcViewPoint() + u_camRight * jitter.x + u_camUp * jitter.y;
-    ray.dir = normalize(jitteredViewPoint - u_camPos);
-
-    totalIncomingLight += trace(ray);
+  if (all(equal(pixel % RT_PATH_STATS_STRIDE, uvec2(0u)))) {
+    atomicAdd(numStatsPaths, uint(numRays));
+    atomicAdd(numStatsPathSegments, numPathSegments);
   }
 
-  color += totalIncomingLight / u_numRaysPerPixel;
+  if (numRays > 0)
+    color += totalIncomingLight / float(numRays);
 
   FragColor = vec4(color, 1.f);
+  FragNumRays = float(numRays);
+
+  if (u_updateDenoiseFeatures)
+    writeDenoiseFeatures(pixel, pixelIdx);
+  else {
+    FragAlbedo = vec4(0.f);
+    FragNormalDepth = vec4(0.f);
+  }
 }
 
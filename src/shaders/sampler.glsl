@@ -0,0 +1,196 @@
+// Samples of the path tracers, shared by rt.frag and the CPU tracer (tracer/PathSampler.hpp) like rng.glsl, which
+// it needs. The includer defines RNG_FN, SAMPLER_INOUT(T) (an inout parameter or a reference) and
+// getBlueNoise(i), the rank of pixel i of the blue noise tile (engine/BlueNoise.hpp)
+//
+// Every draw of a path segment has its own dimension, bounce * RT_SAMPLER_BOUNCE_DIMENSIONS on. A dimension is a
+// 1D or 2D sequence whose sample index is shuffled by a nested uniform scramble seeded from the dimension, so the
+// dimensions are independent while the first 2^m samples of each stay the same set (Burley, "Practical Hash-based
+// Owen Scrambling"):
+// - RT_SAMPLER_RANDOM: the hash RNG of rng.glsl, white noise
+// - RT_SAMPLER_SOBOL: the first two Sobol dimensions, Owen scrambled per pixel
+// - RT_SAMPLER_LATTICE: a rank-1 lattice sequence shared by the pixels, each rotated (Cranley-Patterson) by its
+//   blue noise rank, so the error left after a few samples is blue noise
+
+#ifndef RNG_FN
+#define RNG_FN
+#endif
+
+#define SAMPLER_SHARED_SEED 0xffffffffu // In place of the pixel for the seeds shared by the pixels
+#define LATTICE_GENERATOR uvec2(1u, 182667u) // Cools, Kuo and Nuyens, "lattice-39102-1024-1048576.3600"
+
+struct SamplerState {
+  uint type;
+  uvec2 pixel;
+  uint pixelIdx;
+  uint sampleIdx;
+  uint dimension;
+  uint rngState;
+};
+
+RNG_FN uint reverseBits(uint x) {
+#ifdef GL_core_profile
+  return bitfieldReverse(x);
+#else
+  x = ((x >> 1u) & 0x55555555u) | ((x & 0x55555555u) << 1u);
+  x = ((x >> 2u) & 0x33333333u) | ((x & 0x33333333u) << 2u);
+  x = ((x >> 4u) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4u);
+  x = ((x >> 8u) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8u);
+  return (x >> 16u) | (x << 16u);
+#endif
+}
+
+// Owen scramble of the bits read from the lowest one: a bit only changes with the ones under it. Vegdahl's
+// constants for the Laine-Karras hash
+RNG_FN uint laineKarrasPermutation(uint x, uint seed) {
+  x ^= x * 0x3d20adeau;
+  x += seed;
+  x *= (seed >> 16u) | 1u;
+  x ^= x * 0x05526c56u;
+  x ^= x * 0x53a22864u;
+  return x;
+}
+
+// Owen scramble of the bits read from the highest one
+RNG_FN uint nestedUniformScramble(uint x, uint seed) {
+  return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// The second Sobol dimension with its fraction bits reversed, the first one reversed is the index. Its generator
+// matrix is Pascal's triangle modulo 2: bit j is the XOR of the index bits k whose position contains j bitwise
+// (Lucas), 5 steps instead of a loop over the direction numbers
+RNG_FN uint sobol1Reversed(uint index) {
+  index ^= (index >> 1u) & 0x55555555u;
+  index ^= (index >> 2u) & 0x33333333u;
+  index ^= (index >> 4u) & 0x0f0f0f0fu;
+  index ^= (index >> 8u) & 0x00ff00ffu;
+  index ^= (index >> 16u) & 0x0000ffffu;
+  return index;
+}
+
+// In (0, 1) with 23 bits, as rngToFloat
+RNG_FN float samplerToFloat(uint x) {
+  return float(x >> 9u) * (1.f / 8388608.f) + (0.5f / 8388608.f);
+}
+
+RNG_FN uvec3 calcSamplerSeeds(uint pixelIdx, uint dimension) {
+  return pcg3d(uvec3(pixelIdx, dimension, 0x5a3d1e57u));
+}
+
+// Bits of the rotation of a pixel: its rank at a tile offset given by the seed, the seed fills the bits below
+RNG_FN uint calcBlueNoiseShift(uvec2 pixel, uint seed) {
+  uint x = (pixel.x + seed) % BLUE_NOISE_SIZE;
+  uint y = (pixel.y + (seed >> 8u)) % BLUE_NOISE_SIZE;
+
+  return (getBlueNoise(x + y * BLUE_NOISE_SIZE) << (32u - BLUE_NOISE_BITS)) | (seed >> BLUE_NOISE_BITS);
+}
+
+RNG_FN SamplerState samplerStart(uint type, uvec2 pixel, uint pixelIdx, uint sampleIdx) {
+  SamplerState s;
+  s.type = type;
+  s.pixel = pixel;
+  s.pixelIdx = pixelIdx;
+  s.sampleIdx = sampleIdx;
+  s.dimension = 0u;
+  s.rngState = rngSeed(pixelIdx, sampleIdx, 0u);
+
+  return s;
+}
+
+// Bounce 0 is the camera ray, bounce i + 1 scatters the i-th hit
+RNG_FN void samplerStartBounce(SAMPLER_INOUT(SamplerState) s, uint bounce) {
+  s.dimension = bounce * RT_SAMPLER_BOUNCE_DIMENSIONS;
+  s.rngState = rngSeed(s.pixelIdx, s.sampleIdx, bounce);
+}
+
+RNG_FN float samplerNext1D(SAMPLER_INOUT(SamplerState) s) {
+  uint dimension = s.dimension++;
+  if (s.type == RT_SAMPLER_RANDOM) {
+    s.rngState = rngStep(s.rngState);
+    return rngToFloat(s.rngState);
+  }
+
+  if (s.type == RT_SAMPLER_SOBOL) {
+    uvec3 seeds = calcSamplerSeeds(s.pixelIdx, dimension);
+    uint index = nestedUniformScramble(s.sampleIdx, seeds.x);
+    return samplerToFloat(reverseBits(laineKarrasPermutation(index, seeds.y)));
+  }
+
+  // The radical inverse of the shuffled index
+  uint radicalInverse = laineKarrasPermutation(reverseBits(s.sampleIdx), calcSamplerSeeds(SAMPLER_SHARED_SEED, dimension).x);
+  uint shift = calcBlueNoiseShift(s.pixel, calcSamplerSeeds(s.pixelIdx, dimension).x);
+  return samplerToFloat(radicalInverse + shift);
+}
+
+RNG_FN vec2 samplerNext2D(SAMPLER_INOUT(SamplerState) s) {
+  uint dimension = s.dimension++;
+  if (s.type == RT_SAMPLER_RANDOM) {
+    s.rngState = rngStep(s.rngState);
+    float x = rngToFloat(s.rngState);
+    s.rngState = rngStep(s.rngState);
+    float y = rngToFloat(s.rngState);
+    return vec2(x, y);
+  }
+
+  if (s.type == RT_SAMPLER_SOBOL) {
+    uvec3 seeds = calcSamplerSeeds(s.pixelIdx, dimension);
+    uint index = nestedUniformScramble(s.sampleIdx, seeds.x);
+    uint x = reverseBits(laineKarrasPermutation(index, seeds.y));
+    uint y = reverseBits(laineKarrasPermutation(sobol1Reversed(index), seeds.z));
+    return vec2(samplerToFloat(x), samplerToFloat(y));
+  }
+
+  // The radical inverse of the shuffled index times the generator, modulo 1 in 32 bit fixed point
+  uint radicalInverse = laineKarrasPermutation(reverseBits(s.sampleIdx), calcSamplerSeeds(SAMPLER_SHARED_SEED, dimension).x);
+  uvec3 seeds = calcSamplerSeeds(s.pixelIdx, dimension);
+  uvec2 p = LATTICE_GENERATOR * radicalInverse;
+  p += uvec2(calcBlueNoiseShift(s.pixel, seeds.x), calcBlueNoiseShift(s.pixel, seeds.y));
+  return vec2(samplerToFloat(p.x), samplerToFloat(p.y));
+}
+
+// ===== Mappings of [0, 1)^2, one sample each ===== //
+
+// Shirley and Chiu, keeps the strata of the square
+RNG_FN vec2 mapConcentricDisk(vec2 u) {
+  vec2 p = u * 2.f - 1.f;
+  if (p.x == 0.f && p.y == 0.f)
+    return vec2(0.f);
+
+  float r, theta;
+  if (abs(p.x) > abs(p.y)) {
+    r = p.x;
+    theta = (PI / 4.f) * (p.y / p.x);
+  } else {
+    r = p.y;
+    theta = PI / 2.f - (PI / 4.f) * (p.x / p.y);
+  }
+
+  return r * vec2(cos(theta), sin(theta));
+}
+
+// Cosine weighted around n, the disk lifted on the orthonormal basis of Duff et al.
+RNG_FN vec3 mapCosineHemisphere(vec2 u, vec3 n) {
+  vec2 d = mapConcentricDisk(u);
+  float z = sqrt(max(0.f, 1.f - d.x * d.x - d.y * d.y));
+
+  float s = n.z >= 0.f ? 1.f : -1.f;
+  float a = -1.f / (s + n.z);
+  float b = n.x * n.y * a;
+  vec3 tangent = vec3(1.f + s * n.x * n.x * a, s * b, -s * n.x);
+  vec3 bitangent = vec3(b, s + n.y * n.y * a, -n.y);
+
+  return normalize(tangent * d.x + bitangent * d.y + n * z);
+}
+
+RNG_FN vec3 mapUniformSphere(vec2 u) {
+  float z = 1.f - 2.f * u.x;
+  float r = sqrt(max(0.f, 1.f - z * z));
+  float phi = 2.f * PI * u.y;
+
+  return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+// Barycentric weights of b and c
+RNG_FN vec2 mapUniformTriangle(vec2 u) {
+  float su = sqrt(u.x);
+  return vec2(su * (1.f - u.y), su * u.y);
+}
@@ -1,12 +1,14 @@
 #version 460 core
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec2 FragStats;
 
 in vec2 texCoord;
 
 uniform sampler2D u_screenColorTexFinal;
+uniform sampler2D u_screenStatsTexFinal;
 
 void main() {
 	FragColor = texture(u_screenColorTexFinal, texCoord);
+	FragStats = texture(u_screenStatsTexFinal, texCoord).xy;
 }
-
@@ -0,0 +1,117 @@
+#include "Denoiser.hpp"
+
+#include <algorithm>
+
+#define DENOISER_ROWS_PER_TASK 8u
+
+namespace denoise {
+
+// Color and variance of every pixel, what denoise.frag keeps in its RGBA targets
+using DenoiseImage = std::vector<vec4>;
+
+static void runRows(uvec2 resolution, TileScheduler& scheduler, const std::function<void(uvec2)>& pixelFunc) {
+  scheduler.run(uvec2(1u, (resolution.y + DENOISER_ROWS_PER_TASK - 1) / DENOISER_ROWS_PER_TASK), [&](uvec2 task, u32) {
+    u32 rowEnd = std::min((task.y + 1) * DENOISER_ROWS_PER_TASK, resolution.y);
+    for (u32 y = task.y * DENOISER_ROWS_PER_TASK; y < rowEnd; y++)
+      for (u32 x = 0; x < resolution.x; x++)
+        pixelFunc({x, y});
+  });
+}
+
+// estimateVariance of denoise.frag
+static DenoiseImage estimateVariance(
+  uvec2 resolution, const std::vector<vec3>& mean, const std::vector<float>& meanSquaredLuminance, u32 numPasses,
+  TileScheduler& scheduler
+) {
+  DenoiseImage image(mean.size());
+  ivec2 size(resolution);
+
+  runRows(resolution, scheduler, [&](uvec2 pixel) {
+    u32 idx = pixel.x + pixel.y * resolution.x;
+    float variance = calcPassesVariance(meanSquaredLuminance[idx], denoiseLuminance(mean[idx]), static_cast<float>(numPasses));
+
+    if (variance < 0.f) {
+      float sum = 0.f;
+      float sumSquares = 0.f;
+      for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++) {
+          ivec2 q = glm::clamp(ivec2(pixel) + ivec2(x, y), ivec2(0), size - 1);
+          float luminance = denoiseLuminance(mean[q.x + q.y * size.x]);
+          sum += luminance;
+          sumSquares += luminance * luminance;
+        }
+
+      variance = std::max(sumSquares / 9.f - sum * sum / 81.f, 0.f);
+    }
+
+    image[idx] = vec4(mean[idx], variance);
+  });
+
+  return image;
+}
+
+// calcPrefilteredVariance and filterIteration of denoise.frag
+static DenoiseImage filterIteration(
+  uvec2 resolution, const DenoiseImage& input, const std::vector<DenoiseFeature>& features, int step, TileScheduler& scheduler
+) {
+  DenoiseImage output(input.size());
+  ivec2 size(resolution);
+
+  runRows(resolution, scheduler, [&](uvec2 pixel) {
+    u32 idx = pixel.x + pixel.y * resolution.x;
+
+    float prefilteredVariance = 0.f;
+    for (int y = -1; y <= 1; y++)
+      for (int x = -1; x <= 1; x++) {
+        ivec2 q = glm::clamp(ivec2(pixel) + ivec2(x, y), ivec2(0), size - 1);
+        prefilteredVariance += input[q.x + q.y * size.x].a * (x == 0 ? 0.5f : 0.25f) * (y == 0 ? 0.5f : 0.25f);
+      }
+
+    const DenoiseFeature& feature = features[idx];
+    float luminance = denoiseLuminance(vec3(input[idx]));
+    float luminanceDeviation = std::sqrt(prefilteredVariance);
+
+    vec3 colorSum(0.f);
+    float varianceSum = 0.f;
+    float weightSum = 0.f;
+    for (int y = -2; y <= 2; y++)
+      for (int x = -2; x <= 2; x++) {
+        ivec2 q = ivec2(pixel) + ivec2(x, y) * step;
+        if (q.x < 0 || q.y < 0 || q.x >= size.x || q.y >= size.y)
+          continue;
+
+        const vec4& tap = input[q.x + q.y * size.x];
+        float edgeWeight = calcEdgeWeight(
+          feature, features[q.x + q.y * size.x], luminance, denoiseLuminance(vec3(tap)), luminanceDeviation,
+          glm::length(vec2(x, y)) * static_cast<float>(step)
+        );
+        float weight = getAtrousTap(x) * getAtrousTap(y) * edgeWeight;
+
+        colorSum += vec3(tap) * weight;
+        varianceSum += tap.a * weight * weight;
+        weightSum += weight;
+      }
+
+    weightSum = std::max(weightSum, 1e-6f);
+    output[idx] = vec4(colorSum / weightSum, varianceSum / (weightSum * weightSum));
+  });
+
+  return output;
+}
+
+std::vector<vec3> filter(
+  uvec2 resolution, const std::vector<vec3>& mean, const std::vector<float>& meanSquaredLuminance, u32 numPasses,
+  const std::vector<DenoiseFeature>& features, int numIterations, TileScheduler& scheduler
+) {
+  DenoiseImage image = estimateVariance(resolution, mean, meanSquaredLuminance, numPasses, scheduler);
+  for (int i = 1; i <= numIterations; i++)
+    image = filterIteration(resolution, image, features, 1 << (i - 1), scheduler);
+
+  std::vector<vec3> filtered(image.size());
+  for (size_t i = 0; i < image.size(); i++)
+    filtered[i] = vec3(image[i]);
+
+  return filtered;
+}
+
+} // namespace denoise
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "../objects/RayTracingData.hpp"
+#include "../engine/TileScheduler.hpp"
+
+namespace denoise {
+  using std::abs;
+  using std::exp;
+  using std::max;
+  using std::pow;
+  using glm::dot;
+
+#define DENOISE_FN inline
+#include "../shaders/denoise.glsl"
+#undef DENOISE_FN
+
+  // The passes of denoise.frag over an image of the CPU tracer (row-major, bottom row first): mean of the frames,
+  // mean of their squared luminance and first hit features of every pixel. Rows of the image are spread over the
+  // scheduler
+  std::vector<vec3> filter(
+    uvec2 resolution, const std::vector<vec3>& mean, const std::vector<float>& meanSquaredLuminance, u32 numPasses,
+    const std::vector<DenoiseFeature>& features, int numIterations, TileScheduler& scheduler
+  );
+}
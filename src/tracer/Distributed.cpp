@@ -0,0 +1,343 @@
+#include "Distributed.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+#include "../objects/Scene.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+static std::string getExecutablePath() {
+#ifdef _WIN32
+  char path[MAX_PATH];
+  DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+  return std::string(path, length);
+#else
+  std::error_code errorCode;
+  return std::filesystem::read_symlink("/proc/self/exe", errorCode).string();
+#endif
+}
+
+static double getSecondsSince(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - time).count();
+}
+
+TileCoordinator::TileCoordinator(const DistributedConfig& config, u16 port) : config(config) {
+  listener = Socket::listen(port);
+
+  size_t numPixels = static_cast<size_t>(config.resolution.x) * config.resolution.y;
+  accumulated.resize(numPixels, vec3(0.f));
+  numPixelFrames.resize(numPixels, 0);
+}
+
+// The listener goes first: a worker still in its backlog would otherwise wait for its config forever. The others get
+// a stop, or see their connection close once they're done loading
+TileCoordinator::~TileCoordinator() {
+  listener.close();
+
+  TileJob stop;
+  for (const std::unique_ptr<Worker>& worker : workers)
+    worker->socket.send(stop);
+  workers.clear();
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(DISTRIBUTED_SHUTDOWN_TIMEOUT);
+  for (u64 process : spawnedWorkers) {
+#ifdef _WIN32
+    HANDLE handle = reinterpret_cast<HANDLE>(process);
+    double timeLeft = std::max(-getSecondsSince(deadline), 0.);
+    if (WaitForSingleObject(handle, static_cast<DWORD>(timeLeft * 1e3)) == WAIT_TIMEOUT) {
+      warning("[TileCoordinator::~TileCoordinator] A local worker didn't stop in time, killing it");
+      TerminateProcess(handle, 1);
+      WaitForSingleObject(handle, INFINITE);
+    }
+    CloseHandle(handle);
+#else
+    pid_t pid = static_cast<pid_t>(process);
+    while (waitpid(pid, nullptr, WNOHANG) == 0) {
+      if (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        continue;
+      }
+
+      warning("[TileCoordinator::~TileCoordinator] A local worker didn't stop in time, killing it");
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+      break;
+    }
+#endif
+  }
+}
+
+bool TileCoordinator::spawnLocalWorker(u32 numThreads) {
+  std::string path = getExecutablePath();
+  std::string address = "127.0.0.1:" + std::to_string(getPort());
+  std::string threads = std::to_string(numThreads);
+
+#ifdef _WIN32
+  std::string commandLine = std::format("\"{}\" --worker {} --threads {}", path, address, threads);
+  STARTUPINFOA startupInfo{};
+  startupInfo.cb = sizeof(startupInfo);
+  PROCESS_INFORMATION processInfo{};
+
+  if (!CreateProcessA(path.c_str(), commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo)) {
+    warning(std::format("[TileCoordinator::spawnLocalWorker] Can't start [{}]", path));
+    return false;
+  }
+
+  CloseHandle(processInfo.hThread);
+  spawnedWorkers.push_back(reinterpret_cast<u64>(processInfo.hProcess));
+#else
+  std::string workerArg = "--worker", threadsArg = "--threads";
+  char* argv[] = { path.data(), workerArg.data(), address.data(), threadsArg.data(), threads.data(), nullptr };
+
+  pid_t pid;
+  if (path.empty() || posix_spawn(&pid, path.c_str(), nullptr, nullptr, argv, environ) != 0) {
+    warning(std::format("[TileCoordinator::spawnLocalWorker] Can't start [{}]", path));
+    return false;
+  }
+
+  spawnedWorkers.push_back(static_cast<u64>(pid));
+#endif
+
+  return true;
+}
+
+bool TileCoordinator::waitForWorker(double timeout) {
+  auto start = std::chrono::steady_clock::now();
+  u64 numRays = 0;
+
+  while (getNumWorkers() == 0 && getSecondsSince(start) < timeout)
+    poll(std::max(timeout - getSecondsSince(start), 0.), numRays);
+
+  return getNumWorkers() > 0;
+}
+
+u64 TileCoordinator::renderFrames(u32 firstFrame, u32 numFrames) {
+  jobs.clear();
+  pendingJobs.clear();
+
+  uvec2 numTiles = (config.resolution + DISTRIBUTED_TILE_SIZE - 1u) / DISTRIBUTED_TILE_SIZE;
+  for (u32 frame = firstFrame; frame < firstFrame + numFrames; frame += DISTRIBUTED_FRAMES_PER_JOB)
+    for (u32 y = 0; y < numTiles.y; y++)
+      for (u32 x = 0; x < numTiles.x; x++) {
+        TileJob job;
+        job.jobIdx = static_cast<u32>(jobs.size());
+        job.tileMin = uvec2(x, y) * DISTRIBUTED_TILE_SIZE;
+        job.tileMax = glm::min(job.tileMin + DISTRIBUTED_TILE_SIZE, config.resolution);
+        job.firstFrame = frame;
+        job.numFrames = std::min(DISTRIBUTED_FRAMES_PER_JOB, firstFrame + numFrames - frame);
+
+        pendingJobs.push_back(job.jobIdx);
+        jobs.push_back(job);
+      }
+
+  u32 numJobsDone = 0;
+  u64 numRays = 0;
+  auto lastWorkerTime = std::chrono::steady_clock::now();
+
+  while (numJobsDone < jobs.size()) {
+    dispatchJobs();
+    numJobsDone += poll(1., numRays);
+
+    if (getNumWorkers() > 0)
+      lastWorkerTime = std::chrono::steady_clock::now();
+    else if (getSecondsSince(lastWorkerTime) > DISTRIBUTED_WORKER_TIMEOUT) {
+      warning("[TileCoordinator::renderFrames] Every worker is lost");
+      return 0;
+    }
+  }
+
+  return numRays;
+}
+
+u32 TileCoordinator::getNumWorkers() const {
+  return static_cast<u32>(std::count_if(workers.begin(), workers.end(), [](const std::unique_ptr<Worker>& worker) {
+    return worker->isReady;
+  }));
+}
+
+void TileCoordinator::write(const std::string& path) const {
+  std::vector<vec3> image(accumulated.size());
+  for (size_t i = 0; i < accumulated.size(); i++)
+    image[i] = accumulated[i] / static_cast<float>(std::max(numPixelFrames[i], 1u));
+
+  PathTracer::writeImage(path, config.resolution, image);
+}
+
+// Keeps DISTRIBUTED_JOBS_IN_FLIGHT jobs on every ready worker, the next one is rendered while a tile is on the wire
+void TileCoordinator::dispatchJobs() {
+  for (size_t i = 0; i < workers.size() && !pendingJobs.empty();) {
+    Worker& worker = *workers[i];
+    bool isSent = true;
+
+    if (worker.isReady && worker.jobs.empty())
+      worker.lastMessage = std::chrono::steady_clock::now(); // Idle time doesn't count for the timeout
+
+    while (worker.isReady && isSent && worker.jobs.size() < DISTRIBUTED_JOBS_IN_FLIGHT && !pendingJobs.empty()) {
+      u32 jobIdx = pendingJobs.front();
+      worker.jobs.push_back(jobIdx);
+      pendingJobs.pop_front();
+      isSent = worker.socket.send(jobs[jobIdx]);
+    }
+
+    if (isSent)
+      i++;
+    else
+      dropWorker(i, "send failed");
+  }
+}
+
+u32 TileCoordinator::poll(double timeout, u64& numRays) {
+  std::vector<const Socket*> sockets = { &listener };
+  for (const std::unique_ptr<Worker>& worker : workers)
+    sockets.push_back(&worker->socket);
+
+  std::vector<bool> readable;
+  Socket::waitReadable(sockets, timeout, readable);
+
+  u32 numJobsDone = 0;
+  std::vector<bool> isLost(workers.size(), false);
+
+  for (size_t i = 0; i < workers.size(); i++) {
+    Worker& worker = *workers[i];
+    if (readable[i + 1])
+      isLost[i] = !receive(worker, numJobsDone, numRays);
+    else if (!worker.jobs.empty() && getSecondsSince(worker.lastMessage) > DISTRIBUTED_WORKER_TIMEOUT)
+      isLost[i] = true;
+  }
+
+  for (size_t i = workers.size(); i-- > 0;)
+    if (isLost[i])
+      dropWorker(i, "disconnected or timed out");
+
+  if (readable[0]) {
+    auto worker = std::make_unique<Worker>();
+    worker->socket = listener.accept();
+    worker->lastMessage = std::chrono::steady_clock::now();
+
+    // A worker stalling in the middle of a tile must not hold up the others, it's dropped and its jobs go back
+    if (worker->socket.isValid())
+      worker->socket.setTimeout(DISTRIBUTED_MESSAGE_TIMEOUT);
+
+    if (worker->socket.isValid() && worker->socket.send(config))
+      workers.push_back(std::move(worker));
+  }
+
+  return numJobsDone;
+}
+
+bool TileCoordinator::receive(Worker& worker, u32& numJobsDone, u64& numRays) {
+  worker.lastMessage = std::chrono::steady_clock::now();
+
+  if (!worker.isReady) {
+    DistributedHello hello;
+    if (!worker.socket.receive(hello) || hello.magic != DISTRIBUTED_MAGIC)
+      return false;
+
+    if (numRaysPerPixel != 0 && hello.numRaysPerPixel != numRaysPerPixel) {
+      warning(std::format("[TileCoordinator::receive] Worker with {} rays per pixel instead of {}", hello.numRaysPerPixel, numRaysPerPixel));
+      return false;
+    }
+
+    numRaysPerPixel = hello.numRaysPerPixel;
+    worker.isReady = true;
+    return true;
+  }
+
+  TileResult result;
+  if (!worker.socket.receive(result) || worker.jobs.empty() || result.jobIdx != worker.jobs.front())
+    return false;
+
+  const TileJob& job = jobs[result.jobIdx];
+  uvec2 size = job.tileMax - job.tileMin;
+  tile.resize(size.x * size.y);
+  if (!worker.socket.receive(tile.data(), tile.size() * sizeof(vec3)))
+    return false;
+
+  for (u32 y = 0; y < size.y; y++)
+    for (u32 x = 0; x < size.x; x++) {
+      size_t pixelIdx = static_cast<size_t>(job.tileMin.y + y) * config.resolution.x + job.tileMin.x + x;
+      accumulated[pixelIdx] += tile[y * size.x + x];
+      numPixelFrames[pixelIdx] += result.numFrames;
+    }
+
+  worker.jobs.pop_front();
+  numJobsDone++;
+  numRays += result.numRays;
+  return true;
+}
+
+// The jobs go first in the queue, they are the oldest ones
+void TileCoordinator::dropWorker(size_t workerIdx, const char* reason) {
+  Worker& worker = *workers[workerIdx];
+  warning(std::format("[TileCoordinator::dropWorker] Worker lost ({}), {} jobs reassigned", reason, worker.jobs.size()));
+
+  pendingJobs.insert(pendingJobs.begin(), worker.jobs.begin(), worker.jobs.end());
+  numReassignedJobs += static_cast<u32>(worker.jobs.size());
+  numLostWorkers += worker.isReady;
+
+  workers.erase(workers.begin() + workerIdx);
+}
+
+namespace distributed {
+
+int runWorker(const std::string& host, u16 port, u32 numThreads) {
+  Socket socket = Socket::connect(host, port);
+  DistributedConfig config;
+
+  if (!socket.isValid() || !socket.receive(config) || config.magic != DISTRIBUTED_MAGIC) {
+    warning(std::format("[distributed::runWorker] No coordinator at [{}:{}]", host, port));
+    return 1;
+  }
+
+  if (config.sceneNumber < 1 || config.sceneNumber > NUM_SCENES) {
+    warning(std::format("[distributed::runWorker] Unknown scene [{}]", config.sceneNumber));
+    return 1;
+  }
+
+  scene::setHeadless(true);
+  scene::setLazyBLAS(config.useLazyBVH);
+  RayTracingData rtData;
+  scene::load(config.sceneNumber, rtData);
+
+  PathTracer pathTracer(config.resolution, numThreads);
+  pathTracer.loadScene();
+  pathTracer.setCamera(config.camera);
+  pathTracer.setRayStreams(config.useRayStreams);
+
+  DistributedHello hello;
+  hello.numRaysPerPixel = static_cast<u32>(rtData.numRaysPerPixel);
+  hello.numThreads = pathTracer.getScheduler().getNumThreads();
+  if (!socket.send(hello))
+    return 1;
+
+  std::vector<vec3> sums;
+  TileJob job;
+
+  // A closed connection is a lost coordinator, there is nobody to render for anymore
+  while (socket.receive(job) && job.numFrames > 0) {
+    uvec2 size = job.tileMax - job.tileMin;
+    sums.assign(size.x * size.y, vec3(0.f));
+
+    u64 numRays = pathTracer.getNumRays();
+    for (u32 frame = job.firstFrame; frame < job.firstFrame + job.numFrames; frame++)
+      pathTracer.renderRegion(job.tileMin, job.tileMax, frame, rtData, config.lightPos, sums.data());
+
+    TileResult result{job.jobIdx, job.numFrames, pathTracer.getNumRays() - numRays};
+    if (!socket.send(result) || !socket.send(sums.data(), sums.size() * sizeof(vec3)))
+      return 1;
+  }
+
+  return 0;
+}
+
+} // namespace distributed
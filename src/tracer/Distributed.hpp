@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PathTracer.hpp"
+#include "../engine/Socket.hpp"
+
+#define DISTRIBUTED_DEFAULT_PORT 27272u
+#define DISTRIBUTED_TILE_SIZE 64u
+#define DISTRIBUTED_FRAMES_PER_JOB 4u
+#define DISTRIBUTED_JOBS_IN_FLIGHT 2u // Per worker, the next job waits there while a tile is sent back
+#define DISTRIBUTED_WORKER_TIMEOUT 60. // Seconds a worker with jobs can stay silent before it's dropped
+#define DISTRIBUTED_MESSAGE_TIMEOUT 10. // Seconds the rest of a started message can take on the wire
+#define DISTRIBUTED_SHUTDOWN_TIMEOUT 5. // Seconds the spawned workers get to exit before they're killed
+#define DISTRIBUTED_MAGIC 0x44525450u
+
+// Messages are the raw structs: the coordinator and the workers must be the same build on machines of the same
+// endianness
+
+// Coordinator to worker, once connected
+struct DistributedConfig {
+  u32 magic = DISTRIBUTED_MAGIC;
+  u32 sceneNumber = 0;
+  uvec2 resolution;
+  TracerCamera camera;
+  vec3 lightPos;
+  u32 useRayStreams = 0;
+  u32 useLazyBVH = 0;
+};
+
+// Worker to coordinator, once the scene is loaded
+struct DistributedHello {
+  u32 magic = DISTRIBUTED_MAGIC;
+  u32 numRaysPerPixel = 0;
+  u32 numThreads = 0;
+};
+
+// Coordinator to worker, no frames stops the worker
+struct TileJob {
+  u32 jobIdx = 0;
+  uvec2 tileMin;
+  uvec2 tileMax;
+  u32 firstFrame = 0;
+  u32 numFrames = 0;
+};
+
+// Worker to coordinator, followed by the sum of the frames for every pixel of the tile (row-major vec3)
+struct TileResult {
+  u32 jobIdx = 0;
+  u32 numFrames = 0;
+  u64 numRays = 0;
+};
+
+// Hands the tiles of the frames to worker processes over TCP and merges what they send back in a progressive
+// accumulation. Workers connect at any time, on this host (spawnLocalWorker) or another one. A worker that
+// disconnects or stays silent too long is dropped and its jobs go back to the queue for the others
+class TileCoordinator {
+public:
+  TileCoordinator(const DistributedConfig& config, u16 port = DISTRIBUTED_DEFAULT_PORT);
+  ~TileCoordinator(); // Stops the workers, waits for the spawned ones up to DISTRIBUTED_SHUTDOWN_TIMEOUT then kills them
+
+  bool isListening() const { return listener.isValid(); }
+  u16 getPort() const { return listener.getPort(); }
+
+  // `<this executable> --worker 127.0.0.1:<port> --threads <numThreads>`
+  bool spawnLocalWorker(u32 numThreads);
+
+  // False if no worker loaded the scene in time
+  bool waitForWorker(double timeout);
+
+  // Adds frames [firstFrame, firstFrame + numFrames) of every pixel to the accumulation, returns the path segments
+  // traced. 0 if every worker was lost and none came back within DISTRIBUTED_WORKER_TIMEOUT
+  u64 renderFrames(u32 firstFrame, u32 numFrames);
+
+  u32 getNumRaysPerPixel() const { return numRaysPerPixel; }
+  u32 getNumWorkers() const;
+  u32 getNumLostWorkers() const { return numLostWorkers; }
+  u32 getNumReassignedJobs() const { return numReassignedJobs; }
+
+  // Per pixel average over its own frame count, as an 8 bit PNG through PathTracer::writeImage
+  void write(const std::string& path) const;
+
+private:
+  struct Worker {
+    Socket socket;
+    bool isReady = false; // Hello received
+    std::deque<u32> jobs; // In flight, in sending order
+    std::chrono::steady_clock::time_point lastMessage;
+  };
+
+  DistributedConfig config;
+  Socket listener;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<u64> spawnedWorkers; // Process handles or ids
+
+  std::vector<TileJob> jobs; // Of the current renderFrames
+  std::deque<u32> pendingJobs;
+  std::vector<vec3> tile;
+
+  std::vector<vec3> accumulated; // Sum of the frames
+  std::vector<u32> numPixelFrames;
+  u32 numRaysPerPixel = 0;
+  u32 numLostWorkers = 0;
+  u32 numReassignedJobs = 0;
+
+  void dispatchJobs();
+  // Accepts the new workers and reads what the others sent, returns the jobs done
+  u32 poll(double timeout, u64& numRays);
+  bool receive(Worker& worker, u32& numJobsDone, u64& numRays);
+  void dropWorker(size_t workerIdx, const char* reason);
+};
+
+namespace distributed {
+  // Connects to a coordinator, loads the scene it asks for and renders its jobs until told to stop
+  int runWorker(const std::string& host, u16 port, u32 numThreads);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "../objects/RayTracingData.hpp"
+#include "../engine/BlueNoise.hpp"
+
+namespace sampler {
+  using uint = u32;
+  using std::abs;
+  using std::cos;
+  using std::max;
+  using std::sin;
+  using std::sqrt;
+  using glm::normalize;
+
+  inline uint getBlueNoise(uint i) { return blueNoise::tile[i]; }
+
+#define RNG_FN inline
+#define SAMPLER_INOUT(T) T&
+#include "../shaders/rng.glsl"
+#include "../shaders/sampler.glsl"
+#undef SAMPLER_INOUT
+#undef RNG_FN
+}
+
+// The sample functions of rt.frag over shaders/sampler.glsl. Every call is its own statement, so the samples are
+// drawn in the shader order
+struct PathSampler {
+  sampler::SamplerState state;
+
+  static PathSampler start(u32 type, uvec2 pixel, u32 pixelIdx, u32 sampleIdx) {
+    return PathSampler{sampler::samplerStart(type, pixel, pixelIdx, sampleIdx)};
+  }
+
+  void startBounce(u32 bounce) { sampler::samplerStartBounce(state, bounce); }
+
+  float get1D() { return sampler::samplerNext1D(state); }
+  vec2 get2D() { return sampler::samplerNext2D(state); }
+};
@@ -0,0 +1,578 @@
+#include "PathTracer.hpp"
+
+#include <cmath>
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "../engine/RadixSort.hpp"
+#include "../engine/mesh/texture/image2D.hpp"
+#include "../objects/Scene.hpp"
+#include "../objects/intersect.hpp"
+
+static vec3 getEnvironmentLight(const Ray& ray, const RayTracingData& rtData, const vec3& lightPos) {
+  if (!rtData.enableEnvLight)
+    return vec3(0.f);
+
+  vec3 lightDir = glm::normalize(ray.origin - lightPos);
+  float skyGradientT = std::pow(glm::smoothstep(0.f, 0.4f, ray.dir.y), 0.35f);
+  vec3 skyGradient = glm::mix(rtData.skyHorizonColor, rtData.skyZenithColor, skyGradientT);
+  float sun = std::pow(std::max(0.f, glm::dot(ray.dir, -lightDir)), rtData.sunFocus) * rtData.sunIntensity;
+
+  float groundToSkyT = glm::smoothstep(-0.01f, 0.f, ray.dir.y);
+  float sunMask = groundToSkyT >= 1.f ? 1.f : 0.f;
+
+  return glm::mix(rtData.groundColor, skyGradient, groundToSkyT) + sun * sunMask;
+}
+
+struct TracerLightSample {
+  vec3 pos;
+  vec3 normal;
+  vec3 emittedLight;
+};
+
+// sampleEmitter of rt.frag
+static TracerLightSample sampleEmitter(PathSampler& sampler) {
+  const std::vector<Emitter>& emitters = scene::getEmitters();
+  u32 numEmitters = static_cast<u32>(emitters.size());
+
+  float slot = sampler.get1D() * static_cast<float>(numEmitters);
+  u32 emitterIdx = std::min(static_cast<u32>(slot), numEmitters - 1);
+  if (slot - static_cast<float>(emitterIdx) >= emitters[emitterIdx].probability)
+    emitterIdx = emitters[emitterIdx].alias;
+
+  const Emitter& emitter = emitters[emitterIdx];
+  TracerLightSample lightSample;
+
+  if (emitter.type == EMITTER_TYPE_SPHERE) {
+    const Sphere& sphere = scene::getSpheres()[emitter.sphereIdx];
+    lightSample.normal = sampler::mapUniformSphere(sampler.get2D());
+    lightSample.pos = sphere.pos + lightSample.normal * sphere.radius;
+  } else {
+    vec2 barycentric = sampler::mapUniformTriangle(sampler.get2D());
+    lightSample.pos = emitter.a + emitter.ab * barycentric.x + emitter.ac * barycentric.y;
+    lightSample.normal = glm::normalize(glm::cross(emitter.ab, emitter.ac));
+  }
+
+  const RayTracingMaterial& material = scene::getMaterials()[emitter.materialIdx];
+  lightSample.emittedLight = material.emissionColor * material.emissionStrength;
+
+  return lightSample;
+}
+
+static float calcLightPdf(const vec3& emittedLight, float dst, float cosLight, const RayTracingData& rtData) {
+  return calcEmitterLuminance(emittedLight) / rtData.emittersPower * dst * dst / cosLight;
+}
+
+static float powerHeuristic(float pdf, float otherPdf) {
+  return pdf * pdf / (pdf * pdf + otherPdf * otherPdf);
+}
+
+// getHitMaterial of rt.frag
+static RayTracingMaterial getHitMaterial(const TracerHit& hit) {
+  RayTracingMaterial material = scene::getMaterials()[hit.materialIdx];
+  if (material.flags & RT_MATERIAL_FLAG_CHECKERED_PATTERN) {
+    vec2 c = glm::mod(glm::floor(vec2(hit.hitPoint.x, hit.hitPoint.z) * 0.35f), 2.f);
+    material.color = c.x == c.y ? material.color : vec4(material.emissionColor, 1.f);
+  }
+
+  return material;
+}
+
+PathTracer::PathTracer(uvec2 resolution, u32 numThreads, bool pinThreads)
+  : resolution(resolution),
+    accumulated(resolution.x * resolution.y, vec3(0.f)),
+    accumulatedMoments(resolution.x * resolution.y, 0.f),
+    frame(resolution.x * resolution.y),
+    scheduler(numThreads, pinThreads) {}
+
+void PathTracer::loadScene() {
+  const std::vector<MeshRT>& meshes = scene::getMeshes();
+  meshBVHs.clear();
+  meshBVHs.resize(meshes.size());
+  lazyBVHs.clear();
+  lazyBVHs.resize(meshes.size());
+
+  u32 numBytes = 0;
+  u32 numLazyBVHs = 0;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    if (scene::isLazyBLAS()) {
+      lazyBVHs[i] = std::make_unique<LazyBVH>();
+      lazyBVHs[i]->build(meshes[i].vertices, meshes[i].indices);
+      numLazyBVHs++;
+      continue;
+    }
+
+    meshBVHs[i].build(meshes[i].wideBVH, meshes[i].vertices, meshes[i].indices);
+    numBytes += meshBVHs[i].getNumBytes();
+  }
+
+  // Key space of the ray sorting
+  sceneBounds = AABB{};
+  if (!scene::getTLAS().nodes.empty())
+    sceneBounds.grow(AABB{scene::getTLAS().nodes[0].boundsMin, scene::getTLAS().nodes[0].boundsMax});
+  if (!scene::getSpheresBVH().nodes.empty())
+    sceneBounds.grow(AABB{scene::getSpheresBVH().nodes[0].boundsMin, scene::getSpheresBVH().nodes[0].boundsMax});
+
+  printf(
+    "SIMD BVHs: %zu meshes, %u bytes, %s kernels, %u lazy BVHs\n", meshBVHs.size() - numLazyBVHs, numBytes,
+    simd::getLevelName(simd::getLevel()), numLazyBVHs
+  );
+}
+
+void PathTracer::setCamera(const TracerCamera& camera) {
+  mat4 view = glm::lookAt(camera.position, camera.position + camera.orientation, global::up);
+  float aspectRatio = static_cast<float>(resolution.x) / resolution.y;
+  mat4 proj = glm::perspective(glm::radians(camera.fov), aspectRatio, camera.nearPlane, camera.farPlane);
+
+  // Same vectors Mesh::draw gives the shader: the up is the world one
+  camPos = camera.position;
+  camRight = vec3(glm::transpose(view)[0]);
+  camUp = global::up;
+  camInv = glm::inverse(proj * view);
+
+  std::fill(accumulated.begin(), accumulated.end(), vec3(0.f));
+  std::fill(accumulatedMoments.begin(), accumulatedMoments.end(), 0.f);
+  numFrames = 0;
+}
+
+// Same as calcRayCollision in rt.frag with the BVHs: spheres first, then the top level and the bottom level of every
+// instance it reaches, through the SIMD BVHs once loaded. The normals are resolved for the closest hit only. A lazy
+// BVH builds the subtrees it enters, which the shared claim flags make safe from the const tiles
+TracerHit PathTracer::calcRayCollision(const Ray& ray, const RayTracingData& rtData) const {
+  const std::vector<Sphere>& spheres = scene::getSpheres();
+  const std::vector<MeshRT>& meshes = scene::getMeshes();
+  const std::vector<MeshInstance>& instances = scene::getInstances();
+
+  TracerHit closestHit;
+  float closestDst = FLT_MAX;
+  int hitSphereIdx = -1;
+
+  if (rtData.numSpheres > 0)
+    scene::getSpheresBVH().intersect(ray, closestDst, [&](u32 sphereIdx, float& dst) {
+      float sphereDst = intersect::raySphere(ray, spheres[sphereIdx].pos, spheres[sphereIdx].radius);
+      if (sphereDst < dst) {
+        dst = sphereDst;
+        hitSphereIdx = sphereIdx;
+      }
+    });
+
+  int hitInstanceIdx = -1;
+  u32 hitTriIdx = 0;
+  vec2 barycentric(0.f);
+
+  if (rtData.numInstances > 0)
+    scene::getTLAS().intersect(ray, closestDst, [&](u32 instanceIdx, float& dst) {
+      const MeshInstance& instance = instances[instanceIdx];
+      const MeshRT& mesh = meshes[instance.meshIndex];
+
+      // Direction isn't normalized, so distances stay the same in both spaces
+      Ray objectRay{vec3(instance.invTransform * vec4(ray.origin, 1.f)), vec3(instance.invTransform * vec4(ray.dir, 0.f))};
+
+      // The packets hold the precomputed edges, the watertight test needs the vertices
+      LazyBVH* lazyBVH = instance.meshIndex < lazyBVHs.size() ? lazyBVHs[instance.meshIndex].get() : nullptr;
+      if (!rtData.useWatertight && !lazyBVH && instance.meshIndex < meshBVHs.size()) {
+        vec2 hitBarycentric;
+        u32 triIdx = meshBVHs[instance.meshIndex].intersect(objectRay, dst, hitBarycentric);
+
+        if (triIdx != BVH_INVALID_INDEX) {
+          hitInstanceIdx = instanceIdx;
+          hitTriIdx = triIdx;
+          barycentric = hitBarycentric;
+        }
+        return;
+      }
+
+      intersect::RayShear shear = intersect::calcRayShear(objectRay);
+
+      auto intersectTriangle = [&](u32 triIdx, float& dst) {
+        const uvec3& tri = mesh.indices[triIdx];
+        const vec3& a = mesh.vertices[tri.x].position;
+        const vec3& b = mesh.vertices[tri.y].position;
+        const vec3& c = mesh.vertices[tri.z].position;
+
+        intersect::TriangleHit hit = rtData.useWatertight
+          ? intersect::rayTriangleWatertight(objectRay, shear, a, b, c)
+          : intersect::rayTriangle(objectRay, a, b - a, c - a);
+
+        if (hit.didHit && hit.dst < dst) {
+          dst = hit.dst;
+          hitInstanceIdx = instanceIdx;
+          hitTriIdx = triIdx;
+          barycentric = vec2(hit.u, hit.v);
+        }
+      };
+
+      if (lazyBVH)
+        lazyBVH->intersect(objectRay, dst, intersectTriangle);
+      else
+        mesh.bvh.intersect(objectRay, dst, intersectTriangle);
+    });
+
+  if (closestDst == FLT_MAX)
+    return closestHit;
+
+  closestHit.didHit = true;
+  closestHit.dst = closestDst;
+  closestHit.hitPoint = ray.origin + ray.dir * closestDst;
+
+  if (hitInstanceIdx >= 0) {
+    const MeshInstance& instance = instances[hitInstanceIdx];
+    const MeshRT& mesh = meshes[instance.meshIndex];
+    const uvec3& tri = mesh.indices[hitTriIdx];
+    const VertexPN& a = mesh.vertices[tri.x];
+    const VertexPN& b = mesh.vertices[tri.y];
+    const VertexPN& c = mesh.vertices[tri.z];
+
+    float w = 1.f - barycentric.x - barycentric.y;
+    vec3 normal = glm::normalize(a.normal * w + b.normal * barycentric.x + c.normal * barycentric.y);
+    vec3 geometricNormal = glm::cross(b.position - a.position, c.position - a.position);
+
+    glm::mat3 normalMatrix = glm::transpose(glm::mat3(instance.invTransform));
+    closestHit.normal = glm::normalize(normalMatrix * normal);
+    closestHit.geometricNormal = glm::normalize(normalMatrix * geometricNormal);
+
+    if (instance.flags & RT_INSTANCE_FLAG_MATERIAL_OVERRIDE)
+      closestHit.materialIdx = instance.materialIdx;
+    else
+      closestHit.materialIdx = mesh.meshInfo.materialIdx;
+  } else {
+    const Sphere& sphere = spheres[hitSphereIdx];
+    closestHit.normal = glm::normalize(closestHit.hitPoint - sphere.pos);
+    closestHit.geometricNormal = closestHit.normal;
+    closestHit.materialIdx = sphere.materialIdx;
+  }
+
+  return closestHit;
+}
+
+// Stream mode: a path of the tile between two bounces
+struct PathSegment {
+  PathState path;
+  u32 pixelIdx; // In the tile
+};
+
+// Spreads the lowest 10 bits so that there are two zero bits between each of them
+static u32 expandBits(u32 v) {
+  v = (v * 0x00010001u) & 0xff0000ffu;
+  v = (v * 0x00000101u) & 0x0f00f00fu;
+  v = (v * 0x00000011u) & 0xc30c30c3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+// Direction octant in the top 3 bits, then the Morton code of the origin in the scene bounds
+static u32 calcRayKey(const Ray& ray, const AABB& bounds) {
+  u32 octant = (ray.dir.x < 0.f) | (ray.dir.y < 0.f) << 1 | (ray.dir.z < 0.f) << 2;
+  vec3 p = (ray.origin - bounds.min) / glm::max(bounds.extent(), vec3(FLT_MIN));
+  uvec3 q = uvec3(glm::clamp(p * 512.f, vec3(0.f), vec3(511.f)));
+
+  return octant << TRACER_RAY_KEY_MORTON_BITS | expandBits(q.x) << 2 | expandBits(q.y) << 1 | expandBits(q.z);
+}
+
+vec3 PathTracer::calcViewPoint(uvec2 pixel, const RayTracingData& rtData) const {
+  vec2 texCoord = (vec2(pixel) + 0.5f) / vec2(resolution);
+  vec2 ndc = texCoord * 2.f - 1.f;
+  vec4 worldPos = camInv * (vec4(ndc.x, ndc.y, -1.f, 1.f) * rtData.focusDistance);
+
+  return vec3(worldPos) / worldPos.w;
+}
+
+Ray PathTracer::generateCameraRay(const vec3& viewPoint, const RayTracingData& rtData, PathSampler& sampler) const {
+  Ray ray;
+  vec2 defocusJitter = sampler::mapConcentricDisk(sampler.get2D()) * rtData.defocusStrength / static_cast<float>(resolution.x);
+  ray.origin = camPos + camRight * defocusJitter.x + camUp * defocusJitter.y;
+
+  vec2 jitter = sampler::mapConcentricDisk(sampler.get2D()) * rtData.divergeStrength / static_cast<float>(resolution.x);
+  vec3 jitteredViewPoint = viewPoint + camRight * jitter.x + camUp * jitter.y;
+  ray.dir = glm::normalize(jitteredViewPoint - camPos);
+
+  return ray;
+}
+
+// Body of the bounce loop of trace after the collision, with the light sampling and its shadow ray, then the Russian
+// roulette. Returns false when the path ends
+bool PathTracer::shadeHit(
+  const TracerHit& hit, int bounce, PathState& path, PathSampler& sampler, const RayTracingData& rtData, const vec3& lightPos,
+  TracerRayCounts& counts
+) const {
+  Ray& ray = path.ray;
+
+  if (!hit.didHit) {
+    path.incomingLight += getEnvironmentLight(ray, rtData, lightPos) * path.rayColor;
+    return false;
+  }
+
+  RayTracingMaterial material = getHitMaterial(hit);
+
+  bool useLightSampling = rtData.useLightSampling && rtData.numEmitters > 0;
+  auto offsetSign = [&](const vec3& dir) { return glm::dot(dir, hit.geometricNormal) < 0.f ? -1.f : 1.f; };
+
+  vec3 emittedLight = material.emissionColor * material.emissionStrength;
+  float emissionWeight = 1.f;
+  if (useLightSampling && path.bsdfPdf > 0.f && calcEmitterLuminance(emittedLight) > 0.f) {
+    float lightPdf = calcLightPdf(emittedLight, hit.dst, std::abs(glm::dot(hit.geometricNormal, ray.dir)), rtData);
+    emissionWeight = powerHeuristic(path.bsdfPdf, lightPdf);
+  }
+  path.incomingLight += emittedLight * path.rayColor * emissionWeight;
+
+  float diffuseProbability = glm::clamp(1.f - material.specularProbability, 0.f, 1.f);
+  if (useLightSampling && diffuseProbability > 0.f && bounce + 1 < rtData.numRayBounces) {
+    TracerLightSample lightSample = sampleEmitter(sampler);
+    vec3 toLight = lightSample.pos - hit.hitPoint;
+    float lightDst = glm::length(toLight);
+    vec3 lightDir = toLight / lightDst;
+    float cosSurface = glm::dot(hit.normal, lightDir);
+    float cosLight = -glm::dot(lightSample.normal, lightDir); // Triangles are hit from the front only
+
+    if (cosSurface > 0.f && cosLight > 0.f) {
+      Ray shadowRay{intersect::offsetRayOrigin(hit.hitPoint, hit.geometricNormal * offsetSign(lightDir)), lightDir};
+      TracerHit shadowHit = calcRayCollision(shadowRay, rtData);
+      counts.numShadowRays++;
+
+      if (!shadowHit.didHit || shadowHit.dst >= lightDst * 0.999f) {
+        float lightPdf = calcLightPdf(lightSample.emittedLight, lightDst, cosLight, rtData);
+        float lightBsdfPdf = diffuseProbability * cosSurface / PI;
+        path.incomingLight += lightSample.emittedLight * vec3(material.color) * path.rayColor * (lightBsdfPdf / lightPdf * powerHeuristic(lightPdf, lightBsdfPdf));
+      }
+    }
+  }
+
+  vec3 diffuseDir = sampler::mapCosineHemisphere(sampler.get2D(), hit.normal);
+  vec3 specularDir = glm::reflect(ray.dir, hit.normal);
+  float isSpecularBounce = material.specularProbability >= sampler.get1D() ? 1.f : 0.f;
+  ray.dir = glm::mix(diffuseDir, specularDir, material.smoothness * isSpecularBounce);
+  ray.origin = intersect::offsetRayOrigin(hit.hitPoint, hit.geometricNormal * offsetSign(ray.dir));
+
+  path.bsdfPdf = (1.f - isSpecularBounce) * diffuseProbability * std::max(glm::dot(hit.normal, ray.dir), 0.f) / PI;
+  path.rayColor *= glm::mix(vec3(material.color), material.specularColor, isSpecularBounce);
+
+  if (rtData.useRussianRoulette && bounce + 1 >= rtData.rouletteMinBounces) {
+    float survivalProbability = std::min(std::max(path.rayColor.r, std::max(path.rayColor.g, path.rayColor.b)), 1.f);
+    if (sampler.get1D() >= survivalProbability)
+      return false;
+
+    path.rayColor /= survivalProbability;
+  }
+
+  return true;
+}
+
+// main and trace of rt.frag for one pixel, depth first
+vec3 PathTracer::renderPixel(uvec2 pixel, u32 frameIdx, const RayTracingData& rtData, const vec3& lightPos, TracerRayCounts& counts) const {
+  u32 pixelIdx = pixel.x + pixel.y * resolution.x;
+  vec3 viewPoint = calcViewPoint(pixel, rtData);
+  vec3 totalIncomingLight(0.f);
+
+  for (int i = 0; i < rtData.numRaysPerPixel; i++) {
+    u32 sampleIdx = frameIdx * rtData.numRaysPerPixel + i;
+    PathSampler sampler = PathSampler::start(static_cast<u32>(rtData.samplerType), pixel, pixelIdx, sampleIdx);
+    PathState path;
+    path.ray = generateCameraRay(viewPoint, rtData, sampler);
+    counts.numPaths++;
+
+    for (int bounce = 0; bounce < rtData.numRayBounces; bounce++) {
+      counts.numSegments++;
+      sampler.startBounce(bounce + 1);
+      if (!shadeHit(calcRayCollision(path.ray, rtData), bounce, path, sampler, rtData, lightPos, counts))
+        break;
+    }
+
+    totalIncomingLight += path.incomingLight;
+  }
+
+  return totalIncomingLight / static_cast<float>(rtData.numRaysPerPixel);
+}
+
+// Same paths as renderPixel, a bounce of every path of the tile at a time: the segments are sorted so rays leaving
+// from nearby points in the same octant are intersected one after the other, then all of them are shaded. The samples
+// are keyed on the bounce, so the order doesn't change them. Samples are summed in the same order as depth
+// first, the image is the same. Shadow rays are traced as the hits are shaded
+void PathTracer::renderTileStream(
+  uvec2 tileMin, uvec2 tileMax, u32 frameIdx, const RayTracingData& rtData, const vec3& lightPos, const TracerTarget& target,
+  TracerRayCounts& counts
+) const {
+  uvec2 size = tileMax - tileMin;
+  u32 numPixels = size.x * size.y;
+
+  std::vector<uvec2> pixels(numPixels);
+  std::vector<vec3> viewPoints(numPixels);
+  std::vector<vec3> totalIncomingLight(numPixels, vec3(0.f));
+
+  for (u32 i = 0; i < numPixels; i++) {
+    pixels[i] = tileMin + uvec2(i % size.x, i / size.x);
+    viewPoints[i] = calcViewPoint(pixels[i], rtData);
+  }
+
+  std::vector<PathSegment> segments, sortedSegments;
+  std::vector<TracerHit> hits(numPixels);
+  std::vector<u32> keys, order;
+
+  auto startSampler = [&](const PathSegment& segment, u32 sampleIdx) {
+    uvec2 pixel = pixels[segment.pixelIdx];
+    return PathSampler::start(static_cast<u32>(rtData.samplerType), pixel, pixel.x + pixel.y * resolution.x, sampleIdx);
+  };
+
+  for (int sample = 0; sample < rtData.numRaysPerPixel; sample++) {
+    u32 sampleIdx = frameIdx * rtData.numRaysPerPixel + sample;
+
+    segments.resize(numPixels);
+    for (u32 i = 0; i < numPixels; i++) {
+      segments[i] = {{}, i};
+      PathSampler sampler = startSampler(segments[i], sampleIdx);
+      segments[i].path.ray = generateCameraRay(viewPoints[i], rtData, sampler);
+    }
+    counts.numPaths += numPixels;
+
+    for (int bounce = 0; bounce < rtData.numRayBounces && !segments.empty(); bounce++) {
+      u32 numSegments = static_cast<u32>(segments.size());
+      counts.numSegments += numSegments;
+
+      // Camera rays are coherent already
+      if (bounce > 0) {
+        keys.resize(numSegments);
+        order.resize(numSegments);
+        for (u32 i = 0; i < numSegments; i++) {
+          keys[i] = calcRayKey(segments[i].path.ray, sceneBounds);
+          order[i] = i;
+        }
+
+        // Runs on a tile worker, the thread pool would nest under the scheduler
+        radixSortSerial(keys, order, TRACER_RAY_KEY_MORTON_BITS + 3);
+
+        sortedSegments.resize(numSegments);
+        for (u32 i = 0; i < numSegments; i++)
+          sortedSegments[i] = segments[order[i]];
+        std::swap(segments, sortedSegments);
+      }
+
+      for (u32 i = 0; i < numSegments; i++)
+        hits[i] = calcRayCollision(segments[i].path.ray, rtData);
+
+      u32 numActive = 0;
+      for (u32 i = 0; i < numSegments; i++) {
+        PathSegment& segment = segments[i];
+        PathSampler sampler = startSampler(segment, sampleIdx);
+        sampler.startBounce(bounce + 1);
+
+        if (shadeHit(hits[i], bounce, segment.path, sampler, rtData, lightPos, counts))
+          segments[numActive++] = segment;
+        else
+          totalIncomingLight[segment.pixelIdx] += segment.path.incomingLight;
+      }
+      segments.resize(numActive);
+    }
+
+    // Out of bounces
+    for (const PathSegment& segment : segments)
+      totalIncomingLight[segment.pixelIdx] += segment.path.incomingLight;
+  }
+
+  for (u32 i = 0; i < numPixels; i++)
+    target.at(pixels[i]) += totalIncomingLight[i] / static_cast<float>(rtData.numRaysPerPixel);
+}
+
+void PathTracer::renderFrame(const RayTracingData& rtData, const vec3& lightPos) {
+  std::fill(frame.begin(), frame.end(), vec3(0.f));
+  renderRegion(uvec2(0u), resolution, numFrames, rtData, lightPos, frame.data());
+
+  for (size_t i = 0; i < frame.size(); i++) {
+    float luminance = denoise::denoiseLuminance(frame[i]);
+    accumulated[i] += frame[i];
+    accumulatedMoments[i] += luminance * luminance;
+  }
+  numFrames++;
+}
+
+void PathTracer::renderRegion(
+  uvec2 regionMin, uvec2 regionMax, u32 frameIdx, const RayTracingData& rtData, const vec3& lightPos, vec3* sums
+) {
+  TracerTarget target{sums, regionMin, regionMax.x - regionMin.x};
+  u32 tileSize = useRayStreams ? TRACER_STREAM_TILE_SIZE : TRACER_TILE_SIZE;
+  uvec2 numTiles = (regionMax - regionMin + tileSize - 1u) / tileSize;
+
+  scheduler.run(numTiles, [&](uvec2 tile, u32) {
+    uvec2 tileMin = regionMin + tile * tileSize;
+    uvec2 tileMax = glm::min(tileMin + tileSize, regionMax);
+    TracerRayCounts counts;
+
+    if (useRayStreams)
+      renderTileStream(tileMin, tileMax, frameIdx, rtData, lightPos, target, counts);
+    else
+      for (u32 y = tileMin.y; y < tileMax.y; y++)
+        for (u32 x = tileMin.x; x < tileMax.x; x++)
+          target.at({x, y}) += renderPixel({x, y}, frameIdx, rtData, lightPos, counts);
+
+    numRays.fetch_add(counts.numSegments + counts.numShadowRays, std::memory_order_relaxed);
+    numPaths.fetch_add(counts.numPaths, std::memory_order_relaxed);
+    numPathSegments.fetch_add(counts.numSegments, std::memory_order_relaxed);
+  });
+}
+
+std::vector<denoise::DenoiseFeature> PathTracer::renderFeatures(const RayTracingData& rtData) {
+  std::vector<denoise::DenoiseFeature> features(resolution.x * resolution.y);
+  uvec2 numTiles = (resolution + TRACER_TILE_SIZE - 1u) / TRACER_TILE_SIZE;
+
+  scheduler.run(numTiles, [&](uvec2 tile, u32) {
+    uvec2 tileMin = tile * TRACER_TILE_SIZE;
+    uvec2 tileMax = glm::min(tileMin + TRACER_TILE_SIZE, resolution);
+
+    for (u32 y = tileMin.y; y < tileMax.y; y++)
+      for (u32 x = tileMin.x; x < tileMax.x; x++) {
+        u32 pixelIdx = x + y * resolution.x;
+        vec3 viewPoint = calcViewPoint({x, y}, rtData);
+        denoise::DenoiseFeature feature{vec3(0.f), vec3(0.f), 0.f};
+
+        for (u32 i = 0; i < RT_DENOISE_FEATURE_RAYS; i++) {
+          PathSampler sampler = PathSampler::start(static_cast<u32>(rtData.samplerType), {x, y}, pixelIdx, i);
+          Ray ray = generateCameraRay(viewPoint, rtData, sampler);
+          TracerHit hit = calcRayCollision(ray, rtData);
+
+          if (hit.didHit) {
+            feature.albedo += vec3(getHitMaterial(hit).color);
+            feature.normal += hit.normal;
+            feature.depth += hit.dst;
+          } else {
+            feature.albedo += vec3(1.f);
+            feature.normal -= ray.dir;
+            feature.depth += RT_DENOISE_MISS_DEPTH;
+          }
+        }
+
+        features[pixelIdx] = {
+          feature.albedo / static_cast<float>(RT_DENOISE_FEATURE_RAYS), glm::normalize(feature.normal),
+          feature.depth / static_cast<float>(RT_DENOISE_FEATURE_RAYS)
+        };
+      }
+  });
+
+  return features;
+}
+
+std::vector<vec3> PathTracer::denoise(const RayTracingData& rtData, int numIterations) {
+  float scale = 1.f / std::max(numFrames, 1u);
+  std::vector<vec3> mean(accumulated.size());
+  std::vector<float> meanSquaredLuminance(accumulated.size());
+  for (size_t i = 0; i < accumulated.size(); i++) {
+    mean[i] = accumulated[i] * scale;
+    meanSquaredLuminance[i] = accumulatedMoments[i] * scale;
+  }
+
+  return denoise::filter(resolution, mean, meanSquaredLuminance, numFrames, renderFeatures(rtData), numIterations, scheduler);
+}
+
+// Rows go bottom to top like the framebuffer, image2D::write flips them
+void PathTracer::writeImage(const std::string& path, uvec2 resolution, const std::vector<vec3>& image, float scale) {
+  std::vector<byte> pixels(image.size() * 3);
+  for (size_t i = 0; i < image.size(); i++)
+    for (int channel = 0; channel < 3; channel++)
+      pixels[i * 3 + channel] = static_cast<byte>(std::round(glm::clamp(image[i][channel] * scale, 0.f, 255.f)));
+
+  image2D::write(path, resolution, 3, pixels.data());
+}
+
+void PathTracer::write(const std::string& path) const {
+  writeImage(path, resolution, accumulated, 255.f / std::max(numFrames, 1u));
+}
+
+void PathTracer::write(const std::string& path, const std::vector<vec3>& image) const {
+  writeImage(path, resolution, image, 255.f);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../objects/RayTracingData.hpp"
+#include "../objects/Ray.hpp"
+#include "../objects/bvh/LazyBVH.hpp"
+#include "../objects/bvh/SimdBVH.hpp"
+#include "../engine/TileScheduler.hpp"
+#include "PathSampler.hpp"
+#include "Denoiser.hpp"
+
+#define TRACER_TILE_SIZE 16u
+#define TRACER_STREAM_TILE_SIZE 64u // Bigger batches sort into longer coherent runs
+#define TRACER_RAY_KEY_MORTON_BITS 27u // 9 per axis, under the 3 octant bits
+
+// Same projection as Camera, without the window
+struct TracerCamera {
+  vec3 position;
+  vec3 orientation;
+  float fov = 45.f;
+  float nearPlane = 0.1f;
+  float farPlane = 100.f;
+};
+
+// Same start as the scene camera and the light in main
+#define TRACER_DEFAULT_CAMERA TracerCamera{{-1.72f, 8.53f, 84.28f}, {0.00f, -0.11f, -1.03f}}
+#define TRACER_DEFAULT_LIGHT_POS vec3(300.f, 300.f, -1000.f)
+
+struct TracerHit {
+  bool didHit = false;
+  float dst = FLT_MAX;
+  vec3 hitPoint;
+  vec3 normal;
+  vec3 geometricNormal;
+  u32 materialIdx = 0;
+};
+
+// A path between two bounces, with the state trace of rt.frag keeps in locals
+struct PathState {
+  Ray ray;
+  vec3 rayColor = vec3(1.f);
+  vec3 incomingLight = vec3(0.f);
+  float bsdfPdf = 0.f; // Of the last diffuse bounce, 0 after the camera and the specular ones
+};
+
+// Rays of a tile, added to the totals of the tracer once it is done
+struct TracerRayCounts {
+  u32 numPaths = 0;
+  u32 numSegments = 0;
+  u32 numShadowRays = 0;
+};
+
+// Row-major pixels of an image region, from its origin
+struct TracerTarget {
+  vec3* data;
+  uvec2 origin;
+  u32 width;
+
+  vec3& at(uvec2 pixel) const { return data[(pixel.y - origin.y) * width + pixel.x - origin.x]; }
+};
+
+// CPU reference of rt.frag over the scene loaded by scene::sceneN (headless or not). Paths draw the same samples as
+// in the shader (shaders/sampler.glsl), every frame adds one sample of numRaysPerPixel rays and the result is
+// their average, like the average pass. Tiles are rendered by a work-stealing scheduler
+class PathTracer {
+public:
+  PathTracer(uvec2 resolution, u32 numThreads = std::thread::hardware_concurrency(), bool pinThreads = false);
+
+  // Packs the scene meshes for the SIMD kernels, call again when they change. Without it the meshes are walked
+  // with the scalar routines. Meshes loaded without their BVHs (scene::setLazyBLAS) get a LazyBVH instead, walked with the
+  // scalar routines, whose subtrees are built by the first rays that reach them
+  void loadScene();
+
+  void setCamera(const TracerCamera& camera);
+  void renderFrame(const RayTracingData& rtData, const vec3& lightPos);
+
+  // Adds frame frameIdx of the pixels in [regionMin, regionMax) to sums (row-major over the region), without touching
+  // the accumulation. Frames are seeded by their index, so any process renders the same frame
+  void renderRegion(uvec2 regionMin, uvec2 regionMax, u32 frameIdx, const RayTracingData& rtData, const vec3& lightPos, vec3* sums);
+
+  // Wavefront mode: the paths of a tile advance one bounce at a time, sorted by direction and origin before every
+  // intersection pass. Same image as the default depth first walk
+  void setRayStreams(bool enabled) { useRayStreams = enabled; }
+
+  u32 getNumFrames() const { return numFrames; }
+  u64 getNumRays() const { return numRays; } // Path segments and shadow rays traced since the construction
+  double getMeanPathLength() const { return numPaths ? static_cast<double>(numPathSegments) / numPaths : 0.; }
+  const std::vector<vec3>& getAccumulated() const { return accumulated; }
+  const std::vector<float>& getAccumulatedMoments() const { return accumulatedMoments; }
+  const TileScheduler& getScheduler() const { return scheduler; }
+
+  // Averaged first hits of the first camera rays of every pixel, as writeDenoiseFeatures of rt.frag
+  std::vector<denoise::DenoiseFeature> renderFeatures(const RayTracingData& rtData);
+
+  // Average of the frames through denoise::filter, with the features of the current camera
+  std::vector<vec3> denoise(const RayTracingData& rtData, int numIterations);
+
+  // Average of the frames as an 8 bit PNG, through image2D::write
+  void write(const std::string& path) const;
+  void write(const std::string& path, const std::vector<vec3>& image) const; // An image of the resolution instead
+  // Any image of that resolution, times the scale and clamped to [0, 255]
+  static void writeImage(const std::string& path, uvec2 resolution, const std::vector<vec3>& image, float scale = 255.f);
+
+  TracerHit calcRayCollision(const Ray& ray, const RayTracingData& rtData) const;
+
+private:
+  uvec2 resolution;
+  std::vector<vec3> accumulated; // Sum of the frames
+  std::vector<float> accumulatedMoments; // Sum of their squared luminance, as the alpha of average.frag
+  std::vector<vec3> frame; // The last one
+  u32 numFrames = 0;
+
+  vec3 camPos;
+  vec3 camRight;
+  vec3 camUp;
+  mat4 camInv;
+
+  std::vector<SimdBVH> meshBVHs; // Per scene mesh
+  std::vector<std::unique_ptr<LazyBVH>> lazyBVHs; // Per scene mesh, null where the scene built the BVH
+  AABB sceneBounds;
+  TileScheduler scheduler;
+
+  bool useRayStreams = false;
+  std::atomic<u64> numRays = 0;
+  std::atomic<u64> numPaths = 0;
+  std::atomic<u64> numPathSegments = 0;
+
+  vec3 calcViewPoint(uvec2 pixel, const RayTracingData& rtData) const;
+  Ray generateCameraRay(const vec3& viewPoint, const RayTracingData& rtData, PathSampler& sampler) const;
+  bool shadeHit(
+    const TracerHit& hit, int bounce, PathState& path, PathSampler& sampler, const RayTracingData& rtData, const vec3& lightPos,
+    TracerRayCounts& counts
+  ) const;
+  vec3 renderPixel(uvec2 pixel, u32 frameIdx, const RayTracingData& rtData, const vec3& lightPos, TracerRayCounts& counts) const;
+  void renderTileStream(
+    uvec2 tileMin, uvec2 tileMax, u32 frameIdx, const RayTracingData& rtData, const vec3& lightPos, const TracerTarget& target,
+    TracerRayCounts& counts
+  ) const;
+};
@@ -0,0 +1,217 @@
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PathTracer.hpp"
+#include "Distributed.hpp"
+#include "../engine/RenderBudget.hpp"
+#include "../objects/Scene.hpp"
+
+#define TRACER_DEFAULT_FRAMES 16u
+#define TRACER_DEFAULT_RESOLUTION uvec2(1200u, 720u) // Window size in main
+
+// Passes of DISTRIBUTED_FRAMES_PER_JOB frames over the workers, the budget is checked between passes
+static int renderDistributed(
+  const DistributedConfig& config, u16 port, u32 numLocalWorkers, u32 numWorkerThreads, RenderBudget budget, u32 numFrames,
+  const std::string& output
+) {
+  TileCoordinator coordinator(config, port);
+  if (!coordinator.isListening())
+    return 1;
+
+  for (u32 i = 0; i < numLocalWorkers; i++)
+    coordinator.spawnLocalWorker(numWorkerThreads);
+
+  printf("Coordinator listening on port %u, waiting for a worker\n", coordinator.getPort());
+  if (!coordinator.waitForWorker(DISTRIBUTED_WORKER_TIMEOUT)) {
+    warning("[tracer::renderDistributed] No worker connected");
+    return 1;
+  }
+
+  u32 numRaysPerPixel = coordinator.getNumRaysPerPixel();
+  if (!budget.isLimited())
+    budget = RenderBudget(0., numFrames * numRaysPerPixel);
+
+  u32 frame = 0;
+  budget.start();
+  while (budget.hasRoomForFrame()) {
+    u32 numPassFrames = DISTRIBUTED_FRAMES_PER_JOB;
+    if (budget.getSppLimit() > 0)
+      numPassFrames = std::min(numPassFrames, (budget.getSppLimit() - budget.getSpp() + numRaysPerPixel - 1) / numRaysPerPixel);
+
+    u64 numRays = coordinator.renderFrames(frame, numPassFrames);
+    if (numRays == 0)
+      return 1;
+
+    budget.addFrame(numPassFrames * numRaysPerPixel, numRays);
+    frame += numPassFrames;
+  }
+  budget.stop();
+
+  coordinator.write(output);
+
+  printf(
+    "Rendered scene%u, %u frames of %ux%u on %u workers (%u lost, %u jobs reassigned) -> %s\n", config.sceneNumber, frame,
+    config.resolution.x, config.resolution.y, coordinator.getNumWorkers(), coordinator.getNumLostWorkers(),
+    coordinator.getNumReassignedJobs(), output.c_str()
+  );
+  budget.print("Distributed tracer");
+
+  return 0;
+}
+
+namespace tracer {
+
+int run(int argc, char* argv[]) {
+  std::vector<std::string> args;
+  u32 numThreads = std::thread::hardware_concurrency();
+  bool pinThreads = false;
+  bool useRayStreams = false;
+  bool useDenoiser = false;
+  bool useLazyBVH = false;
+  bool isThreadsSet = false;
+  double budgetSeconds = 0.;
+  u32 budgetSpp = 0;
+  u32 numLocalWorkers = 0;
+  int listenPort = -1;
+
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--pin")
+      pinThreads = true;
+    else if (arg == "--streams")
+      useRayStreams = true;
+    else if (arg == "--denoise")
+      useDenoiser = true;
+    else if (arg == "--lazy-bvh")
+      useLazyBVH = true;
+    else if (arg == "--threads" && i + 1 < argc) {
+      numThreads = static_cast<u32>(std::atoi(argv[++i]));
+      isThreadsSet = true;
+    }
+    else if (arg == "--workers" && i + 1 < argc)
+      numLocalWorkers = static_cast<u32>(std::atoi(argv[++i]));
+    else if (arg == "--listen" && i + 1 < argc)
+      listenPort = std::atoi(argv[++i]);
+    else if (arg == "--time" && i + 1 < argc)
+      budgetSeconds = std::atof(argv[++i]);
+    else if (arg == "--spp" && i + 1 < argc)
+      budgetSpp = static_cast<u32>(std::atoi(argv[++i]));
+    else
+      args.push_back(arg);
+  }
+
+  int sceneNumber = args.empty() ? 0 : std::atoi(args[0].c_str());
+  if (sceneNumber < 1 || sceneNumber > static_cast<int>(NUM_SCENES)) {
+    warning(std::format("[tracer::run] Unknown scene [{}], available: 1 to {}", args.empty() ? "" : args[0], NUM_SCENES));
+    return 1;
+  }
+
+  u32 numFrames = args.size() > 1 ? static_cast<u32>(std::atoi(args[1].c_str())) : TRACER_DEFAULT_FRAMES;
+  uvec2 resolution = TRACER_DEFAULT_RESOLUTION;
+  if (args.size() > 2 && std::sscanf(args[2].c_str(), "%ux%u", &resolution.x, &resolution.y) != 2) {
+    warning(std::format("[tracer::run] Expected the resolution as <width>x<height>, got [{}]", args[2]));
+    return 1;
+  }
+  std::string output = args.size() > 3 ? args[3] : std::format("render_scene{}.png", sceneNumber);
+
+  TracerCamera camera = TRACER_DEFAULT_CAMERA;
+  vec3 lightPos = TRACER_DEFAULT_LIGHT_POS;
+
+  // The workers load the scene, local ones share the cores unless --threads is given
+  if (numLocalWorkers > 0 || listenPort >= 0) {
+    DistributedConfig config;
+    config.sceneNumber = static_cast<u32>(sceneNumber);
+    config.resolution = resolution;
+    config.camera = camera;
+    config.lightPos = lightPos;
+    config.useRayStreams = useRayStreams;
+    config.useLazyBVH = useLazyBVH;
+
+    // The coordinator only gets the sums of the tiles, neither the moments nor the features
+    if (useDenoiser)
+      warning("[tracer::run] --denoise is ignored by distributed renders");
+
+    u16 port = static_cast<u16>(listenPort >= 0 ? listenPort : DISTRIBUTED_DEFAULT_PORT);
+    u32 numWorkerThreads = isThreadsSet ? numThreads : std::max(numThreads / std::max(numLocalWorkers, 1u), 1u);
+    return renderDistributed(config, port, numLocalWorkers, numWorkerThreads, RenderBudget(budgetSeconds, budgetSpp), numFrames, output);
+  }
+
+  scene::setHeadless(true);
+  scene::setLazyBLAS(useLazyBVH);
+  RayTracingData rtData;
+  scene::load(sceneNumber, rtData);
+
+  PathTracer pathTracer(resolution, numThreads, pinThreads);
+  pathTracer.loadScene();
+  pathTracer.setCamera(camera);
+  pathTracer.setRayStreams(useRayStreams);
+
+  // The frame count is the budget unless a time or spp is given
+  RenderBudget budget(budgetSeconds, budgetSpp);
+  if (!budget.isLimited())
+    budget = RenderBudget(0., numFrames * rtData.numRaysPerPixel);
+
+  budget.start();
+  while (budget.hasRoomForFrame()) {
+    u64 numRays = pathTracer.getNumRays();
+    pathTracer.renderFrame(rtData, lightPos);
+    budget.addFrame(rtData.numRaysPerPixel, pathTracer.getNumRays() - numRays);
+  }
+  budget.stop();
+  double seconds = budget.getElapsed();
+
+  if (useDenoiser) {
+    auto start = std::chrono::steady_clock::now();
+    pathTracer.write(output, pathTracer.denoise(rtData, rtData.denoiseIterations));
+    printf(
+      "Denoised in %.3f s (%d iterations)\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+      rtData.denoiseIterations
+    );
+  } else
+    pathTracer.write(output);
+
+  const TileScheduler& scheduler = pathTracer.getScheduler();
+  double numCameraRays = static_cast<double>(resolution.x) * resolution.y * budget.getSpp();
+  printf(
+    "Rendered scene%d, %u frames of %ux%u in %.3f s on %u threads (%.2f Mcamera rays/s, %s) -> %s\n",
+    sceneNumber, budget.getNumFrames(), resolution.x, resolution.y, seconds, scheduler.getNumThreads(),
+    numCameraRays / seconds * 1e-6, useRayStreams ? "in streams" : "depth first", output.c_str()
+  );
+  budget.print("CPU tracer");
+  printf("Mean path length: %.2f bounces (at most %d)\n", pathTracer.getMeanPathLength(), rtData.numRayBounces);
+
+  printf("%-8s %10s %10s %8s %8s\n", "thread", "busy s", "idle s", "tiles", "steals");
+  const std::vector<TileSchedulerThreadStats>& threadStats = scheduler.getThreadStats();
+  for (size_t i = 0; i < threadStats.size(); i++)
+    printf("%-8zu %10.3f %10.3f %8u %8u\n", i, threadStats[i].busyTime, threadStats[i].idleTime, threadStats[i].numTiles, threadStats[i].numSteals);
+  printf("Load imbalance (busiest thread over the mean): %.3f%s\n", scheduler.calcImbalance(), pinThreads ? ", pinned threads" : "");
+
+  return 0;
+}
+
+int runWorker(int argc, char* argv[]) {
+  std::string address = argv[2];
+  u32 numThreads = std::thread::hardware_concurrency();
+
+  for (int i = 3; i + 1 < argc; i++)
+    if (std::string(argv[i]) == "--threads")
+      numThreads = static_cast<u32>(std::atoi(argv[++i]));
+
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    warning(std::format("[tracer::runWorker] Expected the coordinator as <host>:<port>, got [{}]", address));
+    return 1;
+  }
+
+  return distributed::runWorker(address.substr(0, colon), static_cast<u16>(std::atoi(address.c_str() + colon + 1)), numThreads);
+}
+
+} // namespace tracer
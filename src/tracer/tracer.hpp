@@ -0,0 +1,13 @@
+#pragma once
+
+// Headless CPU renders, launched with `--render <scene> [frames] [width]x[height] [output] [--threads n] [--pin] [--streams]
+// [--time seconds] [--spp n] [--workers n] [--listen port] [--denoise] [--lazy-bvh]`, the time and spp budgets replace
+// the frame count. With --workers or --listen the tiles go to worker processes: n spawned on this host and any
+// connecting to the port. --denoise filters the local renders as denoise.frag before writing them. --lazy-bvh builds
+// the mesh BVHs as the rays reach them (LazyBVH), the first frame starts before the whole scene is built
+namespace tracer {
+  int run(int argc, char* argv[]);
+
+  // `--worker <host>:<port> [--threads n]`, renders tiles for a coordinator
+  int runWorker(int argc, char* argv[]);
+}